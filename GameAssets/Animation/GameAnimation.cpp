@@ -0,0 +1,845 @@
+#include "GameAnimation.h"
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Quantization                                                                                                                                 |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+const float SMALLEST_THREE_RANGE = 0.70710678f;
+const float SMALLEST_THREE_MAX = 32767.0f;
+const float SMALLEST_THREE_STEP = 2.0f * SMALLEST_THREE_RANGE / SMALLEST_THREE_MAX;
+const uint32 SMALLEST_THREE_MASK = 0x7FFF;
+
+inline void Quantize(v3 Value, v3 Min, v3 Step, uint16* Out) {
+    float* V = &Value.X;
+    float* M = &Min.X;
+    float* S = &Step.X;
+    for (int i = 0; i < 3; i++) {
+        Out[i] = S[i] > 0 ? (uint16)(Clamp((V[i] - M[i]) / S[i], 0.0f, 65535.0f) + 0.5f) : 0;
+    }
+}
+
+inline v3 Dequantize(uint16* Value, v3 Min, v3 Step) {
+    return V3(Min.X + Value[0] * Step.X, Min.Y + Value[1] * Step.Y, Min.Z + Value[2] * Step.Z);
+}
+
+inline void Quantize(quaternion Q, uint16* Out) {
+    Q = normalize(Q);
+    float C[4] = { Q.c, Q.i, Q.j, Q.k };
+    int Largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (fabsf(C[i]) > fabsf(C[Largest])) Largest = i;
+    }
+
+    float Sign = C[Largest] < 0 ? -1.0f : 1.0f;
+    int n = 0;
+    for (int i = 0; i < 4; i++) {
+        if (i == Largest) continue;
+        float Unit = Clamp((Sign * C[i] + SMALLEST_THREE_RANGE) / (2.0f * SMALLEST_THREE_RANGE), 0.0f, 1.0f);
+        Out[n++] = (uint16)(Unit * SMALLEST_THREE_MAX + 0.5f);
+    }
+    Out[0] |= (Largest & 1) << 15;
+    Out[1] |= (Largest >> 1) << 15;
+}
+
+inline quaternion Dequantize(uint16* Value) {
+    int Largest = (Value[0] >> 15) | ((Value[1] >> 15) << 1);
+    float A = (Value[0] & SMALLEST_THREE_MASK) * SMALLEST_THREE_STEP - SMALLEST_THREE_RANGE;
+    float B = (Value[1] & SMALLEST_THREE_MASK) * SMALLEST_THREE_STEP - SMALLEST_THREE_RANGE;
+    float C = (Value[2] & SMALLEST_THREE_MASK) * SMALLEST_THREE_STEP - SMALLEST_THREE_RANGE;
+    float D = sqrtf(fmaxf(1.0f - A * A - B * B - C * C, 0.0f));
+    switch (Largest) {
+        case 0:  return Quaternion(D, A, B, C);
+        case 1:  return Quaternion(A, D, B, C);
+        case 2:  return Quaternion(A, B, D, C);
+        default: return Quaternion(A, B, C, D);
+    }
+}
+
+inline animation_key QuantizeKey(game_animation* Animation, animation_channel Channel, transform T, uint32 Frame) {
+    animation_key Result = {};
+    Result.Frame = (uint16)Frame;
+    switch (Channel) {
+        case Animation_Channel_Translation: {
+            Quantize(T.Translation, Animation->TranslationMin, Animation->TranslationStep, Result.Value);
+        } break;
+        case Animation_Channel_Rotation: {
+            Quantize(T.Rotation, Result.Value);
+        } break;
+        case Animation_Channel_Scale: {
+            Quantize(V3(T.Scale.X, T.Scale.Y, T.Scale.Z), Animation->ScaleMin, Animation->ScaleStep, Result.Value);
+        } break;
+    }
+    return Result;
+}
+
+// Writes the key into its channel of Out, the other channels are left as they are
+inline void Decode(game_animation* Animation, animation_channel Channel, animation_key* Key, transform* Out) {
+    switch (Channel) {
+        case Animation_Channel_Translation: {
+            Out->Translation = Dequantize(Key->Value, Animation->TranslationMin, Animation->TranslationStep);
+        } break;
+        case Animation_Channel_Rotation: {
+            Out->Rotation = Dequantize(Key->Value);
+        } break;
+        case Animation_Channel_Scale: {
+            v3 Scaling = Dequantize(Key->Value, Animation->ScaleMin, Animation->ScaleStep);
+            Out->Scale = Scale(Scaling.X, Scaling.Y, Scaling.Z);
+        } break;
+    }
+}
+
+// Angle between two rotations from the chord between them, acos loses too much precision near 1
+inline float AngleBetween(quaternion A, quaternion B) {
+    if (dot(A, B) < 0) B = -B;
+    quaternion Chord = A - B;
+    return 4.0f * asinf(fminf(0.5f * sqrtf(dot(Chord, Chord)), 1.0f));
+}
+
+inline float ScaleDistance(scale A, scale B) {
+    return modulus(V3(A.X - B.X, A.Y - B.Y, A.Z - B.Z));
+}
+
+inline bool IsWithinAnimationTolerance(animation_channel Channel, transform A, transform B) {
+    switch (Channel) {
+        case Animation_Channel_Translation: return modulus(A.Translation - B.Translation) <= ANIMATION_TRANSLATION_TOLERANCE;
+        case Animation_Channel_Rotation:    return AngleBetween(A.Rotation, B.Rotation) <= ANIMATION_ROTATION_TOLERANCE;
+        case Animation_Channel_Scale:       return ScaleDistance(A.Scale, B.Scale) <= ANIMATION_SCALE_TOLERANCE;
+    }
+    return false;
+}
+
+// The value the sampler will see for this frame once quantized
+inline transform RoundTrip(game_animation* Animation, animation_channel Channel, transform T) {
+    animation_key Key = QuantizeKey(Animation, Channel, T, 0);
+    Decode(Animation, Channel, &Key, &T);
+    return T;
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Compression                                                                                                                                  |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+/*
+    .anim files start with a header line ("nF 120 nB 20 fps 24.0 local 1") followed by one line per frame and bone:
+    Frame BoneID Translation Rotation Scale. Frames are baked, so they are compressed here and only the quantized keys
+    that interpolation can't reproduce reach the assets file. Without `local` the bones are skinning transforms.
+*/
+preprocessed_animation PreprocessAnimation(read_file_result File) {
+    preprocessed_animation Result = {};
+    Result.File = File;
+
+    if (File.ContentSize > 0) {
+        uint32 nFrames = 0, nBones = 0;
+        float FramesPerSecond = ANIMATION_DEFAULT_FPS;
+        bool Local = false;
+
+        tokenizer Tokenizer = InitTokenizer(File.Content);
+        token Token = RequireToken(Tokenizer, Token_Identifier);
+        while (Token.Type == Token_Identifier) {
+            if (Token == "nF")       nFrames = Parseuint32(Tokenizer);
+            else if (Token == "nB")  nBones = Parseuint32(Tokenizer);
+            else if (Token == "fps") FramesPerSecond = ParseFloat(Tokenizer);
+            else if (Token == "local") Local = Parseuint32(Tokenizer) != 0;
+            Token = GetToken(Tokenizer);
+        }
+
+        Result.Frames = new transform[nFrames * nBones];
+        Result.Keep = new bool[nFrames * nBones * animation_channel_count];
+
+        Tokenizer = InitTokenizer(File.Content);
+        AdvanceUntilLine(Tokenizer, 2);
+
+        transform* pOut = Result.Frames;
+        for (uint32 i = 0; i < nFrames; i++) {
+            for (uint32 j = 0; j < nBones; j++) {
+                uint32 Frame = Parseuint32(Tokenizer);
+                uint32 BoneID = Parseuint32(Tokenizer);
+                Assert(Frame == i && BoneID == j);
+
+                v3 Translation = ParseV3(Tokenizer);
+                quaternion Rotation = ParseQuaternion(Tokenizer);
+                v3 Scaling = ParseV3(Tokenizer);
+                *pOut++ = Transform(Translation, Rotation, Scale(Scaling.X, Scaling.Y, Scaling.Z));
+            }
+        }
+
+        InitializeAnimation(&Result.Animation, Result.Frames, nFrames, nBones, FramesPerSecond);
+        Result.Animation.Local = Local;
+        DecimateAnimation(&Result.Animation, Result.Frames, Result.Keep);
+    }
+    return Result;
+}
+
+// Header and per clip quantization ranges. Frames are stored frame major (Frames[Frame * nBones + Bone]).
+void InitializeAnimation(game_animation* Animation, transform* Frames, uint32 nFrames, uint32 nBones, float FramesPerSecond) {
+    Assert(nFrames <= 65536, "Animation has too many frames for 16 bit keys.");
+    *Animation = {};
+    Animation->nBones = nBones;
+    Animation->nFrames = nFrames;
+    Animation->FramesPerSecond = FramesPerSecond;
+    Animation->Duration = nFrames > 1 ? (float)(nFrames - 1) / FramesPerSecond : 0.0f;
+
+    if (nFrames * nBones == 0) return;
+
+    v3 TranslationMax = Frames[0].Translation;
+    v3 ScaleMax = V3(Frames[0].Scale.X, Frames[0].Scale.Y, Frames[0].Scale.Z);
+    Animation->TranslationMin = TranslationMax;
+    Animation->ScaleMin = ScaleMax;
+    for (uint32 i = 1; i < nFrames * nBones; i++) {
+        v3 Translation = Frames[i].Translation;
+        v3 Scaling = V3(Frames[i].Scale.X, Frames[i].Scale.Y, Frames[i].Scale.Z);
+        Animation->TranslationMin = V3(fminf(Animation->TranslationMin.X, Translation.X), fminf(Animation->TranslationMin.Y, Translation.Y), fminf(Animation->TranslationMin.Z, Translation.Z));
+        TranslationMax = V3(fmaxf(TranslationMax.X, Translation.X), fmaxf(TranslationMax.Y, Translation.Y), fmaxf(TranslationMax.Z, Translation.Z));
+        Animation->ScaleMin = V3(fminf(Animation->ScaleMin.X, Scaling.X), fminf(Animation->ScaleMin.Y, Scaling.Y), fminf(Animation->ScaleMin.Z, Scaling.Z));
+        ScaleMax = V3(fmaxf(ScaleMax.X, Scaling.X), fmaxf(ScaleMax.Y, Scaling.Y), fmaxf(ScaleMax.Z, Scaling.Z));
+    }
+    Animation->TranslationStep = (1.0f / 65535.0f) * (TranslationMax - Animation->TranslationMin);
+    Animation->ScaleStep = (1.0f / 65535.0f) * (ScaleMax - Animation->ScaleMin);
+}
+
+/*
+    Marks in `Keep` (Keep[(Frame * nBones + Bone) * animation_channel_count + Channel]) the frames that become keys,
+    and returns how many there are. Channels that stay at identity get no keys. The others are walked greedily: the
+    current key reaches as far forward as the frames in between can be interpolated from it, and the last frame is
+    dropped too when the channel holds still after its last key. Interpolation runs on the quantized keys, so the
+    tolerances bound the error the sampler will actually show.
+*/
+uint32 DecimateAnimation(game_animation* Animation, transform* Frames, bool* Keep) {
+    uint32 nFrames = Animation->nFrames;
+    uint32 nBones = Animation->nBones;
+    uint32 KeepStride = nBones * animation_channel_count;
+
+    uint32 nKeys = 0;
+    for (uint32 Bone = 0; Bone < nBones; Bone++) {
+        for (int c = 0; c < animation_channel_count; c++) {
+            animation_channel Channel = (animation_channel)c;
+            transform* Track = Frames + Bone;
+            bool* KeepTrack = Keep + Bone * animation_channel_count + Channel;
+
+            bool IsIdentity = true;
+            for (uint32 Frame = 0; Frame < nFrames; Frame++) {
+                KeepTrack[Frame * KeepStride] = false;
+                IsIdentity = IsIdentity && IsWithinAnimationTolerance(Channel, IdentityTransform, Track[Frame * nBones]);
+            }
+            if (IsIdentity) continue;
+
+            KeepTrack[0] = true;
+            nKeys++;
+
+            uint32 Start = 0;
+            transform StartKey = RoundTrip(Animation, Channel, Track[0]);
+            for (uint32 End = 2; End < nFrames; End++) {
+                transform EndKey = RoundTrip(Animation, Channel, Track[End * nBones]);
+                bool Fits = true;
+                for (uint32 Frame = Start + 1; Frame < End && Fits; Frame++) {
+                    float t = (float)(Frame - Start) / (float)(End - Start);
+                    Fits = IsWithinAnimationTolerance(Channel, Lerp(StartKey, EndKey, t), Track[Frame * nBones]);
+                }
+                if (!Fits) {
+                    Start = End - 1;
+                    StartKey = RoundTrip(Animation, Channel, Track[Start * nBones]);
+                    KeepTrack[Start * KeepStride] = true;
+                    nKeys++;
+                }
+            }
+
+            bool Holds = true;
+            for (uint32 Frame = Start + 1; Frame < nFrames && Holds; Frame++) {
+                Holds = IsWithinAnimationTolerance(Channel, StartKey, Track[Frame * nBones]);
+            }
+            if (!Holds) {
+                KeepTrack[(nFrames - 1) * KeepStride] = true;
+                nKeys++;
+            }
+        }
+    }
+
+    Animation->nKeys = nKeys;
+    return nKeys;
+}
+
+uint64 GetAnimationSize(uint32 nBones, uint32 nKeys) {
+    return nBones * animation_channel_count * sizeof(animation_track) + nKeys * sizeof(animation_key);
+}
+
+// Tracks and keys, in that order and contiguous, so the assets file only needs the pointers fixed up
+void WriteAnimation(memory_arena* Arena, game_animation* Animation, transform* Frames, bool* Keep) {
+    uint32 nBones = Animation->nBones;
+    Animation->Tracks = PushArray(Arena, nBones * animation_channel_count, animation_track);
+    Animation->Keys = PushArray(Arena, Animation->nKeys, animation_key);
+
+    uint32 Key = 0;
+    for (uint32 Bone = 0; Bone < nBones; Bone++) {
+        for (int c = 0; c < animation_channel_count; c++) {
+            animation_channel Channel = (animation_channel)c;
+            animation_track* Track = &Animation->Tracks[Bone * animation_channel_count + Channel];
+            Track->FirstKey = Key;
+            for (uint32 Frame = 0; Frame < Animation->nFrames; Frame++) {
+                if (Keep[(Frame * nBones + Bone) * animation_channel_count + Channel]) {
+                    Animation->Keys[Key++] = QuantizeKey(Animation, Channel, Frames[Frame * nBones + Bone], Frame);
+                }
+            }
+            Track->nKeys = Key - Track->FirstKey;
+        }
+    }
+    Assert(Key == Animation->nKeys);
+}
+
+// Largest difference between the baked frames and what the sampler returns at their times
+animation_error MeasureAnimationError(game_animation* Animation, transform* Frames) {
+    animation_error Result = {};
+    for (uint32 Frame = 0; Frame < Animation->nFrames; Frame++) {
+        for (uint32 Bone = 0; Bone < Animation->nBones; Bone++) {
+            transform Baked = Frames[Frame * Animation->nBones + Bone];
+            transform Sampled = Sample(Animation, Bone, Frame / Animation->FramesPerSecond);
+            Result.Translation = fmaxf(Result.Translation, modulus(Sampled.Translation - Baked.Translation));
+            Result.Rotation = fmaxf(Result.Rotation, AngleBetween(Sampled.Rotation, Baked.Rotation));
+            Result.Scale = fmaxf(Result.Scale, ScaleDistance(Sampled.Scale, Baked.Scale));
+        }
+    }
+    return Result;
+}
+
+game_animation LoadAnimation(memory_arena* Arena, preprocessed_animation* Preprocessed) {
+    game_animation Result = Preprocessed->Animation;
+    WriteAnimation(Arena, &Result, Preprocessed->Frames, Preprocessed->Keep);
+    Preprocessed->Error = MeasureAnimationError(&Result, Preprocessed->Frames);
+
+    delete [] Preprocessed->Frames;
+    delete [] Preprocessed->Keep;
+    Preprocessed->Frames = 0;
+    Preprocessed->Keep = 0;
+
+    return Result;
+}
+
+void SetAnimationPointers(game_animation* Animation, uint8* Memory) {
+    Animation->Tracks = (animation_track*)Memory;
+    Animation->Keys = (animation_key*)(Animation->Tracks + Animation->nBones * animation_channel_count);
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Sampling                                                                                                                                     |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+// Keys around Frame in a track with keys, and how far Frame is between them. Past either end both are the end key.
+inline float FindKeys(animation_key* Keys, uint32 nKeys, float Frame, animation_key** Low, animation_key** High) {
+    if (nKeys == 1 || Frame <= Keys[0].Frame) {
+        *Low = *High = Keys;
+        return 0;
+    }
+    if (Frame >= Keys[nKeys - 1].Frame) {
+        *Low = *High = Keys + nKeys - 1;
+        return 0;
+    }
+
+    uint32 L = 0, H = nKeys - 1;
+    while (H - L > 1) {
+        uint32 Middle = (L + H) / 2;
+        if (Keys[Middle].Frame <= Frame) L = Middle;
+        else                              H = Middle;
+    }
+    *Low = Keys + L;
+    *High = Keys + H;
+    return (Frame - Keys[L].Frame) / (float)(Keys[H].Frame - Keys[L].Frame);
+}
+
+// Pose of one bone at `Time` seconds, clamped to the ends of each track
+transform Sample(game_animation* Animation, uint32 Bone, float Time) {
+    float Frame = Time * Animation->FramesPerSecond;
+    transform Result = IdentityTransform;
+    for (int c = 0; c < animation_channel_count; c++) {
+        animation_channel Channel = (animation_channel)c;
+        animation_track Track = Animation->Tracks[Bone * animation_channel_count + Channel];
+        if (Track.nKeys == 0) continue;
+
+        animation_key *Low, *High;
+        float t = FindKeys(Animation->Keys + Track.FirstKey, Track.nKeys, Frame, &Low, &High);
+        transform A = IdentityTransform, B = IdentityTransform;
+        Decode(Animation, Channel, Low, &A);
+        Decode(Animation, Channel, High, &B);
+        transform Lerped = Lerp(A, B, t);
+        switch (Channel) {
+            case Animation_Channel_Translation: Result.Translation = Lerped.Translation; break;
+            case Animation_Channel_Rotation:    Result.Rotation = Lerped.Rotation; break;
+            case Animation_Channel_Scale:       Result.Scale = Lerped.Scale; break;
+        }
+    }
+    return Result;
+}
+
+// Quantized keys of one channel for four bones, lanes whose track has no keys (or skipped) are flagged in Empty
+struct wide_animation_keys {
+    __m128i Low[3];
+    __m128i High[3];
+    wide_float t;
+    wide_float Empty;
+};
+
+inline void GatherKeys(game_animation* Animation, uint32 FirstBone, animation_channel Channel, float Frame, uint32 SkipLanes, wide_animation_keys* Out) {
+    int32 Low[3][4], High[3][4], Empty[4];
+    float t[4];
+    for (int Lane = 0; Lane < 4; Lane++) {
+        uint32 Bone = min(FirstBone + Lane, Animation->nBones - 1);
+        animation_track Track = Animation->Tracks[Bone * animation_channel_count + Channel];
+        animation_key Zero = {};
+        animation_key *LowKey = &Zero, *HighKey = &Zero;
+        if (SkipLanes & (1u << Lane)) Track.nKeys = 0;
+        t[Lane] = 0;
+        Empty[Lane] = Track.nKeys == 0 ? -1 : 0;
+        if (Track.nKeys > 0) {
+            t[Lane] = FindKeys(Animation->Keys + Track.FirstKey, Track.nKeys, Frame, &LowKey, &HighKey);
+        }
+        for (int i = 0; i < 3; i++) {
+            Low[i][Lane] = LowKey->Value[i];
+            High[i][Lane] = HighKey->Value[i];
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        Out->Low[i] = _mm_loadu_si128((__m128i*)Low[i]);
+        Out->High[i] = _mm_loadu_si128((__m128i*)High[i]);
+    }
+    Out->t = LoadWide(t);
+    Out->Empty = WideFloat(_mm_castsi128_ps(_mm_loadu_si128((__m128i*)Empty)));
+}
+
+inline wide_v3 Dequantize(__m128i* Value, v3 Min, v3 Step) {
+    return {
+        Step.X * WideFloat(_mm_cvtepi32_ps(Value[0])) + Min.X,
+        Step.Y * WideFloat(_mm_cvtepi32_ps(Value[1])) + Min.Y,
+        Step.Z * WideFloat(_mm_cvtepi32_ps(Value[2])) + Min.Z
+    };
+}
+
+inline wide_quaternion Dequantize(__m128i* Value) {
+    __m128i Mask = _mm_set1_epi32(SMALLEST_THREE_MASK);
+    __m128i Largest = _mm_or_si128(_mm_srli_epi32(Value[0], 15), _mm_slli_epi32(_mm_srli_epi32(Value[1], 15), 1));
+    wide_float A = SMALLEST_THREE_STEP * WideFloat(_mm_cvtepi32_ps(_mm_and_si128(Value[0], Mask))) - SMALLEST_THREE_RANGE;
+    wide_float B = SMALLEST_THREE_STEP * WideFloat(_mm_cvtepi32_ps(_mm_and_si128(Value[1], Mask))) - SMALLEST_THREE_RANGE;
+    wide_float C = SMALLEST_THREE_STEP * WideFloat(_mm_cvtepi32_ps(_mm_and_si128(Value[2], Mask))) - SMALLEST_THREE_RANGE;
+    wide_float D = Sqrt(Max(WideFloat(1.0f) - A * A - B * B - C * C, WideFloat(0.0f)));
+
+    wide_float Is0 = WideFloat(_mm_castsi128_ps(_mm_cmpeq_epi32(Largest, _mm_set1_epi32(0))));
+    wide_float Is1 = WideFloat(_mm_castsi128_ps(_mm_cmpeq_epi32(Largest, _mm_set1_epi32(1))));
+    wide_float Is2 = WideFloat(_mm_castsi128_ps(_mm_cmpeq_epi32(Largest, _mm_set1_epi32(2))));
+    wide_float Is3 = WideFloat(_mm_castsi128_ps(_mm_cmpeq_epi32(Largest, _mm_set1_epi32(3))));
+    return {
+        Select(Is0, D, A),
+        Select(Is0, A, Select(Is1, D, B)),
+        Select(Is2, D, Select(Is3, C, B)),
+        Select(Is3, D, C)
+    };
+}
+
+inline wide_v3 Lerp(wide_v3 A, wide_v3 B, wide_float t) {
+    return (WideFloat(1.0f) - t) * A + t * B;
+}
+
+inline wide_v3 Select(wide_float Mask, v3 A, wide_v3 B) {
+    return { Select(Mask, WideFloat(A.X), B.X), Select(Mask, WideFloat(A.Y), B.Y), Select(Mask, WideFloat(A.Z), B.Z) };
+}
+
+struct wide_transform {
+    wide_v3 Translation;
+    wide_quaternion Rotation;
+    wide_v3 Scale;
+};
+
+// Pose of bones [First, First + 4), dequantized and interpolated in SSE once the keys are found per bone
+inline wide_transform SampleWide(game_animation* Animation, uint32 First, float Frame, uint32 SkipLanes = 0) {
+    wide_animation_keys Keys[animation_channel_count];
+    for (int c = 0; c < animation_channel_count; c++) {
+        GatherKeys(Animation, First, (animation_channel)c, Frame, SkipLanes, &Keys[c]);
+    }
+
+    wide_transform Result;
+    wide_animation_keys* T = &Keys[Animation_Channel_Translation];
+    Result.Translation = Lerp(
+        Dequantize(T->Low, Animation->TranslationMin, Animation->TranslationStep),
+        Dequantize(T->High, Animation->TranslationMin, Animation->TranslationStep),
+        T->t
+    );
+    Result.Translation = Select(T->Empty, V3(0, 0, 0), Result.Translation);
+
+    wide_animation_keys* R = &Keys[Animation_Channel_Rotation];
+    Result.Rotation = Lerp(Dequantize(R->Low), Dequantize(R->High), R->t);
+    Result.Rotation.c = Select(R->Empty, WideFloat(1.0f), Result.Rotation.c);
+    Result.Rotation.i = Select(R->Empty, WideFloat(0.0f), Result.Rotation.i);
+    Result.Rotation.j = Select(R->Empty, WideFloat(0.0f), Result.Rotation.j);
+    Result.Rotation.k = Select(R->Empty, WideFloat(0.0f), Result.Rotation.k);
+
+    wide_animation_keys* S = &Keys[Animation_Channel_Scale];
+    Result.Scale = Lerp(
+        Dequantize(S->Low, Animation->ScaleMin, Animation->ScaleStep),
+        Dequantize(S->High, Animation->ScaleMin, Animation->ScaleStep),
+        S->t
+    );
+    Result.Scale = Select(S->Empty, V3(1, 1, 1), Result.Scale);
+    return Result;
+}
+
+inline void StoreTransforms(wide_transform* Pose, armature* Armature, uint32 First) {
+    float Out[10][4];
+    StoreWide(Out[0], Pose->Translation.X);
+    StoreWide(Out[1], Pose->Translation.Y);
+    StoreWide(Out[2], Pose->Translation.Z);
+    StoreWide(Out[3], Pose->Rotation.c);
+    StoreWide(Out[4], Pose->Rotation.i);
+    StoreWide(Out[5], Pose->Rotation.j);
+    StoreWide(Out[6], Pose->Rotation.k);
+    StoreWide(Out[7], Pose->Scale.X);
+    StoreWide(Out[8], Pose->Scale.Y);
+    StoreWide(Out[9], Pose->Scale.Z);
+
+    uint32 nLanes = min(Armature->nBones - First, 4u);
+    for (uint32 Lane = 0; Lane < nLanes; Lane++) {
+        transform* Transform = &Armature->Bones[First + Lane].Transform;
+        Transform->Translation = V3(Out[0][Lane], Out[1][Lane], Out[2][Lane]);
+        Transform->Rotation = Quaternion(Out[3][Lane], Out[4][Lane], Out[5][Lane], Out[6][Lane]);
+        Transform->Scale = Scale(Out[7][Lane], Out[8][Lane], Out[9][Lane]);
+    }
+}
+
+// Rows of four matrices given one wide value per column, transposed so each lane lands in its own matrix
+inline void StoreRows(matrix4* Matrices, int Row, uint32 nLanes, wide_float X, wide_float Y, wide_float Z, wide_float W) {
+    __m128 R0 = X.V, R1 = Y.V, R2 = Z.V, R3 = W.V;
+    _MM_TRANSPOSE4_PS(R0, R1, R2, R3);
+    __m128 Rows[4] = { R0, R1, R2, R3 };
+    for (uint32 Lane = 0; Lane < nLanes; Lane++) {
+        _mm_storeu_ps(Matrices[Lane].Array + 4 * Row, Rows[Lane]);
+    }
+}
+
+/*
+    Skinning and normal matrices of four bones, the same as `Matrix(Transform)` and `inverse` of its upper 3x3 (which
+    is the inverse transpose). Bones are exported already in model space, so this is the whole local to model step.
+    Rotation matrices are orthonormal, so the normal matrix is the rotation with each row divided by its scale.
+*/
+inline void StoreMatrices(wide_transform* Pose, bone_palette* Palette, uint32 First, uint32 nBones, bool WithNormals) {
+    wide_quaternion Q = Pose->Rotation;
+    wide_float One = WideFloat(1.0f), Two = WideFloat(2.0f), Zero = WideFloat(0.0f);
+    wide_float XX = Two * (Q.c * Q.c + Q.i * Q.i) - One;
+    wide_float XY = Two * (Q.i * Q.j - Q.c * Q.k);
+    wide_float XZ = Two * (Q.i * Q.k + Q.c * Q.j);
+    wide_float YX = Two * (Q.i * Q.j + Q.c * Q.k);
+    wide_float YY = Two * (Q.c * Q.c + Q.j * Q.j) - One;
+    wide_float YZ = Two * (Q.j * Q.k - Q.c * Q.i);
+    wide_float ZX = Two * (Q.i * Q.k - Q.c * Q.j);
+    wide_float ZY = Two * (Q.j * Q.k + Q.c * Q.i);
+    wide_float ZZ = Two * (Q.c * Q.c + Q.k * Q.k) - One;
+
+    wide_v3 S = Pose->Scale;
+    wide_v3 T = Pose->Translation;
+    uint32 nLanes = min(nBones - First, 4u);
+    matrix4* Transforms = Palette->bone_transforms + First;
+    StoreRows(Transforms, 0, nLanes, S.X * XX, S.X * XY, S.X * XZ, Zero);
+    StoreRows(Transforms, 1, nLanes, S.Y * YX, S.Y * YY, S.Y * YZ, Zero);
+    StoreRows(Transforms, 2, nLanes, S.Z * ZX, S.Z * ZY, S.Z * ZZ, Zero);
+    StoreRows(Transforms, 3, nLanes, T.X, T.Y, T.Z, One);
+    if (!WithNormals) return;
+
+    wide_v3 InvS = { One / S.X, One / S.Y, One / S.Z };
+    matrix4* Normals = Palette->bone_normal_transforms + First;
+    StoreRows(Normals, 0, nLanes, InvS.X * XX, InvS.X * XY, InvS.X * XZ, Zero);
+    StoreRows(Normals, 1, nLanes, InvS.Y * YX, InvS.Y * YY, InvS.Y * YZ, Zero);
+    StoreRows(Normals, 2, nLanes, InvS.Z * ZX, InvS.Z * ZY, InvS.Z * ZZ, Zero);
+    StoreRows(Normals, 3, nLanes, Zero, Zero, Zero, One);
+}
+
+/*
+    Pose of the whole armature, four bones at a time. Matches the per bone Sample up to rounding. Lanes past the last
+    bone repeat it and are not written.
+*/
+void Sample(game_animation* Animation, float Time, armature* Armature) {
+    Assert(Armature->nBones <= Animation->nBones, "Animation doesn't cover the armature.");
+    float Frame = Time * Animation->FramesPerSecond;
+    for (uint32 First = 0; First < Armature->nBones; First += 4) {
+        wide_transform Pose = SampleWide(Animation, First, Frame);
+        StoreTransforms(&Pose, Armature, First);
+    }
+}
+
+/*
+    Same pose, also written to the palette while it is still in registers. Armatures with a bind pose get local
+    matrices here that ComposePalette then turns into skinning matrices.
+*/
+void Sample(game_animation* Animation, float Time, armature* Armature, bone_palette* Palette, uint32 SkipBones) {
+    Assert(Armature->nBones <= Animation->nBones, "Animation doesn't cover the armature.");
+    Assert(Animation->Local == Armature->HasBindPose, "Animation and armature were exported for different bone spaces.");
+    float Frame = Time * Animation->FramesPerSecond;
+    for (uint32 First = 0; First < Armature->nBones; First += 4) {
+        wide_transform Pose = SampleWide(Animation, First, Frame, (SkipBones >> First) & 0xF);
+        StoreTransforms(&Pose, Armature, First);
+        StoreMatrices(&Pose, Palette, First, Armature->nBones, !Armature->HasBindPose);
+    }
+    // Skipped bones keep their rest pose instead of the identity their empty tracks sampled to
+    for (uint32 i = 0; i < Armature->nBones; i++) {
+        if (!(SkipBones & (1u << i))) continue;
+        bone* Bone = &Armature->Bones[i];
+        Bone->Transform = Bone->Rest;
+        Palette->bone_transforms[i] = Matrix(Bone->Rest);
+        if (!Armature->HasBindPose) Palette->bone_normal_transforms[i] = Matrix4(inverse(Matrix3(Palette->bone_transforms[i])));
+    }
+    if (Armature->HasBindPose) ComposePalette(Armature, Palette);
+    Palette->n_bones = Armature->nBones;
+}
+
+// operator* in SSE: rows of A combine the rows of B, so A is applied first
+inline void Multiply(matrix4* A, matrix4* B, matrix4* Out) {
+    __m128 B0 = _mm_loadu_ps(B->Array);
+    __m128 B1 = _mm_loadu_ps(B->Array + 4);
+    __m128 B2 = _mm_loadu_ps(B->Array + 8);
+    __m128 B3 = _mm_loadu_ps(B->Array + 12);
+    for (int Row = 0; Row < 4; Row++) {
+        float* a = A->Element[Row];
+        __m128 Result = _mm_mul_ps(_mm_set1_ps(a[0]), B0);
+        Result = _mm_add_ps(Result, _mm_mul_ps(_mm_set1_ps(a[1]), B1));
+        Result = _mm_add_ps(Result, _mm_mul_ps(_mm_set1_ps(a[2]), B2));
+        Result = _mm_add_ps(Result, _mm_mul_ps(_mm_set1_ps(a[3]), B3));
+        _mm_storeu_ps(Out->Element[Row], Result);
+    }
+}
+
+/*
+    Turns the local matrices in the palette into skinning matrices in one pass down the hierarchy (parents are sorted
+    first): model = local * parent model, skinning = inverse bind * model. Normal matrices are rebuilt from the result,
+    since a parent scale leaves the rotation rows of the children no longer orthogonal.
+*/
+void ComposePalette(armature* Armature, bone_palette* Palette) {
+    matrix4 Model[MAX_ARMATURE_BONES];
+    for (uint32 i = 0; i < Armature->nBones; i++) {
+        bone* Bone = &Armature->Bones[i];
+        if (Bone->Parent >= 0) Multiply(&Palette->bone_transforms[i], &Model[Bone->Parent], &Model[i]);
+        else Model[i] = Palette->bone_transforms[i];
+        Multiply(&Bone->InverseBind, &Model[i], &Palette->bone_transforms[i]);
+        Palette->bone_normal_transforms[i] = Matrix4(inverse(Matrix3(Palette->bone_transforms[i])));
+    }
+}
+
+inline void Advance(game_animator* Animator, float dt) {
+    game_animation* Animation = Animator->Animation;
+    Animator->Time += dt;
+    if (Animator->Time >= Animation->Duration) {
+        if (Animator->Loop && Animation->Duration > 0) {
+            Animator->Time = fmodf(Animator->Time, Animation->Duration);
+        }
+        else {
+            Animator->Time = 0;
+            if (!Animator->Loop) Animator->Active = false;
+        }
+    }
+}
+
+void Update(game_animator* Animator, float dt, uint32 SkipBones) {
+    game_animation* Animation = Animator->Animation;
+    armature* Armature = Animator->Armature;
+
+    if (Animator->Active) {
+        if (Animator->Palette != NULL) Sample(Animation, Animator->Time, Armature, Animator->Palette, SkipBones);
+        else Sample(Animation, Animator->Time, Armature);
+        Advance(Animator, dt);
+    }
+    else {
+        // Rest pose, where skinning leaves the mesh as it is
+        for (int i = 0; i < Armature->nBones; i++) {
+            Armature->Bones[i].Transform = Armature->Bones[i].Rest;
+        }
+        if (Animator->Palette != NULL) {
+            bone_palette* Palette = Animator->Palette;
+            for (int i = 0; i < Armature->nBones; i++) {
+                Palette->bone_transforms[i] = Identity4;
+                Palette->bone_normal_transforms[i] = Identity4;
+            }
+            Palette->n_bones = Armature->nBones;
+        }
+    }
+}
+
+// Where a point of the bind pose mesh ends up in model space when it follows the bone
+v3 SkinPoint(bone_palette* Palette, uint32 Bone, v3 Point) {
+    matrix4* M = &Palette->bone_transforms[Bone];
+    return V3(
+        Point.X * M->XX + Point.Y * M->YX + Point.Z * M->ZX + M->WX,
+        Point.X * M->XY + Point.Y * M->YY + Point.Z * M->ZY + M->WY,
+        Point.X * M->XZ + Point.Y * M->YZ + Point.Z * M->ZZ + M->WZ
+    );
+}
+
+// Skinning matrix of a bone back as a transform, for attaching entities. Shear from non uniform parent scales is lost.
+transform GetBoneTransform(bone_palette* Palette, uint32 Bone) {
+    matrix4* M = &Palette->bone_transforms[Bone];
+    v3 X = V3(M->XX, M->XY, M->XZ);
+    v3 Y = V3(M->YX, M->YY, M->YZ);
+    v3 Z = V3(M->ZX, M->ZY, M->ZZ);
+    transform Result;
+    Result.Translation = V3(M->WX, M->WY, M->WZ);
+    Result.Scale = Scale(modulus(X), modulus(Y), modulus(Z));
+    matrix3 Rotation = {};
+    Rotation.X = X / Result.Scale.X;
+    Rotation.Y = Y / Result.Scale.Y;
+    Rotation.Z = Z / Result.Scale.Z;
+    Result.Rotation = Quaternion(Rotation);
+    return Result;
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Animation system                                                                                                                             |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+// Including the padding to align the palettes
+uint64 GetAnimationSystemSize(uint32 MaxAnimators) {
+    return sizeof(animation_system) + MaxAnimators * (sizeof(game_animator*) + sizeof(animator_lod) + 2 * sizeof(bone_palette)) + 15;
+}
+
+animation_system* AllocateAnimationSystem(memory_arena* Arena, uint32 MaxAnimators) {
+    animation_system* Result = PushStruct(Arena, animation_system);
+    Result->nAnimators = 0;
+    Result->MaxAnimators = MaxAnimators;
+    Result->Animators = PushArray(Arena, MaxAnimators, game_animator*);
+    Result->LODs = PushArray(Arena, MaxAnimators, animator_lod);
+    // The palette type is 16 byte aligned but the arena doesn't align pushes
+    memory_index Palettes = (memory_index)PushSize(Arena, 2 * MaxAnimators * sizeof(bone_palette) + 15);
+    Result->Palettes = (bone_palette*)((Palettes + 15) & ~(memory_index)15);
+    Result->Targets = Result->Palettes + MaxAnimators;
+    Result->Settings = DEFAULT_ANIMATION_LOD;
+    Result->Stats = {};
+    Result->dt = 0;
+    return Result;
+}
+
+void ClearAnimators(animation_system* System) {
+    System->nAnimators = 0;
+}
+
+/*
+    Palettes are handed out in gather order, so they stay valid until the next ClearAnimators. Distance to the camera
+    and whether the animator is in view pick its level of detail.
+*/
+void PushAnimator(animation_system* System, game_animator* Animator, float Distance, bool Visible) {
+    Assert(System->nAnimators < System->MaxAnimators, "Too many animators.");
+    uint32 Index = System->nAnimators++;
+    System->Animators[Index] = Animator;
+    animator_lod* LOD = &System->LODs[Index];
+    LOD->Distance = Distance;
+    LOD->Visible = Visible;
+    LOD->Reset = Animator->Palette != &System->Palettes[Index];
+    LOD->Skip = false;
+    LOD->SkipBones = 0;
+    Animator->Palette = &System->Palettes[Index];
+}
+
+inline uint32 GetInterval(animation_lod_settings* Settings, animator_lod* LOD) {
+    uint32 Result = 1;
+    if (LOD->Distance > Settings->FarDistance) Result = Settings->FarInterval;
+    else if (LOD->Distance > Settings->ReducedDistance) Result = Settings->ReducedInterval;
+    if (!LOD->Visible) Result = max(Result, Settings->CulledInterval);
+    return max(Result, 1u);
+}
+
+/*
+    Picks the interval of every animator and how many evaluations it needs this tick, within the budget. Full rate
+    animators are scheduled first. Animators that just got their palette are always evaluated, there is no pose to hold
+    in it yet.
+*/
+void ScheduleAnimators(animation_system* System) {
+    animation_lod_settings* Settings = &System->Settings;
+    animation_lod_stats* Stats = &System->Stats;
+    *Stats = {};
+    uint32 Budget = Settings->MaxEvaluations;
+    for (int Pass = 0; Pass < 2; Pass++) {
+        for (uint32 i = 0; i < System->nAnimators; i++) {
+            game_animator* Animator = System->Animators[i];
+            animator_lod* LOD = &System->LODs[i];
+            uint32 Interval = GetInterval(Settings, LOD);
+            if ((Interval == 1) != (Pass == 0)) continue;
+
+            // Nothing to blend from
+            if (LOD->Reset || !Animator->Active || Interval != Animator->Interval) Animator->Countdown = 0;
+            Animator->Interval = Interval;
+            if (LOD->Distance > Settings->LeafDistance && Animator->Armature->LeafBones != 0) {
+                LOD->SkipBones = Animator->Armature->LeafBones;
+                Stats->nLeafDropped++;
+            }
+
+            if (Interval == 1) Stats->nFull++;
+            else if (!LOD->Visible) Stats->nCulled++;
+            else Stats->nReduced++;
+
+            uint32 Cost = 0;
+            if (Animator->Active) {
+                if (Interval == 1 || Animator->Countdown == 1) Cost = 1;
+                else if (Animator->Countdown == 0) Cost = 2;
+            }
+            if (Cost > Budget && !LOD->Reset) {
+                LOD->Skip = true;
+                Stats->nSkipped++;
+                continue;
+            }
+            Budget -= min(Cost, Budget);
+            Stats->nEvaluations += Cost;
+        }
+    }
+}
+
+inline void BlendPalette(bone_palette* Palette, bone_palette* Target, uint32 nBones, float t) {
+    __m128 T = _mm_set1_ps(t);
+    float* From[2] = { Palette->bone_transforms[0].Array, Palette->bone_normal_transforms[0].Array };
+    float* To[2] = { Target->bone_transforms[0].Array, Target->bone_normal_transforms[0].Array };
+    for (int m = 0; m < 2; m++) {
+        for (uint32 i = 0; i < 16 * nBones; i += 4) {
+            __m128 A = _mm_load_ps(From[m] + i);
+            __m128 B = _mm_load_ps(To[m] + i);
+            _mm_store_ps(From[m] + i, _mm_add_ps(A, _mm_mul_ps(_mm_sub_ps(B, A), T)));
+        }
+    }
+}
+
+/*
+    Reduced rate: the pose one interval ahead goes to the target palette and the palette covers 1/Countdown of what is
+    left to it every tick. With nothing to blend from the current pose is sampled too. The armature transforms hold
+    the target pose meanwhile.
+*/
+void UpdateReduced(game_animator* Animator, animator_lod* LOD, bone_palette* Target, float dt) {
+    game_animation* Animation = Animator->Animation;
+    armature* Armature = Animator->Armature;
+    if (LOD->Skip) {
+        Advance(Animator, dt);
+        return;
+    }
+
+    if (Animator->Countdown == 0) {
+        Sample(Animation, Animator->Time, Armature, Animator->Palette, LOD->SkipBones);
+    }
+    else {
+        BlendPalette(Animator->Palette, Target, Armature->nBones, 1.0f / Animator->Countdown);
+        Animator->Countdown--;
+    }
+
+    if (Animator->Countdown == 0) {
+        float Ahead = Animator->Time + Animator->Interval * dt;
+        if (Animator->Loop && Animation->Duration > 0) Ahead = fmodf(Ahead, Animation->Duration);
+        else Ahead = min(Ahead, Animation->Duration);
+        Sample(Animation, Ahead, Armature, Target, LOD->SkipBones);
+        Animator->Countdown = Animator->Interval;
+    }
+    Advance(Animator, dt);
+}
+
+PARALLEL_FOR_CALLBACK(EvaluateAnimators) {
+    animation_system* System = (animation_system*)Data;
+    for (uint32 i = Start; i < End; i++) {
+        game_animator* Animator = System->Animators[i];
+        animator_lod* LOD = &System->LODs[i];
+        if (!Animator->Active) Update(Animator, System->dt);
+        else if (Animator->Interval > 1) UpdateReduced(Animator, LOD, &System->Targets[i], System->dt);
+        else if (LOD->Skip) Advance(Animator, System->dt);
+        else Update(Animator, System->dt, LOD->SkipBones);
+    }
+}
+
+// Samples every gathered animator into its palette (or toward it, at reduced rate) and advances it by dt
+void UpdateAnimators(platform_api* Platform, animation_system* System, float dt) {
+    System->dt = dt;
+    ScheduleAnimators(System);
+    ParallelFor(Platform, System->nAnimators, 8, EvaluateAnimators, System);
+}
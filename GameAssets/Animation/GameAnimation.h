@@ -0,0 +1,180 @@
+#include "GamePlatform.h"
+#include "GameMath.h"
+#include "GameMathWide.h"
+#include "Mesh/GameMesh.h"
+
+#ifndef GAME_ANIMATION
+#define GAME_ANIMATION
+
+enum game_animation_id {
+    Animation_Idle_ID,
+    Animation_Walk_ID,
+    Animation_Jump_ID,
+    Animation_Attack_ID,
+
+    game_animation_id_count
+};
+
+// Files exported before the header carried a frame rate were played one frame per tick at the default tick rate
+const float ANIMATION_DEFAULT_FPS = 60.0f;
+
+// Decimation tolerances. A baked frame is dropped when interpolating the keys around it lands this close to it.
+const float ANIMATION_TRANSLATION_TOLERANCE = 0.001f;
+const float ANIMATION_SCALE_TOLERANCE = 0.001f;
+const float ANIMATION_ROTATION_TOLERANCE = 0.1f * Degrees;
+
+enum animation_channel {
+    Animation_Channel_Translation,
+    Animation_Channel_Rotation,
+    Animation_Channel_Scale,
+
+    animation_channel_count
+};
+
+/*
+    Every bone has one track per channel with its keys sorted by frame, so channels that barely move take one or two
+    keys while the rest keep as many as they need, and channels that stay at identity take none.
+
+    Keys are quantized to 16 bits per component:
+        - Translation and scale are offsets in the range the clip spans on each axis (`Min + Value * Step`).
+        - Rotations are stored as the smallest three: the largest component is dropped (the quaternion is negated so
+          it is positive and can be rebuilt) and the other three, all in [-1/sqrt(2), 1/sqrt(2)], take 15 bits each.
+          The dropped index takes the top bit of the first two values.
+*/
+struct animation_key {
+    uint16 Frame;
+    uint16 Value[3];
+};
+
+struct animation_track {
+    uint32 FirstKey;
+    uint32 nKeys;
+};
+
+struct game_animation {
+    game_animation_id ID;
+    uint32 nBones;
+    uint32 nFrames;
+    uint32 nKeys;
+    float FramesPerSecond;
+    float Duration;
+    bool Local;                 // Tracks relative to the parent bone, for armatures with a bind pose
+    v3 TranslationMin;
+    v3 TranslationStep;
+    v3 ScaleMin;
+    v3 ScaleStep;
+    animation_track* Tracks;    // nBones * animation_channel_count, bone major
+    animation_key* Keys;
+};
+
+struct animation_error {
+    float Translation;
+    float Rotation;
+    float Scale;
+};
+
+// Baked frames as read from the file, kept until the animation is written to the assets file
+struct preprocessed_animation {
+    read_file_result File;
+    game_animation Animation;
+    transform* Frames;
+    bool* Keep;
+    animation_error Error;
+};
+
+/*
+    Skinning matrices of one posed armature, parent transforms and inverse bind poses already applied, and their normal
+    matrices. Laid out as the bones uniform block so the renderer uploads it as is, and read by anything else that
+    needs where a bone is (debug drawing, attachments) instead of composing the hierarchy again.
+*/
+typedef bone_uniforms bone_palette;
+
+struct game_animator {
+    game_animation* Animation;
+    armature* Armature;
+    bone_palette* Palette;      // Written by the animation system every tick
+    float Time;
+    bool Active;
+    bool Loop;
+    uint32 Interval;            // Ticks between evaluations, picked by the level of detail
+    uint32 Countdown;           // Ticks left until the palette reaches the last evaluation
+};
+
+const uint32 MAX_ANIMATORS = 512;
+
+/*
+    Animation level of detail. Animators far from the camera or out of view are evaluated every few ticks, one interval
+    ahead, and their palettes blended toward that pose in between, so they land on the exact pose every interval.
+    Past LeafDistance the leaf bones (fingers, toes, ...) are left at rest and not sampled. Settings can be changed
+    any tick.
+*/
+struct animation_lod_settings {
+    float ReducedDistance;      // Evaluated every ReducedInterval ticks past this distance
+    float FarDistance;          // Every FarInterval ticks past this one
+    float LeafDistance;
+    uint32 ReducedInterval;
+    uint32 FarInterval;
+    uint32 CulledInterval;      // Out of view, whatever the distance
+    uint32 MaxEvaluations;      // Per tick. Animators due over the budget hold their pose, full rate ones go first.
+};
+
+const animation_lod_settings DEFAULT_ANIMATION_LOD = { 30.0f, 80.0f, 50.0f, 2, 4, 8, 256 };
+
+struct animation_lod_stats {
+    uint32 nFull;
+    uint32 nReduced;
+    uint32 nCulled;
+    uint32 nSkipped;            // Due for an evaluation but over the budget
+    uint32 nLeafDropped;
+    uint32 nEvaluations;
+};
+
+// Gathered with every animator each tick
+struct animator_lod {
+    float Distance;
+    bool Visible;
+    bool Reset;                 // Palette moved since the last tick, nothing to blend from
+    bool Skip;
+    uint32 SkipBones;
+};
+
+/*
+    Animators gathered every tick, each one with its palette in one contiguous buffer. Poses are evaluated as parallel
+    jobs over this list instead of inside the systems that own the animators.
+*/
+struct animation_system {
+    uint32 nAnimators;
+    uint32 MaxAnimators;
+    game_animator** Animators;
+    animator_lod* LODs;
+    bone_palette* Palettes;
+    bone_palette* Targets;      // Next evaluation of reduced rate animators
+    animation_lod_settings Settings;
+    animation_lod_stats Stats;
+    float dt;
+};
+
+preprocessed_animation PreprocessAnimation(read_file_result File);
+void InitializeAnimation(game_animation* Animation, transform* Frames, uint32 nFrames, uint32 nBones, float FramesPerSecond);
+uint32 DecimateAnimation(game_animation* Animation, transform* Frames, bool* Keep);
+uint64 GetAnimationSize(uint32 nBones, uint32 nKeys);
+void WriteAnimation(memory_arena* Arena, game_animation* Animation, transform* Frames, bool* Keep);
+animation_error MeasureAnimationError(game_animation* Animation, transform* Frames);
+game_animation LoadAnimation(memory_arena* Arena, preprocessed_animation* Preprocessed);
+void SetAnimationPointers(game_animation* Animation, uint8* Memory);
+
+transform Sample(game_animation* Animation, uint32 Bone, float Time);
+void Sample(game_animation* Animation, float Time, armature* Armature);
+void Sample(game_animation* Animation, float Time, armature* Armature, bone_palette* Palette, uint32 SkipBones = 0);
+void ComposePalette(armature* Armature, bone_palette* Palette);
+void Update(game_animator* Animator, float dt, uint32 SkipBones = 0);
+v3 SkinPoint(bone_palette* Palette, uint32 Bone, v3 Point);
+transform GetBoneTransform(bone_palette* Palette, uint32 Bone);
+
+uint64 GetAnimationSystemSize(uint32 MaxAnimators);
+animation_system* AllocateAnimationSystem(memory_arena* Arena, uint32 MaxAnimators);
+void ClearAnimators(animation_system* System);
+void PushAnimator(animation_system* System, game_animator* Animator, float Distance = 0, bool Visible = true);
+void UpdateAnimators(platform_api* Platform, animation_system* System, float dt);
+
+#endif
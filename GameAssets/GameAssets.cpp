@@ -4,6 +4,7 @@
 #include "GameBitmap.cpp"
 #include "GameShader.cpp"
 #include "GameMesh.cpp"
+#include "Animation/GameAnimation.cpp"
 
 void LoadShaderPipelines(game_assets* Assets) {
     Assets->nSamplers = 0;
@@ -52,10 +53,103 @@ void LoadShaderPipelines(game_assets* Assets) {
     }
 }
 
+// Shader code follows the assets in the pack, each one ended by a 0
+void SetShaderPointers(game_assets* Assets) {
+    char* Pointer = (char*)(Assets->Memory + Assets->AssetsSize);
+    for (int i = 0; i < game_shader_id_count; i++) {
+        game_shader* Shader = &Assets->Shader[i];
+
+        Shader->Code = Pointer;
+        Pointer += Shader->File.ContentSize + 1;
+    }
+
+    for (int i = 0; i < game_compute_shader_id_count; i++) {
+        game_compute_shader* Shader = &Assets->ComputeShader[i];
+
+        Shader->Code = Pointer;
+        Pointer += Shader->Size + 1;
+    }
+}
+
+// Pack written by a previous run, if there is one and this build can read it
+game_assets* ReadPreviousAssetsFile(platform_api* Platform, const char* Path, read_file_result* File) {
+    *File = {};
+    if (Platform->GetFileTimestamp(Path) == 0) return NULL;
+
+    *File = Platform->ReadEntireFile(Path);
+    game_assets* Previous = (game_assets*)File->Content;
+    if (
+        File->ContentSize < sizeof(game_assets) ||
+        Previous->Version != ASSETS_FILE_VERSION ||
+        Previous->HeaderSize != sizeof(game_assets) ||
+        File->ContentSize != sizeof(game_assets) + Previous->TotalSize
+    ) {
+        Log(Info, "Assets file is out of date, rebuilding all assets.");
+        Platform->FreeFileMemory(File->Content);
+        File->Content = 0;
+        return NULL;
+    }
+
+    Previous->Memory = (uint8*)File->Content + sizeof(game_assets);
+    SetShaderPointers(Previous);
+    return Previous;
+}
+
+// Whether the vertex layouts and pipelines set up in WriteAssetsFile are the ones in the previous pack
+bool IsSameShaderSetup(game_assets* Assets, game_assets* Previous) {
+    for (int i = 0; i < vertex_layout_id_count; i++) {
+        if (!(Assets->VertexLayouts[i] == Previous->VertexLayouts[i])) return false;
+    }
+    for (int i = 0; i < game_shader_pipeline_id_count; i++) {
+        game_shader_pipeline* Pipeline = &Assets->ShaderPipeline[i];
+        game_shader_pipeline* PreviousPipeline = &Previous->ShaderPipeline[i];
+        if (
+            memcmp(Pipeline->Pipeline, PreviousPipeline->Pipeline, sizeof(Pipeline->Pipeline)) != 0 ||
+            memcmp(Pipeline->IsProvided, PreviousPipeline->IsProvided, sizeof(Pipeline->IsProvided)) != 0
+        ) return false;
+    }
+    return true;
+}
+
+/*
+    Copies the source stamps of an up to date build into the previous pack header, so sources that were saved again
+    without changes match by timestamp next time instead of being read and hashed on every build.
+*/
+void RestampPreviousAssets(game_assets* Assets, game_assets* Previous) {
+    for (int i = 0; i < Assets->Asset.Count; i++) {
+        game_asset* Asset = &Assets->Asset.Content[i];
+        game_asset* PreviousAsset = GetPreviousAsset(Asset->Type, Asset->ID);
+        if (PreviousAsset) PreviousAsset->Source = Asset->Source;
+    }
+    for (int i = 0; i < game_shader_id_count; i++) {
+        Previous->Shader[i].Source = Assets->Shader[i].Source;
+    }
+    for (int i = 0; i < game_compute_shader_id_count; i++) {
+        Previous->ComputeShader[i].Source = Assets->ComputeShader[i].Source;
+    }
+}
+
+/*
+    Builds the assets file at Path. Only assets and shaders whose sources changed since the pack already there are
+    preprocessed, the rest are copied from it. If nothing changed the pack is left as it is, only its header is written
+    again when some source timestamps moved.
+*/
 void WriteAssetsFile(platform_api* Platform, const char* Path) {
     game_assets Assets = {};
+    Assets.Version = ASSETS_FILE_VERSION;
+    Assets.HeaderSize = sizeof(game_assets);
     Assets.Platform = Platform;
 
+    read_file_result PreviousFile;
+    game_assets* Previous = ReadPreviousAssetsFile(Platform, Path, &PreviousFile);
+    PreprocessedAssets.Previous = Previous;
+    memset(PreprocessedAssets.Cached, 0, sizeof(PreprocessedAssets.Cached));
+    memset(PreprocessedAssets.CachedShader, 0, sizeof(PreprocessedAssets.CachedShader));
+    memset(PreprocessedAssets.CachedComputeShader, 0, sizeof(PreprocessedAssets.CachedComputeShader));
+    PreprocessedAssets.nSources = 0;
+    PreprocessedAssets.nRebuilt = 0;
+    PreprocessedAssets.nRestamped = 0;
+
 // Assets
     // Fonts
     PushAsset(&Assets, "..\\GameAssets\\Font\\Files\\Menlo-Regular.ttf", Font_Menlo_Regular_ID);
@@ -95,14 +189,15 @@ void WriteAssetsFile(platform_api* Platform, const char* Path) {
 
 // Shaders
     // Vertex layouts
-    Assets.VertexLayouts[vertex_layout_vec2_id]           = VertexLayout(1, shader_type_vec2);
-    Assets.VertexLayouts[vertex_layout_vec2_vec2_id]      = VertexLayout(2, shader_type_vec2, shader_type_vec2);
-    Assets.VertexLayouts[vertex_layout_vec3_id]           = VertexLayout(1, shader_type_vec3);
-    Assets.VertexLayouts[vertex_layout_vec3_vec2_id]      = VertexLayout(2, shader_type_vec3, shader_type_vec2);
-    Assets.VertexLayouts[vertex_layout_vec3_vec2_vec3_id] = VertexLayout(3, shader_type_vec3, shader_type_vec2, shader_type_vec3);
-    Assets.VertexLayouts[vertex_layout_vec3_vec4_id]      = VertexLayout(2, shader_type_vec3, shader_type_vec4);
-    Assets.VertexLayouts[vertex_layout_vec4_id]           = VertexLayout(1, shader_type_vec4);
-    Assets.VertexLayouts[vertex_layout_bones_id]          = VertexLayout(5, shader_type_vec3, shader_type_vec2, shader_type_vec3, shader_type_ivec2, shader_type_vec2);
+    Assets.VertexLayouts[vertex_layout_vec2_id]            = VertexLayout(1, shader_type_vec2);
+    Assets.VertexLayouts[vertex_layout_vec2_vec2_id]       = VertexLayout(2, shader_type_vec2, shader_type_vec2);
+    Assets.VertexLayouts[vertex_layout_vec3_id]            = VertexLayout(1, shader_type_vec3);
+    Assets.VertexLayouts[vertex_layout_vec3_vec2_id]       = VertexLayout(2, shader_type_vec3, shader_type_vec2);
+    Assets.VertexLayouts[vertex_layout_vec3_vec2_vec3_id]  = VertexLayout(3, shader_type_vec3, shader_type_vec2, shader_type_vec3);
+    Assets.VertexLayouts[vertex_layout_vec3_vec4_id]       = VertexLayout(2, shader_type_vec3, shader_type_vec4);
+    Assets.VertexLayouts[vertex_layout_vec3_vec4_float_id] = VertexLayout(3, shader_type_vec3, shader_type_vec4, shader_type_float);
+    Assets.VertexLayouts[vertex_layout_vec4_id]            = VertexLayout(1, shader_type_vec4);
+    Assets.VertexLayouts[vertex_layout_bones_id]           = VertexLayout(5, shader_type_vec3, shader_type_vec2, shader_type_vec3, shader_type_ivec2, shader_type_vec2);
     for (int i = 0; i < vertex_layout_id_count; i++) Assets.VertexLayouts[i].ID = (vertex_layout_id)i;
 
     // Vertex
@@ -112,6 +207,7 @@ void WriteAssetsFile(platform_api* Platform, const char* Path) {
     PushShader(&Assets, "..\\GameAssets\\Shader\\Files\\Vertex\\Perspective.vert", Vertex_Shader_Perspective_ID);
     PushShader(&Assets, "..\\GameAssets\\Shader\\Files\\Vertex\\Bones.vert", Vertex_Shader_Bones_ID);
     PushShader(&Assets, "..\\GameAssets\\Shader\\Files\\Vertex\\Barycentric.vert", Vertex_Shader_Barycentric_ID);
+    PushShader(&Assets, "..\\GameAssets\\Shader\\Files\\Vertex\\Particle.vert", Vertex_Shader_Particle_ID);
 #if GAME_RENDER_API_VULKAN
     PushShader(&Assets, "..\\GameAssets\\Shaders\\Vertex\\VulkanTest.vert", Vertex_Shader_Vulkan_Test_ID);
 #endif
@@ -141,6 +237,7 @@ void WriteAssetsFile(platform_api* Platform, const char* Path) {
     PushShader(&Assets, "..\\GameAssets\\Shader\\Files\\Fragment\\Sea.frag", Fragment_Shader_Sea_ID);
     PushShader(&Assets, "..\\GameAssets\\Shader\\Files\\Fragment\\BezierExterior.frag", Fragment_Shader_Bezier_Exterior_ID);
     PushShader(&Assets, "..\\GameAssets\\Shader\\Files\\Fragment\\BezierInterior.frag", Fragment_Shader_Bezier_Interior_ID);
+    PushShader(&Assets, "..\\GameAssets\\Shader\\Files\\Fragment\\VertexColor.frag", Fragment_Shader_Vertex_Color_ID);
 #if GAME_RENDER_API_VULKAN
     PushShader(&Assets, "..\\GameAssets\\Shader\\Files\\Fragment\\VulkanTest.frag", Fragment_Shader_Vulkan_Test_ID);
 #endif
@@ -159,6 +256,7 @@ void WriteAssetsFile(platform_api* Platform, const char* Path) {
     PushShaderPipeline(&Assets, Shader_Pipeline_Bezier_Exterior_ID,     2, Vertex_Shader_Barycentric_ID,    Fragment_Shader_Bezier_Exterior_ID);
     PushShaderPipeline(&Assets, Shader_Pipeline_Bezier_Interior_ID,     2, Vertex_Shader_Barycentric_ID,    Fragment_Shader_Bezier_Interior_ID);
     PushShaderPipeline(&Assets, Shader_Pipeline_Solid_Text_ID,          2, Vertex_Shader_Barycentric_ID,    Fragment_Shader_Single_Color_ID);
+    PushShaderPipeline(&Assets, Shader_Pipeline_Particle_ID,            2, Vertex_Shader_Particle_ID,       Fragment_Shader_Vertex_Color_ID);
     PushShaderPipeline(&Assets, Shader_Pipeline_Jump_Flood_ID,          2, Vertex_Shader_Passthrough_ID,    Fragment_Shader_Jump_Flood_ID);
     PushShaderPipeline(&Assets, Shader_Pipeline_Debug_Normals_ID,       3,
         Vertex_Shader_Bones_ID,
@@ -196,23 +294,51 @@ void WriteAssetsFile(platform_api* Platform, const char* Path) {
     PushShader(&Assets, "..\\GameAssets\\Shader\\Files\\Compute\\Kernel.comp", Compute_Shader_Kernel_ID);
 
 // Output file
+    char LogBuffer[128];
+    bool UpToDate = Previous &&
+        PreprocessedAssets.nRebuilt == 0 &&
+        Previous->Asset.Count == Assets.Asset.Count &&
+        IsSameShaderSetup(&Assets, Previous);
+    if (UpToDate) {
+        if (PreprocessedAssets.nRestamped > 0) {
+            RestampPreviousAssets(&Assets, Previous);
+            Platform->WriteEntireFile(Path, PreviousFile.ContentSize, PreviousFile.Content);
+        }
+        sprintf_s(
+            LogBuffer, "Assets file is up to date, %u sources checked, %u restamped.",
+            PreprocessedAssets.nSources, PreprocessedAssets.nRestamped
+        );
+        Log(Info, LogBuffer);
+        Platform->FreeFileMemory(PreviousFile.Content);
+        PreprocessedAssets.Previous = NULL;
+        return;
+    }
+
     void* FileMemory = VirtualAlloc(0, sizeof(game_assets) + Assets.TotalSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
     Assets.Memory = (uint8*)FileMemory + sizeof(game_assets);
     memory_arena AssetArena = MemoryArena(Assets.TotalSize, (uint8*)Assets.Memory);
 
     // Assets
     for (int i = 0; i < Assets.Asset.Count; i++) {
-        LoadAsset(&AssetArena, &Assets, &Assets.Asset.Content[i]);
+        uint8* Cached = PreprocessedAssets.Cached[i];
+        if (Cached) CopyAsset(&AssetArena, &Assets, &Assets.Asset.Content[i], Cached);
+        else        LoadAsset(&AssetArena, &Assets, &Assets.Asset.Content[i]);
     }
 
     // Shaders
     for (int i = 0; i < game_shader_id_count; i++) {
-        LoadShader(Platform, &AssetArena, &Assets.Shader[i]);
+        game_shader* Shader = &Assets.Shader[i];
+        char* Cached = PreprocessedAssets.CachedShader[i];
+        if (Cached) memcpy(PushSize(&AssetArena, Shader->File.ContentSize + 1), Cached, Shader->File.ContentSize);
+        else        LoadShader(Platform, &AssetArena, Shader);
     }
 
     // Compute shaders
     for (int i = 0; i < game_compute_shader_id_count; i++) {
-        LoadComputeShader(Platform, &AssetArena, &Assets.ComputeShader[i]);
+        game_compute_shader* Shader = &Assets.ComputeShader[i];
+        char* Cached = PreprocessedAssets.CachedComputeShader[i];
+        if (Cached) memcpy(PushSize(&AssetArena, Shader->Size + 1), Cached, Shader->Size);
+        else        LoadComputeShader(Platform, &AssetArena, Shader);
     }
 
     // Shader pipelines vertex and uniform layouts
@@ -222,9 +348,15 @@ void WriteAssetsFile(platform_api* Platform, const char* Path) {
     if (OutputAssets) *OutputAssets = Assets;
     Platform->WriteEntireFile(Path, sizeof(game_assets) + Assets.TotalSize, FileMemory);
 
-    Log(Info, "Finished writing assets file.");
+    sprintf_s(
+        LogBuffer, "Finished writing assets file, %u of %u sources rebuilt.",
+        PreprocessedAssets.nRebuilt, PreprocessedAssets.nSources
+    );
+    Log(Info, LogBuffer);
 
     VirtualFree(FileMemory, 0, MEM_RELEASE);
+    Platform->FreeFileMemory(PreviousFile.Content);
+    PreprocessedAssets.Previous = NULL;
 }
 
 void LoadAssetsFromFile(
@@ -262,6 +394,7 @@ void LoadAssetsFromFile(
                 Heightmap->Bitmap.Content = (uint32*)(Assets->Memory + Asset.Offset);
                 uint64 BitmapSize = PreprocessBitmap(&Heightmap->Bitmap.Header);
                 Heightmap->Vertices = (float*)(Assets->Memory + Asset.Offset + BitmapSize);
+                Heightmap->Heights = Heightmap->Vertices + 5 * Heightmap->nVertices;
             } break;
 
             case Asset_Type_Font: {
@@ -294,11 +427,12 @@ void LoadAssetsFromFile(
                 Mesh->Vertices = (void*)(Assets->Memory + Asset.Offset);
                 vertex_layout Layout = Assets->VertexLayouts[Mesh->LayoutID];
                 Mesh->Faces = (uint32*)((uint8*)Mesh->Vertices + Layout.Stride * Mesh->nVertices);
+                Mesh->BVH = (mesh_bvh_node*)(Mesh->Faces + 3 * Mesh->nFaces);
             } break;
 
             case Asset_Type_Animation: {
                 game_animation* Animation = GetAsset(Assets, Asset.ID.Animation);
-                Animation->Content = (float*)(Assets->Memory + Asset.Offset);
+                SetAnimationPointers(Animation, Assets->Memory + Asset.Offset);
             } break;
 
             // case Asset_Type_Video: {
@@ -325,20 +459,7 @@ void LoadAssetsFromFile(
 
     Log(Info, "Assets loaded.");
 
-    char* Pointer = (char*)(Assets->Memory + Assets->AssetsSize);
-    for (int i = 0; i < game_shader_id_count; i++) {
-        game_shader* Shader = &Assets->Shader[i];
-
-        Shader->Code = Pointer;
-        Pointer += Shader->File.ContentSize + 1;
-    }
-
-    for (int i = 0; i < game_compute_shader_id_count; i++) {
-        game_compute_shader* Shader = &Assets->ComputeShader[i];
-
-        Shader->Code = Pointer;
-        Pointer += Shader->Size + 1;
-    }
+    SetShaderPointers(Assets);
 
     Log(Info, "Shaders loaded.");
 }
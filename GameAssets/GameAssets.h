@@ -6,6 +6,7 @@
 #include "Sound/GameSound.h"
 #include "Video/GameVideo.h"
 #include "Mesh/GameMesh.h"
+#include "Animation/GameAnimation.h"
 #include "Shader/GameShader.h"
 
 #ifndef GAME_ASSETS
@@ -42,15 +43,6 @@ enum game_heightmap_id {
     game_heightmap_id_count
 };
 
-enum game_animation_id {
-    Animation_Idle_ID,
-    Animation_Walk_ID,
-    Animation_Jump_ID,
-    Animation_Attack_ID,
-
-    game_animation_id_count
-};
-
 union game_asset_id {
     game_text_id Text;
     game_sound_id Sound;
@@ -66,6 +58,7 @@ struct game_asset {
     game_asset_id ID;
     game_asset_type Type;
     read_file_result File;
+    file_stamp Source;
     uint64 MemoryNeeded;
     uint64 Offset;
 };
@@ -169,26 +162,37 @@ struct game_text {
 // | Heightmaps                                                                                                                                                       |
 // +------------------------------------------------------------------------------------------------------------------------------------------------------------------+
 
+/*
+    Heights are the green channel of every pixel scaled as the tessellation shader does, one per pixel with rows in the
+    order they are stored, so the CPU can query the same surface the GPU draws.
+*/
 struct game_heightmap {
     game_bitmap Bitmap;
     uint32 nVertices;
     float* Vertices;
+    uint32 nColumns;
+    uint32 nRows;
+    float* Heights;
 };
 
 const int HEIGHTMAP_RESOLUTION = 20;
+const float HEIGHTMAP_SIZE = 10.0f;             // Width and depth in world units, from the origin along X and Z
+const float HEIGHTMAP_HEIGHT_SCALE = 0.2f;      // Height of a full green pixel, as in Heightmap.tese
 
 uint64 ComputeNeededMemoryForHeightmap(read_file_result File) {
-    uint64 BitmapSize = PreprocessBitmap((bitmap_header*)File.Content);
+    bitmap_header* Header = (bitmap_header*)File.Content;
+    uint64 BitmapSize = PreprocessBitmap(Header);
     uint64 VerticesSize = HEIGHTMAP_RESOLUTION * HEIGHTMAP_RESOLUTION * 4 * 5 * sizeof(float);
-    return BitmapSize + VerticesSize;
+    uint64 HeightsSize = (uint64)Header->Width * Header->Height * sizeof(float);
+    return BitmapSize + VerticesSize + HeightsSize;
 }
 
 game_heightmap LoadHeightmap(memory_arena* Arena, game_asset* Asset) {
     game_heightmap Result = {};
 
     Result.Bitmap = LoadBitmapFile(Arena, Asset->File);
-    float Width = 10.0f;
-    float Height = 10.0f;
+    float Width = HEIGHTMAP_SIZE;
+    float Height = HEIGHTMAP_SIZE;
 
     Result.nVertices = HEIGHTMAP_RESOLUTION * HEIGHTMAP_RESOLUTION * 4;
     Result.Vertices = (float*)PushSize(Arena, Result.nVertices * 5 * sizeof(float));
@@ -221,122 +225,36 @@ game_heightmap LoadHeightmap(memory_arena* Arena, game_asset* Asset) {
         }
     }
 
-    return Result;
-}
-
-// +------------------------------------------------------------------------------------------------------------------------------------------------------------------+
-// | Animation                                                                                                                                                        |
-// +------------------------------------------------------------------------------------------------------------------------------------------------------------------+
-
-struct game_animation {
-    game_animation_id ID;
-    uint32 nFrames;
-    uint32 nBones;
-    float* Content;
-};
-
-struct game_animator {
-    game_animation* Animation;
-    armature* Armature;
-    uint32 CurrentFrame;
-    bool Active;
-    bool Loop;
-};
-
-void Update(game_animator* Animator) {
-    game_animation* Animation = Animator->Animation;
-    armature* Armature = Animator->Armature;
-
-    float* Pointer = Animation->Content + Animator->CurrentFrame * Armature->nBones * 10;
-    if(Animator->Active) {
-        for (int i = 0; i < Armature->nBones; i++) {
-            bone* Bone = &Armature->Bones[i];
-            Bone->Transform.Translation.X = *Pointer++;
-            Bone->Transform.Translation.Y = *Pointer++;
-            Bone->Transform.Translation.Z = *Pointer++;
-            Bone->Transform.Rotation.c = *Pointer++;
-            Bone->Transform.Rotation.i = *Pointer++;
-            Bone->Transform.Rotation.j = *Pointer++;
-            Bone->Transform.Rotation.k = *Pointer++;
-            Bone->Transform.Scale.X = *Pointer++;
-            Bone->Transform.Scale.Y = *Pointer++;
-            Bone->Transform.Scale.Z = *Pointer++;
-        }
-
-        Animator->CurrentFrame++;
-        if (Animator->CurrentFrame >= Animation->nFrames - 1) {
-            Animator->CurrentFrame = 0;
-            if (!Animator->Loop) Animator->Active = false;
-        }
-    }
-    else {
-        for (int i = 0; i < Armature->nBones; i++) {
-            bone* Bone = &Armature->Bones[i];
-            Bone->Transform.Translation = V3(0,0,0);
-            Bone->Transform.Rotation = Quaternion(1.0, 0.0, 0.0, 0.0);
-            Bone->Transform.Scale = Scale();
+    // Green is the second byte of every pixel, rows of 24 bit bitmaps are padded as in LoadBitmapFile
+    bitmap_header* Header = &Result.Bitmap.Header;
+    uint32 RowSize = Result.Bitmap.Pitch;
+    if (Header->Size == 40 && Result.Bitmap.BytesPerPixel == 3) RowSize = (RowSize / 4 + 1) * 4;
+    Result.nColumns = Header->Width;
+    Result.nRows = Header->Height;
+    Result.Heights = PushArray(Arena, Result.nColumns * Result.nRows, float);
+    uint8* Pixels = (uint8*)Result.Bitmap.Content;
+    for (uint32 Row = 0; Row < Result.nRows; Row++) {
+        for (uint32 Column = 0; Column < Result.nColumns; Column++) {
+            uint8 Green = Pixels[Row * RowSize + Column * Result.Bitmap.BytesPerPixel + 1];
+            Result.Heights[Row * Result.nColumns + Column] = HEIGHTMAP_HEIGHT_SCALE * Green / 255.0f;
         }
     }
-}
 
-void GetAnimationSizes(void* Content, uint32* nFrames, uint32* nBones) {
-    tokenizer Tokenizer = InitTokenizer(Content);
-    token Token = RequireToken(Tokenizer, Token_Identifier);
-    while (Token.Type == Token_Identifier) {
-        if (Token == "nF")     *nFrames = Parseuint32(Tokenizer);
-        else if (Token == "nB") *nBones = Parseuint32(Tokenizer);
-        Token = GetToken(Tokenizer);
-    }
-}
-
-uint64 ComputeNeededMemoryForAnimation(read_file_result File) {
-    uint64 Result = 0;
-
-    if (File.ContentSize > 0) {
-        uint32 nFrames = 0, nBones = 0;
-        GetAnimationSizes(File.Content, &nFrames, &nBones);
-
-        Result = nFrames * nBones * 10 * sizeof(float);
-    }
     return Result;
 }
 
-game_animation LoadAnimation(memory_arena* Arena, game_asset* Asset) {
-    game_animation Result = {};
-    Result.ID = Asset->ID.Animation;
-
-    GetAnimationSizes(Asset->File.Content, &Result.nFrames, &Result.nBones);
-
-    Result.Content = PushArray(Arena, Result.nFrames * Result.nBones * 10, float);
-
-    tokenizer Tokenizer = InitTokenizer(Asset->File.Content);
-    AdvanceUntilLine(Tokenizer, 2);
-    
-    float* pOut = Result.Content;
-    for (uint32 i = 0; i < Result.nFrames; i++) {
-        for (uint32 j = 0; j < Result.nBones; j++) {
-            uint32 Frame = Parseuint32(Tokenizer);
-            uint32 BoneID = Parseuint32(Tokenizer);
-            Assert(Frame == i && BoneID == j);
-
-            v3 Translation = ParseV3(Tokenizer);
-            quaternion Rotation = ParseQuaternion(Tokenizer);
-            v3 Scale = ParseV3(Tokenizer);
-
-            *pOut++ = Translation.X;
-            *pOut++ = Translation.Y;
-            *pOut++ = Translation.Z;
-            *pOut++ = Rotation.c;
-            *pOut++ = Rotation.i;
-            *pOut++ = Rotation.j;
-            *pOut++ = Rotation.k;
-            *pOut++ = Scale.X;
-            *pOut++ = Scale.Y;
-            *pOut++ = Scale.Z;
-        }
-    }
-
-    return Result;
+// Bilinear between pixel centers, clamped at the edges. X and Z in world units.
+float GetHeight(game_heightmap* Heightmap, float X, float Z) {
+    float u = Clamp(X * Heightmap->nColumns / HEIGHTMAP_SIZE - 0.5f, 0.0f, (float)(Heightmap->nColumns - 1));
+    float v = Clamp(Z * Heightmap->nRows / HEIGHTMAP_SIZE - 0.5f, 0.0f, (float)(Heightmap->nRows - 1));
+    uint32 Column = min((uint32)u, Heightmap->nColumns - 2);
+    uint32 Row = min((uint32)v, Heightmap->nRows - 2);
+    float fu = u - Column;
+    float fv = v - Row;
+    float* H = Heightmap->Heights + Row * Heightmap->nColumns + Column;
+    float H0 = H[0] + fu * (H[1] - H[0]);
+    float H1 = H[Heightmap->nColumns] + fu * (H[Heightmap->nColumns + 1] - H[Heightmap->nColumns]);
+    return H0 + fv * (H1 - H0);
 }
 
 // +------------------------------------------------------------------------------------------------------------------------------------------------------------------+
@@ -355,7 +273,12 @@ const uint32 ASSET_COUNT =
 
 ArrayDefinition(ASSET_COUNT, game_asset)
 
+// Bump when what an asset writes to the pack changes, so packs from older builds are rebuilt instead of reused
+const uint32 ASSETS_FILE_VERSION = 1;
+
 struct game_assets {
+    uint32 Version;
+    uint32 HeaderSize;          // sizeof(game_assets) when written, packs with another layout are not reused
     platform_api* Platform;
     game_asset_array Asset;
     game_text Text[game_text_id_count];
@@ -380,10 +303,22 @@ struct game_assets {
     uint8* Memory;
 };
 
+/*
+    Build state of the assets file. Sources that did not change since the previous pack are not preprocessed again,
+    their content is copied from it: Cached points there, by push order for assets and by ID for shaders.
+*/
 struct preprocessed_assets {
     preprocessed_font Font[game_bitmap_id_count];
     preprocessed_sound Sound[game_sound_id_count];
     preprocessed_mesh Mesh[game_mesh_id_count];
+    preprocessed_animation Animation[game_animation_id_count];
+    game_assets* Previous;
+    uint8* Cached[ASSET_COUNT];
+    char* CachedShader[game_shader_id_count];
+    char* CachedComputeShader[game_compute_shader_id_count];
+    uint32 nSources;
+    uint32 nRebuilt;
+    uint32 nRestamped;      // Read again because the timestamp changed, but still the same content
 };
 
 static preprocessed_assets PreprocessedAssets;
@@ -397,120 +332,165 @@ game_mesh*      GetAsset(game_assets* Assets, game_mesh_id ID)      { return &As
 game_animation* GetAsset(game_assets* Assets, game_animation_id ID) { return &Assets->Animation[ID]; }
 //game_video*     GetAsset(game_assets* Assets, game_video_id ID)     { return &Assets->Videos[ID]; }
 
+/*
+    Whether the source at Path is still what Cached was built from. While the timestamp matches the file is not even
+    read. Otherwise it is read into File and only counts as changed if its size or hash changed too, so saving a file
+    again without changes does not rebuild it. Cached can be NULL when there is nothing to compare with, and it is
+    ignored if it was built from another path (e.g. after IDs were reordered).
+*/
+bool CheckSource(platform_api* Platform, const char* Path, file_stamp* Cached, file_stamp* Stamp, read_file_result* File) {
+    PreprocessedAssets.nSources++;
+    *File = {};
+    File->Path = Path;
+    uint32 PathHash = Hash(Path);
+    if (Cached && Cached->PathHash != PathHash) Cached = NULL;
+    int64 Timestamp = Platform->GetFileTimestamp(Path);
+    if (Cached && Timestamp != 0 && Timestamp == Cached->Timestamp) {
+        *Stamp = *Cached;
+        return true;
+    }
+
+    *File = Platform->ReadEntireFile(Path);
+    Stamp->Timestamp = File->Timestamp;
+    Stamp->Size = File->ContentSize;
+    Stamp->Hash = Hash(File->Content, File->ContentSize);
+    Stamp->PathHash = PathHash;
+    bool Unchanged = Cached && Stamp->Size == Cached->Size && Stamp->Hash == Cached->Hash;
+    if (Unchanged) {
+        Platform->FreeFileMemory(File->Content);
+        File->Content = 0;
+        PreprocessedAssets.nRestamped++;
+    }
+    else PreprocessedAssets.nRebuilt++;
+    return Unchanged;
+}
+
+game_asset* GetPreviousAsset(game_asset_type Type, game_asset_id ID) {
+    game_assets* Previous = PreprocessedAssets.Previous;
+    if (Previous) {
+        for (int i = 0; i < Previous->Asset.Count; i++) {
+            game_asset* Asset = &Previous->Asset.Content[i];
+            if (Asset->Type == Type && Asset->ID.Text == ID.Text) return Asset;
+        }
+    }
+    return NULL;
+}
+
+/*
+    Stamps the source of an asset about to be pushed. If the previous pack has it built from the same source, its size
+    and content are taken from there and true is returned, otherwise the file is left in Asset->File to preprocess.
+*/
+bool ReuseAsset(game_assets* Assets, game_asset* Asset, const char* Path) {
+    game_asset* Previous = GetPreviousAsset(Asset->Type, Asset->ID);
+    bool Unchanged = CheckSource(Assets->Platform, Path, Previous ? &Previous->Source : NULL, &Asset->Source, &Asset->File);
+    if (Unchanged) {
+        Asset->File.ContentSize = Previous->File.ContentSize;
+        Asset->MemoryNeeded = Previous->MemoryNeeded;
+        PreprocessedAssets.Cached[Assets->Asset.Count] = PreprocessedAssets.Previous->Memory + Previous->Offset;
+    }
+    else {
+        Assert(Asset->File.ContentSize > 0);
+    }
+    return Unchanged;
+}
+
+void AddAsset(game_assets* Assets, game_asset Asset) {
+    Append(&Assets->Asset, Asset);
+    Assets->TotalSize += Asset.MemoryNeeded;
+    Assets->AssetsSize += Asset.MemoryNeeded;
+}
+
 void PushAsset(game_assets* Assets, const char* Path, game_text_id ID) {
     game_asset Asset = {};
     Asset.Type = Asset_Type_Text;
     Asset.ID.Text = ID;
-    Asset.File = Assets->Platform->ReadEntireFile(Path);
-    Assert(Asset.File.ContentSize > 0);
-    Asset.MemoryNeeded = Asset.File.ContentSize + 1;
-    
-    Append(&Assets->Asset, Asset);
-    Assets->TotalSize += Asset.MemoryNeeded;
-    Assets->AssetsSize += Asset.MemoryNeeded;
+    if (!ReuseAsset(Assets, &Asset, Path)) {
+        Asset.MemoryNeeded = Asset.File.ContentSize + 1;
+    }
+    AddAsset(Assets, Asset);
 };
 
 void PushAsset(game_assets* Assets, const char* Path, game_sound_id ID) {
     game_asset Asset = {};
     Asset.Type = Asset_Type_Sound;
     Asset.ID.Sound = ID;
-    Asset.File = Assets->Platform->ReadEntireFile(Path);
-    Assert(Asset.File.ContentSize > 0);
-
-    preprocessed_sound Preprocessed = PreprocessSound(Asset.File);
-    PreprocessedAssets.Sound[ID] = Preprocessed;
-    Asset.MemoryNeeded = Preprocessed.Size;
-
-    Append(&Assets->Asset, Asset);
-    Assets->TotalSize += Asset.MemoryNeeded;
-    Assets->AssetsSize += Asset.MemoryNeeded;
+    if (!ReuseAsset(Assets, &Asset, Path)) {
+        preprocessed_sound Preprocessed = PreprocessSound(Asset.File);
+        PreprocessedAssets.Sound[ID] = Preprocessed;
+        Asset.MemoryNeeded = Preprocessed.Size;
+    }
+    AddAsset(Assets, Asset);
 };
 
 void PushAsset(game_assets* Assets, const char* Path, game_bitmap_id ID) {
     game_asset Asset = {};
     Asset.Type = Asset_Type_Bitmap;
     Asset.ID.Bitmap = ID;
-    Asset.File = Assets->Platform->ReadEntireFile(Path);
-    Assert(Asset.File.ContentSize > 0);
-    Asset.MemoryNeeded = PreprocessBitmap((bitmap_header*)Asset.File.Content);
-
-    Append(&Assets->Asset, Asset);
-    Assets->TotalSize += Asset.MemoryNeeded;
-    Assets->AssetsSize += Asset.MemoryNeeded;
+    if (!ReuseAsset(Assets, &Asset, Path)) {
+        Asset.MemoryNeeded = PreprocessBitmap((bitmap_header*)Asset.File.Content);
+    }
+    AddAsset(Assets, Asset);
 };
 
 void PushAsset(game_assets* Assets, const char* Path, game_heightmap_id ID) {
     game_asset Asset = {};
     Asset.Type = Asset_Type_Heightmap;
     Asset.ID.Heightmap = ID;
-    Asset.File = Assets->Platform->ReadEntireFile(Path);
-    Assert(Asset.File.ContentSize > 0);
-    Asset.MemoryNeeded = ComputeNeededMemoryForHeightmap(Asset.File);
-
-    Append(&Assets->Asset, Asset);
-    Assets->TotalSize += Asset.MemoryNeeded;
-    Assets->AssetsSize += Asset.MemoryNeeded;
+    if (!ReuseAsset(Assets, &Asset, Path)) {
+        Asset.MemoryNeeded = ComputeNeededMemoryForHeightmap(Asset.File);
+    }
+    AddAsset(Assets, Asset);
 };
 
 void PushAsset(game_assets* Assets, const char* Path, game_font_id ID) {
     game_asset Asset = {};
     Asset.Type = Asset_Type_Font;
     Asset.ID.Font = ID;
-    Asset.File = Assets->Platform->ReadEntireFile(Path);
-    Assert(Asset.File.ContentSize > 0);
-    preprocessed_font Preprocessed = PreprocessFont(Asset.File);
-    PreprocessedAssets.Font[ID] = Preprocessed;
-    Asset.MemoryNeeded = Preprocessed.Size;
-
-    Append(&Assets->Asset, Asset);
-    Assets->TotalSize += Asset.MemoryNeeded;
-    Assets->AssetsSize += Asset.MemoryNeeded;
+    if (!ReuseAsset(Assets, &Asset, Path)) {
+        preprocessed_font Preprocessed = PreprocessFont(Asset.File);
+        PreprocessedAssets.Font[ID] = Preprocessed;
+        Asset.MemoryNeeded = Preprocessed.Size;
+    }
+    AddAsset(Assets, Asset);
 };
 
 void PushAsset(game_assets* Assets, const char* Path, game_mesh_id ID) {
     game_asset Asset = {};
     Asset.Type = Asset_Type_Mesh;
     Asset.ID.Mesh = ID;
-    Asset.File = Assets->Platform->ReadEntireFile(Path);
-    Assert(Asset.File.ContentSize > 0);
-
-    preprocessed_mesh Preprocessed = PreprocessMesh(Asset.File);
-    Asset.MemoryNeeded = 0;
-    if (Preprocessed.nBones > 0) Asset.MemoryNeeded += Preprocessed.nVertices * (10 * sizeof(float) + 2 * sizeof(int32));
-    else                         Asset.MemoryNeeded += Preprocessed.nVertices * 8 * sizeof(float);
-    Asset.MemoryNeeded += Preprocessed.nFaces * 3 * sizeof(uint32);
-
-    PreprocessedAssets.Mesh[ID] = Preprocessed;
-
-    Append(&Assets->Asset, Asset);
-    Assets->TotalSize += Asset.MemoryNeeded;
-    Assets->AssetsSize += Asset.MemoryNeeded;
+    if (!ReuseAsset(Assets, &Asset, Path)) {
+        preprocessed_mesh Preprocessed = PreprocessMesh(Asset.File);
+        Asset.MemoryNeeded = 0;
+        if (Preprocessed.nBones > 0) Asset.MemoryNeeded += Preprocessed.nVertices * (10 * sizeof(float) + 2 * sizeof(int32));
+        else                         Asset.MemoryNeeded += Preprocessed.nVertices * 8 * sizeof(float);
+        Asset.MemoryNeeded += Preprocessed.nFaces * 3 * sizeof(uint32);
+        Asset.MemoryNeeded += GetMeshBVHSize(Preprocessed.nFaces);
+
+        PreprocessedAssets.Mesh[ID] = Preprocessed;
+    }
+    AddAsset(Assets, Asset);
 };
 
 void PushAsset(game_assets* Assets, const char* Path, game_animation_id ID) {
     game_asset Asset = {};
     Asset.Type = Asset_Type_Animation;
     Asset.ID.Animation = ID;
-    Asset.File = Assets->Platform->ReadEntireFile(Path);
-    Assert(Asset.File.ContentSize > 0);
-    Asset.MemoryNeeded = ComputeNeededMemoryForAnimation(Asset.File);
-
-    Append(&Assets->Asset, Asset);
-    Assets->TotalSize += Asset.MemoryNeeded;
-    Assets->AssetsSize += Asset.MemoryNeeded;
+    if (!ReuseAsset(Assets, &Asset, Path)) {
+        preprocessed_animation Preprocessed = PreprocessAnimation(Asset.File);
+        PreprocessedAssets.Animation[ID] = Preprocessed;
+        Asset.MemoryNeeded = GetAnimationSize(Preprocessed.Animation.nBones, Preprocessed.Animation.nKeys);
+    }
+    AddAsset(Assets, Asset);
 };
 
 void PushAsset(game_assets* Assets, const char* Path, game_video_id ID) {
     game_asset Asset = {};
     Asset.Type = Asset_Type_Video;
     Asset.ID.Video = ID;
-    Asset.File = Assets->Platform->ReadEntireFile(Path);
-    Assert(Asset.File.ContentSize > 0);
-    Asset.MemoryNeeded = Asset.File.ContentSize;
-
-    Append(&Assets->Asset, Asset);
-    Assets->TotalSize += Asset.MemoryNeeded;
-    Assets->AssetsSize += Asset.MemoryNeeded;
+    if (!ReuseAsset(Assets, &Asset, Path)) {
+        Asset.MemoryNeeded = Asset.File.ContentSize;
+    }
+    AddAsset(Assets, Asset);
 };
 
 void LoadAsset(memory_arena* Arena, game_assets* Assets, game_asset* Asset) {
@@ -562,8 +542,17 @@ void LoadAsset(memory_arena* Arena, game_assets* Assets, game_asset* Asset) {
         } break;
 
         case Asset_Type_Animation: {
-            Assets->Animation[ID.Animation] = LoadAnimation(Arena, Asset);
-            sprintf_s(LogBuffer, "Loaded animation %s.", Asset->File.Path);
+            preprocessed_animation* Preprocessed = &PreprocessedAssets.Animation[ID.Animation];
+            game_animation* Animation = &Assets->Animation[ID.Animation];
+            *Animation = LoadAnimation(Arena, Preprocessed);
+            Animation->ID = ID.Animation;
+            uint64 BakedSize = Animation->nFrames * Animation->nBones * 10 * sizeof(float);
+            sprintf_s(
+                LogBuffer,
+                "Loaded animation %s. %u keys, %.1f:1 over baked frames, max error %.5f units, %.3f degrees, %.5f scale.",
+                Asset->File.Path, Animation->nKeys, (double)BakedSize / Asset->MemoryNeeded,
+                Preprocessed->Error.Translation, Preprocessed->Error.Rotation / Degrees, Preprocessed->Error.Scale
+            );
         } break;
 
         default: {
@@ -578,6 +567,24 @@ void LoadAsset(memory_arena* Arena, game_assets* Assets, game_asset* Asset) {
     Asset->File.Content = 0;
 }
 
+// Writes an asset whose source did not change from its content in the previous pack
+void CopyAsset(memory_arena* Arena, game_assets* Assets, game_asset* Asset, uint8* Content) {
+    game_assets* Previous = PreprocessedAssets.Previous;
+    Asset->Offset = Arena->Used;
+    memcpy(PushSize(Arena, Asset->MemoryNeeded), Content, Asset->MemoryNeeded);
+    game_asset_id ID = Asset->ID;
+    switch (Asset->Type) {
+        case Asset_Type_Text:      Assets->Text[ID.Text] = Previous->Text[ID.Text];                     break;
+        case Asset_Type_Bitmap:    Assets->Bitmap[ID.Bitmap] = Previous->Bitmap[ID.Bitmap];             break;
+        case Asset_Type_Heightmap: Assets->Heightmap[ID.Heightmap] = Previous->Heightmap[ID.Heightmap]; break;
+        case Asset_Type_Font:      Assets->Font[ID.Font] = Previous->Font[ID.Font];                     break;
+        case Asset_Type_Sound:     Assets->Sound[ID.Sound] = Previous->Sound[ID.Sound];                 break;
+        case Asset_Type_Mesh:      Assets->Mesh[ID.Mesh] = Previous->Mesh[ID.Mesh];                     break;
+        case Asset_Type_Animation: Assets->Animation[ID.Animation] = Previous->Animation[ID.Animation]; break;
+        default: Raise("Asset type not implemented.");
+    }
+}
+
 game_shader*          GetShader        (game_assets* Assets, game_shader_id ID)          { return &Assets->Shader[ID]; }
 game_shader_pipeline* GetShaderPipeline(game_assets* Assets, game_shader_pipeline_id ID) { return &Assets->ShaderPipeline[ID]; }
 game_compute_shader*  GetShader        (game_assets* Assets, game_compute_shader_id ID)  { return &Assets->ComputeShader[ID]; }
@@ -606,8 +613,21 @@ void PushShader(game_assets* Assets, const char* Path, game_shader_id ID) {
     }
     else Assert(false);
 
-    Shader->File = Assets->Platform->ReadEntireFile(Path);
-    Shader->Code = (char*)Shader->File.Content;
+    // Unchanged shaders keep the layout and uniforms parsed from them last time
+    game_shader* Previous = PreprocessedAssets.Previous ? &PreprocessedAssets.Previous->Shader[ID] : NULL;
+    file_stamp Source;
+    read_file_result File;
+    if (CheckSource(Assets->Platform, Path, Previous ? &Previous->Source : NULL, &Source, &File)) {
+        *Shader = *Previous;
+        Shader->File.Path = Path;
+        Shader->File.Content = 0;
+        PreprocessedAssets.CachedShader[ID] = Shader->Code;
+    }
+    else {
+        Shader->File = File;
+        Shader->Code = (char*)Shader->File.Content;
+    }
+    Shader->Source = Source;
 
     // Extra char with value 0 to separate shaders
     Assets->TotalSize += Shader->File.ContentSize + 1;
@@ -656,9 +676,16 @@ void PushShader(game_assets* Assets, const char* Path, game_compute_shader_id ID
         Raise("Extension of compute shader file should be '.comp'.");
     }
     else {
-        read_file_result ShaderFile = Assets->Platform->ReadEntireFile(Path);
-        Shader->Size = ShaderFile.ContentSize;
-        Shader->Code = (char*)ShaderFile.Content;
+        game_compute_shader* Previous = PreprocessedAssets.Previous ? &PreprocessedAssets.Previous->ComputeShader[ID] : NULL;
+        read_file_result ShaderFile;
+        if (CheckSource(Assets->Platform, Path, Previous ? &Previous->Source : NULL, &Shader->Source, &ShaderFile)) {
+            Shader->Size = Previous->Size;
+            Shader->Code = PreprocessedAssets.CachedComputeShader[ID] = Previous->Code;
+        }
+        else {
+            Shader->Size = ShaderFile.ContentSize;
+            Shader->Code = (char*)ShaderFile.Content;
+        }
 
         // Extra char with value 0 to separate shaders
         Assets->TotalSize += Shader->Size + 1;
@@ -668,6 +695,7 @@ void PushShader(game_assets* Assets, const char* Path, game_compute_shader_id ID
     delete [] Buffer;
 }
 
+void SetShaderPointers(game_assets* Assets);
 void WriteAssetsFile(platform_api* Platform, const char* Path);
 void LoadAssetsFromFile(memory_arena* FontsArena, platform_read_entire_file Read, game_assets* Assets, const char* Path);
 
@@ -12,6 +12,7 @@ preprocessed_mesh PreprocessMesh(read_file_result File) {
             if (Token == "nV")   Result.nVertices = Parseuint32(Tokenizer);
             else if (Token == "nF") Result.nFaces = Parseuint32(Tokenizer);
             else if (Token == "nB") Result.nBones = Parseuint32(Tokenizer);
+            else if (Token == "bind") Result.HasBindPose = Parseuint32(Tokenizer) != 0;
             Token = GetToken(Tokenizer);
         }
     }
@@ -23,6 +24,174 @@ uint32 GetMeshVerticesSize(uint32 nVertices, bool HasArmature) {
     return VertexSize * nVertices;
 }
 
+// A binary BVH over n leaves never needs more than 2n - 1 nodes
+uint32 GetMeshBVHSize(uint32 nFaces) {
+    return nFaces > 0 ? (2 * nFaces - 1) * sizeof(mesh_bvh_node) : 0;
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | BVH                                                                                                                                          |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+const int BVH_SAH_BINS = 12;
+const int BVH_MAX_DEPTH = 64;
+
+inline v3 GetMeshVertexPosition(game_mesh* Mesh, uint32 Stride, uint32 Index) {
+    float* Position = (float*)((uint8*)Mesh->Vertices + Stride * Index);
+    return V3(Position[0], Position[1], Position[2]);
+}
+
+inline uint32 GetMeshStride(game_mesh* Mesh) {
+    return GetMeshVerticesSize(1, Mesh->Armature.nBones > 0);
+}
+
+aabb GetFaceBounds(game_mesh* Mesh, uint32 Stride, uint32 Face) {
+    uint32* Indices = Mesh->Faces + 3 * Face;
+    aabb Result = EmptyAABB();
+    Grow(&Result, GetMeshVertexPosition(Mesh, Stride, Indices[0]));
+    Grow(&Result, GetMeshVertexPosition(Mesh, Stride, Indices[1]));
+    Grow(&Result, GetMeshVertexPosition(Mesh, Stride, Indices[2]));
+    return Result;
+}
+
+inline float GetFaceCentroid(game_mesh* Mesh, uint32 Stride, uint32 Face, int Axis) {
+    uint32* Indices = Mesh->Faces + 3 * Face;
+    v3 A = GetMeshVertexPosition(Mesh, Stride, Indices[0]);
+    v3 B = GetMeshVertexPosition(Mesh, Stride, Indices[1]);
+    v3 C = GetMeshVertexPosition(Mesh, Stride, Indices[2]);
+    return ((&A.X)[Axis] + (&B.X)[Axis] + (&C.X)[Axis]) / 3.0f;
+}
+
+void UpdateBVHNodeBounds(game_mesh* Mesh, uint32 Stride, mesh_bvh_node* Node) {
+    aabb Bounds = EmptyAABB();
+    for (uint32 i = 0; i < Node->nTriangles; i++) {
+        Grow(&Bounds, GetFaceBounds(Mesh, Stride, Node->LeftFirst + i));
+    }
+    Node->Min = Bounds.Min;
+    Node->Max = Bounds.Max;
+}
+
+/*
+    Binned SAH split. Each axis is cut into BVH_SAH_BINS slabs over the centroid range and the cheapest plane between
+    bins wins. A node stays a leaf when no split is cheaper than intersecting all of its triangles.
+*/
+void SubdivideBVHNode(game_mesh* Mesh, uint32 Stride, uint32 NodeIndex, int Depth) {
+    mesh_bvh_node* Node = &Mesh->BVH[NodeIndex];
+    if (Node->nTriangles <= 2 || Depth >= BVH_MAX_DEPTH - 1) return;
+
+    uint32 First = Node->LeftFirst;
+    uint32 Last = First + Node->nTriangles;
+    aabb NodeBounds = { Node->Min, Node->Max };
+    float BestCost = Node->nTriangles * HalfArea(NodeBounds);
+    int BestAxis = -1;
+    int BestBin = 0;
+    float BestCentroidMin = 0, BestBinScale = 0;
+
+    for (int Axis = 0; Axis < 3; Axis++) {
+        float CentroidMin = FLT_MAX, CentroidMax = -FLT_MAX;
+        for (uint32 i = First; i < Last; i++) {
+            float Centroid = GetFaceCentroid(Mesh, Stride, i, Axis);
+            CentroidMin = min(CentroidMin, Centroid);
+            CentroidMax = max(CentroidMax, Centroid);
+        }
+        if (CentroidMin == CentroidMax) continue;
+
+        aabb BinBounds[BVH_SAH_BINS];
+        uint32 BinCount[BVH_SAH_BINS] = {};
+        for (int b = 0; b < BVH_SAH_BINS; b++) BinBounds[b] = EmptyAABB();
+
+        float BinScale = BVH_SAH_BINS / (CentroidMax - CentroidMin);
+        for (uint32 i = First; i < Last; i++) {
+            float Centroid = GetFaceCentroid(Mesh, Stride, i, Axis);
+            int Bin = min(BVH_SAH_BINS - 1, (int)((Centroid - CentroidMin) * BinScale));
+            BinCount[Bin]++;
+            Grow(&BinBounds[Bin], GetFaceBounds(Mesh, Stride, i));
+        }
+
+        // Sweep from both ends so each candidate plane gets its cost in O(1)
+        float LeftArea[BVH_SAH_BINS - 1], RightArea[BVH_SAH_BINS - 1];
+        uint32 LeftCount[BVH_SAH_BINS - 1], RightCount[BVH_SAH_BINS - 1];
+        aabb LeftBox = EmptyAABB(), RightBox = EmptyAABB();
+        uint32 LeftSum = 0, RightSum = 0;
+        for (int b = 0; b < BVH_SAH_BINS - 1; b++) {
+            LeftSum += BinCount[b];
+            LeftCount[b] = LeftSum;
+            Grow(&LeftBox, BinBounds[b]);
+            LeftArea[b] = LeftSum > 0 ? HalfArea(LeftBox) : 0;
+
+            RightSum += BinCount[BVH_SAH_BINS - 1 - b];
+            RightCount[BVH_SAH_BINS - 2 - b] = RightSum;
+            Grow(&RightBox, BinBounds[BVH_SAH_BINS - 1 - b]);
+            RightArea[BVH_SAH_BINS - 2 - b] = RightSum > 0 ? HalfArea(RightBox) : 0;
+        }
+
+        for (int b = 0; b < BVH_SAH_BINS - 1; b++) {
+            float Cost = LeftCount[b] * LeftArea[b] + RightCount[b] * RightArea[b];
+            if (Cost < BestCost) {
+                BestCost = Cost;
+                BestAxis = Axis;
+                BestBin = b;
+                BestCentroidMin = CentroidMin;
+                BestBinScale = BinScale;
+            }
+        }
+    }
+
+    if (BestAxis == -1) return;
+
+    // Partition faces in place, left side holds bins [0, BestBin]
+    int64 i = First;
+    int64 j = Last - 1;
+    while (i <= j) {
+        float Centroid = GetFaceCentroid(Mesh, Stride, i, BestAxis);
+        int Bin = min(BVH_SAH_BINS - 1, (int)((Centroid - BestCentroidMin) * BestBinScale));
+        if (Bin <= BestBin) i++;
+        else {
+            uint32* A = Mesh->Faces + 3 * i;
+            uint32* B = Mesh->Faces + 3 * j;
+            for (int k = 0; k < 3; k++) {
+                uint32 Temp = A[k];
+                A[k] = B[k];
+                B[k] = Temp;
+            }
+            j--;
+        }
+    }
+
+    uint32 LeftTriangles = i - First;
+    if (LeftTriangles == 0 || LeftTriangles == Node->nTriangles) return;
+
+    uint32 LeftIndex = Mesh->nBVHNodes++;
+    uint32 RightIndex = Mesh->nBVHNodes++;
+    mesh_bvh_node* Left = &Mesh->BVH[LeftIndex];
+    mesh_bvh_node* Right = &Mesh->BVH[RightIndex];
+    Left->LeftFirst = First;
+    Left->nTriangles = LeftTriangles;
+    Right->LeftFirst = First + LeftTriangles;
+    Right->nTriangles = Node->nTriangles - LeftTriangles;
+    Node->LeftFirst = LeftIndex;
+    Node->nTriangles = 0;
+
+    UpdateBVHNodeBounds(Mesh, Stride, Left);
+    UpdateBVHNodeBounds(Mesh, Stride, Right);
+    SubdivideBVHNode(Mesh, Stride, LeftIndex, Depth + 1);
+    SubdivideBVHNode(Mesh, Stride, RightIndex, Depth + 1);
+}
+
+// Built once when packing assets, the nodes are stored right after the faces
+void BuildMeshBVH(memory_arena* Arena, game_mesh* Mesh) {
+    Mesh->BVH = (mesh_bvh_node*)PushSize(Arena, GetMeshBVHSize(Mesh->nFaces));
+    Mesh->nBVHNodes = 0;
+    if (Mesh->nFaces == 0) return;
+
+    uint32 Stride = GetMeshStride(Mesh);
+    mesh_bvh_node* Root = &Mesh->BVH[Mesh->nBVHNodes++];
+    Root->LeftFirst = 0;
+    Root->nTriangles = Mesh->nFaces;
+    UpdateBVHNodeBounds(Mesh, Stride, Root);
+    SubdivideBVHNode(Mesh, Stride, 0, 0);
+}
+
 game_mesh LoadMesh(memory_arena* Arena, preprocessed_mesh* Preprocessed) {
     game_mesh Result = {};
 
@@ -33,6 +202,7 @@ game_mesh LoadMesh(memory_arena* Arena, preprocessed_mesh* Preprocessed) {
         Result.nVertices = Preprocessed->nVertices;
         Result.nFaces = Preprocessed->nFaces;
         Result.Armature.nBones = Preprocessed->nBones;
+        Result.Armature.HasBindPose = Preprocessed->HasBindPose;
         bool HasArmature = Result.Armature.nBones > 0;
         Result.LayoutID = HasArmature ? vertex_layout_bones_id : vertex_layout_vec3_vec2_vec3_id;
         uint32 VerticesSize = GetMeshVerticesSize(Preprocessed->nVertices, HasArmature);
@@ -96,7 +266,11 @@ game_mesh LoadMesh(memory_arena* Arena, preprocessed_mesh* Preprocessed) {
             *pOutF++ = Face.Z;
         }
 
+        BuildMeshBVH(Arena, &Result);
+
+        // Bone lines are "ID Name [Parent] Head Tail [BindRotation]", the bind pose sits at the head with unit scale
         token Token;
+        transform Bind[MAX_ARMATURE_BONES];
         for (int i = 0; i < Result.Armature.nBones; i++) {
             bone Bone = {};
             Bone.ID = Parseuint32(Tokenizer);
@@ -105,11 +279,308 @@ game_mesh LoadMesh(memory_arena* Arena, preprocessed_mesh* Preprocessed) {
             for (int j = 0; j < Length; j++) {
                 Bone.Name[j] = Token.Text[j];
             }
+            Bone.Parent = Preprocessed->HasBindPose ? ParseInt(Tokenizer) : -1;
             Bone.Segment.Head = ParseV3(Tokenizer);
             Bone.Segment.Tail = ParseV3(Tokenizer);
+            Bind[Bone.ID] = IdentityTransform;
+            if (Preprocessed->HasBindPose) {
+                Bind[Bone.ID] = Transform(Bone.Segment.Head, ParseQuaternion(Tokenizer));
+            }
             Result.Armature.Bones[Bone.ID] = Bone;
         }
+
+        SetBindPose(&Result.Armature, Bind);
     }
 
     return Result;
-}
\ No newline at end of file
+}
+
+// Bone IDs depend on how the exporter walks the armature, so code that attaches things to bones finds them by name. -1 if missing.
+int FindBone(armature* Armature, const char* Name) {
+    for (int i = 0; i < Armature->nBones; i++) {
+        if (strncmp(Armature->Bones[i].Name, Name, BONE_NAME_LENGTH) == 0) return i;
+    }
+    return -1;
+}
+
+// Rest pose, inverse bind and leaves from the model space bind pose of every bone. Parents have to be set already.
+void SetBindPose(armature* Armature, transform* Bind) {
+    Armature->LeafBones = 0;
+    for (int i = 0; i < Armature->nBones; i++) {
+        bone* Bone = &Armature->Bones[i];
+        Assert(Bone->Parent < i, "Bones have to come after their parent.");
+        Bone->Rest = Bone->Parent >= 0 ? Bind[i] * inverse(Bind[Bone->Parent]) : Bind[i];
+        Bone->InverseBind = Matrix(inverse(Bind[i]));
+        Bone->Transform = Bone->Rest;
+        if (Armature->HasBindPose) Armature->LeafBones |= 1u << i;
+        if (Bone->Parent >= 0) Armature->LeafBones &= ~(1u << Bone->Parent);
+    }
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Raycasting                                                                                                                                   |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+/*
+    Möller-Trumbore. The direction doesn't need to be normalized, `t` is measured in units of its length.
+*/
+bool IntersectTriangle(v3 Origin, v3 Direction, v3 A, v3 B, v3 C, float* t, float* u, float* v) {
+    v3 E1 = B - A;
+    v3 E2 = C - A;
+    v3 P = cross(Direction, E2);
+    float Det = dot(E1, P);
+    if (fabsf(Det) < 1e-12f) return false;
+
+    float InvDet = 1.0f / Det;
+    v3 S = Origin - A;
+    *u = dot(S, P) * InvDet;
+    if (*u < 0.0f || *u > 1.0f) return false;
+
+    v3 Q = cross(S, E1);
+    *v = dot(Direction, Q) * InvDet;
+    if (*v < 0.0f || *u + *v > 1.0f) return false;
+
+    *t = dot(E2, Q) * InvDet;
+    return *t > 0.0f;
+}
+
+// Slab test of one ray against one node, three axes at once. Returns the entry distance or FLT_MAX on a miss.
+inline float IntersectBVHNode(mesh_bvh_node* Node, __m128 Origin, __m128 InverseDirection, float MaxDistance) {
+    __m128 T1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&Node->Min.X), Origin), InverseDirection);
+    __m128 T2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&Node->Max.X), Origin), InverseDirection);
+    __m128 Near = _mm_min_ps(T1, T2);
+    __m128 Far = _mm_max_ps(T1, T2);
+
+    // Fourth lane holds LeftFirst/nTriangles, so only reduce over XYZ
+    float TNear = _mm_cvtss_f32(_mm_max_ss(_mm_max_ss(Near, _mm_shuffle_ps(Near, Near, _MM_SHUFFLE(1,1,1,1))), _mm_shuffle_ps(Near, Near, _MM_SHUFFLE(2,2,2,2))));
+    float TFar  = _mm_cvtss_f32(_mm_min_ss(_mm_min_ss(Far, _mm_shuffle_ps(Far, Far, _MM_SHUFFLE(1,1,1,1))), _mm_shuffle_ps(Far, Far, _MM_SHUFFLE(2,2,2,2))));
+
+    if (TFar >= TNear && TFar > 0.0f && TNear < MaxDistance) return TNear;
+    return FLT_MAX;
+}
+
+/*
+    Closest hit of a ray against the mesh in model space. Children are visited nearest first and the far one is pushed.
+*/
+mesh_raycast_hit Raycast(game_mesh* Mesh, ray Ray, float MaxDistance) {
+    mesh_raycast_hit Result = {};
+    Result.Distance = MaxDistance;
+    if (Mesh->nBVHNodes == 0) return Result;
+
+    uint32 Stride = GetMeshStride(Mesh);
+    __m128 Origin = _mm_setr_ps(Ray.Point.X, Ray.Point.Y, Ray.Point.Z, 0.0f);
+    __m128 InverseDirection = _mm_div_ps(_mm_set1_ps(1.0f), _mm_setr_ps(Ray.Direction.X, Ray.Direction.Y, Ray.Direction.Z, 1.0f));
+
+    mesh_bvh_node* Node = &Mesh->BVH[0];
+    if (IntersectBVHNode(Node, Origin, InverseDirection, Result.Distance) == FLT_MAX) return Result;
+
+    uint32 Stack[BVH_MAX_DEPTH];
+    int StackSize = 0;
+    while (true) {
+        if (Node->nTriangles > 0) {
+            for (uint32 i = 0; i < Node->nTriangles; i++) {
+                uint32 Face = Node->LeftFirst + i;
+                uint32* Indices = Mesh->Faces + 3 * Face;
+                float t, u, v;
+                bool Hit = IntersectTriangle(
+                    Ray.Point, Ray.Direction,
+                    GetMeshVertexPosition(Mesh, Stride, Indices[0]),
+                    GetMeshVertexPosition(Mesh, Stride, Indices[1]),
+                    GetMeshVertexPosition(Mesh, Stride, Indices[2]),
+                    &t, &u, &v
+                );
+                if (Hit && t < Result.Distance) {
+                    Result.Hit = true;
+                    Result.Triangle = Face;
+                    Result.Distance = t;
+                    Result.U = u;
+                    Result.V = v;
+                }
+            }
+            if (StackSize == 0) break;
+            Node = &Mesh->BVH[Stack[--StackSize]];
+            continue;
+        }
+
+        uint32 Child1 = Node->LeftFirst;
+        uint32 Child2 = Node->LeftFirst + 1;
+        float Distance1 = IntersectBVHNode(&Mesh->BVH[Child1], Origin, InverseDirection, Result.Distance);
+        float Distance2 = IntersectBVHNode(&Mesh->BVH[Child2], Origin, InverseDirection, Result.Distance);
+        if (Distance1 > Distance2) {
+            float TempDistance = Distance1; Distance1 = Distance2; Distance2 = TempDistance;
+            uint32 TempChild = Child1; Child1 = Child2; Child2 = TempChild;
+        }
+
+        if (Distance1 == FLT_MAX) {
+            if (StackSize == 0) break;
+            Node = &Mesh->BVH[Stack[--StackSize]];
+        }
+        else {
+            Node = &Mesh->BVH[Child1];
+            if (Distance2 != FLT_MAX) {
+                Assert(StackSize < BVH_MAX_DEPTH, "BVH traversal stack overflow.");
+                Stack[StackSize++] = Child2;
+            }
+        }
+    }
+
+    return Result;
+}
+
+/*
+    World space raycast against a mesh drawn with transform T. The ray is taken to model space without renormalizing
+    the direction, so for a unit direction the hit distance is still in world units.
+*/
+mesh_raycast_hit Raycast(game_mesh* Mesh, transform T, ray Ray, float MaxDistance) {
+    quaternion InverseRotation = Conjugate(T.Rotation);
+    scale InverseScale = Scale(1.0f / T.Scale.X, 1.0f / T.Scale.Y, 1.0f / T.Scale.Z);
+
+    ray ModelRay;
+    ModelRay.Point = InverseScale * (InverseRotation * (Ray.Point - T.Translation));
+    ModelRay.Direction = InverseScale * (InverseRotation * Ray.Direction);
+    return Raycast(Mesh, ModelRay, MaxDistance);
+}
+
+// Packets __________________________________________________________________________________________________________________________________
+
+ray_packet RayPacket(ray Rays[4]) {
+    ray_packet Result;
+    Result.PointX = _mm_setr_ps(Rays[0].Point.X, Rays[1].Point.X, Rays[2].Point.X, Rays[3].Point.X);
+    Result.PointY = _mm_setr_ps(Rays[0].Point.Y, Rays[1].Point.Y, Rays[2].Point.Y, Rays[3].Point.Y);
+    Result.PointZ = _mm_setr_ps(Rays[0].Point.Z, Rays[1].Point.Z, Rays[2].Point.Z, Rays[3].Point.Z);
+    Result.DirectionX = _mm_setr_ps(Rays[0].Direction.X, Rays[1].Direction.X, Rays[2].Direction.X, Rays[3].Direction.X);
+    Result.DirectionY = _mm_setr_ps(Rays[0].Direction.Y, Rays[1].Direction.Y, Rays[2].Direction.Y, Rays[3].Direction.Y);
+    Result.DirectionZ = _mm_setr_ps(Rays[0].Direction.Z, Rays[1].Direction.Z, Rays[2].Direction.Z, Rays[3].Direction.Z);
+    __m128 One = _mm_set1_ps(1.0f);
+    Result.InverseX = _mm_div_ps(One, Result.DirectionX);
+    Result.InverseY = _mm_div_ps(One, Result.DirectionY);
+    Result.InverseZ = _mm_div_ps(One, Result.DirectionZ);
+    return Result;
+}
+
+inline __m128 Select(__m128 Mask, __m128 A, __m128 B) {
+    return _mm_or_ps(_mm_and_ps(Mask, A), _mm_andnot_ps(Mask, B));
+}
+
+// Lane mask of the rays in the packet that enter the node before their current closest hit
+inline __m128 IntersectBVHNode(mesh_bvh_node* Node, ray_packet* Packet, __m128 Closest) {
+    __m128 X1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->Min.X), Packet->PointX), Packet->InverseX);
+    __m128 X2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->Max.X), Packet->PointX), Packet->InverseX);
+    __m128 Y1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->Min.Y), Packet->PointY), Packet->InverseY);
+    __m128 Y2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->Max.Y), Packet->PointY), Packet->InverseY);
+    __m128 Z1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->Min.Z), Packet->PointZ), Packet->InverseZ);
+    __m128 Z2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Node->Max.Z), Packet->PointZ), Packet->InverseZ);
+
+    __m128 Near = _mm_max_ps(_mm_max_ps(_mm_min_ps(X1, X2), _mm_min_ps(Y1, Y2)), _mm_min_ps(Z1, Z2));
+    __m128 Far  = _mm_min_ps(_mm_min_ps(_mm_max_ps(X1, X2), _mm_max_ps(Y1, Y2)), _mm_max_ps(Z1, Z2));
+
+    __m128 Mask = _mm_cmpge_ps(Far, Near);
+    Mask = _mm_and_ps(Mask, _mm_cmpgt_ps(Far, _mm_setzero_ps()));
+    Mask = _mm_and_ps(Mask, _mm_cmplt_ps(Near, Closest));
+    return Mask;
+}
+
+/*
+    Packet version of Raycast. Rays should be coherent (e.g. neighbouring pixels), a node is entered if any ray in the
+    packet hits it and triangles are tested against the four rays at once.
+*/
+void Raycast(game_mesh* Mesh, ray_packet* Packet, mesh_raycast_hit Hits[4]) {
+    __m128 Closest = _mm_set1_ps(FLT_MAX);
+    __m128 U = _mm_setzero_ps();
+    __m128 V = _mm_setzero_ps();
+    __m128 Triangle = _mm_setzero_ps();
+
+    if (Mesh->nBVHNodes > 0 && _mm_movemask_ps(IntersectBVHNode(&Mesh->BVH[0], Packet, Closest))) {
+        uint32 Stride = GetMeshStride(Mesh);
+        __m128 Zero = _mm_setzero_ps();
+        __m128 One = _mm_set1_ps(1.0f);
+        __m128 SignMask = _mm_set1_ps(-0.0f);
+
+        uint32 Stack[BVH_MAX_DEPTH];
+        int StackSize = 0;
+        mesh_bvh_node* Node = &Mesh->BVH[0];
+        while (true) {
+            if (Node->nTriangles > 0) {
+                for (uint32 i = 0; i < Node->nTriangles; i++) {
+                    uint32 Face = Node->LeftFirst + i;
+                    uint32* Indices = Mesh->Faces + 3 * Face;
+                    v3 A = GetMeshVertexPosition(Mesh, Stride, Indices[0]);
+                    v3 E1 = GetMeshVertexPosition(Mesh, Stride, Indices[1]) - A;
+                    v3 E2 = GetMeshVertexPosition(Mesh, Stride, Indices[2]) - A;
+                    __m128 E1X = _mm_set1_ps(E1.X), E1Y = _mm_set1_ps(E1.Y), E1Z = _mm_set1_ps(E1.Z);
+                    __m128 E2X = _mm_set1_ps(E2.X), E2Y = _mm_set1_ps(E2.Y), E2Z = _mm_set1_ps(E2.Z);
+
+                    // P = D x E2
+                    __m128 PX = _mm_sub_ps(_mm_mul_ps(Packet->DirectionY, E2Z), _mm_mul_ps(Packet->DirectionZ, E2Y));
+                    __m128 PY = _mm_sub_ps(_mm_mul_ps(Packet->DirectionZ, E2X), _mm_mul_ps(Packet->DirectionX, E2Z));
+                    __m128 PZ = _mm_sub_ps(_mm_mul_ps(Packet->DirectionX, E2Y), _mm_mul_ps(Packet->DirectionY, E2X));
+                    __m128 Det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(E1X, PX), _mm_mul_ps(E1Y, PY)), _mm_mul_ps(E1Z, PZ));
+                    __m128 InvDet = _mm_div_ps(One, Det);
+
+                    __m128 SX = _mm_sub_ps(Packet->PointX, _mm_set1_ps(A.X));
+                    __m128 SY = _mm_sub_ps(Packet->PointY, _mm_set1_ps(A.Y));
+                    __m128 SZ = _mm_sub_ps(Packet->PointZ, _mm_set1_ps(A.Z));
+                    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(SX, PX), _mm_mul_ps(SY, PY)), _mm_mul_ps(SZ, PZ)), InvDet);
+
+                    // Q = S x E1
+                    __m128 QX = _mm_sub_ps(_mm_mul_ps(SY, E1Z), _mm_mul_ps(SZ, E1Y));
+                    __m128 QY = _mm_sub_ps(_mm_mul_ps(SZ, E1X), _mm_mul_ps(SX, E1Z));
+                    __m128 QZ = _mm_sub_ps(_mm_mul_ps(SX, E1Y), _mm_mul_ps(SY, E1X));
+                    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(Packet->DirectionX, QX), _mm_mul_ps(Packet->DirectionY, QY)), _mm_mul_ps(Packet->DirectionZ, QZ)), InvDet);
+                    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(E2X, QX), _mm_mul_ps(E2Y, QY)), _mm_mul_ps(E2Z, QZ)), InvDet);
+
+                    __m128 Mask = _mm_cmpgt_ps(_mm_andnot_ps(SignMask, Det), _mm_set1_ps(1e-12f));
+                    Mask = _mm_and_ps(Mask, _mm_cmpge_ps(u, Zero));
+                    Mask = _mm_and_ps(Mask, _mm_cmpge_ps(v, Zero));
+                    Mask = _mm_and_ps(Mask, _mm_cmple_ps(_mm_add_ps(u, v), One));
+                    Mask = _mm_and_ps(Mask, _mm_cmpgt_ps(t, Zero));
+                    Mask = _mm_and_ps(Mask, _mm_cmplt_ps(t, Closest));
+
+                    if (_mm_movemask_ps(Mask)) {
+                        Closest = Select(Mask, t, Closest);
+                        U = Select(Mask, u, U);
+                        V = Select(Mask, v, V);
+                        Triangle = Select(Mask, _mm_castsi128_ps(_mm_set1_epi32(Face)), Triangle);
+                    }
+                }
+                if (StackSize == 0) break;
+                Node = &Mesh->BVH[Stack[--StackSize]];
+                continue;
+            }
+
+            uint32 Child1 = Node->LeftFirst;
+            uint32 Child2 = Node->LeftFirst + 1;
+            bool Hit1 = _mm_movemask_ps(IntersectBVHNode(&Mesh->BVH[Child1], Packet, Closest)) != 0;
+            bool Hit2 = _mm_movemask_ps(IntersectBVHNode(&Mesh->BVH[Child2], Packet, Closest)) != 0;
+            if (Hit1) {
+                Node = &Mesh->BVH[Child1];
+                if (Hit2) {
+                    Assert(StackSize < BVH_MAX_DEPTH, "BVH traversal stack overflow.");
+                    Stack[StackSize++] = Child2;
+                }
+            }
+            else if (Hit2) {
+                Node = &Mesh->BVH[Child2];
+            }
+            else {
+                if (StackSize == 0) break;
+                Node = &Mesh->BVH[Stack[--StackSize]];
+            }
+        }
+    }
+
+    float ClosestLanes[4], ULanes[4], VLanes[4];
+    uint32 TriangleLanes[4];
+    _mm_storeu_ps(ClosestLanes, Closest);
+    _mm_storeu_ps(ULanes, U);
+    _mm_storeu_ps(VLanes, V);
+    _mm_storeu_ps((float*)TriangleLanes, Triangle);
+    for (int i = 0; i < 4; i++) {
+        Hits[i].Hit = ClosestLanes[i] < FLT_MAX;
+        Hits[i].Triangle = TriangleLanes[i];
+        Hits[i].Distance = ClosestLanes[i];
+        Hits[i].U = ULanes[i];
+        Hits[i].V = VLanes[i];
+    }
+}
@@ -1,6 +1,7 @@
 #include "GamePlatform.h"
 #include "GameMath.h"
 #include "Shader/GameShader.h"
+#include <immintrin.h>
 
 #ifndef GAME_MESH
 #define GAME_MESH
@@ -18,19 +19,43 @@ enum game_mesh_id {
 
 const int BONE_NAME_LENGTH = 32;
 
+/*
+    Bones are sorted so parents come before their children. `Transform` is the pose relative to the parent (to the model
+    for roots), `Rest` is that same pose in the bind pose and `InverseBind` takes bind pose model space to bone space.
+
+    Meshes exported without a bind pose have every bone as a root with identity bind, and their animations store the
+    skinning transforms directly.
+*/
 struct bone {
     int ID;
+    int Parent;
     char Name[BONE_NAME_LENGTH];
     segment3 Segment;
     transform Transform;
+    transform Rest;
+    matrix4 InverseBind;
 };
 
 const int MAX_ARMATURE_BONES = 32;
 struct armature {
     uint32 nBones;
+    bool HasBindPose;
+    uint32 LeafBones;           // Bit per bone without children, only known with a bind pose
     bone Bones[MAX_ARMATURE_BONES];
 };
 
+/*
+    Flattened BVH over the mesh faces. Children of an inner node are always consecutive, so `LeftFirst` is the left
+    child index for inner nodes and the first face for leaves (leaves have `nTriangles` > 0). Faces are reordered when
+    the tree is built so every leaf references a contiguous range of `game_mesh::Faces`.
+*/
+struct mesh_bvh_node {
+    v3 Min;
+    uint32 LeftFirst;
+    v3 Max;
+    uint32 nTriangles;
+};
+
 struct game_mesh {
     armature Armature;
     game_mesh_id ID;
@@ -39,6 +64,8 @@ struct game_mesh {
     uint32 nFaces;
     void* Vertices;
     uint32* Faces;
+    uint32 nBVHNodes;
+    mesh_bvh_node* BVH;
     float MinX;
     float MaxX;
     float MinY;
@@ -52,10 +79,38 @@ struct preprocessed_mesh {
     uint32 nVertices;
     uint32 nFaces;
     uint32 nBones;
+    bool HasBindPose;
 };
 
 preprocessed_mesh PreprocessMesh(read_file_result File);
 game_mesh LoadMesh(memory_arena* Arena, preprocessed_mesh* Preprocessed);
+void SetBindPose(armature* Armature, transform* Bind);
+int FindBone(armature* Armature, const char* Name);
 uint32 GetMeshVerticesSize(uint32 nVertices, bool HasArmature);
+uint32 GetMeshBVHSize(uint32 nFaces);
+void BuildMeshBVH(memory_arena* Arena, game_mesh* Mesh);
+
+// Raycasting ______________________________________________________________________________________________________________________________
+
+struct mesh_raycast_hit {
+    bool Hit;
+    uint32 Triangle;
+    float Distance;
+    float U;            // Barycentric weight of the second vertex
+    float V;            // Barycentric weight of the third vertex
+};
+
+// Four rays in SoA layout, traversed together
+struct ray_packet {
+    __m128 PointX, PointY, PointZ;
+    __m128 DirectionX, DirectionY, DirectionZ;
+    __m128 InverseX, InverseY, InverseZ;
+};
+
+bool IntersectTriangle(v3 Origin, v3 Direction, v3 A, v3 B, v3 C, float* t, float* u, float* v);
+ray_packet RayPacket(ray Rays[4]);
+mesh_raycast_hit Raycast(game_mesh* Mesh, ray Ray, float MaxDistance = FLT_MAX);
+mesh_raycast_hit Raycast(game_mesh* Mesh, transform T, ray Ray, float MaxDistance = FLT_MAX);
+void Raycast(game_mesh* Mesh, ray_packet* Packet, mesh_raycast_hit Hits[4]);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 450
+precision highp float;
+
+layout (location = 0) in vec4 v_color;
+layout (location = 0) out vec4 frag_color;
+
+void main() {
+	frag_color = v_color;
+}
\ No newline at end of file
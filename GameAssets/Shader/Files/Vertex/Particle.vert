@@ -0,0 +1,27 @@
+#version 450
+precision highp float;
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec4 a_color;
+layout(location = 2) in float a_size;
+
+#ifdef VULKAN
+layout(std140, set = 0, binding = 0) uniform GlobalUniforms 
+#else 
+layout(std140, binding = 0) uniform GlobalUniforms 
+#endif
+{
+	mat4 projection;
+	mat4 view;
+	vec2 resolution;
+	float time;
+} GlobalUBO;
+
+layout(location = 0) out vec4 v_color;
+
+void main() {
+	v_color = a_color;
+
+	gl_Position = GlobalUBO.projection * GlobalUBO.view * vec4(a_position, 1.0);
+	gl_PointSize = max(a_size * GlobalUBO.projection[1][1] * GlobalUBO.resolution.y / (2.0 * gl_Position.w), 1.0);
+}
\ No newline at end of file
@@ -15,6 +15,7 @@ enum game_shader_id {
     Vertex_Shader_Perspective_ID,
     Vertex_Shader_Bones_ID,
     Vertex_Shader_Barycentric_ID,
+    Vertex_Shader_Particle_ID,
 #if GAME_RENDER_API_VULKAN
     Vertex_Shader_Vulkan_Test_ID,
 #endif
@@ -46,6 +47,7 @@ enum game_shader_id {
     Fragment_Shader_Sea_ID,
     Fragment_Shader_Bezier_Exterior_ID,
     Fragment_Shader_Bezier_Interior_ID,
+    Fragment_Shader_Vertex_Color_ID,
 #if GAME_RENDER_API_VULKAN
     Fragment_Shader_Vulkan_Test_ID,
 #endif
@@ -72,6 +74,7 @@ enum game_shader_pipeline_id {
     Shader_Pipeline_Bezier_Exterior_ID,
     Shader_Pipeline_Bezier_Interior_ID,
     Shader_Pipeline_Solid_Text_ID,
+    Shader_Pipeline_Particle_ID,
 #if GAME_RENDER_API_VULKAN
     Shader_Pipeline_Vulkan_Test_ID,
 #endif
@@ -193,6 +196,7 @@ enum vertex_layout_id {
     vertex_layout_vec3_vec2_id,
     vertex_layout_vec3_vec2_vec3_id,
     vertex_layout_vec3_vec4_id,
+    vertex_layout_vec3_vec4_float_id,
     vertex_layout_vec4_id,
     vertex_layout_bones_id,
 
@@ -356,6 +360,7 @@ struct game_shader {
     game_shader_id ID;
     game_shader_type Type;
     read_file_result File;
+    file_stamp Source;
     char* Code;
     uint64 BinarySize;
     uint32* Binary;
@@ -377,6 +382,7 @@ struct game_shader_pipeline {
 struct game_compute_shader {
     game_compute_shader_id ID;
     uint32 Size;
+    file_stamp Source;
     char* Code;
 };
 
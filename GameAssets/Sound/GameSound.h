@@ -2,6 +2,7 @@
 
 #include "GamePlatform.h"
 #include "GameMath.h"
+#include "GameMathWide.h"
 
 #ifndef GAME_SOUND
 #define GAME_SOUND
@@ -118,34 +119,53 @@ float WriteSineWave(game_sound_buffer* pSoundBuffer, float Hz, float InitialPhas
     return Phase;
 }
 
-void FadeIn(game_sound_buffer* pSoundBuffer, uint8 TransitionCount) {
+/*
+    Scales the interleaved stereo samples by a per-sample gain, four samples (eight values) at a time.
+    Gain(i) = Sign * e^(-(i + Offset) / HalfLife) + Bias, so FadeIn and FadeOut only differ in Sign and Bias.
+*/
+void ApplyExponentialGain(game_sound_buffer* pSoundBuffer, float Offset, float HalfLife, float Sign, float Bias) {
     uint32 SampleCount = pSoundBuffer->BufferSize;
-    uint16 HalfLife = (uint16)(SampleCount / 2);
     int16* SampleOut = pSoundBuffer->SampleOut;
-    for (uint32 SampleIndex = 0; SampleIndex < SampleCount; SampleIndex++) {
-        float Exp = (1 - expf(-(float)((SampleIndex + TransitionCount * SampleCount) / (float)HalfLife)));
-        float LeftValue = (float)*SampleOut * Exp;
-        *SampleOut = (uint16)(LeftValue); // LEFT
+    float InvHalfLife = 1.0f / HalfLife;
+
+    uint32 SampleIndex = 0;
+    wide_float Lane = WideFloat(0.0f, 1.0f, 2.0f, 3.0f);
+    for (; SampleIndex + 4 <= SampleCount; SampleIndex += 4) {
+        wide_float Index = Lane + (float)SampleIndex + Offset;
+        __m128 Gain = (Sign * Exp(-InvHalfLife * Index) + Bias).V;
+        __m128 GainLow = _mm_unpacklo_ps(Gain, Gain);
+        __m128 GainHigh = _mm_unpackhi_ps(Gain, Gain);
+
+        __m128i Samples = _mm_loadu_si128((__m128i*)SampleOut);
+        __m128 Low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(Samples, Samples), 16));
+        __m128 High = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(Samples, Samples), 16));
+        __m128i ScaledLow = _mm_cvttps_epi32(_mm_mul_ps(Low, GainLow));
+        __m128i ScaledHigh = _mm_cvttps_epi32(_mm_mul_ps(High, GainHigh));
+        _mm_storeu_si128((__m128i*)SampleOut, _mm_packs_epi32(ScaledLow, ScaledHigh));
+        SampleOut += 8;
+    }
+
+    for (; SampleIndex < SampleCount; SampleIndex++) {
+        float Gain = Sign * expf(-(SampleIndex + Offset) * InvHalfLife) + Bias;
+        float LeftValue = (float)*SampleOut * Gain;
+        *SampleOut = (int16)(LeftValue); // LEFT
         SampleOut++;
-        float RightValue = (float)*SampleOut * Exp;
-        *SampleOut = (uint16)(RightValue); // RIGHT
+        float RightValue = (float)*SampleOut * Gain;
+        *SampleOut = (int16)(RightValue); // RIGHT
         SampleOut++;
     }
 }
 
+void FadeIn(game_sound_buffer* pSoundBuffer, uint8 TransitionCount) {
+    uint32 SampleCount = pSoundBuffer->BufferSize;
+    uint16 HalfLife = (uint16)(SampleCount / 2);
+    ApplyExponentialGain(pSoundBuffer, (float)(TransitionCount * SampleCount), (float)HalfLife, -1.0f, 1.0f);
+}
+
 void FadeOut(game_sound_buffer* pSoundBuffer, uint8 TransitionCount) {
     uint32 SampleCount = pSoundBuffer->BufferSize;
     uint16 HalfLife = (uint16)(SampleCount / 2);
-    int16* SampleOut = pSoundBuffer->SampleOut;
-    for (uint32 SampleIndex = 0; SampleIndex < SampleCount; SampleIndex++) {
-        float Exp = expf(-(float)((SampleIndex + TransitionCount * SampleCount) / (float)HalfLife));
-        float LeftValue = (float)*SampleOut * Exp;
-        *SampleOut = (uint16)(LeftValue); // LEFT
-        SampleOut++;
-        float RightValue = (float)*SampleOut * Exp;
-        *SampleOut = (uint16)(RightValue); // RIGHT
-        SampleOut++;
-    }
+    ApplyExponentialGain(pSoundBuffer, (float)(TransitionCount * SampleCount), (float)HalfLife, 1.0f, 0.0f);
 }
 
 void Silence(game_sound_buffer* pSoundBuffer) {
@@ -0,0 +1,375 @@
+#ifndef GAME_COLLISION
+#define GAME_COLLISION
+
+#include "GamePlatform.h"
+#include "GameMath.h"
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Broadphase                                                                                                                                   |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+/*
+    Sweep and prune over the X axis. Every frame the proxies are refit from their world colliders and the sorted order
+    from the previous frame is fixed with an insertion sort, which is close to linear when things move coherently.
+    The sweep then emits every pair whose boxes overlap in all three axes as a candidate for `Collide(collider, collider)`.
+*/
+
+struct broadphase_proxy {
+    aabb Box;
+    collider Collider;
+    bool Active;
+};
+
+// Proxy indices, as given to `SetProxy`
+struct broadphase_pair {
+    int A;
+    int B;
+};
+
+struct broadphase {
+    uint32 MaxProxies;
+    uint32 nProxies;
+    broadphase_proxy* Proxies;
+    uint32* SortedX;
+    uint32 MaxPairs;
+    uint32 nPairs;
+    broadphase_pair* Pairs;
+};
+
+broadphase* AllocateBroadphase(memory_arena* Arena, uint32 MaxProxies, uint32 MaxPairs) {
+    broadphase* Result = PushStruct(Arena, broadphase);
+    Result->MaxProxies = MaxProxies;
+    Result->nProxies = 0;
+    Result->Proxies = PushArray(Arena, MaxProxies, broadphase_proxy);
+    Result->SortedX = PushArray(Arena, MaxProxies, uint32);
+    for (int i = 0; i < MaxProxies; i++) {
+        Result->SortedX[i] = i;
+    }
+    Result->MaxPairs = MaxPairs;
+    Result->nPairs = 0;
+    Result->Pairs = PushArray(Arena, MaxPairs, broadphase_pair);
+    return Result;
+}
+
+/*
+    Refits proxy `Index` with a collider already in world space. Proxies are addressed by a stable index (entity ID),
+    so the sorted order survives between frames, and pairs report the indices of their proxies.
+*/
+void SetProxy(broadphase* Broadphase, uint32 Index, collider WorldCollider) {
+    Assert(Index < Broadphase->MaxProxies, "Broadphase proxy out of range.");
+    broadphase_proxy* Proxy = &Broadphase->Proxies[Index];
+    Proxy->Collider = WorldCollider;
+    Proxy->Box = AABB(WorldCollider);
+    Proxy->Active = true;
+    if (Index >= Broadphase->nProxies) Broadphase->nProxies = Index + 1;
+}
+
+void ClearProxy(broadphase* Broadphase, uint32 Index) {
+    Assert(Index < Broadphase->MaxProxies, "Broadphase proxy out of range.");
+    Broadphase->Proxies[Index].Active = false;
+}
+
+// Only these collider pairs have a narrowphase test in `Collide(collider, collider)`
+inline bool CanCollide(collider_type Type1, collider_type Type2) {
+    if (Type1 == Type2) return true;
+    if (Type1 == Rect_Collider || Type2 == Rect_Collider) return false;
+    if (Type1 == Cube_Collider || Type2 == Cube_Collider) return false;
+    return true;
+}
+
+void UpdateBroadphase(broadphase* Broadphase) {
+    TIMED_BLOCK;
+
+    broadphase_proxy* Proxies = Broadphase->Proxies;
+    uint32* Sorted = Broadphase->SortedX;
+    uint32 n = Broadphase->nProxies;
+
+    // Inactive proxies sort to the end so the sweep can stop at the first one
+    for (int i = 1; i < n; i++) {
+        uint32 Key = Sorted[i];
+        broadphase_proxy* KeyProxy = &Proxies[Key];
+        float KeyX = KeyProxy->Active ? KeyProxy->Box.Min.X : FLT_MAX;
+        int j = i - 1;
+        while (j >= 0) {
+            broadphase_proxy* Other = &Proxies[Sorted[j]];
+            float OtherX = Other->Active ? Other->Box.Min.X : FLT_MAX;
+            if (OtherX <= KeyX) break;
+            Sorted[j + 1] = Sorted[j];
+            j--;
+        }
+        Sorted[j + 1] = Key;
+    }
+
+    Broadphase->nPairs = 0;
+    for (int i = 0; i < n; i++) {
+        broadphase_proxy* A = &Proxies[Sorted[i]];
+        if (!A->Active) break;
+
+        for (int j = i + 1; j < n; j++) {
+            broadphase_proxy* B = &Proxies[Sorted[j]];
+            if (!B->Active || B->Box.Min.X > A->Box.Max.X) break;
+
+            if (Intersect(A->Box, B->Box) && CanCollide(A->Collider.Type, B->Collider.Type)) {
+                Assert(Broadphase->nPairs < Broadphase->MaxPairs, "Broadphase pair buffer is full.");
+                broadphase_pair* Pair = &Broadphase->Pairs[Broadphase->nPairs++];
+                Pair->A = Sorted[i];
+                Pair->B = Sorted[j];
+            }
+        }
+    }
+}
+
+// Narrowphase over the candidate pairs. Pairs that don't touch are compacted out, so afterwards `Pairs` only holds contacts.
+uint32 CollidePairs(broadphase* Broadphase) {
+    TIMED_BLOCK;
+    uint32 nContacts = 0;
+    for (int i = 0; i < Broadphase->nPairs; i++) {
+        broadphase_pair Pair = Broadphase->Pairs[i];
+        if (Collide(Broadphase->Proxies[Pair.A].Collider, Broadphase->Proxies[Pair.B].Collider)) {
+            Broadphase->Pairs[nContacts++] = Pair;
+        }
+    }
+    Broadphase->nPairs = nContacts;
+    return nContacts;
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Spatial hash                                                                                                                                 |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+/*
+    Uniform grid over positions, stored sparsely as a hash of cell coordinates into a fixed bucket table. Each bucket
+    holds an intrusive doubly linked list of entries, so moving an entry between cells is O(1) and staying in the same
+    cell only writes the position. Different cells can share a bucket, queries filter by the stored cell.
+    Entries are addressed by handle (entity ID), queries write into caller buffers and never allocate.
+*/
+
+struct spatial_hash_entry {
+    v3 Position;
+    iv3 Cell;
+    int Previous;
+    int Next;
+    bool Active;
+};
+
+struct spatial_hash_neighbour {
+    int Handle;
+    float SqDistance;
+};
+
+struct spatial_hash {
+    float CellSize;
+    float InvCellSize;
+    uint32 nBuckets;
+    int* Buckets;
+    uint32 MaxEntries;
+    uint32 nEntries;
+    spatial_hash_entry* Entries;
+};
+
+// nBuckets is rounded up to a power of two
+spatial_hash* AllocateSpatialHash(memory_arena* Arena, uint32 MaxEntries, float CellSize, uint32 nBuckets) {
+    uint32 Buckets = 1;
+    while (Buckets < nBuckets) Buckets <<= 1;
+
+    spatial_hash* Result = PushStruct(Arena, spatial_hash);
+    Result->CellSize = CellSize;
+    Result->InvCellSize = 1.0f / CellSize;
+    Result->nBuckets = Buckets;
+    Result->Buckets = PushArray(Arena, Buckets, int);
+    for (int i = 0; i < Buckets; i++) Result->Buckets[i] = -1;
+    Result->MaxEntries = MaxEntries;
+    Result->nEntries = 0;
+    Result->Entries = PushArray(Arena, MaxEntries, spatial_hash_entry);
+    return Result;
+}
+
+inline iv3 GetCell(spatial_hash* Hash, v3 Position) {
+    return IV3(
+        (int)floorf(Position.X * Hash->InvCellSize),
+        (int)floorf(Position.Y * Hash->InvCellSize),
+        (int)floorf(Position.Z * Hash->InvCellSize)
+    );
+}
+
+inline uint32 GetBucket(spatial_hash* Hash, iv3 Cell) {
+    uint32 Key = ((uint32)Cell.X * 73856093u) ^ ((uint32)Cell.Y * 19349663u) ^ ((uint32)Cell.Z * 83492791u);
+    return Key & (Hash->nBuckets - 1);
+}
+
+void Link(spatial_hash* Hash, int Handle) {
+    spatial_hash_entry* Entry = &Hash->Entries[Handle];
+    uint32 Bucket = GetBucket(Hash, Entry->Cell);
+    Entry->Previous = -1;
+    Entry->Next = Hash->Buckets[Bucket];
+    if (Entry->Next != -1) Hash->Entries[Entry->Next].Previous = Handle;
+    Hash->Buckets[Bucket] = Handle;
+}
+
+void Unlink(spatial_hash* Hash, int Handle) {
+    spatial_hash_entry* Entry = &Hash->Entries[Handle];
+    if (Entry->Previous != -1) Hash->Entries[Entry->Previous].Next = Entry->Next;
+    else                       Hash->Buckets[GetBucket(Hash, Entry->Cell)] = Entry->Next;
+    if (Entry->Next != -1) Hash->Entries[Entry->Next].Previous = Entry->Previous;
+}
+
+void Insert(spatial_hash* Hash, int Handle, v3 Position) {
+    Assert(Handle >= 0 && Handle < Hash->MaxEntries, "Spatial hash handle out of range.");
+    spatial_hash_entry* Entry = &Hash->Entries[Handle];
+    Assert(!Entry->Active, "Handle already in the spatial hash.");
+    Entry->Position = Position;
+    Entry->Cell = GetCell(Hash, Position);
+    Entry->Active = true;
+    Link(Hash, Handle);
+    Hash->nEntries++;
+}
+
+void Remove(spatial_hash* Hash, int Handle) {
+    spatial_hash_entry* Entry = &Hash->Entries[Handle];
+    Assert(Entry->Active, "Handle not in the spatial hash.");
+    Unlink(Hash, Handle);
+    Entry->Active = false;
+    Hash->nEntries--;
+}
+
+void Move(spatial_hash* Hash, int Handle, v3 Position) {
+    spatial_hash_entry* Entry = &Hash->Entries[Handle];
+    if (!Entry->Active) {
+        Insert(Hash, Handle, Position);
+        return;
+    }
+
+    Entry->Position = Position;
+    iv3 Cell = GetCell(Hash, Position);
+    if (!(Cell == Entry->Cell)) {
+        Unlink(Hash, Handle);
+        Entry->Cell = Cell;
+        Link(Hash, Handle);
+    }
+}
+
+/*
+    Handles within Radius of Center. Writes up to MaxResults handles and returns how many were found in total,
+    which can be more than MaxResults.
+*/
+uint32 QueryRadius(spatial_hash* Hash, v3 Center, float Radius, int* Results, uint32 MaxResults) {
+    iv3 MinCell = GetCell(Hash, Center - V3(Radius, Radius, Radius));
+    iv3 MaxCell = GetCell(Hash, Center + V3(Radius, Radius, Radius));
+    float SqRadius = Radius * Radius;
+
+    uint32 nResults = 0;
+    for (int X = MinCell.X; X <= MaxCell.X; X++) {
+        for (int Y = MinCell.Y; Y <= MaxCell.Y; Y++) {
+            for (int Z = MinCell.Z; Z <= MaxCell.Z; Z++) {
+                iv3 Cell = IV3(X, Y, Z);
+                int Handle = Hash->Buckets[GetBucket(Hash, Cell)];
+                while (Handle != -1) {
+                    spatial_hash_entry* Entry = &Hash->Entries[Handle];
+                    if (Entry->Cell == Cell) {
+                        v3 D = Entry->Position - Center;
+                        if (dot(D, D) <= SqRadius) {
+                            if (nResults < MaxResults) Results[nResults] = Handle;
+                            nResults++;
+                        }
+                    }
+                    Handle = Entry->Next;
+                }
+            }
+        }
+    }
+    return nResults;
+}
+
+uint32 QueryAABB(spatial_hash* Hash, aabb Box, int* Results, uint32 MaxResults) {
+    iv3 MinCell = GetCell(Hash, Box.Min);
+    iv3 MaxCell = GetCell(Hash, Box.Max);
+
+    uint32 nResults = 0;
+    for (int X = MinCell.X; X <= MaxCell.X; X++) {
+        for (int Y = MinCell.Y; Y <= MaxCell.Y; Y++) {
+            for (int Z = MinCell.Z; Z <= MaxCell.Z; Z++) {
+                iv3 Cell = IV3(X, Y, Z);
+                int Handle = Hash->Buckets[GetBucket(Hash, Cell)];
+                while (Handle != -1) {
+                    spatial_hash_entry* Entry = &Hash->Entries[Handle];
+                    v3 P = Entry->Position;
+                    if (Entry->Cell == Cell &&
+                        P.X >= Box.Min.X && P.X <= Box.Max.X &&
+                        P.Y >= Box.Min.Y && P.Y <= Box.Max.Y &&
+                        P.Z >= Box.Min.Z && P.Z <= Box.Max.Z) {
+                        if (nResults < MaxResults) Results[nResults] = Handle;
+                        nResults++;
+                    }
+                    Handle = Entry->Next;
+                }
+            }
+        }
+    }
+    return nResults;
+}
+
+// Keeps Results sorted by distance, K is small so an insertion is cheaper than a heap
+inline void InsertNeighbour(spatial_hash_neighbour* Results, uint32* nResults, uint32 K, int Handle, float SqDistance) {
+    if (*nResults == K && SqDistance >= Results[K - 1].SqDistance) return;
+    int i = (*nResults < K) ? (*nResults)++ : K - 1;
+    while (i > 0 && Results[i - 1].SqDistance > SqDistance) {
+        Results[i] = Results[i - 1];
+        i--;
+    }
+    Results[i] = { Handle, SqDistance };
+}
+
+/*
+    K nearest handles to Center (excluding Exclude, pass -1 to keep all), sorted by distance. Searches shells of cells
+    around the center cell and stops once the K-th distance is closer than anything an outer shell could hold, or
+    MaxDistance is exceeded.
+*/
+uint32 QueryNearest(
+    spatial_hash* Hash,
+    v3 Center,
+    uint32 K,
+    spatial_hash_neighbour* Results,
+    float MaxDistance = FLT_MAX,
+    int Exclude = -1
+) {
+    uint32 nResults = 0;
+    if (K == 0 || Hash->nEntries == 0) return 0;
+
+    iv3 CenterCell = GetCell(Hash, Center);
+    float SqMaxDistance = MaxDistance < FLT_MAX ? MaxDistance * MaxDistance : FLT_MAX;
+    uint32 nVisited = 0;
+    for (int Ring = 0; ; Ring++) {
+        for (int X = -Ring; X <= Ring; X++) {
+            for (int Y = -Ring; Y <= Ring; Y++) {
+                // Only the shell, inner cells were visited in earlier rings
+                bool Face = X == -Ring || X == Ring || Y == -Ring || Y == Ring;
+                int ZStep = Face ? 1 : 2 * Ring;
+                for (int Z = -Ring; Z <= Ring; Z += ZStep) {
+                    iv3 Cell = CenterCell + IV3(X, Y, Z);
+                    int Handle = Hash->Buckets[GetBucket(Hash, Cell)];
+                    while (Handle != -1) {
+                        spatial_hash_entry* Entry = &Hash->Entries[Handle];
+                        if (Entry->Cell == Cell) {
+                            nVisited++;
+                            v3 D = Entry->Position - Center;
+                            float SqDistance = dot(D, D);
+                            if (Handle != Exclude && SqDistance <= SqMaxDistance) {
+                                InsertNeighbour(Results, &nResults, K, Handle, SqDistance);
+                            }
+                        }
+                        Handle = Entry->Next;
+                    }
+                }
+            }
+        }
+
+        // Anything outside this ring is at least Ring cell sizes away
+        float Reach = Ring * Hash->CellSize;
+        if (nVisited >= Hash->nEntries) break;
+        if (Reach * Reach > SqMaxDistance) break;
+        if (nResults == K && Results[K - 1].SqDistance <= Reach * Reach) break;
+    }
+    return nResults;
+}
+
+#endif
@@ -30,6 +30,7 @@ struct debug_info {
     float UsedTime;
     float UsedMCyclesPerFrame;
     float UsedMemory;
+    string_table* Strings;
 };
 
 debug_entry* _AddDebugEntry(
@@ -139,6 +140,7 @@ void PushDebugEntry(render_group* Group, debug_entry* Entry, v2 Position, color
 
         case Debug_Type_char:
         case Debug_Type_string:
+        case Debug_Type_string_id:
         case Debug_Type_int8:
         case Debug_Type_int16:
         case Debug_Type_int:
@@ -372,7 +374,8 @@ void PushDebugFramebuffer(render_group* Group, render_group_target Framebuffer,
     Group->TargetCommands[Group->nTargets++] = TargetCommand;
 }
 
-void UpdateAndSizeDebugEntry(game_font* Font, debug_entry* Entry, float* OutWidth, float* OutHeight) {
+// Strings resolves string_id values, entries of that type show the raw ID without it
+void UpdateAndSizeDebugEntry(game_font* Font, string_table* Strings, debug_entry* Entry, float* OutWidth, float* OutHeight) {
     float Points = DEBUG_ENTRIES_TEXT_POINTS;
 
     float ValueWidth = 0, ValueHeight = 0;
@@ -417,6 +420,13 @@ void UpdateAndSizeDebugEntry(game_font* Font, debug_entry* Entry, float* OutWidt
                 GetTextWidthAndHeight(Entry->ValueString, Font, Points, &ValueWidth, &ValueHeight);
             } break;
 
+            case Debug_Type_string_id: {
+                string_id Value = *(string_id*)Entry->Value;
+                if (Strings) sprintf_s(Entry->ValueString, "\"%s\"", GetString(Strings, Value));
+                else         sprintf_s(Entry->ValueString, "#%u", Value);
+                GetTextWidthAndHeight(Entry->ValueString, Font, Points, &ValueWidth, &ValueHeight);
+            } break;
+
             case Debug_Type_int8: {
                 int8 Value = *(int8*)Entry->Value;
                 sprintf_s(Entry->ValueString, "%d", Value);
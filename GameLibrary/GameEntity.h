@@ -6,6 +6,7 @@
 #include "GameAssets.h"
 #include "GameInput.h"
 #include "GameRender.h"
+#include "GameCollision.h"
 #include "Particles.h"
 
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
@@ -23,65 +24,23 @@ enum game_entity_type {
     game_entity_type_count
 };
 
+/*
+    Cold entity data. Transform, velocity, collider and flags live in `game_entity_components`, indexed by ID. The name is
+    interned in the entity state string table, see GetName and FindEntity.
+*/
 INTROSPECT
 struct game_entity {
-    char Name[32];
+    string_id Name;
     int ID;
     game_entity* Parent;
-    int Index;
     game_entity_type Type;
-    transform Transform;
-    v3 Velocity;
-    collider Collider;
-    bool Collided;
-    bool Active;
     bool Hovered;
 };
 
-game_entity Entity(
-    const char* Name,
-    transform T = Transform(V3(0,0,0)),
-    v3 Velocity = V3(0,0,0),
-    collider Collider = SphereCollider(V3(0.0f, 0.0f, 0.0f), 1.0f),
-    bool Active = true
-) {
-    game_entity Result = {0};
-    Result.ID = -1;
-    strcpy_s(Result.Name, Name);
-    Result.Transform = T;
-    Result.Velocity = Velocity;
-    Result.Active = Active;
-    Result.Collider = Collider;
-    return Result;
-}
-
-bool Collide(game_entity* Entity1, game_entity* Entity2) {
-    collider Collider1 = Entity1->Collider;
-    Collider1.Offset += Entity1->Transform.Translation;
-    if (Collider1.Type == Capsule_Collider) {
-        Collider1.Capsule.Segment = Entity1->Transform * Collider1.Capsule.Segment;
-    }
-    collider Collider2 = Entity2->Collider;
-    Collider2.Offset += Entity2->Transform.Translation;
-    if (Collider2.Type == Capsule_Collider) {
-        Collider2.Capsule.Segment = Entity2->Transform * Collider2.Capsule.Segment;
-    }
-    if (Collide(Collider1, Collider2)) {
-        Entity1->Collided = true;
-        Entity2->Collided = true;
-        return true;
-    }
-    return false;
-}
-
-
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 // | Camera                                                                                                                                       |
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 
-const int MAX_CAMERAS = 16;
-DefineFreeList(MAX_CAMERAS, camera);
-
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 // | Enemies                                                                                                                                      |
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
@@ -90,9 +49,6 @@ struct enemy {
     game_entity* Entity;
 };
 
-const int MAX_ENEMIES = 32;
-DefineFreeList(MAX_ENEMIES, enemy);
-
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 // | Weapons                                                                                                                                      |
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
@@ -111,9 +67,6 @@ struct weapon {
     int ParentBone;
 };
 
-const int MAX_WEAPONS = 32;
-DefineFreeList(MAX_WEAPONS, weapon);
-
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 // | Character                                                                                                                                    |
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
@@ -141,12 +94,21 @@ enum character_class {
     Priest_Class
 };
 
+/*
+    Generational reference to an entity. The generation of an ID changes every time it is added or removed, so a handle
+    kept after its entity was removed (or the ID reused) no longer resolves.
+*/
+struct entity_handle {
+    int ID;
+    uint32 Generation;
+};
+
 struct character {
     armature Armature;
     game_animator Animator;
     game_entity* Entity;
-    weapon* LeftHand;
-    weapon* RightHand;
+    entity_handle LeftHand;
+    entity_handle RightHand;
     character_action Action;
 };
 
@@ -197,7 +159,7 @@ character_action GetCharacterAction(character* Character, game_input* Input) {
         case Character_Action_Idle_ID: {
             Character->Animator.Active = true;
             if (JumpingInput || MovingInput || AttackInput) {
-                Character->Animator.CurrentFrame = 0;
+                Character->Animator.Time = 0;
             }
 
             if     (JumpingInput) Result = CharacterAction(Character_Action_Jump_ID);
@@ -207,11 +169,11 @@ character_action GetCharacterAction(character* Character, game_input* Input) {
         case Character_Action_Walk_ID: {
             if (JumpingInput) {
                 Result = CharacterAction(Character_Action_Jump_ID);
-                Character->Animator.CurrentFrame = 0;
+                Character->Animator.Time = 0;
             }
             else if (AttackInput) {
                 Result = CharacterAction(Character_Action_Attack_ID);
-                Character->Animator.CurrentFrame = 0;
+                Character->Animator.Time = 0;
             }
             else if (!MovingInput) {
                 Character->Animator.Active = false;
@@ -221,13 +183,13 @@ character_action GetCharacterAction(character* Character, game_input* Input) {
         case Character_Action_Jump_ID: {
             if (!Character->Animator.Active) {
                 Result = CharacterAction(Character_Action_Idle_ID);
-                Character->Animator.CurrentFrame = 0;
+                Character->Animator.Time = 0;
             }
         } break;
         case Character_Action_Attack_ID: {
             if (!Character->Animator.Active) {
                 Result = CharacterAction(Character_Action_Idle_ID);
-                Character->Animator.CurrentFrame = 0;
+                Character->Animator.Time = 0;
             }
         } break;
         default: Raise("Invalid character action");
@@ -237,21 +199,6 @@ character_action GetCharacterAction(character* Character, game_input* Input) {
     return Result;
 }
 
-void Equip(weapon* Weapon, character* Character) {
-    Weapon->Entity->Parent = Character->Entity;
-    if (Weapon->Type == Weapon_Sword) {
-        Character->RightHand = Weapon;
-        Weapon->ParentBone = 8;
-    }
-    else if (Weapon->Type == Weapon_Shield) {
-        Character->LeftHand = Weapon;
-        Weapon->ParentBone = 2;
-    }
-}
-
-const int MAX_CHARACTERS = 8;
-DefineFreeList(MAX_CHARACTERS, character);
-
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 // | Props                                                                                                                                        |
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
@@ -264,27 +211,419 @@ struct prop {
     game_entity* Entity;
 };
 
-const int MAX_PROPS = 32;
-DefineFreeList(MAX_PROPS, prop);
-
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 // | Entity List                                                                                                                                  |
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 
-const int32 MAX_ENTITIES = MAX_CAMERAS + MAX_CHARACTERS + MAX_ENEMIES + MAX_PROPS;
-DefineFreeList(MAX_ENTITIES, game_entity);
+/*
+    Size of the game's entity ID space. Each entity state takes its own, MaxEntities in InitializeEntityState, and
+    everything indexed by ID (entities, components, generations, name links and the ID side of the per type sets) is
+    allocated for that many IDs, so a small scene or test only pays for the IDs it asks for. Per type elements come
+    on top, from pools that grow as entities of that type are added.
+*/
+const int MAX_ENTITIES = 8192;
+
+struct game_entity_list {
+    uint32 nFreeIDs;
+    uint32* FreeIDs;
+    uint32 Count;
+    game_entity* List;
+};
+DefineFreeListRemove(game_entity);
+DefineFreeListInsert(game_entity);
+
+/*
+    Hot per-entity data as structure of arrays, indexed by entity ID. Movement and collision stream through these
+    without pulling names and type data into cache. Slots without an entity are zeroed.
+
+    Translation, rotation and scale are local to the parent entity (world space for entities without parent). World
+    and WorldMatrix are cached and only refreshed for entities flagged Dirty, see UpdateWorldTransforms. PreviousWorld
+    is the world transform before the last simulation tick, rendering interpolates between both.
+*/
+struct game_entity_components {
+    v3* Translation;
+    quaternion* Rotation;
+    scale* Scale;
+    v3* Velocity;
+    collider* Collider;
+    int* Parent;
+    transform* World;
+    transform* PreviousWorld;
+    matrix4* WorldMatrix;
+    bool* Dirty;
+    bool* Active;
+    bool* Collided;
+};
+
+const int MAX_HIERARCHY_DEPTH = 16;
+
+// Live entity IDs sorted by depth, so parents always come before their children. Rebuilt only when parents change.
+struct entity_hierarchy {
+    int* Order;
+    int8* Depths;       // By ID, only meaningful while the order is rebuilt
+    int nOrder;
+    bool OrderDirty;
+};
+
+// Names the default string table of an entity state holds per ID, see InitializeEntityState
+const uint32 ENTITY_NAMES_PER_ID = 4;
+const uint32 MAX_ENTITY_NAMES = ENTITY_NAMES_PER_ID * MAX_ENTITIES;
+
+// Entity IDs by name ID, chained like the spatial hash since several entities may share a name. nBuckets is a power of two.
+struct entity_name_index {
+    uint32 nBuckets;
+    int* Buckets;
+    int* Previous;
+    int* Next;
+};
 
+// Per type data is keyed by entity ID and packed, so iterating e.g. all enemies only touches live enemies
 struct game_entity_state {
+    string_table* Names;
+    entity_name_index NameIndex;
     game_entity_list Entities;
-    camera_list Cameras;
-    character_list Characters;
-    enemy_list Enemies;
-    prop_list Props;
-    weapon_list Weapons;
+    game_entity_components Components;
+    entity_hierarchy Hierarchy;
+    uint32* Generations;
+    bool* Removed;      // By ID, only set inside RemoveEntities
+    int MaxEntities;
+    // One past the highest ID handed out so far, per tick loops stop here. Clearing keeps it, the grid and broadphase
+    // may still hold old IDs until their next update.
+    int nIDs;
+    sparse_set<camera> Cameras;
+    sparse_set<character> Characters;
+    sparse_set<enemy> Enemies;
+    sparse_set<prop> Props;
+    sparse_set<weapon> Weapons;
     character* ControlledCharacter;
     camera* ActiveCamera;
 };
 
+inline void ClearNameIndex(entity_name_index* Index) {
+    for (int i = 0; i < Index->nBuckets; i++) Index->Buckets[i] = -1;
+}
+
+/*
+    Allocates everything indexed by entity ID for MaxEntities IDs. Per type pools grow from Arena as entities are
+    added, it has to outlive the entity state. Names are interned in Names, usually the game wide string table; without
+    one a table for ENTITY_NAMES_PER_ID names per ID is allocated from Arena.
+*/
+void InitializeEntityState(game_entity_state* State, memory_arena* Arena, int MaxEntities, string_table* Names = NULL) {
+    Assert(MaxEntities > 0, "Entity state without IDs.");
+    uint32 MaxNames = ENTITY_NAMES_PER_ID * MaxEntities;
+    State->Names = Names ? Names : AllocateStringTable(Arena, MaxNames, MaxNames * 16);
+    State->MaxEntities = MaxEntities;
+
+    State->Entities.FreeIDs = PushArray(Arena, MaxEntities, uint32);
+    State->Entities.List = PushArray(Arena, MaxEntities, game_entity);
+
+    game_entity_components* Components = &State->Components;
+    Components->Translation = PushArray(Arena, MaxEntities, v3);
+    Components->Rotation = PushArray(Arena, MaxEntities, quaternion);
+    Components->Scale = PushArray(Arena, MaxEntities, scale);
+    Components->Velocity = PushArray(Arena, MaxEntities, v3);
+    Components->Collider = PushArray(Arena, MaxEntities, collider);
+    Components->Parent = PushArray(Arena, MaxEntities, int);
+    Components->World = PushArray(Arena, MaxEntities, transform);
+    Components->PreviousWorld = PushArray(Arena, MaxEntities, transform);
+    Components->WorldMatrix = PushArray(Arena, MaxEntities, matrix4);
+    Components->Dirty = PushArray(Arena, MaxEntities, bool);
+    Components->Active = PushArray(Arena, MaxEntities, bool);
+    Components->Collided = PushArray(Arena, MaxEntities, bool);
+
+    State->Hierarchy.Order = PushArray(Arena, MaxEntities, int);
+    State->Hierarchy.Depths = PushArray(Arena, MaxEntities, int8);
+    State->Generations = PushArray(Arena, MaxEntities, uint32);
+    State->Removed = PushArray(Arena, MaxEntities, bool);
+
+    entity_name_index* Index = &State->NameIndex;
+    Index->nBuckets = 1;
+    while (Index->nBuckets < 2 * MaxEntities) Index->nBuckets <<= 1;
+    Index->Buckets = PushArray(Arena, Index->nBuckets, int);
+    Index->Previous = PushArray(Arena, MaxEntities, int);
+    Index->Next = PushArray(Arena, MaxEntities, int);
+    ClearNameIndex(Index);
+
+    State->Cameras.Initialize(Arena, MaxEntities);
+    State->Characters.Initialize(Arena, MaxEntities);
+    State->Enemies.Initialize(Arena, MaxEntities);
+    State->Props.Initialize(Arena, MaxEntities);
+    State->Weapons.Initialize(Arena, MaxEntities);
+}
+
+/*
+    Removes every entity at once. Pool memory is kept and reused by the next entities, generations are kept so handles
+    from before stop resolving. Slots past nIDs were never written and are still zero.
+*/
+void ClearEntityState(game_entity_state* State) {
+    int n = State->nIDs;
+    game_entity_list* Entities = &State->Entities;
+    Entities->nFreeIDs = 0;
+    Entities->Count = 0;
+    memset(Entities->List, 0, n * sizeof(game_entity));
+
+    game_entity_components* Components = &State->Components;
+    memset(Components->Translation, 0, n * sizeof(v3));
+    memset(Components->Rotation, 0, n * sizeof(quaternion));
+    memset(Components->Scale, 0, n * sizeof(scale));
+    memset(Components->Velocity, 0, n * sizeof(v3));
+    memset(Components->Collider, 0, n * sizeof(collider));
+    memset(Components->Parent, 0, n * sizeof(int));
+    memset(Components->World, 0, n * sizeof(transform));
+    memset(Components->PreviousWorld, 0, n * sizeof(transform));
+    memset(Components->WorldMatrix, 0, n * sizeof(matrix4));
+    memset(Components->Dirty, 0, n * sizeof(bool));
+    memset(Components->Active, 0, n * sizeof(bool));
+    memset(Components->Collided, 0, n * sizeof(bool));
+
+    State->Hierarchy.nOrder = 0;
+    State->Hierarchy.OrderDirty = false;
+    ClearNameIndex(&State->NameIndex);
+    State->Cameras.Clear();
+    State->Characters.Clear();
+    State->Enemies.Clear();
+    State->Props.Clear();
+    State->Weapons.Clear();
+    State->ControlledCharacter = NULL;
+    State->ActiveCamera = NULL;
+}
+
+inline entity_handle GetHandle(game_entity_state* State, game_entity* Entity) {
+    return { Entity->ID, State->Generations[Entity->ID] };
+}
+
+inline bool IsValid(game_entity_state* State, entity_handle Handle) {
+    return Handle.ID >= 0 && Handle.ID < State->MaxEntities && Handle.Generation != 0 && State->Generations[Handle.ID] == Handle.Generation;
+}
+
+// NULL when the handle is stale
+inline game_entity* GetEntity(game_entity_state* State, entity_handle Handle) {
+    return IsValid(State, Handle) ? &State->Entities.List[Handle.ID] : NULL;
+}
+
+inline const char* GetName(game_entity_state* State, game_entity* Entity) {
+    return GetString(State->Names, Entity->Name);
+}
+
+inline uint32 GetNameBucket(entity_name_index* Index, string_id Name) {
+    return Name & (Index->nBuckets - 1);
+}
+
+void LinkName(game_entity_state* State, int ID) {
+    entity_name_index* Index = &State->NameIndex;
+    uint32 Bucket = GetNameBucket(Index, State->Entities.List[ID].Name);
+    Index->Previous[ID] = -1;
+    Index->Next[ID] = Index->Buckets[Bucket];
+    if (Index->Next[ID] != -1) Index->Previous[Index->Next[ID]] = ID;
+    Index->Buckets[Bucket] = ID;
+}
+
+void UnlinkName(game_entity_state* State, int ID) {
+    entity_name_index* Index = &State->NameIndex;
+    if (Index->Previous[ID] != -1) Index->Next[Index->Previous[ID]] = Index->Next[ID];
+    else                           Index->Buckets[GetNameBucket(Index, State->Entities.List[ID].Name)] = Index->Next[ID];
+    if (Index->Next[ID] != -1) Index->Previous[Index->Next[ID]] = Index->Previous[ID];
+}
+
+// Some entity with this name, NULL if there is none. A name that was never interned doesn't touch the index.
+game_entity* FindEntity(game_entity_state* State, const char* Name) {
+    string_id NameID = FindString(State->Names, Name);
+    if (NameID == 0) return NULL;
+    for (int ID = State->NameIndex.Buckets[GetNameBucket(&State->NameIndex, NameID)]; ID != -1; ID = State->NameIndex.Next[ID]) {
+        if (State->Entities.List[ID].Name == NameID) return &State->Entities.List[ID];
+    }
+    return NULL;
+}
+
+// Packed IDs of every entity of one type
+uint32 GetEntityIDs(game_entity_state* State, game_entity_type Type, uint32** IDs) {
+    switch(Type) {
+        case Entity_Type_Camera:    *IDs = State->Cameras.IDs;    return State->Cameras.Count;
+        case Entity_Type_Character: *IDs = State->Characters.IDs; return State->Characters.Count;
+        case Entity_Type_Enemy:     *IDs = State->Enemies.IDs;    return State->Enemies.Count;
+        case Entity_Type_Prop:      *IDs = State->Props.IDs;      return State->Props.Count;
+        case Entity_Type_Weapon:    *IDs = State->Weapons.IDs;    return State->Weapons.Count;
+        default: Raise("Invalid entity type.");
+    }
+    return 0;
+}
+
+inline transform GetTransform(game_entity_state* State, int ID) {
+    game_entity_components* Components = &State->Components;
+    return Transform(Components->Translation[ID], Components->Rotation[ID], Components->Scale[ID]);
+}
+
+// Sets the local transform
+inline void SetTransform(game_entity_state* State, int ID, transform T) {
+    game_entity_components* Components = &State->Components;
+    Components->Translation[ID] = T.Translation;
+    Components->Rotation[ID] = T.Rotation;
+    Components->Scale[ID] = T.Scale;
+    Components->Dirty[ID] = true;
+}
+
+// Cached world transform, valid after the last UpdateWorldTransforms
+inline transform GetWorldTransform(game_entity_state* State, int ID) {
+    return State->Components.World[ID];
+}
+
+// World transform Alpha of the way from the previous tick to the last one
+inline transform GetRenderTransform(game_entity_state* State, int ID, float Alpha) {
+    return Lerp(State->Components.PreviousWorld[ID], State->Components.World[ID], Alpha);
+}
+
+inline void SavePreviousTransforms(game_entity_state* State) {
+    memcpy(State->Components.PreviousWorld, State->Components.World, State->nIDs * sizeof(transform));
+}
+
+collider WorldCollider(game_entity_state* State, int ID) {
+    collider Result = State->Components.Collider[ID];
+    transform World = State->Components.World[ID];
+    Result.Offset += World.Translation;
+    if (Result.Type == Capsule_Collider) {
+        Result.Capsule.Segment = World * Result.Capsule.Segment;
+    }
+    return Result;
+}
+
+bool Collide(game_entity_state* State, int ID1, int ID2) {
+    collider Collider1 = WorldCollider(State, ID1);
+    collider Collider2 = WorldCollider(State, ID2);
+    if (Collide(Collider1, Collider2)) {
+        State->Components.Collided[ID1] = true;
+        State->Components.Collided[ID2] = true;
+        return true;
+    }
+    return false;
+}
+
+/*
+    An entity together with its components, copied out of the columns by ID for the debug UI. Changing it doesn't
+    change the entity.
+*/
+INTROSPECT
+struct game_entity_view {
+    game_entity* Entity;
+    transform Transform;
+    transform World;
+    v3 Velocity;
+    collider Collider;
+    bool Collided;
+    bool Active;
+};
+
+game_entity_view GetEntityView(game_entity_state* State, int ID) {
+    game_entity_components* Components = &State->Components;
+    game_entity_view Result = {};
+    Result.Entity = &State->Entities.List[ID];
+    Result.Transform = GetTransform(State, ID);
+    Result.World = Components->World[ID];
+    Result.Velocity = Components->Velocity[ID];
+    Result.Collider = Components->Collider[ID];
+    Result.Collided = Components->Collided[ID];
+    Result.Active = Components->Active[ID];
+    return Result;
+}
+
+// Runs over the X, Y, Z floats of every slot up to nIDs as one flat array so it vectorizes. Empty slots have zero velocity.
+void IntegrateVelocities(game_entity_state* State, float dt) {
+    TIMED_BLOCK;
+    game_entity_components* Components = &State->Components;
+    float* Translation = &Components->Translation[0].X;
+    float* Velocity = &Components->Velocity[0].X;
+    for (int i = 0; i < 3 * State->nIDs; i++) {
+        Translation[i] += dt * Velocity[i];
+    }
+    for (int i = 0; i < State->nIDs; i++) {
+        v3 V = Components->Velocity[i];
+        Components->Dirty[i] |= V.X != 0 || V.Y != 0 || V.Z != 0;
+    }
+}
+
+// Transform hierarchy _____________________________________________________________________________________________________________________
+
+// Parent -1 detaches. The child keeps its local transform, which is now relative to the new parent.
+void SetParent(game_entity_state* State, int ChildID, int ParentID) {
+    game_entity* Child = &State->Entities.List[ChildID];
+    Child->Parent = ParentID >= 0 ? &State->Entities.List[ParentID] : NULL;
+    State->Components.Parent[ChildID] = ParentID;
+    State->Components.Dirty[ChildID] = true;
+    State->Hierarchy.OrderDirty = true;
+}
+
+// Counting sort of live entities by depth
+void BuildTransformOrder(game_entity_state* State) {
+    TIMED_BLOCK;
+    game_entity_components* Components = &State->Components;
+    entity_hierarchy* Hierarchy = &State->Hierarchy;
+
+    int8* Depths = Hierarchy->Depths;
+    int nIDs = 0;
+    int Counts[MAX_HIERARCHY_DEPTH] = {};
+    for (int Type = 0; Type < game_entity_type_count; Type++) {
+        uint32* TypeIDs = NULL;
+        uint32 nTypeIDs = GetEntityIDs(State, (game_entity_type)Type, &TypeIDs);
+        for (int i = 0; i < nTypeIDs; i++) {
+            int ID = TypeIDs[i];
+            int Depth = 0;
+            for (int Parent = Components->Parent[ID]; Parent >= 0; Parent = Components->Parent[Parent]) {
+                Depth++;
+                Assert(Depth < MAX_HIERARCHY_DEPTH, "Entity hierarchy too deep or cyclic.");
+            }
+            Depths[ID] = Depth;
+            Counts[Depth]++;
+            nIDs++;
+        }
+    }
+
+    int Offsets[MAX_HIERARCHY_DEPTH];
+    int Offset = 0;
+    for (int Depth = 0; Depth < MAX_HIERARCHY_DEPTH; Depth++) {
+        Offsets[Depth] = Offset;
+        Offset += Counts[Depth];
+    }
+    for (int Type = 0; Type < game_entity_type_count; Type++) {
+        uint32* TypeIDs = NULL;
+        uint32 nTypeIDs = GetEntityIDs(State, (game_entity_type)Type, &TypeIDs);
+        for (int i = 0; i < nTypeIDs; i++) {
+            int ID = TypeIDs[i];
+            Hierarchy->Order[Offsets[Depths[ID]]++] = ID;
+        }
+    }
+    Hierarchy->nOrder = nIDs;
+    Hierarchy->OrderDirty = false;
+}
+
+/*
+    One flat pass in hierarchy order. A dirty parent dirties its children before they are visited, and only dirty
+    entities recompute their world transform and matrix, so anything that didn't move costs a flag check. Returns the
+    number of entities recomputed.
+*/
+int UpdateWorldTransforms(game_entity_state* State) {
+    TIMED_BLOCK;
+    game_entity_components* Components = &State->Components;
+    entity_hierarchy* Hierarchy = &State->Hierarchy;
+    if (Hierarchy->OrderDirty) BuildTransformOrder(State);
+
+    int nUpdated = 0;
+    for (int i = 0; i < Hierarchy->nOrder; i++) {
+        int ID = Hierarchy->Order[i];
+        int Parent = Components->Parent[ID];
+        if (Parent >= 0 && Components->Dirty[Parent]) Components->Dirty[ID] = true;
+        if (!Components->Dirty[ID]) continue;
+
+        transform Local = GetTransform(State, ID);
+        Components->World[ID] = Parent >= 0 ? Local * Components->World[Parent] : Local;
+        Components->WorldMatrix[ID] = Matrix(Components->World[ID]);
+        nUpdated++;
+    }
+
+    for (int i = 0; i < Hierarchy->nOrder; i++) {
+        Components->Dirty[Hierarchy->Order[i]] = false;
+    }
+    return nUpdated;
+}
+
 game_entity* AddEntity(
     game_entity_state* State,
     const char* Name,
@@ -295,7 +634,7 @@ game_entity* AddEntity(
     scale S = Scale(),
     bool Active = true
 ) {
-    Assert(State->Entities.Count < MAX_ENTITIES);
+    Assert(State->Entities.Count < State->MaxEntities, "Not enough entity IDs.");
 
     // If any ID is free, use it
     int EntityID = -1;
@@ -308,73 +647,164 @@ game_entity* AddEntity(
         EntityID = State->Entities.Count++;
     }
 
+    if (EntityID >= State->nIDs) State->nIDs = EntityID + 1;
+
     game_entity* Entity = &State->Entities.List[EntityID];
+    State->Generations[EntityID]++;
     Entity->ID = EntityID;
     Entity->Type = Type;
-    Entity->Transform = Transform(Position, Rotation, S);
-    Entity->Active = Active;
-    Entity->Collider = Collider;
     Entity->Parent = NULL;
-    strcpy_s(Entity->Name, Name);
+    Entity->Name = Intern(State->Names, Name);
+    LinkName(State, EntityID);
+
+    game_entity_components* Components = &State->Components;
+    SetTransform(State, EntityID, Transform(Position, Rotation, S));
+    Components->World[EntityID] = GetTransform(State, EntityID);
+    Components->PreviousWorld[EntityID] = Components->World[EntityID];
+    Components->Parent[EntityID] = -1;
+    Components->Velocity[EntityID] = V3(0,0,0);
+    Components->Collider[EntityID] = Collider;
+    Components->Active[EntityID] = Active;
+    Components->Collided[EntityID] = false;
+    State->Hierarchy.OrderDirty = true;
 
     return Entity;
 }
 
-void RemoveEntity(game_entity_state* State, int EntityID) {
-    game_entity* Entity = &State->Entities.List[EntityID];
-    Assert(!Entity->Active);
+// Despawns a batch of entities. Children of removed entities that aren't removed themselves stay where they are in world space.
+void RemoveEntities(game_entity_state* State, int* IDs, uint32 nIDs) {
+    game_entity_components* Components = &State->Components;
+    bool* Removed = State->Removed;
+    for (int i = 0; i < nIDs; i++) {
+        Assert(!Components->Active[IDs[i]]);
+        Removed[IDs[i]] = true;
+    }
 
-    switch(Entity->Type) {
-        case Entity_Type_Camera: {
-            Remove(&State->Cameras, Entity->Index);
-        } break;
+    // One pass over the hierarchy for the whole batch
+    for (int i = 0; i < State->nIDs; i++) {
+        int Parent = Components->Parent[i];
+        if (Parent >= 0 && Removed[Parent] && !Removed[i] && State->Entities.List[i].Parent != NULL) {
+            SetTransform(State, i, Components->World[i]);
+            SetParent(State, i, -1);
+        }
+    }
 
-        case Entity_Type_Character: {
-            Remove(&State->Characters, Entity->Index);
-        } break;
+    for (int i = 0; i < nIDs; i++) {
+        int EntityID = IDs[i];
+        game_entity* Entity = &State->Entities.List[EntityID];
+        UnlinkName(State, EntityID);
+        switch(Entity->Type) {
+            case Entity_Type_Camera: {
+                State->Cameras.Remove(EntityID);
+            } break;
 
-        case Entity_Type_Enemy: {
-            Remove(&State->Enemies, Entity->Index);
-        } break;
+            case Entity_Type_Character: {
+                State->Characters.Remove(EntityID);
+            } break;
 
-        case Entity_Type_Prop: {
-            Remove(&State->Props, Entity->Index);
-        } break;
+            case Entity_Type_Enemy: {
+                State->Enemies.Remove(EntityID);
+            } break;
 
-        case Entity_Type_Weapon: {
-            Remove(&State->Weapons, Entity->Index);
-        } break;
+            case Entity_Type_Prop: {
+                State->Props.Remove(EntityID);
+            } break;
 
-        default: Raise("Invalid entity type.");
+            case Entity_Type_Weapon: {
+                State->Weapons.Remove(EntityID);
+            } break;
+
+            default: Raise("Invalid entity type.");
+        }
+
+        *Entity = {};
+        State->Generations[EntityID]++;
+
+        Components->Translation[EntityID] = {};
+        Components->Rotation[EntityID] = {};
+        Components->Scale[EntityID] = {};
+        Components->Velocity[EntityID] = {};
+        Components->Collider[EntityID] = {};
+        Components->Parent[EntityID] = -1;
+        Components->World[EntityID] = {};
+        Components->PreviousWorld[EntityID] = {};
+        Components->WorldMatrix[EntityID] = {};
+        Components->Dirty[EntityID] = false;
+        Components->Collided[EntityID] = false;
+        State->Entities.Count--;
+        State->Entities.FreeIDs[State->Entities.nFreeIDs] = EntityID;
+        State->Entities.nFreeIDs++;
     }
+    for (int i = 0; i < nIDs; i++) Removed[IDs[i]] = false;
+    State->Hierarchy.OrderDirty = true;
+}
 
-    *Entity = {};
-    State->Entities.Count--;
-    State->Entities.FreeIDs[State->Entities.nFreeIDs] = EntityID;
-    State->Entities.nFreeIDs++;
+void RemoveEntity(game_entity_state* State, int EntityID) {
+    RemoveEntities(State, &EntityID, 1);
+}
+
+// Grows the pool of a type once for a wave of Count entities, instead of once per chunk while they are added
+void ReserveEntities(game_entity_state* State, game_entity_type Type, uint32 Count) {
+    Assert(State->Entities.Count + Count <= State->MaxEntities, "Not enough entity IDs.");
+    switch(Type) {
+        case Entity_Type_Camera:    State->Cameras.Reserve(Count);    break;
+        case Entity_Type_Character: State->Characters.Reserve(Count); break;
+        case Entity_Type_Enemy:     State->Enemies.Reserve(Count);    break;
+        case Entity_Type_Prop:      State->Props.Reserve(Count);      break;
+        case Entity_Type_Weapon:    State->Weapons.Reserve(Count);    break;
+        default: Raise("Invalid entity type.");
+    }
 }
 
 game_entity* QueryEntity(game_entity_state* State, game_entity_type Type, bool Active = true) {
-    for (int i = 0; i < MAX_ENTITIES; i++) {
-        game_entity* Entity = &State->Entities.List[i];
-        if (Entity->Type == Type && Entity->Active == Active) {
-            return Entity;
+    uint32* IDs = NULL;
+    uint32 nIDs = GetEntityIDs(State, Type, &IDs);
+    for (int i = 0; i < nIDs; i++) {
+        if (State->Components.Active[IDs[i]] == Active) {
+            return &State->Entities.List[IDs[i]];
         }
     }
     return 0;
 }
 
 int QueryEntityCount(game_entity_state* State, game_entity_type Type, bool Active = true) {
+    uint32* IDs = NULL;
+    uint32 nIDs = GetEntityIDs(State, Type, &IDs);
     int Result = 0;
-    for (int i = 0; i < MAX_ENTITIES; i++) {
-        game_entity* Entity = &State->Entities.List[i];
-        if (Entity->Type == Type && Entity->Active == Active) {
+    for (int i = 0; i < nIDs; i++) {
+        if (State->Components.Active[IDs[i]] == Active) {
             Result++;
         }
     }
     return Result;
 }
 
+// Character bones weapons are held by. Looked up by name, bone IDs change whenever the exporter renumbers the armature.
+const char* SWORD_BONE_NAME = "Hand_R";
+const char* SHIELD_BONE_NAME = "Hand_L";
+
+void Equip(game_entity_state* State, weapon* Weapon, character* Character) {
+    SetParent(State, Weapon->Entity->ID, Character->Entity->ID);
+    const char* BoneName = NULL;
+    if (Weapon->Type == Weapon_Sword) {
+        Character->RightHand = GetHandle(State, Weapon->Entity);
+        BoneName = SWORD_BONE_NAME;
+    }
+    else if (Weapon->Type == Weapon_Shield) {
+        Character->LeftHand = GetHandle(State, Weapon->Entity);
+        BoneName = SHIELD_BONE_NAME;
+    }
+    if (BoneName == NULL) return;
+
+    // Without the bone the weapon still follows the character, just not the hand
+    int Bone = FindBone(&Character->Armature, BoneName);
+    if (Bone < 0) {
+        Log(Warn, "Character armature has no bone to hold the weapon.");
+        Bone = 0;
+    }
+    Weapon->ParentBone = Bone;
+}
+
 // Entity initialization ___________________________________________________________________________________________________________________
 
 camera* AddCamera(
@@ -383,56 +813,30 @@ camera* AddCamera(
     float Angle, float Pitch,
     float Distance = 9.0
 ) {
-    Assert(State->Cameras.Count < MAX_CAMERAS);
-    // If any ID is free, use it
-    int CameraID = -1;
-    if (State->Cameras.nFreeIDs > 0) {
-        CameraID = State->Cameras.FreeIDs[State->Cameras.nFreeIDs - 1];
-        State->Cameras.FreeIDs[State->Cameras.nFreeIDs-- - 1] = -1;
-        State->Cameras.Count++;
-    }
-    else CameraID = State->Cameras.Count++;
+    char NameBuffer[32];
+    sprintf_s(NameBuffer, "Camera %d", State->Cameras.Count);
 
-    camera* Cam = &State->Cameras.List[CameraID];
+    quaternion Rotation = Quaternion(Angle * Degrees, V3(0,1,0)) * Quaternion(Pitch * Degrees, V3(1,0,0));
+    bool Active = State->Cameras.Count == 0;
+    game_entity* Entity = AddEntity(State, NameBuffer, Entity_Type_Camera, SphereCollider(Position, 1.0f), Position, Rotation, Scale(), Active);
+
+    camera* Cam = State->Cameras.Insert(Entity->ID);
     Cam->Angle = Angle;
     Cam->Pitch = Pitch;
     Cam->Position = Position;
     Cam->Distance = Distance;
-
-    char NameBuffer[32];
-    sprintf_s(NameBuffer, "Camera %d", CameraID);
-
-    quaternion Rotation = Quaternion(Cam->Angle * Degrees, V3(0,1,0)) * Quaternion(Cam->Pitch * Degrees, V3(1,0,0));
-    game_entity* Entity = AddEntity(State, NameBuffer, Entity_Type_Camera, SphereCollider(Position, 1.0f), Position, Rotation, Scale(), CameraID == 0);
-    Entity->Index = CameraID;
     Cam->Entity = (void*)Entity;
+    if (Active) State->ActiveCamera = Cam;
 
     return Cam;
 }
 
 character* AddCharacter(game_assets* Assets, game_entity_state* State, v3 Position, int MaxHP) {
-    Assert(State->Characters.Count < MAX_CHARACTERS);
-    // If any ID is free, use it
-    int CharacterID = -1;
-    if (State->Characters.nFreeIDs > 0) {
-        CharacterID = State->Characters.FreeIDs[State->Characters.nFreeIDs - 1];
-        State->Characters.FreeIDs[State->Characters.nFreeIDs-- - 1] = -1;
-        State->Characters.Count++;
-    }
-    else CharacterID = State->Characters.Count++;
-
-    character* pCharacter = &State->Characters.List[CharacterID];
-    pCharacter->Animator.Active = false;
-    pCharacter->Animator.Animation = GetAsset(Assets, Animation_Walk_ID);
-    game_mesh* Mesh = GetAsset(Assets, Mesh_Body_ID);
-    pCharacter->Armature = Mesh->Armature;
-    pCharacter->Animator.Armature = &pCharacter->Armature;
-
     char NameBuffer[32];
-    sprintf_s(NameBuffer, "Character %d", CharacterID);
+    sprintf_s(NameBuffer, "Character %d", State->Characters.Count);
 
     quaternion Rotation = Quaternion(1.5f * Pi, V3(0,1,0));
-    pCharacter->Entity = AddEntity(
+    game_entity* Entity = AddEntity(
         State, 
         NameBuffer, 
         Entity_Type_Character,
@@ -441,29 +845,28 @@ character* AddCharacter(game_assets* Assets, game_entity_state* State, v3 Positi
         Rotation, 
         Scale()
     );
-    pCharacter->Entity->Index = CharacterID;
+
+    character* pCharacter = State->Characters.Insert(Entity->ID);
+    pCharacter->Entity = Entity;
+    pCharacter->Animator.Active = false;
+    pCharacter->Animator.Animation = GetAsset(Assets, Animation_Walk_ID);
+    game_mesh* Mesh = GetAsset(Assets, Mesh_Body_ID);
+    pCharacter->Armature = Mesh->Armature;
+    pCharacter->Animator.Armature = &pCharacter->Armature;
+    pCharacter->Animator.Palette = NULL;
 
     return pCharacter;
 }
 
 enemy* AddEnemy(game_entity_state* State, v3 Position) {
-    Assert(State->Characters.Count < MAX_ENEMIES);
-    // If any ID is free, use it
-    int EnemyID = -1;
-    if (State->Enemies.nFreeIDs > 0) {
-        EnemyID = State->Enemies.FreeIDs[State->Enemies.nFreeIDs - 1];
-        State->Enemies.FreeIDs[State->Enemies.nFreeIDs-- - 1] = -1;
-        State->Enemies.Count++;
-    }
-    else EnemyID = State->Enemies.Count++;
-
-    enemy* pEnemy = &State->Enemies.List[EnemyID];
     char NameBuffer[32];
-    sprintf_s(NameBuffer, "Enemy %d", EnemyID);
+    sprintf_s(NameBuffer, "Enemy %d", State->Enemies.Count);
 
     quaternion Rotation = Quaternion(1.0, 0.0, 0.0, 0.0);
-    pEnemy->Entity = AddEntity(State, NameBuffer, Entity_Type_Enemy, SphereCollider(V3(0,0,0), 1.5f), Position, Rotation, Scale());
-    pEnemy->Entity->Index = EnemyID;
+    game_entity* Entity = AddEntity(State, NameBuffer, Entity_Type_Enemy, SphereCollider(V3(0,0,0), 1.5f), Position, Rotation, Scale());
+
+    enemy* pEnemy = State->Enemies.Insert(Entity->ID);
+    pEnemy->Entity = Entity;
     return pEnemy;
 }
 
@@ -476,26 +879,16 @@ prop* AddProp(
     quaternion Rotation = Quaternion(1.0, 0.0, 0.0, 0.0),
     scale S = Scale()
 ) {
-    Assert(State->Props.Count < MAX_PROPS);
-    // If any ID is free, use it
-    int PropID = -1;
-    if (State->Props.nFreeIDs > 0) {
-        PropID = State->Props.FreeIDs[State->Props.nFreeIDs - 1];
-        State->Props.FreeIDs[State->Props.nFreeIDs-- - 1] = -1;
-        State->Props.Count++;
-    }
-    else PropID = State->Props.Count++;
+    char NameBuffer[32];
+    sprintf_s(NameBuffer, "Prop %d", State->Props.Count);
 
-    prop* pProp = &State->Props.List[PropID];
+    game_entity* Entity = AddEntity(State, NameBuffer, Entity_Type_Prop, SphereCollider(V3(0,0,0), 5.0f), Position, Rotation, S);
+
+    prop* pProp = State->Props.Insert(Entity->ID);
     pProp->MeshID = MeshID;
     pProp->Shader = Shader;
     pProp->Color = Color;
-
-    char NameBuffer[32];
-    sprintf_s(NameBuffer, "Prop %d", PropID);
-
-    pProp->Entity = AddEntity(State, NameBuffer, Entity_Type_Prop, SphereCollider(V3(0,0,0), 5.0f), Position, Rotation, S);
-    pProp->Entity->Index = PropID;
+    pProp->Entity = Entity;
     return pProp;
 }
 
@@ -507,32 +900,17 @@ weapon* AddWeapon(
     quaternion Rotation = Quaternion(1.0, 0.0, 0.0, 0.0),
     scale S = Scale()
 ) {
-    Assert(State->Weapons.Count < MAX_PROPS);
-    // If any ID is free, use it
-    int WeaponID = -1;
-    if (State->Weapons.nFreeIDs > 0) {
-        WeaponID = State->Weapons.FreeIDs[State->Weapons.nFreeIDs - 1];
-        State->Weapons.FreeIDs[State->Weapons.nFreeIDs-- - 1] = -1;
-        State->Weapons.Count++;
-    }
-    else WeaponID = State->Weapons.Count++;
-
-    weapon* pWeapon = &State->Weapons.List[WeaponID];
-    pWeapon->Type = Type;
-    pWeapon->ParentBone = -1;
-    pWeapon->Color = Color;
-
     char NameBuffer[32];
-    sprintf_s(NameBuffer, "Weapon %d", WeaponID);
+    sprintf_s(NameBuffer, "Weapon %d", State->Weapons.Count);
 
     collider Collider;
-    switch (pWeapon->Type) {
+    switch (Type) {
         case Weapon_Sword: Collider = CapsuleCollider(V3(0,0,0), V3(0,3,0), 0.5f); break;
         case Weapon_Shield: Collider = CapsuleCollider(V3(0,-0.3,0), V3(0,0.7,0), 1.0f); break;
         default: Assert(false);
     }
 
-    pWeapon->Entity = AddEntity(
+    game_entity* Entity = AddEntity(
         State, 
         NameBuffer, 
         Entity_Type_Weapon,
@@ -541,45 +919,57 @@ weapon* AddWeapon(
         Rotation, 
         S
     );
-    pWeapon->Entity->Index = WeaponID;
+
+    weapon* pWeapon = State->Weapons.Insert(Entity->ID);
+    pWeapon->Type = Type;
+    pWeapon->ParentBone = -1;
+    pWeapon->Color = Color;
+    pWeapon->Entity = Entity;
     return pWeapon;
 }
 
-void PushEntities(render_group* Group, game_entity_state* State, game_input* Input, float Time) {
+void PushEntities(render_group* Group, game_entity_state* State, game_input* Input, float Time, float Alpha = 1.0f) {
     TIMED_BLOCK;
     basis Basis = Group->Camera->Basis;
     ray Ray = MouseRay(Group->Width, Group->Height, Group->Camera->Position + Group->Camera->Distance * Basis.Z, Basis, Input->Mouse.Cursor);
+    game_entity_components* Components = &State->Components;
     int i = 0;
     int nEntities = State->Entities.Count;
-    while (nEntities > 0 && i < MAX_ENTITIES) {
-        game_entity* Entity = &State->Entities.List[i++];
-        
-        if (Entity->Active) nEntities--;
+    while (nEntities > 0 && i < State->nIDs) {
+        int ID = i++;
+        if (Components->Active[ID]) nEntities--;
         else continue;
 
-        collider Collider = Entity->Transform * Entity->Collider;
+        game_entity* Entity = &State->Entities.List[ID];
+        transform EntityTransform = GetRenderTransform(State, ID, Alpha);
+        collider Collider = EntityTransform * Components->Collider[ID];
         Entity->Hovered = Raycast(Ray, Collider);
         switch(Entity->Type) {
             case Entity_Type_Character: {
-                character* pCharacter = &State->Characters.List[Entity->Index];
+                character* pCharacter = State->Characters.Get(ID);
                 PushMesh(
                     Group,
                     Mesh_Body_ID,
-                    Entity->Transform,
+                    EntityTransform,
                     Shader_Pipeline_Mesh_Bones_ID,
                     Bitmap_Empty_ID,
                     White,
-                    &pCharacter->Armature,
+                    &pCharacter->Animator,
                     Entity->Hovered
                 );
             } break;
     
             case Entity_Type_Enemy: {
-                enemy* Enemy = &State->Enemies.List[Entity->Index];
+                enemy* Enemy = State->Enemies.Get(ID);
+                // Collider is only a coarse test, pick the actual triangles
+                if (Entity->Hovered) {
+                    game_mesh* Mesh = GetAsset(Group->Assets, Mesh_Enemy_ID);
+                    Entity->Hovered = Raycast(Mesh, EntityTransform, Ray).Hit;
+                }
                 PushMesh(
                     Group,
                     Mesh_Enemy_ID,
-                    Entity->Transform,
+                    EntityTransform,
                     Shader_Pipeline_Mesh_ID,
                     Bitmap_Enemy_ID,
                     White, 0,
@@ -588,11 +978,11 @@ void PushEntities(render_group* Group, game_entity_state* State, game_input* Inp
             } break;
 
             case Entity_Type_Prop: {
-                prop* pProp = &State->Props.List[Entity->Index];
+                prop* pProp = State->Props.Get(ID);
                 PushMesh(
                     Group,
                     pProp->MeshID,
-                    Entity->Transform,
+                    EntityTransform,
                     pProp->Shader,
                     Bitmap_Empty_ID,
                     pProp->Color
@@ -600,7 +990,7 @@ void PushEntities(render_group* Group, game_entity_state* State, game_input* Inp
             } break;
 
             case Entity_Type_Weapon: {
-                weapon* pWeapon = &State->Weapons.List[Entity->Index];
+                weapon* pWeapon = State->Weapons.Get(ID);
                 game_mesh_id MeshID;
                 switch(pWeapon->Type) {
                     case Weapon_Sword: MeshID = Mesh_Sword_ID; break;
@@ -608,102 +998,320 @@ void PushEntities(render_group* Group, game_entity_state* State, game_input* Inp
                     default: Assert(false);
                 }
 
-                PushMesh(Group, MeshID, Entity->Transform, Shader_Pipeline_Mesh_ID);
+                PushMesh(Group, MeshID, EntityTransform, Shader_Pipeline_Mesh_ID);
             } break;
         }
 
         if (Group->Debug && Group->DebugColliders && Entity->Type != Entity_Type_Camera) {
-            PushCollider(Group, Entity->Collider, Entity->Transform, Entity->Collided ? Red : Yellow);
+            PushCollider(Group, Components->Collider[ID], EntityTransform, Components->Collided[ID] ? Red : Yellow);
+        }
+    }
+}
+
+// Collisions ______________________________________________________________________________________________________________________________
+
+/*
+    Refits one proxy per entity (by entity ID) from its current transform and runs the sweep. Cameras and inactive
+    entities don't take part. Afterwards `Broadphase->Pairs` holds candidate pairs of entity IDs. Collided flags are
+    cleared here, narrowphase sets them again.
+*/
+void UpdateBroadphase(broadphase* Broadphase, game_entity_state* State) {
+    TIMED_BLOCK;
+    game_entity_components* Components = &State->Components;
+    for (int i = 0; i < State->nIDs; i++) {
+        Components->Collided[i] = false;
+        if (Components->Active[i] && State->Entities.List[i].Type != Entity_Type_Camera) {
+            SetProxy(Broadphase, i, WorldCollider(State, i));
+        }
+        else if (i < Broadphase->nProxies) {
+            ClearProxy(Broadphase, i);
+        }
+    }
+    UpdateBroadphase(Broadphase);
+}
+
+// Keeps the grid in sync with entity positions. Entities that stay in their cell only get their position written.
+void UpdateSpatialHash(spatial_hash* Grid, game_entity_state* State) {
+    TIMED_BLOCK;
+    game_entity_components* Components = &State->Components;
+    for (int i = 0; i < State->nIDs; i++) {
+        if (Components->Active[i] && State->Entities.List[i].Type != Entity_Type_Camera) {
+            Move(Grid, i, Components->World[i].Translation);
+        }
+        else if (Grid->Entries[i].Active) {
+            Remove(Grid, i);
+        }
+    }
+}
+
+/*
+    Writes the collider of every entity in the grid for particles to collide with, at its grid handle, and the reach
+    of the farthest one from its grid position. Only spheres and capsules, the shapes entities use.
+*/
+void GatherParticleColliders(particle_collision* Collision, game_entity_state* State) {
+    TIMED_BLOCK;
+    game_entity_components* Components = &State->Components;
+    float Reach = 0;
+    for (int i = 0; i < State->nIDs && i < Collision->MaxColliders; i++) {
+        if (!Components->Active[i] || State->Entities.List[i].Type == Entity_Type_Camera) continue;
+
+        collider Collider = WorldCollider(State, i);
+        particle_collider* Result = &Collision->Colliders[i];
+        switch (Collider.Type) {
+            case Sphere_Collider: {
+                Result->Head = Collider.Offset;
+                Result->Tail = Collider.Offset;
+                Result->Radius = Collider.Sphere.Radius;
+            } break;
+
+            case Capsule_Collider: {
+                Result->Head = Collider.Capsule.Segment.Head;
+                Result->Tail = Collider.Capsule.Segment.Tail;
+                Result->Radius = Collider.Capsule.Distance;
+            } break;
+
+            default: {
+                *Result = {};
+                continue;
+            }
+        }
+        v3 Position = Components->World[i].Translation;
+        float Farthest = max(distance(Result->Head, Position), distance(Result->Tail, Position));
+        Reach = max(Reach, Farthest + Result->Radius);
+    }
+    Collision->Reach = Reach;
+}
+
+/*
+    Entities within Radius of Center, of the given type (any type with game_entity_type_count). Returns the number written.
+    Handles are gathered in Scratch, which is left as it was, so a job can pass its own thread's arena. Without a type
+    only the first MaxResults handles are needed, with one every entity in the grid may have to be looked at.
+*/
+uint32 QueryEntities(
+    memory_arena* Scratch,
+    spatial_hash* Grid,
+    game_entity_state* State,
+    v3 Center,
+    float Radius,
+    game_entity** Results,
+    uint32 MaxResults,
+    game_entity_type Type = game_entity_type_count
+) {
+    memory_index Used = Scratch->Used;
+    uint32 MaxHandles = Type == game_entity_type_count ? MaxResults : Grid->nEntries;
+    int* Handles = PushArray(Scratch, MaxHandles, int);
+    uint32 nFound = QueryRadius(Grid, Center, Radius, Handles, MaxHandles);
+    uint32 nHandles = min(nFound, MaxHandles);
+    uint32 nResults = 0;
+    for (int i = 0; i < nHandles && nResults < MaxResults; i++) {
+        game_entity* Entity = &State->Entities.List[Handles[i]];
+        if (Type == game_entity_type_count || Entity->Type == Type) {
+            Results[nResults++] = Entity;
         }
     }
+    Scratch->Used = Used;
+    return nResults;
 }
 
+// Commands ________________________________________________________________________________________________________________________________
+
+/*
+    Effects that involve more than one entity are not applied from inside jobs. Each broadphase pair owns
+    ENTITY_COMMANDS_PER_PAIR slots of the buffer, which only the job covering that pair writes, so the buffer is sized
+    from the pairs and can't fill up however the pairs are split between threads. The main thread then compacts, sorts
+    and applies them, so the result doesn't depend on which thread ran what or in which order.
+*/
+enum entity_command_type {
+    Entity_Command_None,
+    Entity_Command_Contact,
+    Entity_Command_Equip,
+};
+
+struct entity_command {
+    entity_command_type Type;
+    int ID1;
+    int ID2;
+};
+
+// A contact and a weapon pickup
+const uint32 ENTITY_COMMANDS_PER_PAIR = 2;
+
+struct entity_command_buffer {
+    uint32 MaxCommands;
+    uint32 nCommands;
+    entity_command* Commands;
+};
+
+// Empties the slots of the pairs in [Start, End) and returns the first one
+inline entity_command* GetPairCommands(entity_command_buffer* Buffer, uint32 Start, uint32 End) {
+    Assert(ENTITY_COMMANDS_PER_PAIR * End <= Buffer->MaxCommands, "Entity command buffer smaller than the broadphase.");
+    entity_command* Result = Buffer->Commands + ENTITY_COMMANDS_PER_PAIR * Start;
+    memset(Result, 0, ENTITY_COMMANDS_PER_PAIR * (End - Start) * sizeof(entity_command));
+    return Result;
+}
+
+int CompareEntityCommands(const void* pA, const void* pB) {
+    entity_command* A = (entity_command*)pA;
+    entity_command* B = (entity_command*)pB;
+    if (A->Type != B->Type) return A->Type < B->Type ? -1 : 1;
+    if (A->ID1 != B->ID1) return A->ID1 < B->ID1 ? -1 : 1;
+    if (A->ID2 != B->ID2) return A->ID2 < B->ID2 ? -1 : 1;
+    return 0;
+}
 
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 // | Game state                                                                                                                                   |
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 
-struct game_state {
-    game_entity_state Entities;
-    particle_emitter* Emitter;
-    double dt;
-    float Time;
-    bool Exit;
+// Fixed timestep ________________________________________________________________________________________________________________________
+
+/*
+    The simulation advances in ticks of fixed length, independent of the frame rate. Frame time is added to an
+    accumulator and as many whole ticks as fit are run. What's left over, as a fraction of a tick, is Alpha.
+*/
+struct fixed_timestep {
+    double TickDt;
+    double Accumulator;
+    float Alpha;
+    uint32 MaxTicksPerFrame;
+    uint32 nTicks;          // Ticks run the last frame
+    uint64 Tick;
+    uint64 DroppedTicks;
 };
 
-void UpdateGameState(game_assets* Assets, game_state* State, game_input* Input, camera** pActiveCamera, float Width, float Height) {
-    game_entity_state* EntityState = &State->Entities;
-    uint32 Index = 0;
+const float DEFAULT_TICK_RATE = 60.0f;
+const uint32 DEFAULT_MAX_TICKS_PER_FRAME = 8;
 
-// Cameras _________________________________________________________________________________________________________________________________
-    Index = 0;
-    uint32 nCameras = EntityState->Cameras.Count;
-    while(nCameras > 0) {
-        camera* Cam = &EntityState->Cameras.List[Index++];
-        game_entity* Entity = (game_entity*)Cam->Entity;
+void SetTickRate(fixed_timestep* Step, float TicksPerSecond, uint32 MaxTicksPerFrame = DEFAULT_MAX_TICKS_PER_FRAME) {
+    Assert(TicksPerSecond > 0 && MaxTicksPerFrame > 0);
+    Step->TickDt = 1.0 / TicksPerSecond;
+    Step->MaxTicksPerFrame = MaxTicksPerFrame;
+}
 
-        if (Cam->OnAir) {
-            *pActiveCamera = Cam;
-            EntityState->ActiveCamera = Cam;
-        }
+/*
+    Returns how many ticks to run for a frame that took FrameDt. If the simulation can't keep up, running every
+    tick owed would only make the next frame slower (spiral of death). Anything past MaxTicksPerFrame is dropped
+    and the game slows down instead.
+*/
+uint32 AccumulateTicks(fixed_timestep* Step, double FrameDt) {
+    Step->Accumulator += FrameDt;
+    uint32 nTicks = (uint32)(Step->Accumulator / Step->TickDt);
+    if (nTicks > Step->MaxTicksPerFrame) {
+        Step->DroppedTicks += nTicks - Step->MaxTicksPerFrame;
+        nTicks = Step->MaxTicksPerFrame;
+        Step->Accumulator = nTicks * Step->TickDt;
+    }
+    Step->Accumulator = max(Step->Accumulator - nTicks * Step->TickDt, 0.0);
+    Step->Alpha = (float)(Step->Accumulator / Step->TickDt);
+    Step->nTicks = nTicks;
+    Step->Tick += nTicks;
+    return nTicks;
+}
 
-    // Zoom
-        if (Input->Mode == Keyboard) {
-            if (Input->Mouse.Wheel > 0)      Cam->Distance /= 1.2;
-            else if (Input->Mouse.Wheel < 0) Cam->Distance *= 1.2;
-        }
+const uint32 MAX_GAME_STRINGS = 2 * MAX_ENTITY_NAMES;
 
-    // Orbit around position
-        if (
-            Input->Mode == Keyboard && 
-            Input->Mouse.MiddleClick.IsDown && 
-            Input->Mouse.MiddleClick.WasDown &&
-            Input->Mouse.Cursor.X >= 0 && Input->Mouse.Cursor.X <= Width &&
-            Input->Mouse.Cursor.Y >= 0 && Input->Mouse.Cursor.Y <= Height
-        ) {
-            v2 Offset = Input->Mouse.Cursor - Input->Mouse.LastCursor;
-            double AngularVelocity = 0.5;
+struct game_state {
+    string_table* Strings;              // Interned strings of every system, entity names included
+    game_entity_state Entities;
+    broadphase* Broadphase;
+    spatial_hash* Grid;
+    entity_command_buffer Commands;     // Slots of every broadphase pair
+    particle_system* Particles;
+    animation_system* Animation;
+    fixed_timestep Step;
+    game_input TickInput;               // Input latched between ticks
+    double FrameDt;                     // Measured by the platform
+    double dt;                          // Simulation tick
+    float Time;                         // Simulation time
+    bool Exit;
+};
 
-            Cam->Angle -= AngularVelocity * Offset.X;
-            Cam->Pitch += AngularVelocity * Offset.Y;
-        }
+// Needs the broadphase, the buffer has the slots of as many pairs as it can hold
+void AllocateCommandBuffers(memory_arena* Arena, game_state* State) {
+    Assert(State->Broadphase != NULL, "Command buffers are sized from the broadphase.");
+    entity_command_buffer* Buffer = &State->Commands;
+    Buffer->MaxCommands = ENTITY_COMMANDS_PER_PAIR * State->Broadphase->MaxPairs;
+    Buffer->nCommands = 0;
+    Buffer->Commands = PushArray(Arena, Buffer->MaxCommands, entity_command);
+}
 
-        if (Input->Mode == Controller) {
-            v2 Joystic = V2(Input->Controller.RightJoystick.X, Input->Controller.RightJoystick.Y);
+// Applies the commands written for the current broadphase pairs
+void ApplyEntityCommands(game_state* State) {
+    TIMED_BLOCK;
+    game_entity_state* EntityState = &State->Entities;
+    entity_command_buffer* Buffer = &State->Commands;
 
-            if (modulus(Joystic) > 0.1) {
-                Cam->Angle -= 3.0 * Joystic.X;
-                Cam->Pitch -= 3.0 * Joystic.Y;
-            }
-        }
+    // Empty slots out, in place, then sorted
+    uint32 nSlots = ENTITY_COMMANDS_PER_PAIR * State->Broadphase->nPairs;
+    uint32 nCommands = 0;
+    for (uint32 i = 0; i < nSlots; i++) {
+        if (Buffer->Commands[i].Type != Entity_Command_None) Buffer->Commands[nCommands++] = Buffer->Commands[i];
+    }
+    Buffer->nCommands = nCommands;
+    qsort(Buffer->Commands, nCommands, sizeof(entity_command), CompareEntityCommands);
+
+    for (int i = 0; i < nCommands; i++) {
+        entity_command Command = Buffer->Commands[i];
+        switch(Command.Type) {
+            case Entity_Command_Contact: {
+                EntityState->Components.Collided[Command.ID1] = true;
+                EntityState->Components.Collided[Command.ID2] = true;
+            } break;
 
-    // Rotation
-        Cam->Basis = GetCameraBasis(Cam->Angle, Cam->Pitch);
-        quaternion Rotation = Quaternion(Cam->Angle * Degrees, V3(0,1,0)) * Quaternion(Cam->Pitch * Degrees, V3(-1,0,0));
-        transform Test = Transform(Rotation);
-        matrix4 MatrixT = Matrix(Test);
+            case Entity_Command_Equip: {
+                weapon* Weapon = EntityState->Weapons.Get(Command.ID1);
+                character* Character = EntityState->Characters.Get(Command.ID2);
+                if (Weapon && Character && Weapon->Entity->Parent == NULL) {
+                    Equip(EntityState, Weapon, Character);
+                }
+            } break;
 
-        break;
+            default: Raise("Invalid entity command.");
+        }
     }
+}
 
-    camera* ActiveCamera = EntityState->ActiveCamera;
-    
-// Characters ______________________________________________________________________________________________________________________________
-    Index = 0;
-    uint32 nCharacters = EntityState->Characters.Count;
-    for (int i = 0; i < EntityState->Characters.Count; i++) {
-        character* Character = &EntityState->Characters.List[i];
+// Jobs ____________________________________________________________________________________________________________________________________
+
+/*
+    Per entity updates run as parallel for jobs over the packed type arrays. A job only writes the entities in its range
+    and reads shared state (input, camera, controlled character) that nothing writes during the phase.
+*/
+struct entity_job_context {
+    game_state* State;
+    game_assets* Assets;
+    game_input* Input;
+    camera* ActiveCamera;
+    character* ControlledCharacter;
+    int ControlledID;
+};
+
+PARALLEL_FOR_CALLBACK(UpdateCharacters) {
+    entity_job_context* Context = (entity_job_context*)Data;
+    game_entity_state* EntityState = &Context->State->Entities;
+    game_entity_components* Components = &EntityState->Components;
+    game_assets* Assets = Context->Assets;
+    game_input* Input = Context->Input;
+    camera* ActiveCamera = Context->ActiveCamera;
+
+    for (uint32 i = Start; i < End; i++) {
+        character* Character = &EntityState->Characters[i];
+        int ID = Character->Entity->ID;
+        // Dense storage moves on removal, re-point into wherever the character lives now
+        Character->Animator.Armature = &Character->Armature;
         
-        Character->Entity->Velocity = V3(0, 0, 0);
+        Components->Velocity[ID] = V3(0, 0, 0);
 
         character_action_id PastAction = Character->Action.ID;
         Character->Action = GetCharacterAction(Character, Input);
         character_action_id NewAction = Character->Action.ID;
         Character->Animator.Animation = GetAsset(Assets, Character->Action.AnimationID);
 
-        if (PastAction == Character_Action_Jump_ID) {
-            Character->Entity->Collider.Capsule.Segment.Head += V3(0,Character->Armature.Bones[0].Transform.Translation.Y,0);
-            Character->Entity->Collider.Capsule.Segment.Tail += V3(0,Character->Armature.Bones[0].Transform.Translation.Y,0);
+        // Palette of the last tick, the pose for this one is evaluated after every character has moved
+        if (PastAction == Character_Action_Jump_ID && Character->Animator.Palette != NULL) {
+            float Lift = Character->Animator.Palette->bone_transforms[0].WY;
+            Components->Collider[ID].Capsule.Segment.Head += V3(0,Lift,0);
+            Components->Collider[ID].Capsule.Segment.Tail += V3(0,Lift,0);
         }
 
         // Movement
@@ -733,87 +1341,281 @@ void UpdateGameState(game_assets* Assets, game_state* State, game_input* Input,
             // Direction is in coordinates relative to camera
             float Angle = atan2f(-Direction.X, Direction.Z);
             Direction = Direction.Y * V3(0.0, 1.0, 0.0) + Direction.X * HorizontalBasis.X - Direction.Z * HorizontalBasis.Z;
-            Character->Entity->Velocity = Speed * Direction;
-            Character->Entity->Transform.Rotation = Quaternion(ActiveCamera->Angle * Degrees + Angle, V3(0,1,0));
+            Components->Velocity[ID] = Speed * Direction;
+            Components->Rotation[ID] = Quaternion(ActiveCamera->Angle * Degrees + Angle, V3(0,1,0));
         }
-        Character->Entity->Transform.Translation += State->dt * Character->Entity->Velocity;
 
         if (PastAction == Character_Action_Attack_ID && NewAction == Character_Action_Idle_ID) {
-            Character->Entity->Transform.Translation += Character->Entity->Transform.Rotation * V3(0,0,2);
+            Components->Translation[ID] += Components->Rotation[ID] * V3(0,0,2);
         }
         
-        Character->Entity->Collided = false;
-        Character->Entity->Collider.Capsule.Segment = { V3(0,0.75f,0), V3(0,3.75f,0) };
-
-        EntityState->ControlledCharacter = Character;
-
-        Update(&Character->Animator);
+        Components->Collided[ID] = false;
+        Components->Collider[ID].Capsule.Segment = { V3(0,0.75f,0), V3(0,3.75f,0) };
+        Components->Dirty[ID] = true;
     }
+}
 
-    character* ControlledCharacter = EntityState->ControlledCharacter;
-    
-// Autofollow player _______________________________________________________________________________________________________________________
-    v3 Displacement = ControlledCharacter->Entity->Transform.Translation - ActiveCamera->Position;
-    Displacement.Y = 0;
-    float Distance = modulus(Displacement);
-    v3 Velocity = V3(0,0,0);
-    float MinDistance = .01f;
-    if (Distance >= MinDistance) Velocity = 20.0f * (Distance - MinDistance) * normalize(Displacement);
-    ActiveCamera->Position += State->dt * Velocity;
-    game_entity* ActiveCameraEntity = (game_entity*)ActiveCamera->Entity;
-    ActiveCameraEntity->Transform.Translation = V3(0,0,ActiveCamera->Distance) - ActiveCamera->Position * ActiveCamera->Basis;
-
-// Enemies _________________________________________________________________________________________________________________________________
-    Index = 0;
-    uint32 nEnemies = EntityState->Enemies.Count;
-    while (nEnemies > 0) {
-        enemy* pEnemy = &EntityState->Enemies.List[Index++];
-        if (pEnemy->Entity != NULL) nEnemies--;
-        else continue;
-        
-        pEnemy->Entity->Transform.Translation.Y = 3.2 + sin(3 * State->Time);
-        v3 FacingDirection = ControlledCharacter->Entity->Transform.Translation - pEnemy->Entity->Transform.Translation;
+PARALLEL_FOR_CALLBACK(UpdateEnemies) {
+    entity_job_context* Context = (entity_job_context*)Data;
+    game_entity_state* EntityState = &Context->State->Entities;
+    game_entity_components* Components = &EntityState->Components;
+    float Time = Context->State->Time;
+    v3 Target = Components->Translation[Context->ControlledID];
+
+    for (uint32 i = Start; i < End; i++) {
+        enemy* pEnemy = &EntityState->Enemies[i];
+        int ID = pEnemy->Entity->ID;
+        Components->Translation[ID].Y = 3.2 + sin(3 * Time);
+        v3 FacingDirection = Target - Components->Translation[ID];
         float Angle = atan2f(FacingDirection.Z, FacingDirection.X);
-        pEnemy->Entity->Transform.Rotation = Quaternion(Angle, V3(0,1,0));
+        Components->Rotation[ID] = Quaternion(Angle, V3(0,1,0));
+        Components->Dirty[ID] = true;
     }
+}
 
-// Weapons _________________________________________________________________________________________________________________________________
-    Index = 0;
-    uint32 nWeapons = EntityState->Enemies.Count;
-    while (nEnemies > 0) {
-        weapon* pWeapon = &EntityState->Weapons.List[Index++];
+// Equipped weapons follow a bone of the character they are parented to, the rest spin in place
+PARALLEL_FOR_CALLBACK(UpdateWeapons) {
+    entity_job_context* Context = (entity_job_context*)Data;
+    game_entity_state* EntityState = &Context->State->Entities;
+    game_entity_components* Components = &EntityState->Components;
+    float Time = Context->State->Time;
+
+    for (uint32 i = Start; i < End; i++) {
+        weapon* pWeapon = &EntityState->Weapons[i];
+        int ID = pWeapon->Entity->ID;
         if (pWeapon->ParentBone == -1) {
-            pWeapon->Entity->Transform.Rotation = Quaternion(State->Time, V3(0,1,0));
+            Components->Rotation[ID] = Quaternion(Time, V3(0,1,0));
+            Components->Dirty[ID] = true;
         }
 
-        pWeapon->Entity->Collided = false;
+        Components->Collided[ID] = false;
 
-        bool Collision = Collide(pWeapon->Entity, ControlledCharacter->Entity);
-        if (pWeapon->Entity->Parent == NULL && Collision) {
-            ControlledCharacter->Entity->Collided = true;
-            pWeapon->Entity->Collided = true;
-            Equip(pWeapon, ControlledCharacter);
-        }
-
-        if (pWeapon->ParentBone > 0) {
-            bone Bone = ControlledCharacter->Armature.Bones[pWeapon->ParentBone];
+        character* Owner = Components->Parent[ID] >= 0 ? EntityState->Characters.Get(Components->Parent[ID]) : NULL;
+        if (pWeapon->ParentBone > 0 && Owner != NULL && Owner->Animator.Palette != NULL) {
+            transform BoneTransform = GetBoneTransform(Owner->Animator.Palette, pWeapon->ParentBone);
             transform ModelTransform;
             if (pWeapon->Type == Weapon_Sword) {
                 ModelTransform = Transform(
                     V3(0.5f,2.0f,0),
                     Quaternion(-0.25f * Tau, V3(0,1,0)) * Quaternion(-0.25f * Tau, V3(1,0,0)),
-                    pWeapon->Entity->Transform.Scale
+                    Components->Scale[ID]
                 );
             }
             else if (pWeapon->Type == Weapon_Shield) {
                 ModelTransform = Transform(
                     V3(-0.7f,2.2f,0),
                     Quaternion(0.5f * Tau, V3(0,0,1)) * Quaternion(0.25f * Tau, V3(1,0,0)),
-                    pWeapon->Entity->Transform.Scale
+                    Components->Scale[ID]
                 );
             }
-            pWeapon->Entity->Transform = ModelTransform * Bone.Transform * ControlledCharacter->Entity->Transform;
+            SetTransform(EntityState, ID, ModelTransform * BoneTransform);
+        }
+    }
+}
+
+// Narrowphase over broadphase pairs. Contacts and weapon pickups go to the command slots of each pair.
+PARALLEL_FOR_CALLBACK(CollideEntityPairs) {
+    entity_job_context* Context = (entity_job_context*)Data;
+    game_state* State = Context->State;
+    game_entity_state* EntityState = &State->Entities;
+    broadphase* Broadphase = State->Broadphase;
+    entity_command* Commands = GetPairCommands(&State->Commands, Start, End);
+
+    for (uint32 i = Start; i < End; i++, Commands += ENTITY_COMMANDS_PER_PAIR) {
+        int ID1 = Broadphase->Pairs[i].A;
+        int ID2 = Broadphase->Pairs[i].B;
+        if (!Collide(WorldCollider(EntityState, ID1), WorldCollider(EntityState, ID2))) continue;
+        Commands[0] = { Entity_Command_Contact, ID1, ID2 };
+
+        // Weapon pickup
+        game_entity* Entity1 = &EntityState->Entities.List[ID1];
+        game_entity* Entity2 = &EntityState->Entities.List[ID2];
+        if (Entity1->Type == Entity_Type_Character) {
+            game_entity* Temp = Entity1;
+            Entity1 = Entity2;
+            Entity2 = Temp;
+        }
+        if (Entity1->Type == Entity_Type_Weapon && Entity2->ID == Context->ControlledID && Entity1->Parent == NULL) {
+            Commands[1] = { Entity_Command_Equip, Entity1->ID, Entity2->ID };
+        }
+    }
+}
+
+void ResolveCollisions(platform_api* Platform, entity_job_context* Context) {
+    TIMED_BLOCK;
+    game_state* State = Context->State;
+    UpdateSpatialHash(State->Grid, &State->Entities);
+    UpdateBroadphase(State->Broadphase, &State->Entities);
+    {
+        TIMED_NAMED_BLOCK("Narrowphase");
+        ParallelFor(Platform, State->Broadphase->nPairs, 256, CollideEntityPairs, Context);
+    }
+    ApplyEntityCommands(State);
+}
+
+// Runs once per frame, after the simulation ticks, and follows the interpolated player
+void UpdateCamera(
+    game_state* State,
+    game_input* Input,
+    camera** pActiveCamera,
+    float Width, float Height
+) {
+    TIMED_BLOCK;
+    game_entity_state* EntityState = &State->Entities;
+    game_entity_components* Components = &EntityState->Components;
+
+// Cameras _________________________________________________________________________________________________________________________________
+    for (int i = 0; i < EntityState->Cameras.Count; i++) {
+        camera* Cam = &EntityState->Cameras[i];
+        game_entity* Entity = (game_entity*)Cam->Entity;
+
+        if (Cam->OnAir) {
+            *pActiveCamera = Cam;
+            EntityState->ActiveCamera = Cam;
+        }
+
+    // Zoom
+        if (Input->Mode == Keyboard) {
+            if (Input->Mouse.Wheel > 0)      Cam->Distance /= 1.2;
+            else if (Input->Mouse.Wheel < 0) Cam->Distance *= 1.2;
+        }
+
+    // Orbit around position
+        if (
+            Input->Mode == Keyboard && 
+            Input->Mouse.MiddleClick.IsDown && 
+            Input->Mouse.MiddleClick.WasDown &&
+            Input->Mouse.Cursor.X >= 0 && Input->Mouse.Cursor.X <= Width &&
+            Input->Mouse.Cursor.Y >= 0 && Input->Mouse.Cursor.Y <= Height
+        ) {
+            v2 Offset = Input->Mouse.Cursor - Input->Mouse.LastCursor;
+            double AngularVelocity = 0.5;
+
+            Cam->Angle -= AngularVelocity * Offset.X;
+            Cam->Pitch += AngularVelocity * Offset.Y;
+        }
+
+        if (Input->Mode == Controller) {
+            v2 Joystic = V2(Input->Controller.RightJoystick.X, Input->Controller.RightJoystick.Y);
+
+            if (modulus(Joystic) > 0.1) {
+                Cam->Angle -= 3.0 * Joystic.X;
+                Cam->Pitch -= 3.0 * Joystic.Y;
+            }
+        }
+
+    // Rotation
+        Cam->Basis = GetCameraBasis(Cam->Angle, Cam->Pitch);
+        quaternion Rotation = Quaternion(Cam->Angle * Degrees, V3(0,1,0)) * Quaternion(Cam->Pitch * Degrees, V3(-1,0,0));
+        transform Test = Transform(Rotation);
+        matrix4 MatrixT = Matrix(Test);
+
+        break;
+    }
+
+// Autofollow player _______________________________________________________________________________________________________________________
+    camera* ActiveCamera = EntityState->ActiveCamera;
+    character* ControlledCharacter = EntityState->ControlledCharacter;
+    if (ActiveCamera == NULL || ControlledCharacter == NULL) return;
+
+    int ControlledID = ControlledCharacter->Entity->ID;
+    v3 Displacement = GetRenderTransform(EntityState, ControlledID, State->Step.Alpha).Translation - ActiveCamera->Position;
+    Displacement.Y = 0;
+    float Distance = modulus(Displacement);
+    v3 Velocity = V3(0,0,0);
+    float MinDistance = .01f;
+    if (Distance >= MinDistance) Velocity = 20.0f * (Distance - MinDistance) * normalize(Displacement);
+    ActiveCamera->Position += State->FrameDt * Velocity;
+    game_entity* ActiveCameraEntity = (game_entity*)ActiveCamera->Entity;
+    Components->Translation[ActiveCameraEntity->ID] = V3(0,0,ActiveCamera->Distance) - ActiveCamera->Position * ActiveCamera->Basis;
+    Components->Dirty[ActiveCameraEntity->ID] = true;
+}
+
+// One simulation tick of State->dt
+void UpdateGameState(platform_api* Platform, game_assets* Assets, game_state* State, game_input* Input) {
+    TIMED_BLOCK;
+    game_entity_state* EntityState = &State->Entities;
+    game_entity_components* Components = &EntityState->Components;
+
+    camera* ActiveCamera = EntityState->ActiveCamera;
+    entity_job_context Context = {};
+    Context.State = State;
+    Context.Assets = Assets;
+    Context.Input = Input;
+    Context.ActiveCamera = ActiveCamera;
+    
+// Characters ______________________________________________________________________________________________________________________________
+    {
+        TIMED_NAMED_BLOCK("Characters");
+        ParallelFor(Platform, EntityState->Characters.Count, 8, UpdateCharacters, &Context);
+    }
+    EntityState->ControlledCharacter = &EntityState->Characters[EntityState->Characters.Count - 1];
+
+    character* ControlledCharacter = EntityState->ControlledCharacter;
+    int ControlledID = ControlledCharacter->Entity->ID;
+    Context.ControlledCharacter = ControlledCharacter;
+    Context.ControlledID = ControlledID;
+
+// Animation _______________________________________________________________________________________________________________________________
+    {
+        TIMED_NAMED_BLOCK("Animation");
+        ClearAnimators(State->Animation);
+        for (int i = 0; i < EntityState->Characters.Count; i++) {
+            character* Character = &EntityState->Characters[i];
+            float Distance = 0;
+            bool Visible = true;
+            if (ActiveCamera != NULL) {
+                // Bounding sphere of the capsule
+                collider Collider = WorldCollider(EntityState, Character->Entity->ID);
+                segment3 Segment = Collider.Capsule.Segment;
+                v3 Center = 0.5f * (Segment.Head + Segment.Tail);
+                float Radius = 0.5f * modulus(Segment.Tail - Segment.Head) + Collider.Capsule.Distance;
+                Distance = modulus(Center - GetCameraEye(ActiveCamera));
+                Visible = IsInView(ActiveCamera, Center, Radius);
+            }
+            PushAnimator(State->Animation, &Character->Animator, Distance, Visible);
+        }
+        UpdateAnimators(Platform, State->Animation, (float)State->dt);
+    }
+
+// Movement ________________________________________________________________________________________________________________________________
+    IntegrateVelocities(EntityState, State->dt);
+    
+// Enemies _________________________________________________________________________________________________________________________________
+    {
+        TIMED_NAMED_BLOCK("Enemies");
+        ParallelFor(Platform, EntityState->Enemies.Count, 256, UpdateEnemies, &Context);
+    }
+
+// Weapons _________________________________________________________________________________________________________________________________
+    {
+        TIMED_NAMED_BLOCK("Weapons");
+        ParallelFor(Platform, EntityState->Weapons.Count, 64, UpdateWeapons, &Context);
+    }
+
+// World transforms ________________________________________________________________________________________________________________________
+    UpdateWorldTransforms(EntityState);
+
+// Collisions ______________________________________________________________________________________________________________________________
+    ResolveCollisions(Platform, &Context);
+}
+
+// Runs the ticks this frame's time covers. Rendering then interpolates entities by State->Step.Alpha.
+void SimulateFrame(platform_api* Platform, game_assets* Assets, game_state* State, game_input* Input) {
+    TIMED_BLOCK;
+    LatchInput(&State->TickInput, Input);
+    uint32 nTicks = AccumulateTicks(&State->Step, State->FrameDt);
+    for (uint32 i = 0; i < nTicks; i++) {
+        SavePreviousTransforms(&State->Entities);
+        State->dt = State->Step.TickDt;
+        UpdateGameState(Platform, Assets, State, &State->TickInput);
+        // Particle velocities are per tick (gravity falls by Gravity * dt * dt), so they only ever step with the tick dt
+        if (State->Particles) {
+            GatherParticleColliders(State->Particles->Collision, &State->Entities);
+            UpdateParticles(Platform, State->Particles, State->dt);
         }
+        State->Time += State->dt;
+        ConsumeInput(&State->TickInput);
     }
 }
 
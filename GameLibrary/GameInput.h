@@ -178,6 +178,49 @@ void UpdatePreviousInput(game_input* Input) {
     }
 }
 
+/*
+    Fixed simulation ticks don't line up with frames, a frame may run several ticks or none. Latched keeps the current
+    button state plus every press and lift since the last tick, so a tick neither misses nor repeats them.
+*/
+void LatchInput(game_input* Latched, game_input* Input) {
+    game_input Previous = *Latched;
+    *Latched = *Input;
+    for (int i = 0; i < NUMBER_OF_KEYS; i++) {
+        Latched->Keyboard.Keys[i].JustPressed |= Previous.Keyboard.Keys[i].JustPressed;
+        Latched->Keyboard.Keys[i].JustLifted |= Previous.Keyboard.Keys[i].JustLifted;
+    }
+    for (int i = 0; i < NUMBER_OF_CONTROLLER_BUTTONS; i++) {
+        Latched->Controller.Buttons[i].JustPressed |= Previous.Controller.Buttons[i].JustPressed;
+        Latched->Controller.Buttons[i].JustLifted |= Previous.Controller.Buttons[i].JustLifted;
+    }
+    Latched->Mouse.LeftClick.JustPressed |= Previous.Mouse.LeftClick.JustPressed;
+    Latched->Mouse.LeftClick.JustLifted |= Previous.Mouse.LeftClick.JustLifted;
+    Latched->Mouse.MiddleClick.JustPressed |= Previous.Mouse.MiddleClick.JustPressed;
+    Latched->Mouse.MiddleClick.JustLifted |= Previous.Mouse.MiddleClick.JustLifted;
+    Latched->Mouse.RightClick.JustPressed |= Previous.Mouse.RightClick.JustPressed;
+    Latched->Mouse.RightClick.JustLifted |= Previous.Mouse.RightClick.JustLifted;
+    Latched->Mouse.Wheel += Previous.Mouse.Wheel;
+}
+
+// Called after each tick, so the next one only sees new events
+void ConsumeInput(game_input* Latched) {
+    for (int i = 0; i < NUMBER_OF_KEYS; i++) {
+        Latched->Keyboard.Keys[i].JustPressed = false;
+        Latched->Keyboard.Keys[i].JustLifted = false;
+    }
+    for (int i = 0; i < NUMBER_OF_CONTROLLER_BUTTONS; i++) {
+        Latched->Controller.Buttons[i].JustPressed = false;
+        Latched->Controller.Buttons[i].JustLifted = false;
+    }
+    Latched->Mouse.LeftClick.JustPressed = false;
+    Latched->Mouse.LeftClick.JustLifted = false;
+    Latched->Mouse.MiddleClick.JustPressed = false;
+    Latched->Mouse.MiddleClick.JustLifted = false;
+    Latched->Mouse.RightClick.JustPressed = false;
+    Latched->Mouse.RightClick.JustLifted = false;
+    Latched->Mouse.Wheel = 0;
+}
+
 void PressButton(game_button_state* Button) {
     Button->IsDown = true;
     Button->JustPressed = !Button->WasDown;
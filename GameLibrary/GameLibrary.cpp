@@ -31,11 +31,6 @@ void GameOutputSound(game_assets* Assets, game_sound_buffer* pSoundBuffer, game_
 // Debug
 void LogGameDebugRecords(render_group* Group);
 
-void TestPerformance() {
-    //TIMED_BLOCK;
-    
-}
-
 // Main
 extern "C" GAME_UPDATE(GameUpdate)
 {
@@ -55,9 +50,10 @@ extern "C" GAME_UPDATE(GameUpdate)
     if (!Memory->IsInitialized) {
         firstFrame = true;
 
-        //TestPerformance();
-
         // Initialize entities
+        pGameState->Strings = AllocateStringTable(&Memory->Permanent, MAX_GAME_STRINGS, 16 * MAX_GAME_STRINGS);
+        InitializeEntityState(EntityState, &Memory->Permanent, MAX_ENTITIES, pGameState->Strings);
+        DebugInfo->Strings = pGameState->Strings;
         Group->Camera = AddCamera(EntityState, V3(0, 3.2f, 0), -45.0f, 22.5f);
         Group->Camera->OnAir = true;
         character* Character = AddCharacter(Assets, EntityState, V3(0,0,0), 100);
@@ -65,16 +61,30 @@ extern "C" GAME_UPDATE(GameUpdate)
         enemy* Enemy = AddEnemy(EntityState, V3(10,0,5));
         weapon* Sword = AddWeapon(EntityState, Weapon_Sword, White, V3(-5,0,0));
         weapon* Shield = AddWeapon(EntityState, Weapon_Shield, White, V3(-10,0,0));
-        Equip(Sword, Character);
-        Equip(Shield, Character);
+        Equip(EntityState, Sword, Character);
+        Equip(EntityState, Shield, Character);
 
         // UI
         uint32 MaxUIIDStack = 32;
         uint32* StackMemory = PushArray(&Memory->Permanent, MaxUIIDStack, uint32);
 
-        pGameState->Emitter = AllocateParticleEmitter(&Memory->Permanent, 200);
-        SetParticleEmitterCircle(pGameState->Emitter, V3(0,0,0), 1.0f, V3(0,1,0));
-        pGameState->Emitter->ParticleLifetime = 2.0f;
+        pGameState->Broadphase = AllocateBroadphase(&Memory->Permanent, MAX_ENTITIES, 16 * MAX_ENTITIES);
+        AllocateCommandBuffers(&Memory->Permanent, pGameState);
+        pGameState->Grid = AllocateSpatialHash(&Memory->Permanent, MAX_ENTITIES, 4.0f, 2 * MAX_ENTITIES);
+        pGameState->Animation = AllocateAnimationSystem(&Memory->Permanent, MAX_ANIMATORS);
+
+        pGameState->Particles = AllocateParticleSystem(&Memory->Permanent, 16, 64);
+        pGameState->Particles->Collision = AllocateParticleCollision(&Memory->Permanent, pGameState->Grid, MAX_ENTITIES);
+        particle_emitter* Emitter = CreateParticleEmitter(pGameState->Particles, 200, 100.0f, 2024);
+        SetParticleEmitterCircle(Emitter, V3(0,0,0), 1.0f, V3(0,1,0));
+        Emitter->ParticleLifetime = 2.0f;
+        Emitter->Collide = true;
+        Emitter->Bounce = 0.5f;
+        Emitter->Friction = 0.1f;
+
+        // First frame runs one tick so there is a state to render
+        SetTickRate(&pGameState->Step, DEFAULT_TICK_RATE);
+        pGameState->Step.Accumulator = pGameState->Step.TickDt;
 
         Memory->IsInitialized = true;
     }
@@ -86,15 +96,16 @@ extern "C" GAME_UPDATE(GameUpdate)
     PushClear(Group, Magenta, Target_PingPong);
     PushClear(Group, BackgroundBlue, Target_Output);
 
-    UpdateGameState(Assets, pGameState, Input, &Group->Camera, Group->Width, Group->Height);
+    SimulateFrame(Platform, Assets, pGameState, Input);
+    UpdateCamera(pGameState, Input, &Group->Camera, Group->Width, Group->Height);
     
     //GameOutputSound(Assets, SoundBuffer, pGameState, Input);
 
-    // PushEntities(Group, &pGameState->Entities, Input, Time);
+    // PushEntities(Group, &pGameState->Entities, Input, Time, pGameState->Step.Alpha);
 
     TestRendering(Group, Input, Time);
 
-    Update(Group, pGameState->Emitter, pGameState->dt);
+    PushParticles(Group, pGameState->Particles);
     
     UpdateUI(Memory, Input);
 
@@ -28,10 +28,12 @@ extern GAMELIBRARY_API int nGameLibrary;
 
 #include "GamePlatform.h"
 #include "GameMath.h"
+#include "GameMathWide.h"
 #include "GameInput.h"
 #include "GameAssets.h"
 #include "GameRender.h"
 #include "GameEntity.h"
+#include "GameSnapshot.h"
 #include "Particles.h"
 #include "GameDebug.h"
 #include "GameTest.h"
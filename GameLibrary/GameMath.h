@@ -120,6 +120,44 @@ inline int RandInt(int Min, int Max) {
 	return RandFloat() * (Max - Min) + Min;
 }
 
+/*
+	Random streams independent of rand(), so work split across threads draws from its own stream and gets the same
+	numbers whatever thread runs it. Xorshift32, seeded through an integer hash so consecutive seeds aren't correlated.
+*/
+struct random_series {
+	uint32 State;
+};
+
+inline uint32 Hash(uint32 X) {
+	X ^= X >> 16;
+	X *= 0x7feb352du;
+	X ^= X >> 15;
+	X *= 0x846ca68bu;
+	X ^= X >> 16;
+	return X;
+}
+
+inline random_series RandomSeries(uint32 Seed) {
+	random_series Result;
+	Result.State = Hash(Seed);
+	if (Result.State == 0) Result.State = 0x9e3779b9u;
+	return Result;
+}
+
+inline uint32 NextRandom(random_series* Series) {
+	uint32 X = Series->State;
+	X ^= X << 13;
+	X ^= X >> 17;
+	X ^= X << 5;
+	Series->State = X;
+	return X;
+}
+
+inline float NextFloat(random_series* Series, float Min = 0.0f, float Max = 1.0f) {
+	Assert(Min <= Max);
+	return (NextRandom(Series) >> 8) * (1.0f / 16777216.0f) * (Max - Min) + Min;
+}
+
 // +----------------------------------------------------------------------------------------------------------------------------------------+
 // | 2D                                                                                                                                     |
 // +----------------------------------------------------------------------------------------------------------------------------------------+
@@ -1314,6 +1352,45 @@ inline matrix3 Matrix(quaternion Q) {
 	return Result;
 }
 
+// Rotation of an orthonormal matrix as built by Matrix(quaternion), from its largest diagonal term for precision
+inline quaternion Quaternion(matrix3 R) {
+	float Trace = R.XX + R.YY + R.ZZ;
+	if (Trace > 0) {
+		float c = 0.5f * sqrtf(1.0f + Trace);
+		float f = 0.25f / c;
+		return { c, f * (R.ZY - R.YZ), f * (R.XZ - R.ZX), f * (R.YX - R.XY) };
+	}
+	else if (R.XX > R.YY && R.XX > R.ZZ) {
+		float i = 0.5f * sqrtf(1.0f + R.XX - R.YY - R.ZZ);
+		float f = 0.25f / i;
+		return { f * (R.ZY - R.YZ), i, f * (R.XY + R.YX), f * (R.XZ + R.ZX) };
+	}
+	else if (R.YY > R.ZZ) {
+		float j = 0.5f * sqrtf(1.0f + R.YY - R.XX - R.ZZ);
+		float f = 0.25f / j;
+		return { f * (R.XZ - R.ZX), f * (R.XY + R.YX), j, f * (R.YZ + R.ZY) };
+	}
+	else {
+		float k = 0.5f * sqrtf(1.0f + R.ZZ - R.XX - R.YY);
+		float f = 0.25f / k;
+		return { f * (R.YX - R.XY), f * (R.XZ + R.ZX), f * (R.YZ + R.ZY), k };
+	}
+}
+
+inline float dot(quaternion Q1, quaternion Q2) {
+	return Q1.c * Q2.c + Q1.i * Q2.i + Q1.j * Q2.j + Q1.k * Q2.k;
+}
+
+inline quaternion normalize(quaternion Q) {
+	return (1.0f / sqrtf(dot(Q, Q))) * Q;
+}
+
+// Normalized linear interpolation along the shorter arc. Close enough to slerp for small steps.
+inline quaternion Lerp(quaternion Q1, quaternion Q2, float t) {
+	if (dot(Q1, Q2) < 0) Q2 = -Q2;
+	return normalize((1.0f - t) * Q1 + t * Q2);
+}
+
 
 // +----------------------------------------------------------------------------------------------------------------------------------------+
 // | Transform                                                                                                                              |
@@ -1389,11 +1466,20 @@ inline basis operator*(transform T, basis Basis) {
 inline transform operator*(transform T, transform U) {
 	transform Result = { 0 };
 	Result.Scale = T.Scale * U.Scale;
-	Result.Translation = U.Translation + U.Rotation * T.Translation;
+	Result.Translation = U.Translation + U.Rotation * (U.Scale * T.Translation);
 	Result.Rotation = T.Rotation * U.Rotation;
 	return Result;
 }
 
+// Only exact for uniform scales, a non uniform one would have to be applied after the rotation
+inline transform inverse(transform T) {
+	transform Result;
+	Result.Scale = Scale(1.0f / T.Scale.X, 1.0f / T.Scale.Y, 1.0f / T.Scale.Z);
+	Result.Rotation = Conjugate(T.Rotation);
+	Result.Translation = -(Result.Rotation * (Result.Scale * T.Translation));
+	return Result;
+}
+
 inline bool operator==(transform T, transform U) {
 	return T.Translation == U.Translation && T.Scale == U.Scale && T.Rotation == U.Rotation;
 }
@@ -1412,6 +1498,18 @@ inline matrix4 Matrix(transform T) {
 	return Result;
 }
 
+inline transform Lerp(transform T, transform U, float t) {
+	transform Result;
+	Result.Translation = (1.0f - t) * T.Translation + t * U.Translation;
+	Result.Scale = Scale(
+		(1.0f - t) * T.Scale.X + t * U.Scale.X,
+		(1.0f - t) * T.Scale.Y + t * U.Scale.Y,
+		(1.0f - t) * T.Scale.Z + t * U.Scale.Z
+	);
+	Result.Rotation = Lerp(T.Rotation, U.Rotation, t);
+	return Result;
+}
+
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 // | Geometry                                                                                                                                     |
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
@@ -2052,6 +2150,77 @@ inline collider operator*(transform T, collider C) {
 	return C;
 }
 
+// Bounding boxes ______________________________________________________________________________________________________________________________
+
+struct aabb {
+	v3 Min;
+	v3 Max;
+};
+
+/*
+	Axis aligned bounding box of a collider already placed in world space (i.e. after applying the entity transform).
+	Rect colliders are flat, so their box has no depth.
+*/
+aabb AABB(collider Collider) {
+	aabb Result = {};
+	switch(Collider.Type) {
+		case Rect_Collider: {
+			v3 Half = V3(Collider.Rect.HalfWidth, Collider.Rect.HalfHeight, 0);
+			Result.Min = Collider.Offset - Half;
+			Result.Max = Collider.Offset + Half;
+		} break;
+
+		case Cube_Collider: {
+			v3 Half = V3(Collider.Cube.HalfWidth, Collider.Cube.HalfHeight, Collider.Cube.HalfDepth);
+			Result.Min = Collider.Offset - Half;
+			Result.Max = Collider.Offset + Half;
+		} break;
+
+		case Sphere_Collider: {
+			v3 Half = V3(Collider.Sphere.Radius, Collider.Sphere.Radius, Collider.Sphere.Radius);
+			Result.Min = Collider.Offset - Half;
+			Result.Max = Collider.Offset + Half;
+		} break;
+
+		case Capsule_Collider: {
+			v3 Head = Collider.Capsule.Segment.Head;
+			v3 Tail = Collider.Capsule.Segment.Tail;
+			float R = Collider.Capsule.Distance;
+			Result.Min = V3(min(Head.X, Tail.X) - R, min(Head.Y, Tail.Y) - R, min(Head.Z, Tail.Z) - R);
+			Result.Max = V3(max(Head.X, Tail.X) + R, max(Head.Y, Tail.Y) + R, max(Head.Z, Tail.Z) + R);
+		} break;
+
+		default: Assert(false);
+	}
+	return Result;
+}
+
+inline aabb EmptyAABB() {
+	return { V3(FLT_MAX, FLT_MAX, FLT_MAX), V3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+}
+
+inline void Grow(aabb* Box, v3 Point) {
+	Box->Min = V3(min(Box->Min.X, Point.X), min(Box->Min.Y, Point.Y), min(Box->Min.Z, Point.Z));
+	Box->Max = V3(max(Box->Max.X, Point.X), max(Box->Max.Y, Point.Y), max(Box->Max.Z, Point.Z));
+}
+
+inline void Grow(aabb* Box, aabb Other) {
+	Box->Min = V3(min(Box->Min.X, Other.Min.X), min(Box->Min.Y, Other.Min.Y), min(Box->Min.Z, Other.Min.Z));
+	Box->Max = V3(max(Box->Max.X, Other.Max.X), max(Box->Max.Y, Other.Max.Y), max(Box->Max.Z, Other.Max.Z));
+}
+
+// Half the surface area, which is all the SAH needs
+inline float HalfArea(aabb Box) {
+	v3 E = Box.Max - Box.Min;
+	return E.X * E.Y + E.Y * E.Z + E.Z * E.X;
+}
+
+inline bool Intersect(aabb A, aabb B) {
+	return A.Min.X <= B.Max.X && B.Min.X <= A.Max.X &&
+		   A.Min.Y <= B.Max.Y && B.Min.Y <= A.Max.Y &&
+		   A.Min.Z <= B.Max.Z && B.Min.Z <= A.Max.Z;
+}
+
 bool Collide(collider Collider, v3 Position) {
     switch(Collider.Type) {
         case Rect_Collider: {
@@ -2101,7 +2270,7 @@ bool Collide(collider Collider1, collider Collider2) {
 				return dot(r, r) <= SumRadii * SumRadii;
 			} break;
 			case Capsule_Collider: {
-				float SumDistance = Collider1.Capsule.Distance + Collider1.Capsule.Distance;
+				float SumDistance = Collider1.Capsule.Distance + Collider2.Capsule.Distance;
 				return SqDistance(Collider1.Capsule.Segment, Collider2.Capsule.Segment) <= SumDistance * SumDistance;
 			} break;
 			default: Assert(false);
@@ -0,0 +1,294 @@
+#ifndef GAME_MATH_WIDE
+#define GAME_MATH_WIDE
+
+#include <immintrin.h>
+
+#include "GamePlatform.h"
+#include "GameMath.h"
+
+// +----------------------------------------------------------------------------------------------------------------------------------------+
+// | Wide floats                                                                                                                            |
+// +----------------------------------------------------------------------------------------------------------------------------------------+
+
+/*
+    Four floats processed at once (SSE). Comparisons return lane masks as wide_float, use Select to blend with them.
+*/
+struct wide_float {
+    __m128 V;
+};
+
+inline wide_float WideFloat(float A) {
+    return { _mm_set1_ps(A) };
+}
+
+inline wide_float WideFloat(float A, float B, float C, float D) {
+    return { _mm_setr_ps(A, B, C, D) };
+}
+
+inline wide_float WideFloat(__m128 V) {
+    return { V };
+}
+
+inline wide_float LoadWide(float* Source) {
+    return { _mm_loadu_ps(Source) };
+}
+
+inline void StoreWide(float* Destination, wide_float A) {
+    _mm_storeu_ps(Destination, A.V);
+}
+
+inline wide_float operator+(wide_float A, wide_float B) { return { _mm_add_ps(A.V, B.V) }; }
+inline wide_float operator-(wide_float A, wide_float B) { return { _mm_sub_ps(A.V, B.V) }; }
+inline wide_float operator*(wide_float A, wide_float B) { return { _mm_mul_ps(A.V, B.V) }; }
+inline wide_float operator/(wide_float A, wide_float B) { return { _mm_div_ps(A.V, B.V) }; }
+inline wide_float operator*(float A, wide_float B)      { return { _mm_mul_ps(_mm_set1_ps(A), B.V) }; }
+inline wide_float operator*(wide_float A, float B)      { return { _mm_mul_ps(A.V, _mm_set1_ps(B)) }; }
+inline wide_float operator+(wide_float A, float B)      { return { _mm_add_ps(A.V, _mm_set1_ps(B)) }; }
+inline wide_float operator-(wide_float A, float B)      { return { _mm_sub_ps(A.V, _mm_set1_ps(B)) }; }
+inline wide_float operator-(wide_float A)               { return { _mm_xor_ps(A.V, _mm_set1_ps(-0.0f)) }; }
+
+inline wide_float& operator+=(wide_float& A, wide_float B) { A = A + B; return A; }
+inline wide_float& operator-=(wide_float& A, wide_float B) { A = A - B; return A; }
+inline wide_float& operator*=(wide_float& A, wide_float B) { A = A * B; return A; }
+
+inline wide_float operator<(wide_float A, wide_float B)  { return { _mm_cmplt_ps(A.V, B.V) }; }
+inline wide_float operator<=(wide_float A, wide_float B) { return { _mm_cmple_ps(A.V, B.V) }; }
+inline wide_float operator>(wide_float A, wide_float B)  { return { _mm_cmpgt_ps(A.V, B.V) }; }
+inline wide_float operator>=(wide_float A, wide_float B) { return { _mm_cmpge_ps(A.V, B.V) }; }
+inline wide_float operator&(wide_float A, wide_float B)  { return { _mm_and_ps(A.V, B.V) }; }
+inline wide_float operator|(wide_float A, wide_float B)  { return { _mm_or_ps(A.V, B.V) }; }
+
+// Mask ? A : B, lane by lane
+inline wide_float Select(wide_float Mask, wide_float A, wide_float B) {
+    return { _mm_or_ps(_mm_and_ps(Mask.V, A.V), _mm_andnot_ps(Mask.V, B.V)) };
+}
+
+inline bool Any(wide_float Mask) { return _mm_movemask_ps(Mask.V) != 0; }
+inline bool All(wide_float Mask) { return _mm_movemask_ps(Mask.V) == 0xF; }
+
+inline wide_float Abs(wide_float A)  { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), A.V) }; }
+inline wide_float Min(wide_float A, wide_float B) { return { _mm_min_ps(A.V, B.V) }; }
+inline wide_float Max(wide_float A, wide_float B) { return { _mm_max_ps(A.V, B.V) }; }
+inline wide_float Clamp(wide_float A, float Low, float High) {
+    return { _mm_min_ps(_mm_max_ps(A.V, _mm_set1_ps(Low)), _mm_set1_ps(High)) };
+}
+
+// Rounds toward negative infinity, valid while |A| < 2^31
+inline wide_float Floor(wide_float A) {
+    __m128 Truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(A.V));
+    __m128 Correction = _mm_and_ps(_mm_cmpgt_ps(Truncated, A.V), _mm_set1_ps(1.0f));
+    return { _mm_sub_ps(Truncated, Correction) };
+}
+
+/*
+    Unsigned keys that order the lanes from the largest float to the smallest. Positive floats get every bit but the
+    sign flipped, negative ones stay as they are and come after them.
+*/
+inline void StoreDescendingKeys(uint32* Destination, wide_float A) {
+    __m128i Bits = _mm_castps_si128(A.V);
+    __m128i Flip = _mm_andnot_si128(_mm_srai_epi32(Bits, 31), _mm_set1_epi32(0x7FFFFFFF));
+    _mm_storeu_si128((__m128i*)Destination, _mm_xor_si128(Bits, Flip));
+}
+
+inline float GetLane(wide_float A, int Lane) {
+    float Lanes[4];
+    _mm_storeu_ps(Lanes, A.V);
+    return Lanes[Lane];
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------+
+// | Wide vectors                                                                                                                           |
+// +----------------------------------------------------------------------------------------------------------------------------------------+
+
+struct wide_v3 {
+    wide_float X, Y, Z;
+};
+
+inline wide_v3 WideV3(v3 A) {
+    return { WideFloat(A.X), WideFloat(A.Y), WideFloat(A.Z) };
+}
+
+inline wide_v3 WideV3(wide_float X, wide_float Y, wide_float Z) {
+    return { X, Y, Z };
+}
+
+inline wide_v3 operator+(wide_v3 A, wide_v3 B)    { return { A.X + B.X, A.Y + B.Y, A.Z + B.Z }; }
+inline wide_v3 operator-(wide_v3 A, wide_v3 B)    { return { A.X - B.X, A.Y - B.Y, A.Z - B.Z }; }
+inline wide_v3 operator*(wide_float A, wide_v3 B) { return { A * B.X, A * B.Y, A * B.Z }; }
+inline wide_v3 operator*(float A, wide_v3 B)      { return { A * B.X, A * B.Y, A * B.Z }; }
+inline wide_v3& operator+=(wide_v3& A, wide_v3 B) { A = A + B; return A; }
+
+inline wide_v3 Select(wide_float Mask, wide_v3 A, wide_v3 B) {
+    return { Select(Mask, A.X, B.X), Select(Mask, A.Y, B.Y), Select(Mask, A.Z, B.Z) };
+}
+
+inline wide_float dot(wide_v3 A, wide_v3 B) {
+    return A.X * B.X + A.Y * B.Y + A.Z * B.Z;
+}
+
+inline wide_v3 cross(wide_v3 A, wide_v3 B) {
+    return {
+        A.Y * B.Z - A.Z * B.Y,
+        A.Z * B.X - A.X * B.Z,
+        A.X * B.Y - A.Y * B.X
+    };
+}
+
+struct wide_quaternion {
+    wide_float c, i, j, k;
+};
+
+inline wide_float dot(wide_quaternion A, wide_quaternion B) {
+    return A.c * B.c + A.i * B.i + A.j * B.j + A.k * B.k;
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------+
+// | Approximations                                                                                                                         |
+// +----------------------------------------------------------------------------------------------------------------------------------------+
+
+/*
+    Polynomial kernels after Cephes (S. Moshier). Errors are against double precision libm, measured by TestWideMath:
+        Sin, Cos, SinCos    |x| <= 8192       absolute error < 1.5e-7
+        Atan2               all quadrants     absolute error < 3.0e-7 rad
+        Exp                 [-87.3, 88.3]     relative error < 1.5e-7
+        Sqrt                                  correctly rounded (sqrtps)
+        RSqrt               normal floats     relative error < 5.0e-7 (rsqrtps + one Newton step)
+    Arguments are not checked for NaN or infinity.
+*/
+
+/*
+    Reduces x to [-Pi/4, Pi/4] by multiples of Pi/2 (three part Cody-Waite), evaluates both the sine and the cosine
+    polynomial and swaps them and their signs depending on the octant.
+*/
+inline void SinCos(wide_float X, wide_float* OutSin, wide_float* OutCos) {
+    __m128 SignMask = _mm_set1_ps(-0.0f);
+    __m128 x = X.V;
+    __m128 SignSin = _mm_and_ps(x, SignMask);
+    x = _mm_andnot_ps(SignMask, x);
+
+    // Octant, rounded up to even
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+    j = _mm_add_epi32(j, _mm_set1_epi32(1));
+    j = _mm_and_si128(j, _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(j);
+
+    __m128 SwapSignSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+    __m128 PolyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+    __m128 SignCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+    SignSin = _mm_xor_ps(SignSin, SwapSignSin);
+
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+    __m128 z = _mm_mul_ps(x, x);
+
+    __m128 PolyCos = _mm_set1_ps(2.443315711809948e-5f);
+    PolyCos = _mm_add_ps(_mm_mul_ps(PolyCos, z), _mm_set1_ps(-1.388731625493765e-3f));
+    PolyCos = _mm_add_ps(_mm_mul_ps(PolyCos, z), _mm_set1_ps(4.166664568298827e-2f));
+    PolyCos = _mm_mul_ps(_mm_mul_ps(PolyCos, z), z);
+    PolyCos = _mm_sub_ps(PolyCos, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    PolyCos = _mm_add_ps(PolyCos, _mm_set1_ps(1.0f));
+
+    __m128 PolySin = _mm_set1_ps(-1.9515295891e-4f);
+    PolySin = _mm_add_ps(_mm_mul_ps(PolySin, z), _mm_set1_ps(8.3321608736e-3f));
+    PolySin = _mm_add_ps(_mm_mul_ps(PolySin, z), _mm_set1_ps(-1.6666654611e-1f));
+    PolySin = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(PolySin, z), x), x);
+
+    __m128 Sin = _mm_or_ps(_mm_and_ps(PolyMask, PolySin), _mm_andnot_ps(PolyMask, PolyCos));
+    __m128 Cos = _mm_or_ps(_mm_and_ps(PolyMask, PolyCos), _mm_andnot_ps(PolyMask, PolySin));
+    OutSin->V = _mm_xor_ps(Sin, SignSin);
+    OutCos->V = _mm_xor_ps(Cos, SignCos);
+}
+
+inline wide_float Sin(wide_float X) {
+    wide_float S, C;
+    SinCos(X, &S, &C);
+    return S;
+}
+
+inline wide_float Cos(wide_float X) {
+    wide_float S, C;
+    SinCos(X, &S, &C);
+    return C;
+}
+
+/*
+    Octant reduction on |y|/|x| in [0, 1] (argument shifted by Pi/4 above tan(Pi/8)), odd polynomial, then the
+    result is reflected into the right quadrant. Atan2(0, 0) is 0.
+*/
+inline wide_float Atan2(wide_float Y, wide_float X) {
+    __m128 SignMask = _mm_set1_ps(-0.0f);
+    __m128 AbsX = _mm_andnot_ps(SignMask, X.V);
+    __m128 AbsY = _mm_andnot_ps(SignMask, Y.V);
+    __m128 Num = _mm_min_ps(AbsX, AbsY);
+    __m128 Den = _mm_max_ps(AbsX, AbsY);
+    __m128 Zero = _mm_cmpeq_ps(Den, _mm_setzero_ps());
+    __m128 t = _mm_andnot_ps(Zero, _mm_div_ps(Num, Den));
+
+    __m128 Shift = _mm_cmpgt_ps(t, _mm_set1_ps(0.4142135623730950f));
+    __m128 Shifted = _mm_div_ps(_mm_sub_ps(t, _mm_set1_ps(1.0f)), _mm_add_ps(t, _mm_set1_ps(1.0f)));
+    t = _mm_or_ps(_mm_and_ps(Shift, Shifted), _mm_andnot_ps(Shift, t));
+    __m128 Offset = _mm_and_ps(Shift, _mm_set1_ps(0.25f * Pi));
+
+    __m128 z = _mm_mul_ps(t, t);
+    __m128 Poly = _mm_set1_ps(8.05374449538e-2f);
+    Poly = _mm_add_ps(_mm_mul_ps(Poly, z), _mm_set1_ps(-1.38776856032e-1f));
+    Poly = _mm_add_ps(_mm_mul_ps(Poly, z), _mm_set1_ps(1.99777106478e-1f));
+    Poly = _mm_add_ps(_mm_mul_ps(Poly, z), _mm_set1_ps(-3.33329491539e-1f));
+    Poly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(Poly, z), t), t);
+    __m128 Angle = _mm_add_ps(Poly, Offset);
+
+    __m128 Steep = _mm_cmpgt_ps(AbsY, AbsX);
+    Angle = _mm_or_ps(_mm_and_ps(Steep, _mm_sub_ps(_mm_set1_ps(0.5f * Pi), Angle)), _mm_andnot_ps(Steep, Angle));
+    __m128 Behind = _mm_cmplt_ps(X.V, _mm_setzero_ps());
+    Angle = _mm_or_ps(_mm_and_ps(Behind, _mm_sub_ps(_mm_set1_ps(Pi), Angle)), _mm_andnot_ps(Behind, Angle));
+
+    return { _mm_or_ps(Angle, _mm_and_ps(Y.V, SignMask)) };
+}
+
+/*
+    e^x = 2^n * e^r with n = round(x / ln 2) and |r| <= ln(2) / 2. The exponent is built straight into the float bits.
+*/
+inline wide_float Exp(wide_float X) {
+    __m128 x = _mm_min_ps(_mm_max_ps(X.V, _mm_set1_ps(-87.3365447f)), _mm_set1_ps(88.3762626f));
+
+    __m128 n = Floor(WideFloat(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f)))).V;
+    x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(-2.12194440e-4f)));
+    __m128 z = _mm_mul_ps(x, x);
+
+    __m128 Poly = _mm_set1_ps(1.9875691500e-4f);
+    Poly = _mm_add_ps(_mm_mul_ps(Poly, x), _mm_set1_ps(1.3981999507e-3f));
+    Poly = _mm_add_ps(_mm_mul_ps(Poly, x), _mm_set1_ps(8.3334519073e-3f));
+    Poly = _mm_add_ps(_mm_mul_ps(Poly, x), _mm_set1_ps(4.1665795894e-2f));
+    Poly = _mm_add_ps(_mm_mul_ps(Poly, x), _mm_set1_ps(1.6666665459e-1f));
+    Poly = _mm_add_ps(_mm_mul_ps(Poly, x), _mm_set1_ps(5.0000001201e-1f));
+    Poly = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Poly, z), x), _mm_set1_ps(1.0f));
+
+    __m128i Exponent = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+    return { _mm_mul_ps(Poly, _mm_castsi128_ps(Exponent)) };
+}
+
+inline wide_float Sqrt(wide_float X) {
+    return { _mm_sqrt_ps(X.V) };
+}
+
+// 12 bit hardware estimate refined with one Newton-Raphson step: y' = y * (1.5 - 0.5 * x * y^2)
+inline wide_float RSqrt(wide_float X) {
+    __m128 y = _mm_rsqrt_ps(X.V);
+    __m128 HalfX = _mm_mul_ps(X.V, _mm_set1_ps(0.5f));
+    __m128 Correction = _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(HalfX, _mm_mul_ps(y, y)));
+    return { _mm_mul_ps(y, Correction) };
+}
+
+// Normalized linear interpolation along the shorter arc, as Lerp(quaternion, quaternion, float)
+inline wide_quaternion Lerp(wide_quaternion A, wide_quaternion B, wide_float t) {
+    wide_float Flip = dot(A, B) < WideFloat(0.0f);
+    B = { Select(Flip, -B.c, B.c), Select(Flip, -B.i, B.i), Select(Flip, -B.j, B.j), Select(Flip, -B.k, B.k) };
+    wide_float s = WideFloat(1.0f) - t;
+    wide_quaternion Result = { s * A.c + t * B.c, s * A.i + t * B.i, s * A.j + t * B.j, s * A.k + t * B.k };
+    wide_float Inverse = RSqrt(dot(Result, Result));
+    return { Inverse * Result.c, Inverse * Result.i, Inverse * Result.j, Inverse * Result.k };
+}
+
+#endif
@@ -111,7 +111,7 @@ inline void ClearArena(memory_arena* Arena) {
 }
 
 #define PushStruct(Arena, type) (type *)PushSize_(Arena, sizeof(type))
-#define PushArray(Arena, Count, type) (type *)PushSize_(Arena, Count*sizeof(type))
+#define PushArray(Arena, Count, type) (type *)PushSize_(Arena, (Count)*sizeof(type))
 #define PushSize(Arena, Size) (void*)PushSize_(Arena, Size)
 inline void* PushSize_(memory_arena* Arena, memory_index Size) {
     Assert(Arena->Size >= Arena->Used + Size);
@@ -121,7 +121,7 @@ inline void* PushSize_(memory_arena* Arena, memory_index Size) {
 }
 
 #define PopStruct(Arena, type) (type *)PopSize_(Arena, sizeof(type))
-#define PopArray(Arena, Count, type) (type *)PopSize_(Arena, Count*sizeof(type))
+#define PopArray(Arena, Count, type) (type *)PopSize_(Arena, (Count)*sizeof(type))
 #define PopSize(Arena, Size) (void*)PopSize_(Arena, Size)
 inline void* PopSize_(memory_arena* Arena, memory_index Size) {
     memory_index BytesErased = Size < Arena->Used? Size : Arena->Used;
@@ -312,6 +312,136 @@ uint64 GetLength(linked_list List) {
 #define DefineFreeList(maxNumber, type) struct type##_list {\
     uint32 nFreeIDs; uint32 FreeIDs[maxNumber]; uint32 Count; type List[maxNumber]; }; DefineFreeListRemove(type); DefineFreeListInsert(type);
 
+/*
+    Pool of elements allocated from an arena in chunks. Chunks grow exponentially like `xarray` (each new chunk holds at
+    least as many elements as all chunks before it) and are never moved or given back, so a pointer to an element stays
+    valid as the pool grows. Reusing freed elements is up to the owner, see sparse_set.
+*/
+const int MAX_POOL_CHUNKS = 24;
+const uint32 POOL_FIRST_CHUNK_SIZE = 16;
+
+template <typename T> struct pool {
+    memory_arena* Arena;
+    T* Chunks[MAX_POOL_CHUNKS];
+    uint32 ChunkSizes[MAX_POOL_CHUNKS];
+    uint32 nChunks;
+    uint32 Capacity;
+    uint32 Used;
+    uint32 Current;
+    uint32 CurrentUsed;
+
+    // Adds a chunk with room for at least MinCount elements
+    void Grow(uint32 MinCount) {
+        Assert(Arena != NULL, "Pool without arena.");
+        Assert(nChunks < MAX_POOL_CHUNKS, "Pool chunk index overflow.");
+        uint32 Size = POOL_FIRST_CHUNK_SIZE;
+        if (Size < Capacity) Size = Capacity;
+        if (Size < MinCount) Size = MinCount;
+        Chunks[nChunks] = PushArray(Arena, Size, T);
+        ChunkSizes[nChunks++] = Size;
+        Capacity += Size;
+    }
+
+    // Makes room for Count more elements with at most one arena allocation
+    void Reserve(uint32 Count) {
+        uint32 Free = Capacity - Used;
+        if (Free < Count) Grow(Count - Free);
+    }
+
+    T* Allocate() {
+        while (Current < nChunks && CurrentUsed == ChunkSizes[Current]) {
+            Current++;
+            CurrentUsed = 0;
+        }
+        if (Current == nChunks) Grow(1);
+        Used++;
+        return Chunks[Current] + CurrentUsed++;
+    }
+};
+
+/*
+    Sparse set keyed by a small integer ID (e.g. an entity ID). `IDs` and `Elements` are packed without holes, so iterating
+    is a plain loop up to `Count`, and removing swaps the last entry into the hole. `Sparse` maps an ID to its packed slot
+    and is validated against `IDs`, so it never needs clearing and a zeroed set is empty.
+    Elements themselves live in a pool and never move: pointers stay valid until their own element is removed. Slots
+    past `Count` keep the elements of removed IDs, which are reused before the pool grows.
+    The ID range is set at runtime by Initialize, which takes the arrays and the pool from the same arena.
+*/
+template <typename T> struct sparse_set {
+    uint32 MaxIDs;
+    uint32 Count;
+    uint32 nSlots;
+    uint32* IDs;
+    uint32* Sparse;
+    T** Elements;
+    pool<T> Pool;
+
+    void Initialize(memory_arena* Arena, uint32 nIDs) {
+        MaxIDs = nIDs;
+        IDs = PushArray(Arena, nIDs, uint32);
+        Sparse = PushArray(Arena, nIDs, uint32);
+        Elements = PushArray(Arena, nIDs, T*);
+        Pool.Arena = Arena;
+    }
+
+    bool Contains(uint32 ID) {
+        if (ID >= MaxIDs) return false;
+        uint32 Slot = Sparse[ID];
+        return Slot < Count && IDs[Slot] == ID;
+    }
+
+    T* Get(uint32 ID) {
+        return Contains(ID) ? Elements[Sparse[ID]] : NULL;
+    }
+
+    T* Insert(uint32 ID, const T& Element = {}) {
+        Assert(ID < MaxIDs, "Sparse set ID out of range.");
+        Assert(!Contains(ID), "ID already in sparse set.");
+        uint32 Slot = Count++;
+        if (Slot == nSlots) Elements[nSlots++] = Pool.Allocate();
+        *Elements[Slot] = Element;
+        IDs[Slot] = ID;
+        Sparse[ID] = Slot;
+        return Elements[Slot];
+    }
+
+    void Remove(uint32 ID) {
+        Assert(Contains(ID), "ID not in sparse set.");
+        uint32 Slot = Sparse[ID];
+        uint32 Last = --Count;
+        T* Removed = Elements[Slot];
+        if (Slot != Last) {
+            Elements[Slot] = Elements[Last];
+            IDs[Slot] = IDs[Last];
+            Sparse[IDs[Slot]] = Slot;
+        }
+        Elements[Last] = Removed;
+        *Removed = {};
+    }
+
+    // Makes sure the next Count inserts don't touch the arena more than once
+    void Reserve(uint32 n) {
+        Assert(Count + n <= MaxIDs, "Sparse set reserve out of range.");
+        if (Count + n > nSlots) {
+            uint32 nNew = Count + n - nSlots;
+            Pool.Reserve(nNew);
+            for (int i = 0; i < nNew; i++) {
+                Elements[nSlots++] = Pool.Allocate();
+            }
+        }
+    }
+
+    // Empties the set, keeping its elements for reuse
+    void Clear() {
+        Count = 0;
+    }
+
+    T& operator[](uint32 i) {
+        Assert(i < Count, "Index out of range.");
+        return *Elements[i];
+    }
+};
+
 // Naive implementation of exponential array (see https://www.youtube.com/watch?v=i-h95QIGchY)
 
 const int MAX_XARRAY_CHUNKS = 32;
@@ -395,6 +525,87 @@ public:
     }
 };
 
+// String interning ________________________________________________________________________________________________________________________
+
+/*
+    Stores every distinct string once and names it by a dense ID starting at 1 (0 is no string), so strings can be kept,
+    compared and hashed as integers. Lookup is FNV-1a with linear probing over a power of two table at most half full.
+    Strings are never removed.
+*/
+typedef uint32 string_id;
+
+struct string_table {
+    memory_arena Storage;
+    uint32 nStrings;
+    uint32 MaxStrings;
+    uint32 nBuckets;
+    string_id* Buckets;
+    uint32* Hashes;
+    char** Strings;
+};
+
+inline uint32 HashString(const char* String) {
+    uint32 Hash = 2166136261u;
+    while (*String) {
+        Hash = (Hash ^ (uint8)*String++) * 16777619u;
+    }
+    return Hash;
+}
+
+string_table* AllocateStringTable(memory_arena* Arena, uint32 MaxStrings, memory_index StorageSize) {
+    uint32 nBuckets = 1;
+    while (nBuckets < 2 * MaxStrings) nBuckets <<= 1;
+
+    string_table* Result = PushStruct(Arena, string_table);
+    *Result = {};
+    Result->MaxStrings = MaxStrings;
+    Result->nBuckets = nBuckets;
+    Result->Buckets = PushArray(Arena, nBuckets, string_id);
+    ZeroSize(nBuckets * sizeof(string_id), Result->Buckets);
+    Result->Hashes = PushArray(Arena, MaxStrings + 1, uint32);
+    Result->Strings = PushArray(Arena, MaxStrings + 1, char*);
+    Result->Strings[0] = PushString(Arena, "");
+    Result->Strings[0][0] = '\0';
+    Result->Storage = SuballocateMemoryArena(Arena, StorageSize);
+    return Result;
+}
+
+// Bucket holding String, or the empty bucket where it would go
+string_id* FindBucket(string_table* Table, const char* String, uint32 Hash) {
+    uint32 Mask = Table->nBuckets - 1;
+    for (uint32 i = Hash & Mask; ; i = (i + 1) & Mask) {
+        string_id ID = Table->Buckets[i];
+        if (ID == 0 || (Table->Hashes[ID] == Hash && strcmp(Table->Strings[ID], String) == 0)) {
+            return &Table->Buckets[i];
+        }
+    }
+}
+
+// 0 when the string was never interned
+string_id FindString(string_table* Table, const char* String) {
+    return *FindBucket(Table, String, HashString(String));
+}
+
+string_id Intern(string_table* Table, const char* String) {
+    uint32 Hash = HashString(String);
+    string_id* Bucket = FindBucket(Table, String, Hash);
+    if (*Bucket == 0) {
+        Assert(Table->nStrings < Table->MaxStrings, "String table is full.");
+        string_id ID = ++Table->nStrings;
+        memory_index Length = strlen(String) + 1;
+        Table->Strings[ID] = PushString(&Table->Storage, String);
+        memcpy(Table->Strings[ID], String, Length);
+        Table->Hashes[ID] = Hash;
+        *Bucket = ID;
+    }
+    return *Bucket;
+}
+
+inline const char* GetString(string_table* Table, string_id ID) {
+    Assert(ID <= Table->nStrings, "Invalid string ID.");
+    return Table->Strings[ID];
+}
+
 // Services that the platform layer provides for the game
 struct read_file_result {
     const char* Path;
@@ -403,6 +614,14 @@ struct read_file_result {
     void* Content;
 };
 
+// Enough of a file to tell whether it changed since something was built from it
+struct file_stamp {
+    int64 Timestamp;
+    uint32 Size;
+    uint32 Hash;
+    uint32 PathHash;
+};
+
 const char* GetFileExtension(const char* Path) {
     uint64 L = strlen(Path);
     const char* LastSlash = NULL;
@@ -498,6 +717,10 @@ const char* GetFileExtension(const char* Path) {
 #define PLATFORM_READ_ENTIRE_FILE(name) read_file_result name(const char* Path)
 typedef PLATFORM_READ_ENTIRE_FILE(platform_read_entire_file);
 
+// Last write time of the file, in the same units as read_file_result. 0 if it does not exist.
+#define PLATFORM_GET_FILE_TIMESTAMP(name) int64 name(const char* Path)
+typedef PLATFORM_GET_FILE_TIMESTAMP(platform_get_file_timestamp);
+
 #define PLATFORM_WRITE_ENTIRE_FILE(name) bool name(const char* Path, uint64 MemorySize, void* Memory)
 typedef PLATFORM_WRITE_ENTIRE_FILE(platform_write_entire_file);
 
@@ -507,11 +730,84 @@ typedef PLATFORM_APPEND_TO_FILE(platform_append_to_file);
 #define PLATFORM_FREE_FILE_MEMORY(name) void name(void* Memory)
 typedef PLATFORM_FREE_FILE_MEMORY(platform_free_file_memory);
 
+#define PLATFORM_REMOVE_FILE(name) bool name(const char* Path)
+typedef PLATFORM_REMOVE_FILE(platform_remove_file);
+
+/*
+    Work queue. The platform layer owns the worker threads so they survive reloading the game code, the game only pushes
+    entries and waits for them within a frame. `CompleteAllWork` makes the calling thread help until the queue is empty.
+    Thread index 0 is the main thread, workers are 1 to nThreads - 1.
+*/
+const int MAX_THREADS = 16;
+struct platform_work_queue;
+
+#define PLATFORM_WORK_QUEUE_CALLBACK(name) void name(platform_work_queue* Queue, uint32 ThreadIndex, void* Data)
+typedef PLATFORM_WORK_QUEUE_CALLBACK(platform_work_queue_callback);
+
+#define PLATFORM_ADD_WORK_ENTRY(name) void name(platform_work_queue* Queue, platform_work_queue_callback* Callback, void* Data)
+typedef PLATFORM_ADD_WORK_ENTRY(platform_add_work_entry);
+
+#define PLATFORM_COMPLETE_ALL_WORK(name) void name(platform_work_queue* Queue)
+typedef PLATFORM_COMPLETE_ALL_WORK(platform_complete_all_work);
+
 struct platform_api {
     platform_read_entire_file* ReadEntireFile;
     platform_free_file_memory* FreeFileMemory;
+    platform_get_file_timestamp* GetFileTimestamp;
     platform_write_entire_file* WriteEntireFile;
     platform_append_to_file* AppendToFile;
+    platform_remove_file* RemoveFile;
+    platform_work_queue* WorkQueue;
+    uint32 nThreads;
+    platform_add_work_entry* AddWorkEntry;
+    platform_complete_all_work* CompleteAllWork;
+};
+
+// Parallel for ____________________________________________________________________________________________________________________________
+
+#define PARALLEL_FOR_CALLBACK(name) void name(uint32 ThreadIndex, uint32 Start, uint32 End, void* Data)
+typedef PARALLEL_FOR_CALLBACK(parallel_for_callback);
+
+struct parallel_for_job {
+    parallel_for_callback* Callback;
+    void* Data;
+    uint32 Start;
+    uint32 End;
 };
 
+PLATFORM_WORK_QUEUE_CALLBACK(DoParallelForJob) {
+    parallel_for_job* Job = (parallel_for_job*)Data;
+    Job->Callback(ThreadIndex, Job->Start, Job->End, Job->Data);
+}
+
+/*
+    Calls `Callback` over [0, Count) split in ranges of `BatchSize` and returns when all of them are done. Without a work
+    queue (or with a single batch) the whole range runs on the calling thread as thread 0, which is also the serial path.
+*/
+void ParallelFor(platform_api* Platform, uint32 Count, uint32 BatchSize, parallel_for_callback* Callback, void* Data) {
+    if (Count == 0) return;
+    if (Platform == NULL || Platform->WorkQueue == NULL || Count <= BatchSize) {
+        Callback(0, 0, Count, Data);
+        return;
+    }
+
+    const uint32 MAX_PARALLEL_FOR_JOBS = 256;
+    uint32 nJobs = (Count + BatchSize - 1) / BatchSize;
+    if (nJobs > MAX_PARALLEL_FOR_JOBS) {
+        nJobs = MAX_PARALLEL_FOR_JOBS;
+        BatchSize = (Count + nJobs - 1) / nJobs;
+    }
+
+    parallel_for_job Jobs[MAX_PARALLEL_FOR_JOBS];
+    for (uint32 i = 0; i < nJobs; i++) {
+        parallel_for_job* Job = &Jobs[i];
+        Job->Callback = Callback;
+        Job->Data = Data;
+        Job->Start = i * BatchSize;
+        Job->End = Job->Start + BatchSize < Count ? Job->Start + BatchSize : Count;
+        Platform->AddWorkEntry(Platform->WorkQueue, DoParallelForJob, Job);
+    }
+    Platform->CompleteAllWork(Platform->WorkQueue);
+}
+
 #endif
\ No newline at end of file
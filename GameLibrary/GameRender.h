@@ -9,8 +9,14 @@
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 
 const memory_index VERTEX_BUFFER_SIZE = Kilobytes(64);
+const memory_index PARTICLE_VERTEX_BUFFER_SIZE = Megabytes(2);
 const memory_index ELEMENT_BUFFER_SIZE = Kilobytes(8);
 
+// Particles stream every live particle in one entry, their layout gets a larger buffer
+inline memory_index GetVertexBufferSize(vertex_layout_id LayoutID) {
+    return LayoutID == vertex_layout_vec3_vec4_float_id ? PARTICLE_VERTEX_BUFFER_SIZE : VERTEX_BUFFER_SIZE;
+}
+
 struct vertex_buffer_entry {
     uint32 Offset;
     uint32 Count;
@@ -45,7 +51,7 @@ inline memory_index InitializeVertexBuffer(
     for (int i = 0; i < vertex_layout_id_count; i++) {
         Buffer->Layouts[i] = Assets->VertexLayouts[i];
         Buffer->VertexCount[i] = 0;
-        Size = VERTEX_BUFFER_SIZE;
+        Size = GetVertexBufferSize((vertex_layout_id)i);
         Buffer->Vertices[i] = SuballocateMemoryArena(Arena, Size);
 
         TotalSize += Size;
@@ -130,6 +136,21 @@ basis GetCameraBasis(float Angle, float Pitch) {
     return Result;
 }
 
+inline v3 GetCameraEye(camera* Camera) {
+    return Camera->Position + Camera->Distance * Camera->Basis.Z;
+}
+
+/*
+    Whether a sphere may be in view. The world projection spans 45 degrees to each side horizontally and less than
+    that vertically, so the test against 45 degree planes on both axes keeps everything visible and then some.
+*/
+bool IsInView(camera* Camera, v3 Center, float Radius) {
+    v3 d = Center - GetCameraEye(Camera);
+    float Depth = -dot(d, Camera->Basis.Z);
+    float Margin = Depth + 1.41421356f * Radius;
+    return Depth > -Radius && fabsf(dot(d, Camera->Basis.X)) <= Margin && fabsf(dot(d, Camera->Basis.Y)) <= Margin;
+}
+
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
 // | Render entries                                                                                                                               |
 // +----------------------------------------------------------------------------------------------------------------------------------------------+
@@ -181,7 +202,7 @@ struct render_primitive_options {
     game_bitmap* Texture = NULL;
     game_mesh* Mesh = NULL;
     game_font* Font = NULL;
-    armature* Armature = NULL;
+    bone_palette* Palette = NULL;
     v2 Pen;
     int PatchParameter = 4;
     float TextSize = 0;
@@ -1527,14 +1548,14 @@ void PushMesh(
     game_shader_pipeline_id ShaderID,
     game_bitmap_id TextureID = Bitmap_Empty_ID,
     color Color = White,
-    armature* Armature = NULL,
+    game_animator* Animator = NULL,
     bool Outline = false,
     float Order = SORT_ORDER_MESHES
 ) {
     game_mesh* Mesh = GetAsset(Group->Assets, MeshID);
     render_primitive_options Options = {};
     Options.Mesh = Mesh;
-    Options.Armature = Armature;
+    Options.Palette = Animator != NULL ? Animator->Palette : NULL;
     Options.Texture = GetAsset(Group->Assets, TextureID);
     Options.Flags = DEPTH_TEST_RENDER_FLAG;
     Options.Outline = Outline;
@@ -1545,7 +1566,7 @@ void PushMesh(
         render_primitive_triangle,
         Color,
         GetShaderPipeline(Group->Assets, ShaderID),
-        Armature != NULL ? vertex_layout_vec3_vec2_vec3_id : vertex_layout_bones_id,
+        Animator != NULL ? vertex_layout_vec3_vec2_vec3_id : vertex_layout_bones_id,
         Mesh->nVertices,
         3 * Mesh->nFaces,
         SORT_ORDER_MESHES,
@@ -1575,7 +1596,8 @@ void PushMesh(
     }
 
     // Debug bones rendering
-    if (Group->Debug && Group->DebugBones && Armature != NULL) {
+    if (Group->Debug && Group->DebugBones && Animator != NULL && Animator->Palette != NULL) {
+        armature* Armature = Animator->Armature;
         game_shader_pipeline* Shader = GetShaderPipeline(Group->Assets, Shader_Pipeline_World_Single_Color_ID);
         Options = {};
         Options.Thickness = 2.5f;
@@ -1592,10 +1614,9 @@ void PushMesh(
         )->Vertices;
 
         for (int i = 0; i < Armature->nBones; i++) {
-            bone Bone = Armature->Bones[i];
-            transform BoneTransform = Bone.Transform;
-            Vertices[2*i] = BoneTransform * Transform * Bone.Segment.Head;
-            Vertices[2*i+1] = BoneTransform * Transform * Bone.Segment.Tail;
+            segment3 Segment = Armature->Bones[i].Segment;
+            Vertices[2*i] = Transform * SkinPoint(Animator->Palette, i, Segment.Head);
+            Vertices[2*i+1] = Transform * SkinPoint(Animator->Palette, i, Segment.Tail);
         }
     }
 }
@@ -0,0 +1,429 @@
+#ifndef GAME_SNAPSHOT
+#define GAME_SNAPSHOT
+
+#include "GamePlatform.h"
+#include "GameEntity.h"
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Snapshots                                                                                                                                    |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+/*
+    Compact binary copy of the live part of the simulation: live entities with their components and type data, the free
+    list, and the timestep. Cached world transforms, broadphase, grid and command buffers are rebuilt, not stored.
+    Pointers are stored as entity or asset IDs and names as text, so a snapshot stays valid across runs of the same build.
+
+    Layout: snapshot_header, free IDs, then for each entity type its entities in dense order (entity_snapshot followed by
+    the type data). Keeping dense order means iteration order, and so the simulation, is the same after reading it.
+*/
+
+const uint32 SNAPSHOT_MAGIC = 0x50414E53;
+const uint32 SNAPSHOT_VERSION = 2;
+
+struct snapshot_header {
+    uint32 Magic;
+    uint32 Version;
+    uint32 Size;
+    uint32 nEntities;
+    uint32 nFreeIDs;
+    uint32 Counts[game_entity_type_count];
+    int ActiveCameraID;
+    int ControlledCharacterID;
+    fixed_timestep Step;
+    game_input TickInput;
+    double dt;
+    float Time;
+};
+
+struct free_id_snapshot {
+    uint32 ID;
+    uint32 Generation;
+};
+
+struct entity_snapshot {
+    char Name[32];
+    int ID;
+    uint32 Generation;
+    int Parent;
+    v3 Translation;
+    quaternion Rotation;
+    scale Scale;
+    v3 Velocity;
+    collider Collider;
+    bool Active;
+};
+
+// Followed by nBones bone transforms
+struct character_snapshot {
+    character_action Action;
+    entity_handle LeftHand;
+    entity_handle RightHand;
+    game_animation_id AnimationID;
+    float AnimationTime;
+    uint32 nBones;
+    bool AnimatorActive;
+    bool Loop;
+};
+
+// Per type counts only have the entity ID space as bound, so the buffer is a budget: WriteSnapshot fails past it
+const uint32 MAX_SNAPSHOT_SIZE = Megabytes(4);
+
+template <typename T> inline T* WriteStruct(memory_arena* Arena, const T& Value) {
+    T* Result = PushStruct(Arena, T);
+    *Result = Value;
+    return Result;
+}
+
+#define ReadStruct(Arena, type) PushStruct(Arena, type)
+
+void WriteEntitySnapshot(memory_arena* Arena, game_entity_state* State, int ID) {
+    game_entity_components* Components = &State->Components;
+    entity_snapshot* Snapshot = PushStruct(Arena, entity_snapshot);
+    *Snapshot = {};
+    strncpy_s(Snapshot->Name, GetName(State, &State->Entities.List[ID]), _TRUNCATE);
+    Snapshot->ID = ID;
+    Snapshot->Generation = State->Generations[ID];
+    Snapshot->Parent = Components->Parent[ID];
+    Snapshot->Translation = Components->Translation[ID];
+    Snapshot->Rotation = Components->Rotation[ID];
+    Snapshot->Scale = Components->Scale[ID];
+    Snapshot->Velocity = Components->Velocity[ID];
+    Snapshot->Collider = Components->Collider[ID];
+    Snapshot->Active = Components->Active[ID];
+}
+
+game_entity* ReadEntitySnapshot(memory_arena* Arena, game_entity_state* State, game_entity_type Type) {
+    entity_snapshot* Snapshot = ReadStruct(Arena, entity_snapshot);
+    int ID = Snapshot->ID;
+    Assert(ID >= 0 && ID < State->MaxEntities, "Entity ID out of range in snapshot.");
+
+    game_entity* Entity = &State->Entities.List[ID];
+    Entity->ID = ID;
+    Entity->Name = Intern(State->Names, Snapshot->Name);
+    LinkName(State, ID);
+    Entity->Type = Type;
+    State->Generations[ID] = Snapshot->Generation;
+    if (ID >= State->nIDs) State->nIDs = ID + 1;
+
+    game_entity_components* Components = &State->Components;
+    Components->Parent[ID] = Snapshot->Parent;
+    Components->Translation[ID] = Snapshot->Translation;
+    Components->Rotation[ID] = Snapshot->Rotation;
+    Components->Scale[ID] = Snapshot->Scale;
+    Components->Velocity[ID] = Snapshot->Velocity;
+    Components->Collider[ID] = Snapshot->Collider;
+    Components->Active[ID] = Snapshot->Active;
+    Components->Dirty[ID] = true;
+    return Entity;
+}
+
+// Returns the snapshot size, 0 if it doesn't fit in MaxSize
+uint32 WriteSnapshot(game_state* State, uint8* Buffer, uint32 MaxSize) {
+    TIMED_BLOCK;
+    game_entity_state* EntityState = &State->Entities;
+    if (MaxSize < sizeof(snapshot_header)) return 0;
+    memory_arena Arena = MemoryArena(MaxSize, Buffer);
+
+    snapshot_header* Header = PushStruct(&Arena, snapshot_header);
+    *Header = {};
+    Header->Magic = SNAPSHOT_MAGIC;
+    Header->Version = SNAPSHOT_VERSION;
+    Header->nEntities = EntityState->Entities.Count;
+    Header->nFreeIDs = EntityState->Entities.nFreeIDs;
+    Header->ActiveCameraID = EntityState->ActiveCamera ? ((game_entity*)EntityState->ActiveCamera->Entity)->ID : -1;
+    Header->ControlledCharacterID = EntityState->ControlledCharacter ? EntityState->ControlledCharacter->Entity->ID : -1;
+    Header->Step = State->Step;
+    Header->TickInput = State->TickInput;
+    Header->dt = State->dt;
+    Header->Time = State->Time;
+
+    // Worst case has to fit before anything is written past the header
+    uint32 RequiredSize = sizeof(snapshot_header) + Header->nFreeIDs * sizeof(free_id_snapshot) +
+        EntityState->Entities.Count * sizeof(entity_snapshot) +
+        EntityState->Cameras.Count * sizeof(camera) +
+        EntityState->Characters.Count * (sizeof(character_snapshot) + MAX_ARMATURE_BONES * sizeof(transform)) +
+        EntityState->Props.Count * sizeof(prop) +
+        EntityState->Weapons.Count * sizeof(weapon);
+    if (RequiredSize > MaxSize) {
+        Log(Error, "Entity snapshot doesn't fit in its buffer.");
+        return 0;
+    }
+
+    for (int i = 0; i < Header->nFreeIDs; i++) {
+        uint32 ID = EntityState->Entities.FreeIDs[i];
+        WriteStruct(&Arena, free_id_snapshot{ ID, EntityState->Generations[ID] });
+    }
+
+    for (int Type = 0; Type < game_entity_type_count; Type++) {
+        uint32* IDs = NULL;
+        uint32 nIDs = GetEntityIDs(EntityState, (game_entity_type)Type, &IDs);
+        Header->Counts[Type] = nIDs;
+
+        for (int i = 0; i < nIDs; i++) {
+            int ID = IDs[i];
+            WriteEntitySnapshot(&Arena, EntityState, ID);
+
+            switch(Type) {
+                case Entity_Type_Camera: {
+                    camera* Camera = WriteStruct(&Arena, *EntityState->Cameras.Get(ID));
+                    Camera->Entity = NULL;
+                } break;
+
+                case Entity_Type_Character: {
+                    character* Character = EntityState->Characters.Get(ID);
+                    character_snapshot* Snapshot = PushStruct(&Arena, character_snapshot);
+                    *Snapshot = {};
+                    Snapshot->Action = Character->Action;
+                    Snapshot->LeftHand = Character->LeftHand;
+                    Snapshot->RightHand = Character->RightHand;
+                    Snapshot->AnimationID = Character->Animator.Animation->ID;
+                    Snapshot->AnimationTime = Character->Animator.Time;
+                    Snapshot->nBones = Character->Armature.nBones;
+                    Snapshot->AnimatorActive = Character->Animator.Active;
+                    Snapshot->Loop = Character->Animator.Loop;
+                    transform* Bones = PushArray(&Arena, Snapshot->nBones, transform);
+                    for (int j = 0; j < Snapshot->nBones; j++) {
+                        Bones[j] = Character->Armature.Bones[j].Transform;
+                    }
+                } break;
+
+                case Entity_Type_Enemy: break;
+
+                case Entity_Type_Prop: {
+                    prop* Prop = WriteStruct(&Arena, *EntityState->Props.Get(ID));
+                    Prop->Entity = NULL;
+                } break;
+
+                case Entity_Type_Weapon: {
+                    weapon* Weapon = WriteStruct(&Arena, *EntityState->Weapons.Get(ID));
+                    Weapon->Entity = NULL;
+                } break;
+
+                default: Raise("Invalid entity type.");
+            }
+        }
+    }
+
+    Header->Size = Arena.Used;
+    return Arena.Used;
+}
+
+/*
+    Replaces the entity state with the snapshot. Character armatures start from the body mesh and get the stored bone
+    transforms, animations are looked up by ID. World transforms are recomputed, with no interpolation from before.
+*/
+bool ReadSnapshot(game_state* State, game_assets* Assets, uint8* Buffer, uint32 Size) {
+    TIMED_BLOCK;
+    snapshot_header* Header = (snapshot_header*)Buffer;
+    if (Size < sizeof(snapshot_header) || Header->Magic != SNAPSHOT_MAGIC || Header->Version != SNAPSHOT_VERSION || Header->Size != Size) {
+        Log(Error, "Invalid entity snapshot.");
+        return false;
+    }
+
+    memory_arena Arena = MemoryArena(Size, Buffer);
+    PushStruct(&Arena, snapshot_header);
+
+    game_entity_state* EntityState = &State->Entities;
+    ClearEntityState(EntityState);
+    memset(EntityState->Generations, 0, EntityState->MaxEntities * sizeof(uint32));
+    Assert(Header->nFreeIDs <= EntityState->MaxEntities, "Snapshot has more IDs than the entity state.");
+    EntityState->Entities.nFreeIDs = Header->nFreeIDs;
+    for (int i = 0; i < Header->nFreeIDs; i++) {
+        free_id_snapshot* FreeID = ReadStruct(&Arena, free_id_snapshot);
+        Assert(FreeID->ID < EntityState->MaxEntities, "Entity ID out of range in snapshot.");
+        EntityState->Entities.FreeIDs[i] = FreeID->ID;
+        EntityState->Generations[FreeID->ID] = FreeID->Generation;
+    }
+
+    for (int Type = 0; Type < game_entity_type_count; Type++) {
+        ReserveEntities(EntityState, (game_entity_type)Type, Header->Counts[Type]);
+        for (int i = 0; i < Header->Counts[Type]; i++) {
+            game_entity* Entity = ReadEntitySnapshot(&Arena, EntityState, (game_entity_type)Type);
+            int ID = Entity->ID;
+
+            switch(Type) {
+                case Entity_Type_Camera: {
+                    camera* Camera = EntityState->Cameras.Insert(ID, *ReadStruct(&Arena, camera));
+                    Camera->Entity = (void*)Entity;
+                } break;
+
+                case Entity_Type_Character: {
+                    character_snapshot* Snapshot = ReadStruct(&Arena, character_snapshot);
+                    transform* Bones = PushArray(&Arena, Snapshot->nBones, transform);
+
+                    character* Character = EntityState->Characters.Insert(ID);
+                    Character->Entity = Entity;
+                    Character->Action = Snapshot->Action;
+                    Character->LeftHand = Snapshot->LeftHand;
+                    Character->RightHand = Snapshot->RightHand;
+                    Character->Armature = GetAsset(Assets, Mesh_Body_ID)->Armature;
+                    Assert(Snapshot->nBones == Character->Armature.nBones, "Snapshot armature doesn't match the body mesh.");
+                    for (int j = 0; j < Snapshot->nBones; j++) {
+                        Character->Armature.Bones[j].Transform = Bones[j];
+                    }
+                    Character->Animator.Animation = GetAsset(Assets, Snapshot->AnimationID);
+                    Character->Animator.Armature = &Character->Armature;
+                    Character->Animator.Palette = NULL;     // Handed out again on the next tick
+                    Character->Animator.Time = Snapshot->AnimationTime;
+                    Character->Animator.Active = Snapshot->AnimatorActive;
+                    Character->Animator.Loop = Snapshot->Loop;
+                } break;
+
+                case Entity_Type_Enemy: {
+                    EntityState->Enemies.Insert(ID)->Entity = Entity;
+                } break;
+
+                case Entity_Type_Prop: {
+                    EntityState->Props.Insert(ID, *ReadStruct(&Arena, prop))->Entity = Entity;
+                } break;
+
+                case Entity_Type_Weapon: {
+                    EntityState->Weapons.Insert(ID, *ReadStruct(&Arena, weapon))->Entity = Entity;
+                } break;
+
+                default: Raise("Invalid entity type.");
+            }
+        }
+    }
+
+    EntityState->Entities.Count = Header->nEntities;
+
+    // Parent pointers once every entity is in place
+    for (int Type = 0; Type < game_entity_type_count; Type++) {
+        uint32* IDs = NULL;
+        uint32 nIDs = GetEntityIDs(EntityState, (game_entity_type)Type, &IDs);
+        for (int i = 0; i < nIDs; i++) {
+            int Parent = EntityState->Components.Parent[IDs[i]];
+            EntityState->Entities.List[IDs[i]].Parent = Parent >= 0 ? &EntityState->Entities.List[Parent] : NULL;
+        }
+    }
+
+    EntityState->ActiveCamera = Header->ActiveCameraID >= 0 ? EntityState->Cameras.Get(Header->ActiveCameraID) : NULL;
+    EntityState->ControlledCharacter = Header->ControlledCharacterID >= 0 ? EntityState->Characters.Get(Header->ControlledCharacterID) : NULL;
+    EntityState->Hierarchy.OrderDirty = true;
+    UpdateWorldTransforms(EntityState);
+    SavePreviousTransforms(EntityState);
+
+    State->Step = Header->Step;
+    State->TickInput = Header->TickInput;
+    State->dt = Header->dt;
+    State->Time = Header->Time;
+    return true;
+}
+
+// Deltas __________________________________________________________________________________________________________________________________
+
+/*
+    A snapshot XORed with the one before it is mostly zero, since most entities don't change between ticks. The delta
+    stores it as runs: varint count of unchanged bytes, varint count of changed bytes, then the changed bytes XORed.
+    Bytes past the end of the base are XORed with zero. Decoding needs the exact base, checked by size and hash.
+*/
+const uint32 SNAPSHOT_DELTA_MAGIC = 0x544C4544;
+
+// Zero bytes inside a changed run shorter than this are kept in it, a new run costs at least two bytes
+const int SNAPSHOT_DELTA_MIN_SKIP = 4;
+
+struct snapshot_delta_header {
+    uint32 Magic;
+    uint32 BaseSize;
+    uint32 BaseHash;
+    uint32 Size;
+};
+
+uint32 HashSnapshot(uint8* Buffer, uint32 Size) {
+    uint32 Hash = 2166136261u;
+    for (int i = 0; i < Size; i++) {
+        Hash = (Hash ^ Buffer[i]) * 16777619u;
+    }
+    return Hash;
+}
+
+inline bool WriteVarint(memory_arena* Arena, uint32 Value) {
+    do {
+        if (Arena->Used >= Arena->Size) return false;
+        uint8 Byte = Value & 0x7F;
+        Value >>= 7;
+        Arena->Base[Arena->Used++] = Byte | (Value ? 0x80 : 0);
+    } while (Value);
+    return true;
+}
+
+inline uint32 ReadVarint(memory_arena* Arena) {
+    uint32 Result = 0;
+    for (int Shift = 0; Arena->Used < Arena->Size && Shift < 32; Shift += 7) {
+        uint8 Byte = Arena->Base[Arena->Used++];
+        Result |= (uint32)(Byte & 0x7F) << Shift;
+        if (!(Byte & 0x80)) break;
+    }
+    return Result;
+}
+
+inline uint8 DeltaByte(uint8* Base, uint32 BaseSize, uint8* Snapshot, uint32 i) {
+    return Snapshot[i] ^ (i < BaseSize ? Base[i] : 0);
+}
+
+// Returns the delta size, 0 if it doesn't fit in MaxSize
+uint32 EncodeSnapshotDelta(uint8* Base, uint32 BaseSize, uint8* Snapshot, uint32 Size, uint8* Buffer, uint32 MaxSize) {
+    TIMED_BLOCK;
+    if (MaxSize < sizeof(snapshot_delta_header)) return 0;
+    memory_arena Arena = MemoryArena(MaxSize, Buffer);
+    snapshot_delta_header* Header = PushStruct(&Arena, snapshot_delta_header);
+    *Header = { SNAPSHOT_DELTA_MAGIC, BaseSize, HashSnapshot(Base, BaseSize), Size };
+
+    uint32 i = 0;
+    while (i < Size) {
+        uint32 Start = i;
+        while (i < Size && DeltaByte(Base, BaseSize, Snapshot, i) == 0) i++;
+        if (i == Size) break;
+        uint32 Skip = i - Start;
+
+        Start = i;
+        uint32 nZeros = 0;
+        while (i < Size && nZeros < SNAPSHOT_DELTA_MIN_SKIP) {
+            nZeros = DeltaByte(Base, BaseSize, Snapshot, i) == 0 ? nZeros + 1 : 0;
+            i++;
+        }
+        i -= nZeros;
+        uint32 Count = i - Start;
+
+        if (!WriteVarint(&Arena, Skip) || !WriteVarint(&Arena, Count)) return 0;
+        if (Arena.Used + Count > Arena.Size) return 0;
+        for (int j = 0; j < Count; j++) {
+            Arena.Base[Arena.Used++] = DeltaByte(Base, BaseSize, Snapshot, Start + j);
+        }
+    }
+
+    return Arena.Used;
+}
+
+// Rebuilds the snapshot the delta was made from into Buffer. Returns its size, 0 if the base doesn't match.
+uint32 DecodeSnapshotDelta(uint8* Base, uint32 BaseSize, uint8* Delta, uint32 DeltaSize, uint8* Buffer, uint32 MaxSize) {
+    TIMED_BLOCK;
+    snapshot_delta_header* Header = (snapshot_delta_header*)Delta;
+    if (DeltaSize < sizeof(snapshot_delta_header) || Header->Magic != SNAPSHOT_DELTA_MAGIC) return 0;
+    if (Header->BaseSize != BaseSize || Header->BaseHash != HashSnapshot(Base, BaseSize)) {
+        Log(Error, "Snapshot delta applied to the wrong base.");
+        return 0;
+    }
+    uint32 Size = Header->Size;
+    if (Size > MaxSize) return 0;
+
+    memmove(Buffer, Base, min(BaseSize, Size));
+    if (Size > BaseSize) memset(Buffer + BaseSize, 0, Size - BaseSize);
+
+    memory_arena Arena = MemoryArena(DeltaSize, Delta);
+    PushStruct(&Arena, snapshot_delta_header);
+    uint32 i = 0;
+    while (Arena.Used < Arena.Size) {
+        i += ReadVarint(&Arena);
+        uint32 Count = ReadVarint(&Arena);
+        if (i + Count > Size || Arena.Used + Count > Arena.Size) return 0;
+        for (int j = 0; j < Count; j++) {
+            Buffer[i++] ^= Arena.Base[Arena.Used++];
+        }
+    }
+
+    return Size;
+}
+
+#endif
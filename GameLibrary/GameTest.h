@@ -1,5 +1,54 @@
 #include "GamePlatform.h"
 #include "GameRender.h"
+#include "GameCollision.h"
+#include "GameMathWide.h"
+#include "GameEntity.h"
+#include "Particles.h"
+
+/*
+    Test harness. Every test gets the same arena, cleared before it runs, and reports through TestReport, which logs
+    and prints to Output. A failed Assert stops the run, so the name of each test is printed before it starts.
+*/
+struct test_context {
+    platform_api* Platform;
+    memory_arena Arena;
+    FILE* Output;
+    const char* Filter;
+    const char* Name;
+    uint64 StartCycles;
+    uint32 nTests;
+};
+
+void TestReport(test_context* Test, const char* Format, ...) {
+    char Buffer[512];
+    va_list Args;
+    va_start(Args, Format);
+    vsprintf_s(Buffer, Format, Args);
+    va_end(Args);
+    Log(Info, Buffer);
+    if (Test->Output) fprintf(Test->Output, "    %s\n", Buffer);
+}
+
+// Tests run if their call contains the filter, e.g. "Particle" or "TestSnapshots"
+bool BeginTest(test_context* Test, const char* Name) {
+    if (Test->Filter && !strstr(Name, Test->Filter)) return false;
+    ClearArena(&Test->Arena);
+    Test->Name = Name;
+    if (Test->Output) {
+        fprintf(Test->Output, "%s\n", Name);
+        fflush(Test->Output);
+    }
+    Test->StartCycles = __rdtsc();
+    return true;
+}
+
+void EndTest(test_context* Test) {
+    uint64 Cycles = __rdtsc() - Test->StartCycles;
+    if (Test->Output) fprintf(Test->Output, "    OK, %.1f MCycles, %llu KB of arena.\n", Cycles / 1000000.0, Test->Arena.Used / 1024);
+    Test->nTests++;
+}
+
+#define RUN_TEST(Test, Call) if (BeginTest(Test, #Call)) { Call; EndTest(Test); }
 
 void TestRendering(render_group* Group, game_input* Input, float Time) {
 // 2D
@@ -69,3 +118,1563 @@ void TestRendering(render_group* Group, game_input* Input, float Time) {
     // Heightmap
     PushHeightmap(Group, Heightmap_Spain_ID, Shader_Pipeline_Heightmap_ID);
 }
+
+/*
+    Broadphase benchmark. Moves nEntities random spheres and capsules inside a box for nFrames, timing the sweep and the
+    narrowphase against the brute force O(n^2) loop. Both must find the same contacts.
+*/
+void TestBroadphase(test_context* Test, uint32 nEntities = 10000, uint32 nFrames = 60) {
+    TIMED_BLOCK;
+    memory_arena* Arena = &Test->Arena;
+    broadphase* Broadphase = AllocateBroadphase(Arena, nEntities, 64 * nEntities);
+
+    const float WorldSize = 500.0f;
+    collider* Colliders = PushArray(Arena, nEntities, collider);
+    v3* Positions = PushArray(Arena, nEntities, v3);
+    v3* Velocities = PushArray(Arena, nEntities, v3);
+    srand(1234);
+    for (int i = 0; i < nEntities; i++) {
+        if (i % 2 == 0) Colliders[i] = SphereCollider(V3(0,0,0), RandFloat(0.5f, 1.5f));
+        else            Colliders[i] = CapsuleCollider(V3(0,0,0), V3(0,RandFloat(1.0f, 3.0f),0), RandFloat(0.3f, 1.0f));
+        Positions[i] = V3(RandFloat(0, WorldSize), RandFloat(0, WorldSize / 10.0f), RandFloat(0, WorldSize));
+        Velocities[i] = V3(RandFloat(-10.0f, 10.0f), 0, RandFloat(-10.0f, 10.0f));
+    }
+
+    float dt = 1.0f / 60.0f;
+    uint64 BroadphaseCycles = 0, BruteForceCycles = 0;
+    uint32 TotalContacts = 0;
+    for (int Frame = 0; Frame < nFrames; Frame++) {
+        for (int i = 0; i < nEntities; i++) {
+            Positions[i] += dt * Velocities[i];
+            SetProxy(Broadphase, i, Transform(Positions[i]) * Colliders[i]);
+        }
+
+        uint64 Start = __rdtsc();
+        UpdateBroadphase(Broadphase);
+        uint32 nContacts = CollidePairs(Broadphase);
+        BroadphaseCycles += __rdtsc() - Start;
+        TotalContacts += nContacts;
+
+        // Brute force is too slow to run every frame
+        if (Frame == 0 || Frame == nFrames - 1) {
+            Start = __rdtsc();
+            uint32 nBruteContacts = 0;
+            for (int i = 0; i < nEntities; i++) {
+                collider A = Broadphase->Proxies[i].Collider;
+                for (int j = i + 1; j < nEntities; j++) {
+                    collider B = Broadphase->Proxies[j].Collider;
+                    if (Collide(A, B)) nBruteContacts++;
+                }
+            }
+            BruteForceCycles += __rdtsc() - Start;
+            Assert(nBruteContacts == nContacts, "Broadphase missed contacts.");
+        }
+    }
+
+    TestReport(
+        Test, "Broadphase: %u entities, %u frames, %.3f MCycles/frame, %.1f contacts/frame. Brute force: %.3f MCycles/frame.",
+        nEntities, nFrames,
+        BroadphaseCycles / (1000000.0f * nFrames), (float)TotalContacts / nFrames,
+        BruteForceCycles / (2.0f * 1000000.0f)
+    );
+}
+
+/*
+    Mesh raycasts through the BVH against brute force over every face: a bumpy grid with loose triangles floating above
+    it, and rays from above that hit it or point away. Packets have to match four single rays, misses included.
+*/
+void TestMeshRaycast(test_context* Test, uint32 Side = 32, uint32 nLoose = 256, uint32 nRays = 4096) {
+    TIMED_BLOCK;
+    memory_arena* Arena = &Test->Arena;
+    game_mesh Mesh = {};
+    Mesh.nVertices = Side * Side + 3 * nLoose;
+    Mesh.nFaces = 2 * (Side - 1) * (Side - 1) + nLoose;
+    float* Vertices = PushArray(Arena, 8 * Mesh.nVertices, float);
+    Mesh.Vertices = Vertices;
+    Mesh.Faces = PushArray(Arena, 3 * Mesh.nFaces, uint32);
+
+    srand(27);
+    for (uint32 Row = 0; Row < Side; Row++) {
+        for (uint32 Column = 0; Column < Side; Column++) {
+            float* Vertex = Vertices + 8 * (Row * Side + Column);
+            Vertex[0] = (float)Column;
+            Vertex[1] = sinf(0.5f * Column) * cosf(0.3f * Row) + RandFloat(-0.1f, 0.1f);
+            Vertex[2] = (float)Row;
+        }
+    }
+    uint32* Face = Mesh.Faces;
+    for (uint32 Row = 0; Row + 1 < Side; Row++) {
+        for (uint32 Column = 0; Column + 1 < Side; Column++) {
+            uint32 i = Row * Side + Column;
+            *Face++ = i; *Face++ = i + Side; *Face++ = i + 1;
+            *Face++ = i + 1; *Face++ = i + Side; *Face++ = i + Side + 1;
+        }
+    }
+    for (uint32 i = 0; i < nLoose; i++) {
+        v3 Center = V3(RandFloat(0, (float)Side), RandFloat(2.0f, 6.0f), RandFloat(0, (float)Side));
+        for (uint32 j = 0; j < 3; j++) {
+            uint32 Index = Side * Side + 3 * i + j;
+            float* Vertex = Vertices + 8 * Index;
+            Vertex[0] = Center.X + RandFloat(-1.0f, 1.0f);
+            Vertex[1] = Center.Y + RandFloat(-1.0f, 1.0f);
+            Vertex[2] = Center.Z + RandFloat(-1.0f, 1.0f);
+            *Face++ = Index;
+        }
+    }
+    BuildMeshBVH(Arena, &Mesh);
+
+    uint64 BVHCycles = 0, BruteForceCycles = 0, PacketCycles = 0;
+    uint32 nHits = 0;
+    ray Rays[4];
+    mesh_raycast_hit Hits[4];
+    for (uint32 r = 0; r < nRays; r++) {
+        ray Ray;
+        Ray.Point = V3(RandFloat(-2.0f, Side + 2.0f), 10.0f, RandFloat(-2.0f, Side + 2.0f));
+        Ray.Direction = normalize(V3(RandFloat(-0.5f, 0.5f), r % 8 == 0 ? 1.0f : -1.0f, RandFloat(-0.5f, 0.5f)));
+
+        uint64 Start = __rdtsc();
+        mesh_raycast_hit Hit = Raycast(&Mesh, Ray);
+        BVHCycles += __rdtsc() - Start;
+
+        Start = __rdtsc();
+        mesh_raycast_hit Expected = {};
+        Expected.Distance = FLT_MAX;
+        for (uint32 f = 0; f < Mesh.nFaces; f++) {
+            uint32* Indices = Mesh.Faces + 3 * f;
+            float* A = Vertices + 8 * Indices[0];
+            float* B = Vertices + 8 * Indices[1];
+            float* C = Vertices + 8 * Indices[2];
+            float t, u, v;
+            bool FaceHit = IntersectTriangle(Ray.Point, Ray.Direction, V3(A[0], A[1], A[2]), V3(B[0], B[1], B[2]), V3(C[0], C[1], C[2]), &t, &u, &v);
+            if (FaceHit && t < Expected.Distance) Expected = { true, f, t, u, v };
+        }
+        BruteForceCycles += __rdtsc() - Start;
+
+        Assert(Hit.Hit == Expected.Hit, "BVH raycast disagrees with brute force on hitting.");
+        if (Expected.Hit) {
+            nHits++;
+            Assert(Hit.Triangle == Expected.Triangle, "BVH raycast hit the wrong triangle.");
+            Assert(Hit.Distance == Expected.Distance && Hit.U == Expected.U && Hit.V == Expected.V, "BVH raycast hit is off.");
+        }
+
+        Rays[r % 4] = Ray;
+        if (r % 4 == 3) {
+            ray_packet Packet = RayPacket(Rays);
+            Start = __rdtsc();
+            Raycast(&Mesh, &Packet, Hits);
+            PacketCycles += __rdtsc() - Start;
+            for (int Lane = 0; Lane < 4; Lane++) {
+                mesh_raycast_hit Single = Raycast(&Mesh, Rays[Lane]);
+                Assert(Hits[Lane].Hit == Single.Hit, "Packet raycast disagrees with single rays on hitting.");
+                if (Single.Hit) {
+                    Assert(Hits[Lane].Triangle == Single.Triangle, "Packet raycast hit the wrong triangle.");
+                    Assert(fabsf(Hits[Lane].Distance - Single.Distance) < 1e-4f, "Packet raycast distance is off.");
+                    Assert(fabsf(Hits[Lane].U - Single.U) < 1e-4f && fabsf(Hits[Lane].V - Single.V) < 1e-4f, "Packet raycast barycentrics are off.");
+                }
+            }
+        }
+    }
+    Assert(nHits > 0 && nHits < nRays, "Mesh raycast test rays should both hit and miss.");
+
+    TestReport(
+        Test, "Mesh raycast: %u faces, %u BVH nodes, %u of %u rays hit. BVH %.0f, packets %.0f, brute force %.0f cycles per ray.",
+        Mesh.nFaces, Mesh.nBVHNodes, nHits, nRays,
+        (double)BVHCycles / nRays, (double)PacketCycles / nRays, (double)BruteForceCycles / nRays
+    );
+}
+
+/*
+    Radius, box and k-nearest queries on the spatial hash against brute force over the same points, before and after
+    moving every point once. Timings are cycles per query.
+*/
+void TestSpatialHash(test_context* Test, uint32 nEntities = 10000, uint32 nQueries = 1000) {
+    TIMED_BLOCK;
+    memory_arena* Arena = &Test->Arena;
+    spatial_hash* Hash = AllocateSpatialHash(Arena, nEntities, 4.0f, 2 * nEntities);
+
+    const float WorldSize = 10.0f * sqrtf((float)nEntities);
+    const uint32 K = 8;
+    v3* Positions = PushArray(Arena, nEntities, v3);
+    int* Results = PushArray(Arena, nEntities, int);
+    uint32* Stamps = PushArray(Arena, nEntities, uint32);
+    spatial_hash_neighbour Nearest[K], BruteNearest[K];
+
+    srand(4321);
+    uint64 Start = __rdtsc();
+    for (int i = 0; i < nEntities; i++) {
+        Positions[i] = V3(RandFloat(0, WorldSize), RandFloat(0, 10.0f), RandFloat(0, WorldSize));
+        Insert(Hash, i, Positions[i]);
+    }
+    uint64 InsertCycles = __rdtsc() - Start;
+
+    uint64 MoveCycles = 0, RadiusCycles = 0, BoxCycles = 0, NearestCycles = 0, BruteCycles = 0;
+    uint32 Stamp = 0, TotalFound = 0;
+    for (int Pass = 0; Pass < 2; Pass++) {
+        if (Pass == 1) {
+            Start = __rdtsc();
+            for (int i = 0; i < nEntities; i++) {
+                Positions[i] += V3(RandFloat(-2.0f, 2.0f), 0, RandFloat(-2.0f, 2.0f));
+                Move(Hash, i, Positions[i]);
+            }
+            MoveCycles = __rdtsc() - Start;
+        }
+
+        for (int q = 0; q < nQueries; q++) {
+            v3 Center = V3(RandFloat(0, WorldSize), RandFloat(0, 10.0f), RandFloat(0, WorldSize));
+            float Radius = RandFloat(1.0f, 15.0f);
+            aabb Box = { Center - V3(Radius, Radius, Radius), Center + V3(Radius, Radius, Radius) };
+
+            // Radius
+            Start = __rdtsc();
+            uint32 nFound = QueryRadius(Hash, Center, Radius, Results, nEntities);
+            RadiusCycles += __rdtsc() - Start;
+            TotalFound += nFound;
+
+            Stamp++;
+            for (int i = 0; i < nFound; i++) Stamps[Results[i]] = Stamp;
+            Start = __rdtsc();
+            uint32 nBrute = 0;
+            for (int i = 0; i < nEntities; i++) {
+                v3 D = Positions[i] - Center;
+                if (dot(D, D) <= Radius * Radius) {
+                    nBrute++;
+                    Assert(Stamps[i] == Stamp, "Spatial hash radius query missed an entity.");
+                }
+            }
+            BruteCycles += __rdtsc() - Start;
+            Assert(nBrute == nFound, "Spatial hash radius query returned extra entities.");
+
+            // Box
+            Start = __rdtsc();
+            nFound = QueryAABB(Hash, Box, Results, nEntities);
+            BoxCycles += __rdtsc() - Start;
+
+            Stamp++;
+            for (int i = 0; i < nFound; i++) Stamps[Results[i]] = Stamp;
+            nBrute = 0;
+            for (int i = 0; i < nEntities; i++) {
+                v3 P = Positions[i];
+                if (P.X >= Box.Min.X && P.X <= Box.Max.X &&
+                    P.Y >= Box.Min.Y && P.Y <= Box.Max.Y &&
+                    P.Z >= Box.Min.Z && P.Z <= Box.Max.Z) {
+                    nBrute++;
+                    Assert(Stamps[i] == Stamp, "Spatial hash box query missed an entity.");
+                }
+            }
+            Assert(nBrute == nFound, "Spatial hash box query returned extra entities.");
+
+            // K nearest
+            Start = __rdtsc();
+            uint32 nNearest = QueryNearest(Hash, Center, K, Nearest);
+            NearestCycles += __rdtsc() - Start;
+
+            uint32 nBruteNearest = 0;
+            for (int i = 0; i < nEntities; i++) {
+                v3 D = Positions[i] - Center;
+                InsertNeighbour(BruteNearest, &nBruteNearest, K, i, dot(D, D));
+            }
+            Assert(nNearest == nBruteNearest, "Spatial hash nearest query returned the wrong count.");
+            for (int i = 0; i < nNearest; i++) {
+                Assert(Nearest[i].SqDistance == BruteNearest[i].SqDistance, "Spatial hash nearest query is wrong.");
+            }
+        }
+    }
+
+    float nTotalQueries = 2.0f * nQueries;
+    TestReport(
+        Test, "Spatial hash: %u entities, %.1f found/query. Insert %.1f, move %.1f cycles/entity. "
+        "Radius %.0f, box %.0f, %u-nearest %.0f cycles/query. Brute force %.0f cycles/query.",
+        nEntities, TotalFound / nTotalQueries,
+        (float)InsertCycles / nEntities, (float)MoveCycles / nEntities,
+        RadiusCycles / nTotalQueries, BoxCycles / nTotalQueries, K, NearestCycles / nTotalQueries,
+        BruteCycles / nTotalQueries
+    );
+}
+
+/*
+    Swap-remove keeps the set packed and the ID mapping consistent, removed IDs stop resolving. Elements must keep their
+    address while the pool grows and other elements come and go.
+*/
+void TestSparseSet(test_context* Test) {
+    const uint32 MAX_IDS = 256;
+    typedef sparse_set<uint32> test_set;
+    memory_arena* Arena = &Test->Arena;
+    test_set* Set = PushStruct(Arena, test_set);
+    Set->Initialize(Arena, MAX_IDS);
+    bool Expected[MAX_IDS] = {};
+    uint32* Addresses[MAX_IDS] = {};
+    srand(99);
+    for (int Step = 0; Step < 10000; Step++) {
+        uint32 ID = rand() % MAX_IDS;
+        if (Expected[ID]) {
+            Set->Remove(ID);
+            Expected[ID] = false;
+        }
+        else if (Set->Count < 64 || Step > 5000) {
+            Addresses[ID] = Set->Insert(ID);
+            *Addresses[ID] = 3 * ID;
+            Expected[ID] = true;
+        }
+
+        uint32 nExpected = 0;
+        for (int i = 0; i < MAX_IDS; i++) {
+            Assert(Set->Contains(i) == Expected[i], "Sparse set membership is wrong.");
+            if (Expected[i]) nExpected++;
+        }
+        Assert(Set->Count == nExpected, "Sparse set count is wrong.");
+        for (int i = 0; i < Set->Count; i++) {
+            Assert((*Set)[i] == 3 * Set->IDs[i], "Sparse set element doesn't match its ID.");
+            Assert(Set->Get(Set->IDs[i]) == &(*Set)[i], "Sparse set mapping is wrong.");
+            Assert(Set->Get(Set->IDs[i]) == Addresses[Set->IDs[i]], "Sparse set element moved.");
+        }
+    }
+    Assert(Set->Pool.Capacity <= 2 * MAX_IDS, "Sparse set didn't reuse removed elements.");
+}
+
+/*
+    Crowd of enemies updated and collided serially and through the work queue, starting from the same state. Components
+    (including collided flags written from the command buffers) have to match bit for bit after every frame.
+*/
+void TestEntityJobs(test_context* Test, uint32 nEnemies = 4000, uint32 nFrames = 60) {
+    TIMED_BLOCK;
+    platform_api* Platform = Test->Platform;
+    int MaxEntities = nEnemies + 1;
+    memory_arena* Arena = &Test->Arena;
+    game_state* States[2];
+    entity_job_context Contexts[2];
+    for (int i = 0; i < 2; i++) {
+        game_state* State = PushStruct(Arena, game_state);
+        InitializeEntityState(&State->Entities, Arena, MaxEntities);
+        State->Broadphase = AllocateBroadphase(Arena, MaxEntities, 16 * MaxEntities);
+        State->Grid = AllocateSpatialHash(Arena, MaxEntities, 4.0f, 2 * MaxEntities);
+        AllocateCommandBuffers(Arena, State);
+        State->dt = 1.0 / 60.0;
+
+        prop* Target = AddProp(&State->Entities, Mesh_Sphere_ID, Shader_Pipeline_Sphere_ID);
+        srand(2024);
+        const float WorldSize = 400.0f;
+        for (int j = 0; j < nEnemies; j++) {
+            enemy* Enemy = AddEnemy(&State->Entities, V3(RandFloat(-WorldSize, WorldSize), 0, RandFloat(-WorldSize, WorldSize)) / 2.0f);
+            State->Entities.Components.Velocity[Enemy->Entity->ID] = V3(RandFloat(-5.0f, 5.0f), 0, RandFloat(-5.0f, 5.0f));
+        }
+
+        Contexts[i] = {};
+        Contexts[i].State = State;
+        Contexts[i].ControlledID = Target->Entity->ID;
+        States[i] = State;
+    }
+
+    uint64 Cycles[2] = {};
+    uint32 nContacts = 0;
+    uint32 MostCommands = 0;
+    for (int Frame = 0; Frame < nFrames; Frame++) {
+        for (int i = 0; i < 2; i++) {
+            platform_api* Queue = i == 0 ? NULL : Platform;
+            game_state* State = States[i];
+            uint64 Start = __rdtsc();
+            State->Time += State->dt;
+            IntegrateVelocities(&State->Entities, State->dt);
+            ParallelFor(Queue, State->Entities.Enemies.Count, 256, UpdateEnemies, &Contexts[i]);
+            UpdateWorldTransforms(&State->Entities);
+            ResolveCollisions(Queue, &Contexts[i]);
+            Cycles[i] += __rdtsc() - Start;
+        }
+
+        // Colliders aren't written by the update and may differ in padding, compare everything else
+        game_entity_components* A = &States[0]->Entities.Components;
+        game_entity_components* B = &States[1]->Entities.Components;
+        int nIDs = States[0]->Entities.nIDs;
+        bool Equal = States[1]->Entities.nIDs == nIDs &&
+                     memcmp(A->Translation, B->Translation, nIDs * sizeof(v3)) == 0 &&
+                     memcmp(A->Rotation, B->Rotation, nIDs * sizeof(quaternion)) == 0 &&
+                     memcmp(A->Scale, B->Scale, nIDs * sizeof(scale)) == 0 &&
+                     memcmp(A->Velocity, B->Velocity, nIDs * sizeof(v3)) == 0 &&
+                     memcmp(A->World, B->World, nIDs * sizeof(transform)) == 0 &&
+                     memcmp(A->Collided, B->Collided, nIDs * sizeof(bool)) == 0;
+        Assert(Equal, "Parallel entity update differs from the serial one.");
+        Assert(States[0]->Commands.nCommands == States[1]->Commands.nCommands, "Parallel commands differ from the serial ones.");
+        MostCommands = max(MostCommands, States[0]->Commands.nCommands);
+        for (int j = 0; j < nIDs; j++) {
+            if (States[0]->Entities.Components.Collided[j]) nContacts++;
+        }
+    }
+
+    // Queries gather handles in the arena and give it back. Filtered by type they have to find every enemy in range.
+    game_entity_state* Entities = &States[0]->Entities;
+    UpdateSpatialHash(States[0]->Grid, Entities);
+    game_entity** Found = PushArray(Arena, nEnemies, game_entity*);
+    v3 Center = V3(0, 0, 0);
+    float Radius = 60.0f;
+    uint32 nInRange = 0;
+    for (int i = 0; i < Entities->Enemies.Count; i++) {
+        v3 D = Entities->Components.World[Entities->Enemies.IDs[i]].Translation - Center;
+        if (dot(D, D) <= Radius * Radius) nInRange++;
+    }
+    memory_index Used = Arena->Used;
+    uint32 nFound = QueryEntities(Arena, States[0]->Grid, Entities, Center, Radius, Found, nEnemies, Entity_Type_Enemy);
+    Assert(nFound == nInRange && nInRange > 4 && Arena->Used == Used, "Entity query missed enemies in range.");
+    for (int i = 0; i < nFound; i++) Assert(Found[i]->Type == Entity_Type_Enemy, "Entity query returned the wrong type.");
+    Assert(QueryEntities(Arena, States[0]->Grid, Entities, Center, Radius, Found, 4) == 4, "Entity query ignored its limit.");
+
+    TestReport(
+        Test, "Entity jobs: %u enemies, %u frames, %u threads, %.1f colliding/frame, up to %u commands. Serial %.3f, parallel %.3f MCycles/frame.",
+        nEnemies, nFrames, Platform ? Platform->nThreads : 1, (float)nContacts / nFrames, MostCommands,
+        Cycles[0] / (1000000.0f * nFrames), Cycles[1] / (1000000.0f * nFrames)
+    );
+}
+
+/*
+    Chain of parented props over a crowd of static enemies. Cached world transforms must match composing local transforms
+    up the chain, a frame where nothing moved must recompute nothing, and moving the root must only recompute the chain.
+*/
+void TestTransformHierarchy(test_context* Test, uint32 nStatic = 4000, uint32 nChain = 8) {
+    TIMED_BLOCK;
+    Assert(nChain < MAX_HIERARCHY_DEPTH);
+    memory_arena* Arena = &Test->Arena;
+    game_entity_state* State = PushStruct(Arena, game_entity_state);
+    InitializeEntityState(State, Arena, nStatic + nChain);
+    game_entity_components* Components = &State->Components;
+
+    srand(2024);
+    for (int i = 0; i < nStatic; i++) {
+        AddEnemy(State, V3(RandFloat(-200.0f, 200.0f), 0, RandFloat(-200.0f, 200.0f)));
+    }
+    int Chain[MAX_HIERARCHY_DEPTH];
+    for (int i = 0; i < nChain; i++) {
+        quaternion Rotation = Quaternion(RandFloat(0, Tau), V3(0,1,0));
+        prop* Prop = AddProp(State, Mesh_Sphere_ID, Shader_Pipeline_Sphere_ID, White, V3(0,1,2), Rotation);
+        Chain[i] = Prop->Entity->ID;
+        if (i > 0) SetParent(State, Chain[i], Chain[i-1]);
+    }
+
+    int nUpdated = UpdateWorldTransforms(State);
+    Assert(nUpdated == nStatic + nChain, "First update must compute every world transform.");
+    nUpdated = UpdateWorldTransforms(State);
+    Assert(nUpdated == 0, "Static entities recomputed their world transform.");
+
+    transform Root = GetTransform(State, Chain[0]);
+    Root.Translation += V3(1,0,0);
+    SetTransform(State, Chain[0], Root);
+    nUpdated = UpdateWorldTransforms(State);
+    Assert(nUpdated == nChain, "Moving the root must recompute exactly its descendants.");
+
+    for (int i = 0; i < nChain; i++) {
+        int ID = Chain[i];
+        transform Expected = GetTransform(State, ID);
+        for (int Parent = Components->Parent[ID]; Parent >= 0; Parent = Components->Parent[Parent]) {
+            Expected = Expected * GetTransform(State, Parent);
+        }
+        Assert(modulus(Expected.Translation - Components->World[ID].Translation) < 1e-4f, "Cached world transform is wrong.");
+    }
+
+    // Cost of a frame where nothing moved against one where everything did
+    const int nFrames = 60;
+    uint64 Start = __rdtsc();
+    for (int Frame = 0; Frame < nFrames; Frame++) UpdateWorldTransforms(State);
+    uint64 StaticCycles = __rdtsc() - Start;
+    Start = __rdtsc();
+    for (int Frame = 0; Frame < nFrames; Frame++) {
+        for (int i = 0; i < State->nIDs; i++) Components->Dirty[i] = true;
+        UpdateWorldTransforms(State);
+    }
+    uint64 MovingCycles = __rdtsc() - Start;
+
+    TestReport(
+        Test, "Transform hierarchy: %u entities. Static %.3f, all moving %.3f MCycles/frame.",
+        nStatic + nChain, StaticCycles / (1000000.0f * nFrames), MovingCycles / (1000000.0f * nFrames)
+    );
+}
+
+/*
+    Frame times against a 30 Hz tick: ticks run must add up to the time simulated, Alpha must stay in [0, 1) and a
+    long stall must be capped at MaxTicksPerFrame.
+*/
+void TestFixedTimestep(test_context* Test) {
+    fixed_timestep Step = {};
+    SetTickRate(&Step, 30.0f, 4);
+
+    srand(2024);
+    uint64 nTicks = 0;
+    double FrameTime = 0;
+    for (int Frame = 0; Frame < 1000; Frame++) {
+        double FrameDt = RandFloat(1.0f / 240.0f, 1.0f / 20.0f);
+        FrameTime += FrameDt;
+        nTicks += AccumulateTicks(&Step, FrameDt);
+        Assert(Step.Alpha >= 0.0f && Step.Alpha < 1.0f, "Interpolation factor out of range.");
+    }
+    Assert(fabs(nTicks * Step.TickDt + Step.Accumulator - FrameTime) < 1e-6, "Fixed timestep lost time.");
+    Assert(Step.DroppedTicks == 0, "Fixed timestep dropped ticks without a stall.");
+
+    uint32 StallTicks = AccumulateTicks(&Step, 2.0);
+    Assert(StallTicks == 4 && Step.DroppedTicks > 0, "Spiral of death guard didn't cap the ticks.");
+
+    TestReport(Test, "Fixed timestep: %llu ticks over %.2f s, %llu dropped after a 2 s stall.", nTicks, FrameTime, Step.DroppedTicks);
+}
+
+/*
+    Interning gives one ID per distinct string, and the name index has to follow entities as they are added and removed.
+    Lookup by name is timed against the strcmp scan it replaces.
+*/
+void TestEntityNames(test_context* Test, uint32 nEnemies = 4000) {
+    memory_arena* Arena = &Test->Arena;
+    game_entity_state* State = PushStruct(Arena, game_entity_state);
+    InitializeEntityState(State, Arena, nEnemies);
+
+    string_table* Names = State->Names;
+    string_id Foo = Intern(Names, "Foo");
+    Assert(Foo != 0 && Intern(Names, "Foo") == Foo && Intern(Names, "Bar") != Foo, "Interning is wrong.");
+    Assert(FindString(Names, "Baz") == 0 && strcmp(GetString(Names, Foo), "Foo") == 0, "String lookup is wrong.");
+
+    // A table filled up to MaxStrings has to give every name back
+    const uint32 MaxStrings = 1000;
+    string_table* Full = AllocateStringTable(Arena, MaxStrings, 16 * MaxStrings);
+    char Name[32];
+    for (uint32 i = 0; i < MaxStrings; i++) {
+        sprintf_s(Name, "Name %u", i);
+        Assert(Intern(Full, Name) == i + 1, "Interning gave an unexpected ID.");
+    }
+    for (uint32 i = 0; i < MaxStrings; i++) {
+        sprintf_s(Name, "Name %u", i);
+        Assert(FindString(Full, Name) == i + 1 && strcmp(GetString(Full, i + 1), Name) == 0, "Full string table lost a name.");
+    }
+
+    for (int i = 0; i < nEnemies; i++) {
+        AddEnemy(State, V3(0,0,0));
+    }
+    for (int i = 0; i < nEnemies; i += 2) {
+        State->Components.Active[i] = false;
+        RemoveEntity(State, i);
+    }
+
+    char Buffer[256];
+    for (int i = 0; i < nEnemies; i++) {
+        sprintf_s(Buffer, "Enemy %d", i);
+        game_entity* Entity = FindEntity(State, Buffer);
+        Assert((Entity != NULL) == (i % 2 == 1), "Name index is out of date.");
+        Assert(!Entity || strcmp(GetName(State, Entity), Buffer) == 0, "Name index found the wrong entity.");
+    }
+
+    // Every name looked up once, through the index and by scanning
+    uint64 Start = __rdtsc();
+    uint32 nFound = 0;
+    for (int i = 0; i < nEnemies; i++) {
+        sprintf_s(Buffer, "Enemy %d", i);
+        if (FindEntity(State, Buffer)) nFound++;
+    }
+    uint64 IndexCycles = __rdtsc() - Start;
+    Start = __rdtsc();
+    uint32 nScanned = 0;
+    for (int i = 0; i < nEnemies; i++) {
+        sprintf_s(Buffer, "Enemy %d", i);
+        for (int j = 0; j < State->Enemies.Count; j++) {
+            if (strcmp(GetName(State, State->Enemies[j].Entity), Buffer) == 0) {
+                nScanned++;
+                break;
+            }
+        }
+    }
+    uint64 ScanCycles = __rdtsc() - Start;
+    Assert(nFound == nScanned, "Name index and scan disagree.");
+
+    TestReport(
+        Test, "Entity names: %u lookups, %u strings. Index %.3f, scan %.3f MCycles. game_entity is %u bytes.",
+        nEnemies, Names->nStrings, IndexCycles / 1000000.0f, ScanCycles / 1000000.0f, (uint32)sizeof(game_entity)
+    );
+}
+
+/*
+    Snapshot of a world without characters (those need assets), some entities moved, one removed and one added, then a
+    second snapshot. The delta against the first has to rebuild the second exactly, and reading the second into an empty
+    state has to give back the same entities in the same dense order.
+*/
+void TestSnapshots(test_context* Test, uint32 nEnemies = 2000, uint32 nProps = 200, uint32 nWeapons = 200) {
+    // Room for the entity added after the removal, and for the removed one's ID on the free list
+    int MaxEntities = nEnemies + nProps + nWeapons + 1;
+    memory_arena* Arena = &Test->Arena;
+    game_state* State = PushStruct(Arena, game_state);
+    game_state* Restored = PushStruct(Arena, game_state);
+    InitializeEntityState(&State->Entities, Arena, MaxEntities);
+    InitializeEntityState(&Restored->Entities, Arena, MaxEntities);
+    game_entity_state* Entities = &State->Entities;
+    uint8* Base = (uint8*)PushSize(Arena, MAX_SNAPSHOT_SIZE);
+    uint8* Snapshot = (uint8*)PushSize(Arena, MAX_SNAPSHOT_SIZE);
+    uint8* Delta = (uint8*)PushSize(Arena, MAX_SNAPSHOT_SIZE);
+    uint8* Decoded = (uint8*)PushSize(Arena, MAX_SNAPSHOT_SIZE);
+
+    srand(2024);
+    SetTickRate(&State->Step, DEFAULT_TICK_RATE);
+    for (int i = 0; i < nEnemies; i++) {
+        AddEnemy(Entities, V3(RandFloat(-200.0f, 200.0f), 0, RandFloat(-200.0f, 200.0f)));
+    }
+    for (int i = 0; i < nProps; i++) {
+        AddProp(Entities, Mesh_Sphere_ID, Shader_Pipeline_Sphere_ID, White, V3(RandFloat(-200.0f, 200.0f), 0, 0));
+    }
+    for (int i = 0; i < nWeapons; i++) {
+        weapon* Weapon = AddWeapon(Entities, i % 2 == 0 ? Weapon_Sword : Weapon_Shield);
+        SetParent(Entities, Weapon->Entity->ID, Entities->Props.IDs[i % nProps]);
+    }
+    UpdateWorldTransforms(Entities);
+    uint32 BaseSize = WriteSnapshot(State, Base, MAX_SNAPSHOT_SIZE);
+    Assert(BaseSize > 0, "Snapshot didn't fit.");
+
+    // One tick worth of changes
+    for (int i = 0; i < Entities->Enemies.Count; i += 10) {
+        Entities->Components.Velocity[Entities->Enemies.IDs[i]] = V3(1,0,0);
+    }
+    IntegrateVelocities(Entities, 1.0f / DEFAULT_TICK_RATE);
+    int Removed = Entities->Enemies.IDs[0];
+    Entities->Components.Active[Removed] = false;
+    RemoveEntity(Entities, Removed);
+    AddEnemy(Entities, V3(0,0,0));
+    State->Time += 1.0f / DEFAULT_TICK_RATE;
+    UpdateWorldTransforms(Entities);
+
+    uint64 Start = __rdtsc();
+    uint32 Size = WriteSnapshot(State, Snapshot, MAX_SNAPSHOT_SIZE);
+    uint64 WriteCycles = __rdtsc() - Start;
+    Start = __rdtsc();
+    uint32 DeltaSize = EncodeSnapshotDelta(Base, BaseSize, Snapshot, Size, Delta, MAX_SNAPSHOT_SIZE);
+    uint64 EncodeCycles = __rdtsc() - Start;
+    Start = __rdtsc();
+    uint32 DecodedSize = DecodeSnapshotDelta(Base, BaseSize, Delta, DeltaSize, Decoded, MAX_SNAPSHOT_SIZE);
+    uint64 DecodeCycles = __rdtsc() - Start;
+    Assert(DeltaSize > 0 && DeltaSize < Size, "Snapshot delta is not smaller than the snapshot.");
+    Assert(DecodedSize == Size && memcmp(Decoded, Snapshot, Size) == 0, "Snapshot delta didn't rebuild the snapshot.");
+
+    Start = __rdtsc();
+    bool Read = ReadSnapshot(Restored, NULL, Decoded, DecodedSize);
+    uint64 ReadCycles = __rdtsc() - Start;
+    Assert(Read, "Snapshot was rejected.");
+
+    game_entity_state* Copy = &Restored->Entities;
+    Assert(Copy->Entities.Count == Entities->Entities.Count && Copy->Entities.nFreeIDs == Entities->Entities.nFreeIDs);
+    Assert(Copy->Enemies.Count == Entities->Enemies.Count && Copy->Weapons.Count == Entities->Weapons.Count);
+    for (int i = 0; i < Entities->Enemies.Count; i++) {
+        Assert(Copy->Enemies.IDs[i] == Entities->Enemies.IDs[i], "Snapshot changed the dense order.");
+    }
+    for (int ID = 0; ID < MaxEntities; ID++) {
+        Assert(Copy->Generations[ID] == Entities->Generations[ID], "Snapshot lost a generation.");
+        Assert(Copy->Components.Parent[ID] == Entities->Components.Parent[ID], "Snapshot lost a parent.");
+        Assert(modulus(Copy->Components.Translation[ID] - Entities->Components.Translation[ID]) == 0.0f);
+        Assert(modulus(Copy->Components.Velocity[ID] - Entities->Components.Velocity[ID]) == 0.0f);
+        Assert(modulus(Copy->Components.World[ID].Translation - Entities->Components.World[ID].Translation) < 1e-4f);
+    }
+    Assert(Restored->Time == State->Time && Restored->Step.TickDt == State->Step.TickDt);
+
+    TestReport(
+        Test, "Snapshots: %u entities, %u bytes, delta %u bytes. Write %.3f, read %.3f, encode %.3f, decode %.3f MCycles.",
+        Entities->Entities.Count, Size, DeltaSize, WriteCycles / 1000000.0f, ReadCycles / 1000000.0f,
+        EncodeCycles / 1000000.0f, DecodeCycles / 1000000.0f
+    );
+}
+
+/*
+    A baked animation with a bone that stays at identity, a still bone, a bone moving at constant speed and bones
+    swinging at different rates. After compression every baked frame has to come back within tolerance, the SSE
+    sampler has to match the per bone one, and the animator has to reach the same pose whatever the tick rate. Palettes
+    evaluated by the animation system have to match the matrices built one bone at a time.
+*/
+void TestAnimation(test_context* Test, uint32 nFrames = 241, uint32 nBones = MAX_ARMATURE_BONES, uint32 nAnimators = 64) {
+    Assert(nBones >= 4 && nBones <= MAX_ARMATURE_BONES);
+    const float FramesPerSecond = 60.0f;
+    memory_arena* Arena = &Test->Arena;
+    transform* Frames = PushArray(Arena, nFrames * nBones, transform);
+    bool* Keep = PushArray(Arena, nFrames * nBones * animation_channel_count, bool);
+
+    for (uint32 Frame = 0; Frame < nFrames; Frame++) {
+        float Time = Frame / FramesPerSecond;
+        Frames[Frame * nBones] = IdentityTransform;
+        Frames[Frame * nBones + 1] = Transform(V3(0, 1, 0));
+        Frames[Frame * nBones + 2] = Transform(V3(Time, 0, 0));
+        for (uint32 Bone = 3; Bone < nBones; Bone++) {
+            float Angle = 0.5f * sinf(0.25f * Bone * Time);
+            Frames[Frame * nBones + Bone] = Transform(V3(0, 0.1f * Angle, 0), Quaternion(Angle, V3(1, 0, 0)), Scale(1.0f + 0.2f * Angle, 1, 1));
+        }
+    }
+
+    game_animation Animation = {};
+    InitializeAnimation(&Animation, Frames, nFrames, nBones, FramesPerSecond);
+    uint32 nKeys = DecimateAnimation(&Animation, Frames, Keep);
+    WriteAnimation(Arena, &Animation, Frames, Keep);
+    for (int Channel = 0; Channel < animation_channel_count; Channel++) {
+        Assert(Animation.Tracks[Channel].nKeys == 0, "Identity channel kept keys.");
+    }
+    Assert(Animation.Tracks[animation_channel_count + Animation_Channel_Translation].nKeys == 1, "Constant channel kept keys.");
+    Assert(Animation.Tracks[2 * animation_channel_count + Animation_Channel_Translation].nKeys == 2, "Linear channel kept keys.");
+
+    animation_error Error = MeasureAnimationError(&Animation, Frames);
+    Assert(Error.Translation <= 1.05f * ANIMATION_TRANSLATION_TOLERANCE, "Compressed translation is off.");
+    Assert(Error.Rotation <= 1.05f * ANIMATION_ROTATION_TOLERANCE, "Compressed rotation is off.");
+    Assert(Error.Scale <= 1.05f * ANIMATION_SCALE_TOLERANCE, "Compressed scale is off.");
+
+    // Wide sampler against the per bone one, anywhere in the clip
+    armature Armature = {};
+    Armature.nBones = nBones;
+    srand(2024);
+    uint64 WideCycles = 0, ScalarCycles = 0;
+    for (int i = 0; i < 1000; i++) {
+        float Time = RandFloat(-0.1f, Animation.Duration + 0.1f);
+        uint64 Start = __rdtsc();
+        Sample(&Animation, Time, &Armature);
+        WideCycles += __rdtsc() - Start;
+
+        Start = __rdtsc();
+        for (uint32 Bone = 0; Bone < nBones; Bone++) {
+            transform T = Sample(&Animation, Bone, Time);
+            transform W = Armature.Bones[Bone].Transform;
+            Assert(modulus(T.Translation - W.Translation) < 1e-4f && fabsf(dot(T.Rotation, W.Rotation)) > 0.99999f, "Wide sampler is off.");
+            Assert(fabsf(T.Scale.X - W.Scale.X) + fabsf(T.Scale.Y - W.Scale.Y) + fabsf(T.Scale.Z - W.Scale.Z) < 1e-4f, "Wide sampler is off.");
+        }
+        ScalarCycles += __rdtsc() - Start;
+    }
+
+    // One second of playback at different tick rates
+    float TickRates[3] = { 30.0f, 60.0f, 144.0f };
+    armature Armatures[3] = {};
+    for (int i = 0; i < 3; i++) {
+        Armatures[i].nBones = nBones;
+        game_animator Animator = { &Animation, &Armatures[i], NULL, 0.0f, true, true };
+        for (int Tick = 0; Tick < (int)TickRates[i]; Tick++) Update(&Animator, 1.0f / TickRates[i]);
+        Assert(fabsf(Animator.Time - 1.0f) < 1e-4f, "Animator time depends on the tick rate.");
+        Sample(&Animation, Animator.Time, &Armatures[i]);
+    }
+    for (uint32 Bone = 0; Bone < nBones; Bone++) {
+        transform A = Armatures[0].Bones[Bone].Transform;
+        transform B = Armatures[2].Bones[Bone].Transform;
+        Assert(modulus(A.Translation - B.Translation) < 1e-3f && fabsf(dot(A.Rotation, B.Rotation)) > 0.9999f, "Pose depends on the tick rate.");
+    }
+
+    // A batch of animators at different times, evaluated by the animation system
+    animation_system* System = AllocateAnimationSystem(Arena, nAnimators);
+    game_animator* Animators = PushArray(Arena, nAnimators, game_animator);
+    armature* Poses = PushArray(Arena, nAnimators, armature);
+    for (uint32 i = 0; i < nAnimators; i++) {
+        Poses[i] = {};
+        Poses[i].nBones = nBones;
+        // Inactive ones go to the rest pose, which has to be invertible for the normal matrices
+        for (uint32 Bone = 0; Bone < nBones; Bone++) Poses[i].Bones[Bone].Rest = IdentityTransform;
+        Animators[i] = { &Animation, &Poses[i], NULL, RandFloat(0, Animation.Duration), i % 8 != 0, true };
+        PushAnimator(System, &Animators[i]);
+    }
+    uint64 Start = __rdtsc();
+    UpdateAnimators(NULL, System, 1.0f / FramesPerSecond);
+    uint64 PaletteCycles = __rdtsc() - Start;
+    for (uint32 i = 0; i < nAnimators; i++) {
+        bone_palette* Palette = &System->Palettes[i];
+        Assert(Animators[i].Palette == Palette && Palette->n_bones == nBones, "Animator wasn't given its palette.");
+        for (uint32 Bone = 0; Bone < nBones; Bone++) {
+            matrix4 M = Matrix(Poses[i].Bones[Bone].Transform);
+            matrix4 N = Matrix4(inverse(Matrix3(M)));
+            for (int k = 0; k < 16; k++) {
+                Assert(fabsf(M.Array[k] - Palette->bone_transforms[Bone].Array[k]) < 1e-4f, "Bone palette is off.");
+                Assert(fabsf(N.Array[k] - Palette->bone_normal_transforms[Bone].Array[k]) < 1e-3f, "Bone normal palette is off.");
+            }
+        }
+    }
+
+    TestReport(
+        Test, "Animation: %u keys for %u baked frames, %.1f:1, max error %.5f units and %.3f degrees. Cycles per bone: %.1f wide, %.1f one bone at a time, %.1f into palettes.",
+        nKeys, nFrames * nBones, (double)(nFrames * nBones * sizeof(transform)) / GetAnimationSize(nBones, nKeys),
+        Error.Translation, Error.Rotation / Degrees, (double)WideCycles / (1000 * nBones), (double)ScalarCycles / (1000 * nBones),
+        (double)PaletteCycles / (nAnimators * nBones)
+    );
+}
+
+/*
+    A branching armature with a bind pose animated in parent space. Palettes have to match composing the hierarchy one
+    transform at a time, skinning a bone head has to land where its bone is, and the rest pose has to leave the mesh
+    as it is.
+*/
+void TestBoneHierarchy(test_context* Test, uint32 nFrames = 61) {
+    const uint32 nBones = 6;
+    const int Parents[nBones] = { -1, 0, 1, 1, 3, 0 };
+    const float FramesPerSecond = 30.0f;
+    memory_arena* Arena = &Test->Arena;
+
+    armature Armature = {};
+    Armature.nBones = nBones;
+    Armature.HasBindPose = true;
+    transform Bind[nBones];
+    for (uint32 i = 0; i < nBones; i++) {
+        bone* Bone = &Armature.Bones[i];
+        Bone->ID = i;
+        Bone->Parent = Parents[i];
+        Bone->Segment.Head = V3(0.3f * i, 1.0f + 0.5f * i, 0.1f * i);
+        Bone->Segment.Tail = Bone->Segment.Head + V3(0, 0.5f, 0);
+        Bind[i] = Transform(Bone->Segment.Head, Quaternion(0.2f * i, V3(1, 0, 1)));
+    }
+    SetBindPose(&Armature, Bind);
+    Assert(Armature.LeafBones == ((1 << 2) | (1 << 4) | (1 << 5)), "Leaf bones are off.");
+
+    transform* Frames = PushArray(Arena, nFrames * nBones, transform);
+    bool* Keep = PushArray(Arena, nFrames * nBones * animation_channel_count, bool);
+    for (uint32 Frame = 0; Frame < nFrames; Frame++) {
+        float Angle = 0.6f * sinf(Tau * Frame / (nFrames - 1));
+        for (uint32 i = 0; i < nBones; i++) {
+            transform Motion = Transform(V3(0, 0.05f * Angle, 0), Quaternion(Angle, V3(0, 0, 1)), Scale(1.2f, 1.2f, 1.2f));
+            Frames[Frame * nBones + i] = Motion * Armature.Bones[i].Rest;
+        }
+    }
+    game_animation Animation = {};
+    InitializeAnimation(&Animation, Frames, nFrames, nBones, FramesPerSecond);
+    Animation.Local = true;
+    uint32 nKeys = DecimateAnimation(&Animation, Frames, Keep);
+    WriteAnimation(Arena, &Animation, Frames, Keep);
+
+    bone_palette PaletteStorage = {};
+    bone_palette* Palette = &PaletteStorage;
+    game_animator Animator = { &Animation, &Armature, Palette, 0.0f, true, true };
+    uint64 Cycles = 0;
+    for (int Tick = 0; Tick < 2 * nFrames; Tick++) {
+        uint64 Start = __rdtsc();
+        Update(&Animator, 0.5f / FramesPerSecond);
+        Cycles += __rdtsc() - Start;
+
+        // Model transforms from the sampled local ones, parents first
+        transform Model[nBones];
+        for (uint32 i = 0; i < nBones; i++) {
+            bone* Bone = &Armature.Bones[i];
+            Model[i] = Bone->Parent >= 0 ? Bone->Transform * Model[Bone->Parent] : Bone->Transform;
+            matrix4 Skin = Matrix(inverse(Bind[i]) * Model[i]);
+            matrix4 Normal = Matrix4(inverse(Matrix3(Skin)));
+            for (int k = 0; k < 16; k++) {
+                Assert(fabsf(Skin.Array[k] - Palette->bone_transforms[i].Array[k]) < 1e-4f, "Composed palette is off.");
+                Assert(fabsf(Normal.Array[k] - Palette->bone_normal_transforms[i].Array[k]) < 1e-4f, "Composed normal palette is off.");
+            }
+            Assert(modulus(SkinPoint(Palette, i, Bone->Segment.Head) - Model[i].Translation) < 1e-4f, "Skinned bone head is off.");
+
+            transform Attached = GetBoneTransform(Palette, i);
+            matrix4 Rebuilt = Matrix(Attached);
+            for (int k = 0; k < 16; k++) {
+                Assert(fabsf(Skin.Array[k] - Rebuilt.Array[k]) < 1e-4f, "Bone transform doesn't rebuild the palette.");
+            }
+        }
+    }
+
+    // Rest pose
+    for (uint32 i = 0; i < nBones; i++) {
+        Palette->bone_transforms[i] = Matrix(Armature.Bones[i].Rest);
+    }
+    ComposePalette(&Armature, Palette);
+    for (uint32 i = 0; i < nBones; i++) {
+        for (int k = 0; k < 16; k++) {
+            Assert(fabsf(Palette->bone_transforms[i].Array[k] - Identity4.Array[k]) < 1e-5f, "Rest pose moves the mesh.");
+        }
+    }
+
+    TestReport(Test, "Bone hierarchy: %u keys, %.1f cycles per bone sampled and composed.", nKeys, (double)Cycles / (2 * nFrames * nBones));
+}
+
+/*
+    Animators near, mid distance, far and out of view. Reduced rate palettes have to land on the exact pose every
+    interval, far armatures have to keep their leaf bones at rest, and with a tight budget no more poses than it allows
+    may be evaluated.
+*/
+void TestAnimationLOD(test_context* Test, uint32 nTicks = 64) {
+    const uint32 nBones = 4;
+    const int Parents[nBones] = { -1, 0, 1, 1 };
+    const uint32 nFrames = 61;
+    const uint32 nAnimators = 12;
+    const float FramesPerSecond = 30.0f;
+    const float dt = 1.0f / 60.0f;
+    memory_arena* Arena = &Test->Arena;
+
+    armature Armature = {};
+    Armature.nBones = nBones;
+    Armature.HasBindPose = true;
+    transform Bind[nBones];
+    for (uint32 i = 0; i < nBones; i++) {
+        Armature.Bones[i].ID = i;
+        Armature.Bones[i].Parent = Parents[i];
+        Bind[i] = Transform(V3(0, 1.0f + 0.5f * i, 0.2f * i), Quaternion(0.3f * i, V3(0, 1, 0)));
+    }
+    SetBindPose(&Armature, Bind);
+
+    transform* Frames = PushArray(Arena, nFrames * nBones, transform);
+    bool* Keep = PushArray(Arena, nFrames * nBones * animation_channel_count, bool);
+    for (uint32 Frame = 0; Frame < nFrames; Frame++) {
+        float Angle = 0.8f * sinf(Tau * Frame / (nFrames - 1));
+        for (uint32 i = 0; i < nBones; i++) {
+            Frames[Frame * nBones + i] = Transform(V3(0, 0.1f * Angle, 0), Quaternion(Angle, V3(1, 0, 0))) * Armature.Bones[i].Rest;
+        }
+    }
+    game_animation Animation = {};
+    InitializeAnimation(&Animation, Frames, nFrames, nBones, FramesPerSecond);
+    Animation.Local = true;
+    DecimateAnimation(&Animation, Frames, Keep);
+    WriteAnimation(Arena, &Animation, Frames, Keep);
+
+    // Near, mid distance, far and out of view
+    const float Distances[4] = { 5.0f, 40.0f, 100.0f, 5.0f };
+    animation_system* System = AllocateAnimationSystem(Arena, nAnimators);
+    System->Settings = DEFAULT_ANIMATION_LOD;
+    System->Settings.LeafDistance = 90.0f;
+    game_animator* Animators = PushArray(Arena, nAnimators, game_animator);
+    armature* Poses = PushArray(Arena, 2 * nAnimators, armature);
+    memory_index Reference = (memory_index)PushSize(Arena, sizeof(bone_palette) + 15);
+    bone_palette* Expected = (bone_palette*)((Reference + 15) & ~(memory_index)15);
+    srand(2024);
+    for (uint32 i = 0; i < nAnimators; i++) {
+        Poses[i] = Armature;
+        Poses[nAnimators + i] = Armature;
+        Animators[i] = { &Animation, &Poses[i], NULL, RandFloat(0, Animation.Duration), true, true };
+    }
+
+    uint32 nEvaluations = 0;
+    uint64 Cycles = 0;
+    for (uint32 Tick = 0; Tick < 2 * nTicks; Tick++) {
+        // Second half on a budget tighter than the full rate animators alone
+        bool Budgeted = Tick >= nTicks;
+        System->Settings.MaxEvaluations = Budgeted ? 2 : DEFAULT_ANIMATION_LOD.MaxEvaluations;
+
+        float Times[nAnimators];
+        ClearAnimators(System);
+        for (uint32 i = 0; i < nAnimators; i++) {
+            Times[i] = Animators[i].Time;
+            PushAnimator(System, &Animators[i], Distances[i % 4], i % 4 != 3);
+        }
+        uint64 Start = __rdtsc();
+        UpdateAnimators(NULL, System, dt);
+        Cycles += __rdtsc() - Start;
+
+        animation_lod_stats Stats = System->Stats;
+        nEvaluations += Stats.nEvaluations;
+        Assert(Stats.nFull == 3 && Stats.nReduced == 6 && Stats.nCulled == 3 && Stats.nLeafDropped == 3, "LOD counts are off.");
+        if (Tick > 0 && Budgeted) {
+            Assert(Stats.nEvaluations <= 2, "Evaluations over the budget.");
+            Assert(Stats.nSkipped >= 1, "Over budget animators weren't skipped.");
+        }
+
+        for (uint32 i = 0; i < nAnimators; i++) {
+            game_animator* Animator = &Animators[i];
+            animator_lod* LOD = &System->LODs[i];
+            Assert((i % 4 == 2) == (LOD->SkipBones != 0), "Leaf bones dropped at the wrong distance.");
+            for (uint32 Bone = 0; Bone < nBones; Bone++) {
+                if (LOD->SkipBones & (1 << Bone)) {
+                    Assert(Animator->Armature->Bones[Bone].Transform == Armature.Bones[Bone].Rest, "Dropped leaf bone was sampled.");
+                }
+            }
+
+            // Exact after a full rate evaluation, or when a reduced rate palette reaches its target
+            if (LOD->Skip || (Animator->Interval > 1 && Animator->Countdown != Animator->Interval)) continue;
+            Sample(&Animation, Times[i], &Poses[nAnimators + i], Expected, LOD->SkipBones);
+            for (uint32 Bone = 0; Bone < nBones; Bone++) {
+                for (int k = 0; k < 16; k++) {
+                    float Error = fabsf(Expected->bone_transforms[Bone].Array[k] - Animator->Palette->bone_transforms[Bone].Array[k]);
+                    Assert(Error < 1e-3f, "Reduced rate palette misses the pose.");
+                }
+            }
+        }
+    }
+
+    TestReport(Test, "Animation LOD: %.2f evaluations per animator and tick, %.1f cycles per animator.", (double)nEvaluations / (2 * nTicks * nAnimators), (double)Cycles / (2 * nTicks * nAnimators));
+}
+
+/*
+    Accuracy and speed of the wide approximations against libm. Errors are checked against the bounds documented in
+    GameMathWide.h, timings are cycles per element.
+*/
+void TestWideMath(test_context* Test, uint32 N = 1 << 20) {
+    TIMED_BLOCK;
+    memory_arena* Arena = &Test->Arena;
+    float* Input = PushArray(Arena, N, float);
+    float* Input2 = PushArray(Arena, N, float);
+    float* Output = PushArray(Arena, N, float);
+
+    double MaxError = 0;
+    uint64 Start = 0, WideCycles = 0, LibmCycles = 0;
+
+    // Sin and cos
+    for (int i = 0; i < N; i++) Input[i] = RandFloat(-8192.0f, 8192.0f);
+    MaxError = 0;
+    for (int i = 0; i < N; i += 4) {
+        wide_float S, C;
+        SinCos(LoadWide(Input + i), &S, &C);
+        for (int Lane = 0; Lane < 4; Lane++) {
+            double x = Input[i + Lane];
+            MaxError = max(MaxError, fabs(GetLane(S, Lane) - sin(x)));
+            MaxError = max(MaxError, fabs(GetLane(C, Lane) - cos(x)));
+        }
+    }
+    Assert(MaxError < 1.5e-7, "Wide SinCos out of tolerance.");
+
+    Start = __rdtsc();
+    for (int i = 0; i < N; i += 4) StoreWide(Output + i, Sin(LoadWide(Input + i)));
+    WideCycles = __rdtsc() - Start;
+    Start = __rdtsc();
+    for (int i = 0; i < N; i++) Output[i] = sinf(Input[i]);
+    LibmCycles = __rdtsc() - Start;
+    TestReport(Test, "Sin: max error %.3g, %.2f cycles/element (sinf %.2f).", MaxError, (float)WideCycles / N, (float)LibmCycles / N);
+
+    // Atan2
+    for (int i = 0; i < N; i++) {
+        Input[i] = RandFloat(-100.0f, 100.0f);
+        Input2[i] = RandFloat(-100.0f, 100.0f);
+    }
+    MaxError = 0;
+    for (int i = 0; i < N; i += 4) {
+        wide_float A = Atan2(LoadWide(Input + i), LoadWide(Input2 + i));
+        for (int Lane = 0; Lane < 4; Lane++) {
+            MaxError = max(MaxError, fabs(GetLane(A, Lane) - atan2((double)Input[i + Lane], (double)Input2[i + Lane])));
+        }
+    }
+    Assert(MaxError < 3.0e-7, "Wide Atan2 out of tolerance.");
+
+    Start = __rdtsc();
+    for (int i = 0; i < N; i += 4) StoreWide(Output + i, Atan2(LoadWide(Input + i), LoadWide(Input2 + i)));
+    WideCycles = __rdtsc() - Start;
+    Start = __rdtsc();
+    for (int i = 0; i < N; i++) Output[i] = atan2f(Input[i], Input2[i]);
+    LibmCycles = __rdtsc() - Start;
+    TestReport(Test, "Atan2: max error %.3g, %.2f cycles/element (atan2f %.2f).", MaxError, (float)WideCycles / N, (float)LibmCycles / N);
+
+    // Exp
+    for (int i = 0; i < N; i++) Input[i] = RandFloat(-87.0f, 88.0f);
+    MaxError = 0;
+    for (int i = 0; i < N; i += 4) {
+        wide_float E = Exp(LoadWide(Input + i));
+        for (int Lane = 0; Lane < 4; Lane++) {
+            double Expected = exp((double)Input[i + Lane]);
+            MaxError = max(MaxError, fabs(GetLane(E, Lane) - Expected) / Expected);
+        }
+    }
+    Assert(MaxError < 1.5e-7, "Wide Exp out of tolerance.");
+
+    Start = __rdtsc();
+    for (int i = 0; i < N; i += 4) StoreWide(Output + i, Exp(LoadWide(Input + i)));
+    WideCycles = __rdtsc() - Start;
+    Start = __rdtsc();
+    for (int i = 0; i < N; i++) Output[i] = expf(Input[i]);
+    LibmCycles = __rdtsc() - Start;
+    TestReport(Test, "Exp: max relative error %.3g, %.2f cycles/element (expf %.2f).", MaxError, (float)WideCycles / N, (float)LibmCycles / N);
+
+    // RSqrt
+    for (int i = 0; i < N; i++) Input[i] = RandFloat(1e-6f, 1e6f);
+    MaxError = 0;
+    for (int i = 0; i < N; i += 4) {
+        wide_float R = RSqrt(LoadWide(Input + i));
+        for (int Lane = 0; Lane < 4; Lane++) {
+            double Expected = 1.0 / sqrt((double)Input[i + Lane]);
+            MaxError = max(MaxError, fabs(GetLane(R, Lane) - Expected) / Expected);
+        }
+    }
+    Assert(MaxError < 5.0e-7, "Wide RSqrt out of tolerance.");
+
+    Start = __rdtsc();
+    for (int i = 0; i < N; i += 4) StoreWide(Output + i, RSqrt(LoadWide(Input + i)));
+    WideCycles = __rdtsc() - Start;
+    Start = __rdtsc();
+    for (int i = 0; i < N; i++) Output[i] = 1.0f / sqrtf(Input[i]);
+    LibmCycles = __rdtsc() - Start;
+    TestReport(Test, "RSqrt: max relative error %.3g, %.2f cycles/element (1/sqrtf %.2f).", MaxError, (float)WideCycles / N, (float)LibmCycles / N);
+}
+
+/*
+    One step of SIMD particle integration against the scalar formulas, then compaction: every live particle has to
+    end up in the dense range and every dead one out of it. Cost is measured per live particle with the emitter
+    mostly empty and full, which should be about the same.
+*/
+void TestParticles(test_context* Test, uint32 Size = 100000) {
+    memory_arena* Arena = &Test->Arena;
+    particle_emitter* Emitter = AllocateParticleEmitter(Arena, Size);
+    SetParticleEmitterCircle(Emitter, V3(0, 0, 0), 1.0f, normalize(V3(0.2f, 1, 0.1f)));
+    Emitter->ParticleLifetime = 2.0f;
+    float* Expected = PushArray(Arena, 4 * Size, float);
+    const float dt = 1.0f / 60.0f;
+
+    random_series Series = RandomSeries(2024);
+    uint64 Cycles[2] = {};
+    uint32 nLive[2] = { Size / 100, Size };
+    for (int Run = 0; Run < 2; Run++) {
+        Emitter->Count = 0;
+        SpawnParticles(Emitter, ReserveParticles(Emitter, nLive[Run]), nLive[Run], &Series);
+        for (uint32 i = 0; i < Emitter->Count; i++) {
+            // Drifting sideways as after a contact
+            Emitter->VelocityX[i] = NextFloat(&Series, -0.01f, 0.01f);
+            Emitter->VelocityZ[i] = NextFloat(&Series, -0.01f, 0.01f);
+            // A third of them die this step
+            Emitter->Time[i] = i % 3 == 0 ? NextFloat(&Series, 0, dt) : NextFloat(&Series, dt + 0.01f, Emitter->ParticleLifetime);
+        }
+
+        uint32 nExpected = 0;
+        double SumX = 0;
+        for (uint32 i = 0; i < Emitter->Count; i++) {
+            v3 Position = V3(Emitter->PositionX[i], Emitter->PositionY[i], Emitter->PositionZ[i]);
+            v3 AngularVelocity = 0.01f * cross(Emitter->Circle.Normal, Position);
+            Position += V3(Emitter->VelocityX[i], Emitter->VelocityY[i], Emitter->VelocityZ[i]) + AngularVelocity;
+            color Color = HSV2RGB(1.0f + 0.2f * (Emitter->Time[i] / Emitter->ParticleLifetime), 1.0f, 1.0f, 1.0f);
+            Expected[4 * i] = Position.X;
+            Expected[4 * i + 1] = Position.Y;
+            Expected[4 * i + 2] = Position.Z;
+            Expected[4 * i + 3] = Color.R + Color.G + Color.B;
+            if (Emitter->Time[i] > dt) {
+                nExpected++;
+                SumX += Position.X;
+            }
+        }
+
+        uint32 Count = Emitter->Count;
+        uint64 Start = __rdtsc();
+        IntegrateParticles(Emitter, 0, Emitter->Count, dt);
+        Cycles[Run] = __rdtsc() - Start;
+        for (uint32 i = 0; i < Count; i++) {
+            Assert(fabsf(Expected[4 * i] - Emitter->PositionX[i]) < 1e-5f, "Particle position is off.");
+            Assert(fabsf(Expected[4 * i + 1] - Emitter->PositionY[i]) < 1e-5f, "Particle position is off.");
+            Assert(fabsf(Expected[4 * i + 2] - Emitter->PositionZ[i]) < 1e-5f, "Particle position is off.");
+            Assert(fabsf(Expected[4 * i + 3] - (Emitter->Red[i] + Emitter->Green[i] + Emitter->Blue[i])) < 1e-4f, "Particle color is off.");
+        }
+
+        Start = __rdtsc();
+        CompactParticles(Emitter);
+        Cycles[Run] += __rdtsc() - Start;
+        Assert(Emitter->Count == nExpected, "Compaction lost or kept the wrong particles.");
+        double Sum = 0;
+        for (uint32 i = 0; i < Emitter->Count; i++) {
+            Assert(Emitter->Time[i] > 0, "Dead particle in the live range.");
+            Sum += Emitter->PositionX[i];
+        }
+        Assert(fabs(Sum - SumX) < 1e-3, "Compaction mixed particles up.");
+    }
+
+    TestReport(
+        Test, "Particles: %.2f cycles per live particle with %u live, %.2f with %u.",
+        (double)Cycles[0] / nLive[0], nLive[0], (double)Cycles[1] / nLive[1], nLive[1]
+    );
+}
+
+/*
+    Emitters of different sizes simulated serially and through the work queue from the same seeds. Chunks draw from
+    their own random streams, so every particle has to match bit for bit after every update.
+*/
+void TestParticleJobs(test_context* Test, uint32 nFrames = 30) {
+    platform_api* Platform = Test->Platform;
+    const uint32 Sizes[3] = { 300000, 50000, 1000 };
+    memory_arena* Arena = &Test->Arena;
+    particle_system* Systems[2];
+    for (int i = 0; i < 2; i++) {
+        Systems[i] = AllocateParticleSystem(Arena, 3, 128);
+        for (int e = 0; e < 3; e++) {
+            particle_emitter* Emitter = AllocateParticleEmitter(Arena, Sizes[e]);
+            SetParticleEmitterCircunference(Emitter, V3(0, 0, 0), 2.0f + e, V3(0, 1, 0));
+            Emitter->ParticleLifetime = 1.0f;
+            Emitter->Rate = 6000.0f;
+            AddParticleEmitter(Systems[i], Emitter, 2024 + e);
+
+            // Most of the capacity alive, with lifetimes running out along the test
+            random_series Series = RandomSeries(e);
+            uint32 nLive = Sizes[e] - Sizes[e] / 8;
+            SpawnParticles(Emitter, ReserveParticles(Emitter, nLive), nLive, &Series);
+            for (uint32 j = 0; j < nLive; j++) Emitter->Time[j] = NextFloat(&Series, 0, Emitter->ParticleLifetime);
+        }
+    }
+
+    const float dt = 1.0f / 60.0f;
+    uint64 Cycles[2] = {};
+    uint64 nParticles = 0;
+    for (uint32 Frame = 0; Frame < nFrames; Frame++) {
+        for (int i = 0; i < 2; i++) {
+            if (Frame % 10 == 0) {
+                for (int e = 0; e < 3; e++) TriggerParticleBurst(Systems[i]->Emitters[e], Sizes[e] / 16);
+            }
+            for (int e = 0; e < 3; e++) nParticles += i == 0 ? Systems[i]->Emitters[e]->Count : 0;
+            uint64 Start = __rdtsc();
+            UpdateParticles(i == 0 ? NULL : Platform, Systems[i], dt);
+            Cycles[i] += __rdtsc() - Start;
+        }
+        for (int e = 0; e < 3; e++) {
+            particle_emitter* A = Systems[0]->Emitters[e];
+            particle_emitter* B = Systems[1]->Emitters[e];
+            Assert(A->Count == B->Count, "Parallel particle update lost particles.");
+            float* ArraysA[PARTICLE_ARRAY_COUNT] = { A->PositionX, A->PositionY, A->PositionZ, A->VelocityX, A->VelocityY, A->VelocityZ, A->Time, A->Red, A->Green, A->Blue };
+            float* ArraysB[PARTICLE_ARRAY_COUNT] = { B->PositionX, B->PositionY, B->PositionZ, B->VelocityX, B->VelocityY, B->VelocityZ, B->Time, B->Red, B->Green, B->Blue };
+            for (int k = 0; k < PARTICLE_ARRAY_COUNT; k++) {
+                Assert(memcmp(ArraysA[k], ArraysB[k], A->Count * sizeof(float)) == 0, "Parallel particle update differs from the serial one.");
+            }
+        }
+    }
+
+    TestReport(
+        Test, "Particle jobs: %.0f particles per update, %u threads. Serial %.2f, parallel %.2f cycles per particle.",
+        (double)nParticles / nFrames, Platform ? Platform->nThreads : 1, (double)Cycles[0] / nParticles, (double)Cycles[1] / nParticles
+    );
+}
+
+/*
+    Emitters spawn the whole particles due at their rate and carry the fraction, bursts come on top up to the room
+    left, and a retired emitter is reused by the next one of its class once its last particle dies.
+*/
+void TestParticleEmitters(test_context* Test) {
+    memory_arena* Arena = &Test->Arena;
+    particle_system* System = AllocateParticleSystem(Arena, 4, 16);
+
+    // Three particles per second in quarter second steps, exact in binary
+    particle_emitter* Emitter = CreateParticleEmitter(System, 1000, 3.0f, 1);
+    SetParticleEmitterPoint(Emitter, V3(0, 0, 0));
+    Emitter->ParticleLifetime = 100.0f;
+    Assert(Emitter->Capacity == 1024, "Pooled emitter not rounded up to its class.");
+    uint32 Expected[8] = { 0, 1, 2, 3, 3, 4, 5, 6 };
+    for (int i = 0; i < ArrayCount(Expected); i++) {
+        UpdateParticles(NULL, System, 0.25f);
+        Assert(Emitter->Count == Expected[i], "Particle emission rate not accumulated.");
+    }
+
+    TriggerParticleBurst(Emitter, 2000);
+    UpdateParticles(NULL, System, 0.25f);
+    Assert(Emitter->Count == Emitter->Size, "Particle burst not clamped to the emitter size.");
+    Assert(Emitter->Burst == 0, "Particle burst spawned twice.");
+
+    // Retired emitters keep their particles until they run out
+    RetireParticleEmitter(Emitter);
+    UpdateParticles(NULL, System, 1.0f);
+    Assert(System->nEmitters == 1 && Emitter->Count == Emitter->Size, "Retired emitter dropped live particles.");
+    UpdateParticles(NULL, System, 200.0f);
+    Assert(System->nEmitters == 0, "Retired emitter not removed.");
+
+    memory_index Used = Arena->Used;
+    particle_emitter* Reused = CreateParticleEmitter(System, 600, 10.0f, 2);
+    Assert(Reused == Emitter && Arena->Used == Used, "Retired emitter not reused.");
+    Assert(Reused->Count == 0 && !Reused->Retired && Reused->Size == 600, "Reused emitter kept its old state.");
+
+    particle_emitter* Small = CreateParticleEmitter(System, 100, 10.0f, 3);
+    Assert(Small != Emitter && Small->Capacity == PARTICLE_POOL_MIN_SIZE, "Emitter taken from the wrong class.");
+    Assert(System->nEmitters == 2, "Created emitters not added to the system.");
+}
+
+// Vertex stream of the particle pipeline: one vertex per point, or quads centered on the particle facing the camera
+void TestParticleVertices(test_context* Test) {
+    const uint32 N = 10;
+    memory_arena* Arena = &Test->Arena;
+    particle_emitter* Emitter = AllocateParticleEmitter(Arena, N);
+    SetParticleEmitterSphere(Emitter, V3(1, 2, 3), 1.0f);
+    Emitter->ParticleLifetime = 1.0f;
+    Emitter->ParticleSize = 0.5f;
+    random_series Series = RandomSeries(7);
+    SpawnParticles(Emitter, ReserveParticles(Emitter, N), N, &Series);
+    IntegrateParticles(Emitter, 0, N, 0.1f);
+    float* Vertices = PushArray(Arena, PARTICLE_QUAD_VERTICES * PARTICLE_VERTEX_FLOATS * N, float);
+
+    WriteParticleVertices(Emitter, N, Vertices);
+    for (uint32 i = 0; i < N; i++) {
+        float* Vertex = Vertices + i * PARTICLE_VERTEX_FLOATS;
+        Assert(
+            Vertex[0] == Emitter->PositionX[i] && Vertex[1] == Emitter->PositionY[i] && Vertex[2] == Emitter->PositionZ[i],
+            "Particle vertex out of place."
+        );
+        Assert(Vertex[3] == Emitter->Red[i] && Vertex[4] == Emitter->Green[i] && Vertex[5] == Emitter->Blue[i], "Particle vertex color wrong.");
+        Assert(Vertex[6] == 1.0f && Vertex[7] == Emitter->ParticleSize, "Particle vertex size wrong.");
+    }
+
+    basis Billboard = Identity3;
+    Billboard.X = normalize(V3(1, 0, 1));
+    Billboard.Y = V3(0, 1, 0);
+    Billboard.Z = cross(Billboard.X, Billboard.Y);
+    WriteParticleVertices(Emitter, N, Vertices, &Billboard);
+    for (uint32 i = 0; i < N; i++) {
+        v3 Position = V3(Emitter->PositionX[i], Emitter->PositionY[i], Emitter->PositionZ[i]);
+        v3 Center = V3(0, 0, 0);
+        v3 Corners[PARTICLE_QUAD_VERTICES];
+        for (uint32 c = 0; c < PARTICLE_QUAD_VERTICES; c++) {
+            float* Vertex = Vertices + (i * PARTICLE_QUAD_VERTICES + c) * PARTICLE_VERTEX_FLOATS;
+            Corners[c] = V3(Vertex[0], Vertex[1], Vertex[2]);
+            Center += Corners[c];
+            Assert(fabsf(dot(Corners[c] - Position, Billboard.Z)) < 1e-5f, "Particle quad not facing the camera.");
+        }
+        Assert(distance(Center / (float)PARTICLE_QUAD_VERTICES, Position) < 1e-5f, "Particle quad not centered.");
+        v3 Diagonal = Corners[2] - Corners[0];
+        Assert(distance(Diagonal, Emitter->ParticleSize * (Billboard.X + Billboard.Y)) < 1e-5f, "Particle quad size wrong.");
+    }
+}
+
+// Seen takes N flags
+bool IsParticleOrder(uint32* Order, uint32 N, bool* Seen) {
+    memset(Seen, 0, N * sizeof(bool));
+    for (uint32 i = 0; i < N; i++) {
+        if (Order[i] >= N || Seen[Order[i]]) return false;
+        Seen[Order[i]] = true;
+    }
+    return true;
+}
+
+/*
+    Particles sorted back to front from view depth keys. The order has to be a permutation of the live particles with
+    depths that never grow, and after compaction and new spawns the kept order has to cover the live ones again.
+*/
+void TestParticleSort(test_context* Test, uint32 N = 20000) {
+    memory_arena* Arena = &Test->Arena;
+    particle_emitter* Emitter = AllocateParticleEmitter(Arena, N);
+    bool* Seen = PushArray(Arena, N, bool);
+    SetParticleEmitterSphere(Emitter, V3(0, 0, 0), 10.0f);
+    Emitter->ParticleLifetime = 1.0f;
+    random_series Series = RandomSeries(48);
+    uint32 nLive = N - N / 4;
+    SpawnParticles(Emitter, ReserveParticles(Emitter, nLive), nLive, &Series);
+    for (uint32 i = 0; i < nLive; i++) {
+        Emitter->PositionX[i] = NextFloat(&Series, -50.0f, 50.0f);
+        Emitter->PositionY[i] = NextFloat(&Series, -50.0f, 50.0f);
+        Emitter->PositionZ[i] = NextFloat(&Series, -50.0f, 50.0f);
+        Emitter->Time[i] = NextFloat(&Series, 0, 2.0f);
+    }
+
+    v3 Eye = V3(5, 10, -20);
+    v3 Forward = normalize(V3(0.3f, -0.2f, 1.0f));
+    uint64 Start = __rdtsc();
+    SortParticles(Emitter, Eye, Forward);
+    uint64 Cycles = __rdtsc() - Start;
+
+    Assert(Emitter->nSorted == nLive && IsParticleOrder(Emitter->Order, nLive, Seen), "Particle order is not a permutation.");
+    for (uint32 k = 1; k < nLive; k++) {
+        uint32 i = Emitter->Order[k - 1], j = Emitter->Order[k];
+        float DepthI = dot(V3(Emitter->PositionX[i], Emitter->PositionY[i], Emitter->PositionZ[i]) - Eye, Forward);
+        float DepthJ = dot(V3(Emitter->PositionX[j], Emitter->PositionY[j], Emitter->PositionZ[j]) - Eye, Forward);
+        Assert(DepthI >= DepthJ, "Particles not sorted back to front.");
+    }
+
+    // Lifetimes over 1 run out, the rest of the room is spawned
+    IntegrateParticles(Emitter, 0, Emitter->Count, 1.0f);
+    CompactParticles(Emitter);
+    uint32 Survivors = Emitter->Count;
+    SpawnParticles(Emitter, ReserveParticles(Emitter, N), N, &Series);
+    RefreshParticleOrder(Emitter);
+    Assert(Survivors < nLive && Emitter->Count == N, "Particle sort test did not change the live particles.");
+    Assert(Emitter->nSorted == N && IsParticleOrder(Emitter->Order, N, Seen), "Kept particle order misses live particles.");
+
+    TestReport(Test, "Particle sort: %.2f cycles per particle with %u particles.", (double)Cycles / nLive, nLive);
+}
+
+/*
+    Particles against a sloped heightmap and a sphere and a capsule in a grid. Sampling four points at once has to
+    match the scalar heights, one contact has to come out as the scalar response and carry over into the next step,
+    a crowd of colliders around one range has to be found whole, and particles falling for a few seconds have to
+    bounce and never be left under the ground or inside a collider.
+*/
+void TestParticleCollision(test_context* Test, uint32 N = 20000) {
+    const uint32 Side = 32;
+    memory_arena* Arena = &Test->Arena;
+    particle_emitter* Emitter = AllocateParticleEmitter(Arena, N);
+    SetParticleEmitterSphere(Emitter, V3(5, 4, 5), 3.0f);
+    Emitter->ParticleLifetime = 10.0f;
+    Emitter->Collide = true;
+    Emitter->Bounce = 0.5f;
+    Emitter->Friction = 0.2f;
+    Emitter->Gravity = 9.8f;
+
+    // Ramp rising along X
+    game_heightmap Heightmap = {};
+    Heightmap.nColumns = Side;
+    Heightmap.nRows = Side;
+    Heightmap.Heights = PushArray(Arena, Side * Side, float);
+    for (uint32 i = 0; i < Side * Side; i++) Heightmap.Heights[i] = 0.05f * (i % Side);
+
+    particle_collision* Collision = AllocateParticleCollision(Arena, AllocateSpatialHash(Arena, 2, 4.0f, 4), 2);
+    Collision->Heightmap = &Heightmap;
+    Collision->Colliders[0] = { V3(5, 3, 5), V3(5, 3, 5), 1.0f };
+    Collision->Colliders[1] = { V3(2, 3, 2), V3(2, 3, 8), 0.5f };
+    Collision->Reach = 3.5f;
+    Insert(Collision->Grid, 0, V3(5, 3, 5));
+    Insert(Collision->Grid, 1, V3(2, 3, 5));
+
+    random_series Series = RandomSeries(49);
+    for (int i = 0; i < 1000; i += 4) {
+        float X[4], Z[4], Heights[4];
+        for (int Lane = 0; Lane < 4; Lane++) {
+            X[Lane] = NextFloat(&Series, -1.0f, 11.0f);
+            Z[Lane] = NextFloat(&Series, -1.0f, 11.0f);
+        }
+        wide_v3 Normal;
+        StoreWide(Heights, GetHeight(&Heightmap, LoadWide(X), LoadWide(Z), &Normal));
+        for (int Lane = 0; Lane < 4; Lane++) {
+            Assert(fabsf(Heights[Lane] - GetHeight(&Heightmap, X[Lane], Z[Lane])) < 1e-5f, "Wide heightmap sample is off.");
+        }
+    }
+
+    // Inside the ramp and moving down and along it
+    v3 Position = V3(3.3f, 0.1f, 6.2f);
+    v3 Velocity = V3(0.05f, -0.1f, 0.02f);
+    v3 Normal = normalize(V3(-0.05f * Side / HEIGHTMAP_SIZE, 1, 0));
+    v3 NormalVelocity = dot(Velocity, Normal) * Normal;
+    v3 Expected = (1.0f - Emitter->Friction) * (Velocity - NormalVelocity) - Emitter->Bounce * NormalVelocity;
+    SpawnParticles(Emitter, ReserveParticles(Emitter, 4), 4, &Series);
+    for (uint32 i = 0; i < 4; i++) {
+        Emitter->PositionX[i] = Position.X;
+        Emitter->PositionY[i] = Position.Y;
+        Emitter->PositionZ[i] = Position.Z;
+        Emitter->VelocityX[i] = Velocity.X;
+        Emitter->VelocityY[i] = Velocity.Y;
+        Emitter->VelocityZ[i] = Velocity.Z;
+    }
+    CollideParticles(Emitter, 0, 4, Collision);
+    Assert(fabsf(Emitter->PositionY[0] - GetHeight(&Heightmap, Position.X, Position.Z)) < 1e-5f, "Particle not moved to the ground.");
+    Assert(fabsf(Emitter->VelocityX[0] - Expected.X) < 1e-5f, "Particle bounce is off.");
+    Assert(fabsf(Emitter->VelocityY[0] - Expected.Y) < 1e-5f, "Particle bounce is off.");
+    Assert(fabsf(Emitter->VelocityZ[0] - Expected.Z) < 1e-5f, "Particle bounce is off.");
+
+    // The bounce has to carry over into the next step, with gravity and the swirl on top
+    const float dt = 1.0f / 60.0f;
+    Position = V3(Emitter->PositionX[0], Emitter->PositionY[0], Emitter->PositionZ[0]);
+    Expected.Y -= Emitter->Gravity * dt * dt;
+    v3 Swirl = 0.01f * cross(Emitter->Circle.Normal, Position);
+    IntegrateParticles(Emitter, 0, 4, dt);
+    Assert(fabsf(Emitter->VelocityX[0] - Expected.X) < 1e-5f, "Particle bounce was lost.");
+    Assert(fabsf(Emitter->VelocityY[0] - Expected.Y) < 1e-5f, "Particle bounce was lost.");
+    Assert(fabsf(Emitter->VelocityZ[0] - Expected.Z) < 1e-5f, "Particle bounce was lost.");
+    Assert(fabsf(Emitter->PositionX[0] - (Position.X + Expected.X + Swirl.X)) < 1e-5f, "Particle didn't move by its bounce.");
+    Assert(fabsf(Emitter->PositionZ[0] - (Position.Z + Expected.Z + Swirl.Z)) < 1e-5f, "Particle didn't move by its bounce.");
+
+    // More colliders around one range than fit in a fixed size lookup, every one has to push its particle out
+    const uint32 nCrowd = 64;
+    particle_collision* Crowd = AllocateParticleCollision(Arena, AllocateSpatialHash(Arena, nCrowd, 4.0f, nCrowd), nCrowd);
+    Crowd->Reach = 0.1f;
+    Emitter->Count = 0;
+    SpawnParticles(Emitter, ReserveParticles(Emitter, nCrowd), nCrowd, &Series);
+    for (uint32 i = 0; i < nCrowd; i++) {
+        v3 Center = V3(0.5f * i, 20.0f, 0.0f);
+        Crowd->Colliders[i] = { Center, Center, 0.1f };
+        Insert(Crowd->Grid, i, Center);
+        Emitter->PositionX[i] = Center.X;
+        Emitter->PositionY[i] = Center.Y + 0.05f;
+        Emitter->PositionZ[i] = Center.Z;
+        Emitter->VelocityX[i] = 0.0f;
+        Emitter->VelocityY[i] = -0.1f;
+        Emitter->VelocityZ[i] = 0.0f;
+    }
+    CollideParticles(Emitter, 0, nCrowd, Crowd);
+    for (uint32 i = 0; i < nCrowd; i++) {
+        Assert(Emitter->PositionY[i] > 20.1f - 1e-4f && Emitter->VelocityY[i] > 0, "Particle missed a collider in a crowd.");
+    }
+
+    // A lookup that finds more colliders than there is room for keeps the first ones instead of failing
+    particle_collision* Small = AllocateParticleCollision(Arena, Crowd->Grid, 8);
+    Small->Colliders = Crowd->Colliders;
+    Small->Reach = Crowd->Reach;
+    for (uint32 i = 0; i < nCrowd; i++) Emitter->VelocityY[i] = -0.1f;
+    CollideParticles(Emitter, 0, nCrowd, Small);
+
+    Emitter->Count = 0;
+    SpawnParticles(Emitter, ReserveParticles(Emitter, N), N, &Series);
+    for (uint32 i = 0; i < N; i++) Emitter->Time[i] = Emitter->ParticleLifetime;
+
+    float* Falling = PushArray(Arena, N, float);
+    uint32 nBounces = 0;
+    uint64 IntegrateCycles = 0, CollideCycles = 0;
+    for (int Step = 0; Step < 180; Step++) {
+        uint64 Start = __rdtsc();
+        IntegrateParticles(Emitter, 0, Emitter->Count, dt);
+        IntegrateCycles += __rdtsc() - Start;
+        for (uint32 i = 0; i < Emitter->Count; i++) Emitter->Time[i] = Emitter->ParticleLifetime;
+        memcpy(Falling, Emitter->VelocityY, Emitter->Count * sizeof(float));
+
+        Start = __rdtsc();
+        CollideParticles(Emitter, 0, Emitter->Count, Collision);
+        CollideCycles += __rdtsc() - Start;
+
+        for (uint32 i = 0; i < Emitter->Count; i++) {
+            v3 P = V3(Emitter->PositionX[i], Emitter->PositionY[i], Emitter->PositionZ[i]);
+            if (P.X >= 0 && P.X <= HEIGHTMAP_SIZE && P.Z >= 0 && P.Z <= HEIGHTMAP_SIZE) {
+                Assert(P.Y > GetHeight(&Heightmap, P.X, P.Z) - 1e-4f, "Particle left under the ground.");
+            }
+            for (int c = 0; c < 2; c++) {
+                particle_collider* Collider = &Collision->Colliders[c];
+                v3 Axis = Collider->Tail - Collider->Head;
+                float t = dot(Axis, Axis) > 0 ? Clamp(dot(P - Collider->Head, Axis) / dot(Axis, Axis), 0.0f, 1.0f) : 0.0f;
+                Assert(distance(P, Collider->Head + t * Axis) > Collider->Radius - 1e-3f, "Particle left inside a collider.");
+            }
+            if (Falling[i] < 0 && Emitter->VelocityY[i] > 0) nBounces++;
+        }
+    }
+    Assert(nBounces > 0, "No particle bounced.");
+
+    TestReport(
+        Test, "Particle collision: %.2f cycles per particle (integration %.2f) with %u particles.",
+        (double)CollideCycles / (180.0 * N), (double)IntegrateCycles / (180.0 * N), N
+    );
+}
+
+/*
+    Assets file built from scratch, then again with two sources marked as changed in the manifest, then with nothing
+    changed. Copying unchanged assets from the previous pack has to give the same bytes as preprocessing them, and the
+    up to date build should only check timestamps. The test pack is deleted at the end.
+*/
+void TestAssetsFile(test_context* Test) {
+    platform_api* Platform = Test->Platform;
+    const char* Path = "..\\GameAssets\\game_assets_test";
+    uint32 Stale = 0;
+    Platform->WriteEntireFile(Path, sizeof(Stale), &Stale);
+
+    uint64 Start = __rdtsc();
+    WriteAssetsFile(Platform, Path);
+    uint64 ColdCycles = __rdtsc() - Start;
+    Assert(PreprocessedAssets.nSources > 0 && PreprocessedAssets.nRebuilt == PreprocessedAssets.nSources, "Stale assets file was reused.");
+
+    read_file_result Cold = Platform->ReadEntireFile(Path);
+    game_assets* Header = (game_assets*)Cold.Content;
+    file_stamp Stamps[2] = { Header->Asset.Content[0].Source, Header->Shader[0].Source };
+    Header->Asset.Content[0].Source.Timestamp = 0;
+    Header->Asset.Content[0].Source.Hash ^= 1;
+    Header->Shader[0].Source.Timestamp = 0;
+    Header->Shader[0].Source.Hash ^= 1;
+    Platform->WriteEntireFile(Path, Cold.ContentSize, Cold.Content);
+    Header->Asset.Content[0].Source = Stamps[0];
+    Header->Shader[0].Source = Stamps[1];
+
+    Start = __rdtsc();
+    WriteAssetsFile(Platform, Path);
+    uint64 PartialCycles = __rdtsc() - Start;
+    Assert(PreprocessedAssets.nRebuilt == 2, "Unchanged sources were rebuilt.");
+
+    read_file_result Partial = Platform->ReadEntireFile(Path);
+    Assert(
+        Partial.ContentSize == Cold.ContentSize &&
+        memcmp((uint8*)Partial.Content + sizeof(game_assets), (uint8*)Cold.Content + sizeof(game_assets), Cold.ContentSize - sizeof(game_assets)) == 0,
+        "Assets copied from the previous pack differ from rebuilt ones."
+    );
+
+    Start = __rdtsc();
+    WriteAssetsFile(Platform, Path);
+    uint64 WarmCycles = __rdtsc() - Start;
+    Assert(PreprocessedAssets.nRebuilt == 0, "Up to date assets file was rebuilt.");
+
+    // A source saved again without changes is read once, then its new timestamp goes into the pack header
+    Header->Asset.Content[0].Source.Timestamp = 0;
+    Platform->WriteEntireFile(Path, Cold.ContentSize, Cold.Content);
+    Header->Asset.Content[0].Source = Stamps[0];
+    WriteAssetsFile(Platform, Path);
+    Assert(PreprocessedAssets.nRebuilt == 0 && PreprocessedAssets.nRestamped == 1, "Source with a new timestamp was rebuilt.");
+    WriteAssetsFile(Platform, Path);
+    Assert(PreprocessedAssets.nRestamped == 0, "New timestamp was not written to the assets file.");
+
+    TestReport(
+        Test, "Assets file: %llu cycles from scratch, %llu with 2 changed sources, %llu up to date (%u sources).",
+        ColdCycles, PartialCycles, WarmCycles, PreprocessedAssets.nSources
+    );
+
+    Platform->FreeFileMemory(Cold.Content);
+    Platform->FreeFileMemory(Partial.Content);
+    Platform->RemoveFile(Path);
+}
+
+// Every test above, in the order they were written. New tests add their cases here.
+void RunTests(test_context* Test) {
+    RUN_TEST(Test, TestBroadphase(Test, 10000, 60));
+    RUN_TEST(Test, TestMeshRaycast(Test));
+    RUN_TEST(Test, TestWideMath(Test));
+    RUN_TEST(Test, TestSpatialHash(Test, 1000));
+    RUN_TEST(Test, TestSpatialHash(Test, 10000));
+    RUN_TEST(Test, TestSpatialHash(Test, 100000));
+    RUN_TEST(Test, TestSparseSet(Test));
+    RUN_TEST(Test, TestEntityJobs(Test));
+    RUN_TEST(Test, TestEntityJobs(Test, 8000, 10));
+    RUN_TEST(Test, TestTransformHierarchy(Test));
+    RUN_TEST(Test, TestFixedTimestep(Test));
+    RUN_TEST(Test, TestSnapshots(Test));
+    RUN_TEST(Test, TestEntityNames(Test));
+    RUN_TEST(Test, TestAnimation(Test));
+    RUN_TEST(Test, TestBoneHierarchy(Test));
+    RUN_TEST(Test, TestAnimationLOD(Test));
+    RUN_TEST(Test, TestParticles(Test));
+    RUN_TEST(Test, TestParticleJobs(Test));
+    RUN_TEST(Test, TestParticleEmitters(Test));
+    RUN_TEST(Test, TestParticleVertices(Test));
+    RUN_TEST(Test, TestParticleSort(Test));
+    RUN_TEST(Test, TestParticleCollision(Test));
+    RUN_TEST(Test, TestAssetsFile(Test));
+}
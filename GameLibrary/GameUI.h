@@ -667,7 +667,7 @@ void UIDebugValue(debug_entry* Entry) {
         {ui_size_pixels, 0},
         {ui_size_pixels, 0},
     };
-    UpdateAndSizeDebugEntry(Font, Entry, &Sizes[axis_x].Value, &Sizes[axis_y].Value);
+    UpdateAndSizeDebugEntry(Font, UI.DebugInfo->Strings, Entry, &Sizes[axis_x].Value, &Sizes[axis_y].Value);
 
     ui_element* Element = PushUIElement(Entry->Name, Sizes[0], Sizes[1], ui_alignment_min, ui_alignment_free);
     Element->DebugEntry = Entry;
@@ -796,7 +796,7 @@ void UpdateUI(
     if (Group->Debug) {
         // Handle input
         if (DebugAlpha < 1.0) {
-            double x = (pGameState->dt - 1.8) / 1.1;
+            double x = (pGameState->FrameDt - 1.8) / 1.1;
             DebugAlpha += 0.5 * exp(- x * x);
         }
         else DebugAlpha = 1.0;
@@ -849,16 +849,33 @@ void UpdateUI(
         }
 
         if (UIDropdown(Entities)) {
-            game_entity* Entities[MAX_ENTITIES] = {};
+            // Components are copied out by ID and the copies have to last until the UI is rendered. Only the first
+            // entities are listed, leaving debug entries for the members of the expanded ones.
+            const uint32 MaxViews = min(EntityState->Entities.Count, 32);
+            game_entity_view* Entities = PushArray(&Memory->Transient, MaxViews, game_entity_view);
             uint32 nEntities = 0;
-            uint32 Index = 0;
-            while (nEntities < EntityState->Entities.Count && Index < MAX_ENTITIES) {
-                game_entity* Entity = &EntityState->Entities.List[Index++];
-                if (Entity->Active) {
-                    Entities[nEntities++] = Entity;
+            for (int ID = 0; ID < EntityState->nIDs && nEntities < MaxViews; ID++) {
+                if (EntityState->Components.Active[ID]) {
+                    Entities[nEntities++] = GetEntityView(EntityState, ID);
                 }
             }
-            DEBUG_POINTER_ARRAY(Entities, EntityState->Entities.Count, game_entity);
+            DEBUG_ARRAY(Entities, nEntities, game_entity_view);
+            nEntries = DebugInfo->nEntries;
+            for (; i < nEntries; i++) {
+                debug_entry* Entry = &DebugInfo->Entries[i];
+                UIDebugValue(Entry);
+            }
+        }
+
+        if (UIDropdown(Animation)) {
+            animation_lod_stats* Stats = &pGameState->Animation->Stats;
+            DEBUG_VALUE(pGameState->Animation->nAnimators, uint32);
+            DEBUG_VALUE(Stats->nFull, uint32);
+            DEBUG_VALUE(Stats->nReduced, uint32);
+            DEBUG_VALUE(Stats->nCulled, uint32);
+            DEBUG_VALUE(Stats->nSkipped, uint32);
+            DEBUG_VALUE(Stats->nLeafDropped, uint32);
+            DEBUG_VALUE(Stats->nEvaluations, uint32);
             nEntries = DebugInfo->nEntries;
             for (; i < nEntries; i++) {
                 debug_entry* Entry = &DebugInfo->Entries[i];
@@ -36,6 +36,7 @@ int main() {
         "bool",
         "char",
         "string",
+        "string_id",
         "int8",
         "int16",
         "int",
@@ -1,17 +1,12 @@
 #include "GameMath.h"
+#include "GameMathWide.h"
 #include "GameAssets.h"
 #include "GameRender.h"
+#include "GameCollision.h"
 
 #ifndef PARTICLES
 #define PARTICLES
 
-struct particle {
-    color Color;
-    v3 Position;
-    v3 Velocity;
-    float Time;
-};
-
 enum particle_emitter_type {
     particle_emitter_point,
     particle_emitter_segment,
@@ -36,16 +31,73 @@ struct particle_emitter {
         } Sphere;
     };
     uint32 Size;
-    uint32 Count;
+    uint32 Capacity;            // Slots allocated, at least Size when the emitter is reused from the pool
+    uint32 Count;               // Live particles, always the first Count of every array
     float ParticleLifetime;
-    particle Particles[];
+    float ParticleSize;         // World units
+    uint32 SortInterval;        // Frames between depth sorts, 0 draws particles as they are stored
+    uint32 SortCountdown;
+    uint32 nSorted;             // Live particles at the last sort, all of them in Order
+    bool Collide;               // Against the heightmap and colliders of the system collision, if it has one
+    float Bounce;               // Fraction of the velocity into a surface that comes back out
+    float Friction;             // Fraction of the velocity along a surface lost on contact
+    float Gravity;              // Units per second squared, downwards
+    float Rate;                 // Particles per second
+    float Accumulated;          // Fraction of a particle carried over to the next update
+    uint32 Burst;               // Spawned at once on the next update
+    bool Retired;               // Emits no more, goes back to the pool when its last particle dies
+    particle_emitter* NextFree;
+    uint32 Seed;
+    uint32 Frame;               // Updates so far, with the seed picks the random stream of every chunk
+    // One array per component, Size rounded up to a multiple of 4 so the last group can be processed whole
+    float* PositionX;
+    float* PositionY;
+    float* PositionZ;
+    float* VelocityX;
+    float* VelocityY;
+    float* VelocityZ;
+    float* Time;
+    float* Red;
+    float* Green;
+    float* Blue;
+    // Back to front at the last sort, with the keys it was sorted by and room for the radix sort passes
+    uint32* Order;
+    uint32* OrderScratch;
+    uint32* SortKeys;
+    uint32* SortKeysScratch;
 };
 
+const int PARTICLE_ARRAY_COUNT = 10;
+const int PARTICLE_SORT_ARRAY_COUNT = 4;
+const float PARTICLE_DEFAULT_SIZE = 0.05f;
+
+uint64 GetParticleEmitterSize(uint32 N) {
+    uint32 Padded = (N + 3) & ~3u;
+    return sizeof(particle_emitter) + Padded * (PARTICLE_ARRAY_COUNT * sizeof(float) + PARTICLE_SORT_ARRAY_COUNT * sizeof(uint32));
+}
+
 particle_emitter* AllocateParticleEmitter(memory_arena* Arena, uint32 N) {
     particle_emitter* Result = PushStruct(Arena, particle_emitter);
+    *Result = {};
     Result->Size = N;
+    Result->Capacity = N;
     Result->Count = 0;
-    PushArray(Arena, N, particle);
+    Result->ParticleSize = PARTICLE_DEFAULT_SIZE;
+    Result->SortInterval = 1;
+    uint32 Padded = (N + 3) & ~3u;
+    float** Arrays[PARTICLE_ARRAY_COUNT] = {
+        &Result->PositionX, &Result->PositionY, &Result->PositionZ,
+        &Result->VelocityX, &Result->VelocityY, &Result->VelocityZ,
+        &Result->Time, &Result->Red, &Result->Green, &Result->Blue
+    };
+    for (int i = 0; i < ArrayCount(Arrays); i++) {
+        *Arrays[i] = PushArray(Arena, Padded, float);
+        memset(*Arrays[i], 0, Padded * sizeof(float));
+    }
+    uint32** SortArrays[PARTICLE_SORT_ARRAY_COUNT] = { &Result->Order, &Result->OrderScratch, &Result->SortKeys, &Result->SortKeysScratch };
+    for (int i = 0; i < ArrayCount(SortArrays); i++) {
+        *SortArrays[i] = PushArray(Arena, Padded, uint32);
+    }
     return Result;
 }
 
@@ -74,56 +126,651 @@ void SetParticleEmitterSphere(particle_emitter* Emitter, v3 Center, float Radius
     Emitter->Sphere = { Center, Radius };
 }
 
-void AddParticle(particle_emitter* Emitter) {
-    if (Emitter->Count >= Emitter->Size) {
-        Emitter->Count = 0;
-    }
-    particle* Particle = &Emitter->Particles[Emitter->Count++];
-    Particle->Time = Emitter->ParticleLifetime;
+v3 GetParticleEmitterCenter(particle_emitter* Emitter) {
     switch(Emitter->Type) {
-        case particle_emitter_point: {
-            Particle->Position.X = Emitter->Point.X;
-            Particle->Position.Z = Emitter->Point.Z;
-        } break;
-        case particle_emitter_segment: {
-            float t = RandFloat();
-            Particle->Position = t * Emitter->Segment.Head + (1 - t) * Emitter->Segment.Tail;
-        } break;
-        case particle_emitter_circunference: {
-            basis Basis = Complete(Emitter->Circle.Normal);
-            float Angle = RandFloat(0, Tau);
-            Particle->Position = Emitter->Circle.Radius * (cosf(Angle) * Basis.Y + sinf(Angle) * Basis.Z);
-            Particle->Velocity = V3(0, RandFloat(0.01, 0.03), 0);
-        } break;
-        case particle_emitter_circle: {
-            basis Basis = Complete(Emitter->Circle.Normal);
-            float R = sqrt(RandFloat(0, Emitter->Circle.Radius));
-            float Angle = RandFloat(0, Tau);
-            Particle->Position = R * (cosf(Angle) * Basis.Y + sinf(Angle) * Basis.Z);
-            Particle->Velocity = V3(0, RandFloat(0.01, 0.03), 0);
-        } break;
-    }
-}
-
-void Update(render_group* Group, particle_emitter* Emitter, float dt) {
+        case particle_emitter_point:            return Emitter->Point;
+        case particle_emitter_segment:          return 0.5f * (Emitter->Segment.Head + Emitter->Segment.Tail);
+        case particle_emitter_circunference:
+        case particle_emitter_circle:           return Emitter->Circle.Center;
+        case particle_emitter_sphere:           return Emitter->Sphere.Center;
+    }
+    return V3(0, 0, 0);
+}
+
+// Spawned on top of the rate on the next update
+void TriggerParticleBurst(particle_emitter* Emitter, uint32 N) {
+    Emitter->Burst += N;
+}
+
+// Whole particles due after dt at the emitter rate, the remaining fraction is kept for the next update. Includes bursts.
+uint32 GetParticlesToEmit(particle_emitter* Emitter, float dt) {
+    float Due = Emitter->Accumulated + Emitter->Rate * dt;
+    uint32 Result = (uint32)Due;
+    Emitter->Accumulated = Due - Result;
+    Result += Emitter->Burst;
+    Emitter->Burst = 0;
+    return Result;
+}
+
+// Particles are only added while there is room, live ones are never overwritten. Returns the first new slot.
+uint32 ReserveParticles(particle_emitter* Emitter, uint32 N) {
+    uint32 First = Emitter->Count;
+    Emitter->Count += min(N, Emitter->Size - Emitter->Count);
+    return First;
+}
+
+// New particles in slots [Start, End), reserved already
+void SpawnParticles(particle_emitter* Emitter, uint32 Start, uint32 End, random_series* Series) {
+    basis Basis = Complete(Emitter->Circle.Normal);
+    for (uint32 i = Start; i < End; i++) {
+        v3 Position = V3(0, 0, 0);
+        v3 Velocity = V3(0, 0, 0);
+        switch(Emitter->Type) {
+            case particle_emitter_point: {
+                Position = Emitter->Point;
+            } break;
+            case particle_emitter_segment: {
+                float t = NextFloat(Series);
+                Position = t * Emitter->Segment.Head + (1 - t) * Emitter->Segment.Tail;
+            } break;
+            case particle_emitter_circunference: {
+                float Angle = NextFloat(Series, 0, Tau);
+                Position = Emitter->Circle.Radius * (cosf(Angle) * Basis.Y + sinf(Angle) * Basis.Z);
+                Velocity = V3(0, NextFloat(Series, 0.01, 0.03), 0);
+            } break;
+            case particle_emitter_circle: {
+                float R = sqrt(NextFloat(Series, 0, Emitter->Circle.Radius));
+                float Angle = NextFloat(Series, 0, Tau);
+                Position = R * (cosf(Angle) * Basis.Y + sinf(Angle) * Basis.Z);
+                Velocity = V3(0, NextFloat(Series, 0.01, 0.03), 0);
+            } break;
+        }
+
+        Emitter->PositionX[i] = Position.X;
+        Emitter->PositionY[i] = Position.Y;
+        Emitter->PositionZ[i] = Position.Z;
+        Emitter->VelocityX[i] = Velocity.X;
+        Emitter->VelocityY[i] = Velocity.Y;
+        Emitter->VelocityZ[i] = Velocity.Z;
+        Emitter->Time[i] = Emitter->ParticleLifetime;
+    }
+}
+
+// HSV2RGB with full saturation and value, four hues at a time
+inline void WideHue2RGB(wide_float H, wide_float* R, wide_float* G, wide_float* B) {
+    wide_float Offsets[3] = { WideFloat(1.0f), WideFloat(2.0f / 3.0f), WideFloat(1.0f / 3.0f) };
+    wide_float* Out[3] = { R, G, B };
+    for (int c = 0; c < 3; c++) {
+        wide_float x = H + Offsets[c];
+        x = x - Floor(x);
+        *Out[c] = Clamp(Abs(6.0f * x - 3.0f) - 1.0f, 0.0f, 1.0f);
+    }
+}
+
+/*
+    Moves particles [Start, End) one step, four at a time: by their velocity, which gravity pulls down, plus a swirl
+    around the emitter normal that isn't stored, so contacts from CollideParticles carry over. The hue follows the
+    remaining lifetime and the lifetime runs down. Velocities are per step, not per second. Dead particles are only
+    removed by CompactParticles.
+*/
+void IntegrateParticles(particle_emitter* Emitter, uint32 Start, uint32 End, float dt) {
+    wide_v3 Normal = WideV3(Emitter->Circle.Normal);
+    wide_float Swirl = WideFloat(0.01f);
+    wide_float HuePerTime = WideFloat(0.2f / Emitter->ParticleLifetime);
+    wide_float Step = WideFloat(dt);
+    wide_float Fall = WideFloat(Emitter->Gravity * dt * dt);
+    wide_float Zero = WideFloat(0.0f);
+    for (uint32 i = Start; i < End; i += 4) {
+        wide_v3 Position = { LoadWide(Emitter->PositionX + i), LoadWide(Emitter->PositionY + i), LoadWide(Emitter->PositionZ + i) };
+        wide_float Time = LoadWide(Emitter->Time + i);
+
+        wide_v3 AngularVelocity = Swirl * cross(Normal, Position);
+        wide_v3 Velocity = { LoadWide(Emitter->VelocityX + i), LoadWide(Emitter->VelocityY + i) - Fall, LoadWide(Emitter->VelocityZ + i) };
+        Position += Velocity + AngularVelocity;
+
+        wide_float R, G, B;
+        WideHue2RGB(HuePerTime * Time + 1.0f, &R, &G, &B);
+        Time = Max(Time - Step, Zero);
+
+        StoreWide(Emitter->PositionX + i, Position.X);
+        StoreWide(Emitter->PositionY + i, Position.Y);
+        StoreWide(Emitter->PositionZ + i, Position.Z);
+        StoreWide(Emitter->VelocityX + i, Velocity.X);
+        StoreWide(Emitter->VelocityY + i, Velocity.Y);
+        StoreWide(Emitter->VelocityZ + i, Velocity.Z);
+        StoreWide(Emitter->Time + i, Time);
+        StoreWide(Emitter->Red + i, R);
+        StoreWide(Emitter->Green + i, G);
+        StoreWide(Emitter->Blue + i, B);
+    }
+}
+
+inline void MoveParticle(particle_emitter* Emitter, uint32 From, uint32 To) {
+    Emitter->PositionX[To] = Emitter->PositionX[From];
+    Emitter->PositionY[To] = Emitter->PositionY[From];
+    Emitter->PositionZ[To] = Emitter->PositionZ[From];
+    Emitter->VelocityX[To] = Emitter->VelocityX[From];
+    Emitter->VelocityY[To] = Emitter->VelocityY[From];
+    Emitter->VelocityZ[To] = Emitter->VelocityZ[From];
+    Emitter->Time[To] = Emitter->Time[From];
+    Emitter->Red[To] = Emitter->Red[From];
+    Emitter->Green[To] = Emitter->Green[From];
+    Emitter->Blue[To] = Emitter->Blue[From];
+}
+
+// Swap removes dead particles, the last live one takes the place of each. Groups of four without deaths are skipped.
+void CompactParticles(particle_emitter* Emitter) {
+    wide_float Zero = WideFloat(0.0f);
+    uint32 i = 0;
+    while (i < Emitter->Count) {
+        if (i + 4 <= Emitter->Count && !Any(LoadWide(Emitter->Time + i) <= Zero)) {
+            i += 4;
+        }
+        else if (Emitter->Time[i] <= 0) {
+            MoveParticle(Emitter, --Emitter->Count, i);
+        }
+        else i++;
+    }
+}
+
+// Position, color and size of one vertex in the particle stream
+const uint32 PARTICLE_VERTEX_FLOATS = 8;
+const uint32 PARTICLE_QUAD_VERTICES = 6;
+
+/*
+    Writes N live particles as a vertex stream for the particle pipeline, the first N in Order if given. Without a
+    billboard basis every particle is one point, with one it is a quad of two triangles facing along the basis Z axis,
+    sized on the CPU.
+*/
+void WriteParticleVertices(particle_emitter* Emitter, uint32 N, float* Out, basis* Billboard = NULL, uint32* Order = NULL) {
+    float Size = Emitter->ParticleSize;
+    v3 Corners[PARTICLE_QUAD_VERTICES] = {};
+    uint32 nCorners = 1;
+    if (Billboard) {
+        v3 Right = 0.5f * Size * Billboard->X;
+        v3 Up = 0.5f * Size * Billboard->Y;
+        v3 Quad[PARTICLE_QUAD_VERTICES] = { -Right - Up, Right - Up, Right + Up, -Right - Up, Right + Up, Up - Right };
+        for (int i = 0; i < PARTICLE_QUAD_VERTICES; i++) Corners[i] = Quad[i];
+        nCorners = PARTICLE_QUAD_VERTICES;
+    }
+
+    for (uint32 k = 0; k < N; k++) {
+        uint32 i = Order ? Order[k] : k;
+        v3 Position = V3(Emitter->PositionX[i], Emitter->PositionY[i], Emitter->PositionZ[i]);
+        for (uint32 c = 0; c < nCorners; c++) {
+            v3 Vertex = Position + Corners[c];
+            Out[0] = Vertex.X;
+            Out[1] = Vertex.Y;
+            Out[2] = Vertex.Z;
+            Out[3] = Emitter->Red[i];
+            Out[4] = Emitter->Green[i];
+            Out[5] = Emitter->Blue[i];
+            Out[6] = 1.0f;
+            Out[7] = Size;
+            Out += PARTICLE_VERTEX_FLOATS;
+        }
+    }
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Collision                                                                                                                                    |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+// Capsule in world space, a sphere when Head and Tail are the same point
+struct particle_collider {
+    v3 Head;
+    v3 Tail;
+    float Radius;
+};
+
+/*
+    What particles of colliding emitters hit. Both parts are optional. The grid holds the handles of Colliders at the
+    positions they were gathered around, and no collider surface is farther than Reach from its position. Handles
+    has room for MaxColliders grid handles per thread, for the lookups of CollideParticles.
+*/
+struct particle_collision {
+    game_heightmap* Heightmap;
+    spatial_hash* Grid;
+    particle_collider* Colliders;
+    uint32 MaxColliders;
+    float Reach;
+    int* Handles;
+};
+
+particle_collision* AllocateParticleCollision(memory_arena* Arena, spatial_hash* Grid, uint32 MaxColliders) {
+    particle_collision* Result = PushStruct(Arena, particle_collision);
+    *Result = {};
+    Result->Grid = Grid;
+    Result->MaxColliders = MaxColliders;
+    Result->Colliders = PushArray(Arena, MaxColliders, particle_collider);
+    Result->Handles = PushArray(Arena, MAX_THREADS * MaxColliders, int);
+    return Result;
+}
+
+// GetHeight at four points, with the normal of the bilinear patch under each one
+wide_float GetHeight(game_heightmap* Heightmap, wide_float X, wide_float Z, wide_v3* Normal) {
+    uint32 nColumns = Heightmap->nColumns;
+    float ScaleU = nColumns / HEIGHTMAP_SIZE;
+    float ScaleV = Heightmap->nRows / HEIGHTMAP_SIZE;
+    wide_float u = Clamp(X * ScaleU - 0.5f, 0.0f, (float)(nColumns - 1));
+    wide_float v = Clamp(Z * ScaleV - 0.5f, 0.0f, (float)(Heightmap->nRows - 1));
+    wide_float Column = Min(Floor(u), WideFloat((float)(nColumns - 2)));
+    wide_float Row = Min(Floor(v), WideFloat((float)(Heightmap->nRows - 2)));
+    wide_float fu = u - Column;
+    wide_float fv = v - Row;
+
+    // No gathers in SSE, the four corners of every lane are fetched one by one
+    float Corners[4][4];
+    for (int Lane = 0; Lane < 4; Lane++) {
+        float* H = Heightmap->Heights + (uint32)GetLane(Row, Lane) * nColumns + (uint32)GetLane(Column, Lane);
+        Corners[0][Lane] = H[0];
+        Corners[1][Lane] = H[1];
+        Corners[2][Lane] = H[nColumns];
+        Corners[3][Lane] = H[nColumns + 1];
+    }
+    wide_float H00 = LoadWide(Corners[0]);
+    wide_float H10 = LoadWide(Corners[1]);
+    wide_float H01 = LoadWide(Corners[2]);
+    wide_float H11 = LoadWide(Corners[3]);
+
+    wide_float H0 = H00 + fu * (H10 - H00);
+    wide_float H1 = H01 + fu * (H11 - H01);
+    wide_float dHdX = ((H10 - H00) + fv * ((H11 - H01) - (H10 - H00))) * ScaleU;
+    wide_float dHdZ = (H1 - H0) * ScaleV;
+    wide_float InvLength = WideFloat(1.0f) / Sqrt(dHdX * dHdX + dHdZ * dHdZ + 1.0f);
+    *Normal = { -dHdX * InvLength, InvLength, -dHdZ * InvLength };
+    return H0 + fv * (H1 - H0);
+}
+
+/*
+    Lanes in Contact are moved to Surface. If they were moving into it, the velocity along Normal is reversed and
+    scaled by Bounce and the velocity along the surface loses Friction.
+*/
+inline void RespondToContact(
+    wide_float Contact, wide_v3 Surface, wide_v3 Normal, wide_v3* Position, wide_v3* Velocity, float Bounce, float Friction
+) {
+    wide_float Approach = dot(*Velocity, Normal);
+    wide_v3 NormalVelocity = Approach * Normal;
+    wide_v3 Response = (1.0f - Friction) * (*Velocity - NormalVelocity) - Bounce * NormalVelocity;
+    *Velocity = Select(Contact & (Approach < WideFloat(0.0f)), Response, *Velocity);
+    *Position = Select(Contact, Surface, *Position);
+}
+
+// Particles that share one collider lookup. Consecutive particles were spawned close in time, so a tile stays small.
+const uint32 PARTICLE_COLLISION_TILE = 32;
+
+/*
+    Grid handles of the colliders that can touch particles [Start, End), looked up around their bounding box grown by
+    the reach (padding lanes may widen it). If more than MaxColliders are found only the first ones are kept.
+*/
+uint32 FindParticleColliders(particle_emitter* Emitter, uint32 Start, uint32 End, particle_collision* Collision, int* Handles) {
+    wide_v3 Low = { WideFloat(FLT_MAX), WideFloat(FLT_MAX), WideFloat(FLT_MAX) };
+    wide_v3 High = { WideFloat(-FLT_MAX), WideFloat(-FLT_MAX), WideFloat(-FLT_MAX) };
+    for (uint32 i = Start; i < End; i += 4) {
+        wide_v3 Position = { LoadWide(Emitter->PositionX + i), LoadWide(Emitter->PositionY + i), LoadWide(Emitter->PositionZ + i) };
+        Low = { Min(Low.X, Position.X), Min(Low.Y, Position.Y), Min(Low.Z, Position.Z) };
+        High = { Max(High.X, Position.X), Max(High.Y, Position.Y), Max(High.Z, Position.Z) };
+    }
+    aabb Box = EmptyAABB();
+    for (int Lane = 0; Lane < 4; Lane++) {
+        Grow(&Box, V3(GetLane(Low.X, Lane), GetLane(Low.Y, Lane), GetLane(Low.Z, Lane)));
+        Grow(&Box, V3(GetLane(High.X, Lane), GetLane(High.Y, Lane), GetLane(High.Z, Lane)));
+    }
+    v3 Reach = V3(Collision->Reach, Collision->Reach, Collision->Reach);
+    Box.Min = Box.Min - Reach;
+    Box.Max = Box.Max + Reach;
+    uint32 nFound = QueryAABB(Collision->Grid, Box, Handles, Collision->MaxColliders);
+    return min(nFound, Collision->MaxColliders);
+}
+
+// Particles [Start, End) against the heightmap and the nColliders colliders in Handles
+void CollideParticleTile(
+    particle_emitter* Emitter, uint32 Start, uint32 End, particle_collision* Collision, int* Handles, uint32 nColliders
+) {
+    wide_float Zero = WideFloat(0.0f);
+    wide_float Size = WideFloat(HEIGHTMAP_SIZE);
+    for (uint32 i = Start; i < End; i += 4) {
+        wide_v3 Position = { LoadWide(Emitter->PositionX + i), LoadWide(Emitter->PositionY + i), LoadWide(Emitter->PositionZ + i) };
+        wide_v3 Velocity = { LoadWide(Emitter->VelocityX + i), LoadWide(Emitter->VelocityY + i), LoadWide(Emitter->VelocityZ + i) };
+
+        if (Collision->Heightmap) {
+            wide_v3 Normal;
+            wide_float Ground = GetHeight(Collision->Heightmap, Position.X, Position.Z, &Normal);
+            wide_float Inside = (Position.X >= Zero) & (Position.X <= Size) & (Position.Z >= Zero) & (Position.Z <= Size);
+            wide_v3 Surface = { Position.X, Ground, Position.Z };
+            RespondToContact(Inside & (Position.Y < Ground), Surface, Normal, &Position, &Velocity, Emitter->Bounce, Emitter->Friction);
+        }
+
+        for (uint32 c = 0; c < nColliders; c++) {
+            particle_collider* Collider = &Collision->Colliders[Handles[c]];
+            v3 Axis = Collider->Tail - Collider->Head;
+            float SqLength = dot(Axis, Axis);
+            wide_v3 Head = WideV3(Collider->Head);
+            wide_v3 WideAxis = WideV3(Axis);
+            wide_float t = Clamp(dot(Position - Head, WideAxis) * (SqLength > 0 ? 1.0f / SqLength : 0.0f), 0.0f, 1.0f);
+            wide_v3 Closest = Head + t * WideAxis;
+            wide_v3 Offset = Position - Closest;
+            wide_float SqDistance = dot(Offset, Offset);
+            wide_float Contact = SqDistance < WideFloat(Collider->Radius * Collider->Radius);
+            if (!Any(Contact)) continue;
+
+            wide_v3 Normal = (WideFloat(1.0f) / Sqrt(Max(SqDistance, WideFloat(1e-12f)))) * Offset;
+            RespondToContact(Contact, Closest + Collider->Radius * Normal, Normal, &Position, &Velocity, Emitter->Bounce, Emitter->Friction);
+        }
+
+        StoreWide(Emitter->PositionX + i, Position.X);
+        StoreWide(Emitter->PositionY + i, Position.Y);
+        StoreWide(Emitter->PositionZ + i, Position.Z);
+        StoreWide(Emitter->VelocityX + i, Velocity.X);
+        StoreWide(Emitter->VelocityY + i, Velocity.Y);
+        StoreWide(Emitter->VelocityZ + i, Velocity.Z);
+    }
+}
+
+/*
+    Particles [Start, End) against the heightmap, inside its extent, and against the colliders near them. Colliders
+    are looked up per tile of PARTICLE_COLLISION_TILE particles into the handles of ThreadIndex, so the cost grows with
+    the colliders near each tile and not with every collider the whole range spans.
+*/
+void CollideParticles(particle_emitter* Emitter, uint32 Start, uint32 End, particle_collision* Collision, uint32 ThreadIndex = 0) {
+    Assert(ThreadIndex < MAX_THREADS, "Thread index out of range.");
+    int* Handles = Collision->Handles + ThreadIndex * Collision->MaxColliders;
+    for (uint32 TileStart = Start; TileStart < End; TileStart += PARTICLE_COLLISION_TILE) {
+        uint32 TileEnd = min(TileStart + PARTICLE_COLLISION_TILE, End);
+        uint32 nColliders = Collision->Grid ? FindParticleColliders(Emitter, TileStart, TileEnd, Collision, Handles) : 0;
+        if (nColliders == 0 && !Collision->Heightmap) continue;
+        CollideParticleTile(Emitter, TileStart, TileEnd, Collision, Handles, nColliders);
+    }
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Depth sorting                                                                                                                                |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+/*
+    Radix sort of N keys carrying their values along, least significant byte first. The four byte histograms are
+    counted in one pass and bytes every key shares are skipped. Returns true when the result ended in the scratch
+    arrays instead of Keys and Values.
+*/
+bool RadixSort(uint32* Keys, uint32* Values, uint32* KeysScratch, uint32* ValuesScratch, uint32 N) {
+    uint32 Counts[4][256] = {};
+    for (uint32 i = 0; i < N; i++) {
+        uint32 Key = Keys[i];
+        Counts[0][Key & 0xFF]++;
+        Counts[1][(Key >> 8) & 0xFF]++;
+        Counts[2][(Key >> 16) & 0xFF]++;
+        Counts[3][Key >> 24]++;
+    }
+
+    bool Swapped = false;
+    for (int Pass = 0; Pass < 4; Pass++) {
+        uint32 Shift = 8 * Pass;
+        uint32* Count = Counts[Pass];
+        if (N == 0 || Count[(Keys[0] >> Shift) & 0xFF] == N) continue;
+
+        uint32 Offset = 0;
+        for (int Byte = 0; Byte < 256; Byte++) {
+            uint32 nByte = Count[Byte];
+            Count[Byte] = Offset;
+            Offset += nByte;
+        }
+        for (uint32 i = 0; i < N; i++) {
+            uint32 Key = Keys[i];
+            uint32 Slot = Count[(Key >> Shift) & 0xFF]++;
+            KeysScratch[Slot] = Key;
+            ValuesScratch[Slot] = Values[i];
+        }
+
+        uint32* Temp = Keys; Keys = KeysScratch; KeysScratch = Temp;
+        Temp = Values; Values = ValuesScratch; ValuesScratch = Temp;
+        Swapped = !Swapped;
+    }
+    return Swapped;
+}
+
+// Live particles into Order, farthest along Forward first. Depths are computed four at a time.
+void SortParticles(particle_emitter* Emitter, v3 Eye, v3 Forward) {
     TIMED_BLOCK;
-    
-    AddParticle(Emitter);
-
-    for (int i = 0; i < Emitter->Size; i++) {
-        particle* Particle = &Emitter->Particles[i];
-        if (Particle->Time > 0) {
-            v3 AngularVelocity = 0.01f * cross(Emitter->Circle.Normal, Particle->Position);
-            Particle->Velocity.X = AngularVelocity.X;
-            Particle->Velocity.Z = AngularVelocity.Z;
-
-            Particle->Position += Particle->Velocity;
-            Particle->Color = HSV2RGB(1.0f + 0.2f * (Particle->Time / Emitter->ParticleLifetime), 1.0f, 1.0f, 1.0f);
-            PushPoint(Group, Particle->Position, Particle->Color, SORT_ORDER_DEBUG_OVERLAY - distance(Particle->Position, Group->Camera->Position));
-
-            Particle->Time -= dt;
-            if (Particle->Time < 0) Particle->Time = 0;
+    uint32 N = Emitter->Count;
+    wide_v3 WideEye = WideV3(Eye);
+    wide_v3 WideForward = WideV3(Forward);
+    for (uint32 i = 0; i < N; i += 4) {
+        wide_v3 Position = { LoadWide(Emitter->PositionX + i), LoadWide(Emitter->PositionY + i), LoadWide(Emitter->PositionZ + i) };
+        StoreDescendingKeys(Emitter->SortKeys + i, dot(Position - WideEye, WideForward));
+    }
+    for (uint32 i = 0; i < N; i++) Emitter->Order[i] = i;
+
+    if (RadixSort(Emitter->SortKeys, Emitter->Order, Emitter->SortKeysScratch, Emitter->OrderScratch, N)) {
+        uint32* Temp = Emitter->Order; Emitter->Order = Emitter->OrderScratch; Emitter->OrderScratch = Temp;
+        Temp = Emitter->SortKeys; Emitter->SortKeys = Emitter->SortKeysScratch; Emitter->SortKeysScratch = Temp;
+    }
+    Emitter->nSorted = N;
+}
+
+/*
+    Order from the last sort made valid for the particles alive now: slots past the live count are dropped and slots
+    spawned since then go last. Particles moved by compaction are drawn where the one they replaced was.
+*/
+void RefreshParticleOrder(particle_emitter* Emitter) {
+    uint32 n = 0;
+    for (uint32 i = 0; i < Emitter->nSorted; i++) {
+        if (Emitter->Order[i] < Emitter->Count) Emitter->Order[n++] = Emitter->Order[i];
+    }
+    for (uint32 i = Emitter->nSorted; i < Emitter->Count; i++) Emitter->Order[n++] = i;
+    Emitter->nSorted = n;
+}
+
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+// | Particle system                                                                                                                              |
+// +----------------------------------------------------------------------------------------------------------------------------------------------+
+
+const uint32 PARTICLE_CHUNK_SIZE = 4096;
+
+// Pooled emitters are allocated with capacity PARTICLE_POOL_MIN_SIZE << Class, one free list per class
+const uint32 PARTICLE_POOL_MIN_SIZE = 256;
+const int PARTICLE_POOL_CLASSES = 16;
+
+// Slice of one emitter simulated by one job. Slots from FirstSpawn on are spawned first, from the chunk's own stream.
+struct particle_chunk {
+    particle_emitter* Emitter;
+    uint32 Start;
+    uint32 End;
+    uint32 FirstSpawn;
+    uint32 Index;
+};
+
+/*
+    Every emitter, split every update in chunks of PARTICLE_CHUNK_SIZE particles that worker threads simulate. Chunks
+    only depend on the emitter seed, its update count and their index, so the result is the same whatever thread (or
+    how many of them) runs each one.
+
+    Emitters created at runtime come from Arena and are given back to the free lists when retired, so spawning and
+    retiring effects reuses the same memory. The arena has to outlive the system.
+*/
+struct particle_system {
+    memory_arena* Arena;
+    particle_emitter* FreeEmitters[PARTICLE_POOL_CLASSES];
+    uint32 nEmitters;
+    uint32 MaxEmitters;
+    particle_emitter** Emitters;
+    uint32 nChunks;
+    uint32 MaxChunks;
+    particle_chunk* Chunks;
+    particle_collision* Collision;
+    float dt;
+};
+
+particle_system* AllocateParticleSystem(memory_arena* Arena, uint32 MaxEmitters, uint32 MaxChunks) {
+    particle_system* Result = PushStruct(Arena, particle_system);
+    *Result = {};
+    Result->Arena = Arena;
+    Result->MaxEmitters = MaxEmitters;
+    Result->Emitters = PushArray(Arena, MaxEmitters, particle_emitter*);
+    Result->MaxChunks = MaxChunks;
+    Result->Chunks = PushArray(Arena, MaxChunks, particle_chunk);
+    return Result;
+}
+
+// Chunks an emitter of N particles can take at most
+inline uint32 GetParticleChunkCount(uint32 N) {
+    return (N + PARTICLE_CHUNK_SIZE - 1) / PARTICLE_CHUNK_SIZE;
+}
+
+void AddParticleEmitter(particle_system* System, particle_emitter* Emitter, uint32 Seed) {
+    Assert(System->nEmitters < System->MaxEmitters, "Too many particle emitters.");
+    Emitter->Seed = Seed;
+    Emitter->Frame = 0;
+    System->Emitters[System->nEmitters++] = Emitter;
+}
+
+/*
+    Emitter of N particles from the free list of its class, or from the arena when the list is empty, added to the
+    system. Shape, lifetime and the rest of the settings are left for the caller to set.
+*/
+particle_emitter* CreateParticleEmitter(particle_system* System, uint32 N, float Rate, uint32 Seed) {
+    int Class = 0;
+    while (PARTICLE_POOL_MIN_SIZE << Class < N) Class++;
+    Assert(Class < PARTICLE_POOL_CLASSES, "Particle emitter too large for the pool.");
+
+    particle_emitter* Result = System->FreeEmitters[Class];
+    if (Result) {
+        System->FreeEmitters[Class] = Result->NextFree;
+        Result->NextFree = NULL;
+        Result->Count = 0;
+        Result->Accumulated = 0;
+        Result->Burst = 0;
+        Result->Retired = false;
+        Result->SortCountdown = 0;
+        Result->nSorted = 0;
+    }
+    else {
+        Result = AllocateParticleEmitter(System->Arena, PARTICLE_POOL_MIN_SIZE << Class);
+    }
+    Result->Size = N;
+    Result->Rate = Rate;
+    AddParticleEmitter(System, Result, Seed);
+    return Result;
+}
+
+// Stops emitting, live particles run out their lifetime and then the emitter is given back to the pool
+void RetireParticleEmitter(particle_emitter* Emitter) {
+    Emitter->Retired = true;
+    Emitter->Rate = 0;
+    Emitter->Burst = 0;
+}
+
+// Goes to the largest class it has room for, emitters allocated outside the pool included
+void ReleaseParticleEmitter(particle_system* System, particle_emitter* Emitter) {
+    if (Emitter->Capacity < PARTICLE_POOL_MIN_SIZE) return;
+    int Class = 0;
+    while (Class + 1 < PARTICLE_POOL_CLASSES && PARTICLE_POOL_MIN_SIZE << (Class + 1) <= Emitter->Capacity) Class++;
+    Emitter->NextFree = System->FreeEmitters[Class];
+    System->FreeEmitters[Class] = Emitter;
+}
+
+PARALLEL_FOR_CALLBACK(UpdateParticleChunks) {
+    particle_system* System = (particle_system*)Data;
+    for (uint32 i = Start; i < End; i++) {
+        particle_chunk* Chunk = &System->Chunks[i];
+        particle_emitter* Emitter = Chunk->Emitter;
+        uint32 FirstSpawn = max(Chunk->Start, Chunk->FirstSpawn);
+        if (FirstSpawn < Chunk->End) {
+            random_series Series = RandomSeries(Emitter->Seed ^ Hash(Emitter->Frame ^ Hash(Chunk->Index)));
+            SpawnParticles(Emitter, FirstSpawn, Chunk->End, &Series);
         }
+        IntegrateParticles(Emitter, Chunk->Start, Chunk->End, System->dt);
+        if (Emitter->Collide && System->Collision) {
+            CollideParticles(Emitter, Chunk->Start, Chunk->End, System->Collision, ThreadIndex);
+        }
+    }
+}
+
+PARALLEL_FOR_CALLBACK(CompactParticleEmitters) {
+    particle_system* System = (particle_system*)Data;
+    for (uint32 i = Start; i < End; i++) {
+        CompactParticles(System->Emitters[i]);
+        System->Emitters[i]->Frame++;
+    }
+}
+
+/*
+    Particles due at every emitter rate are reserved, then chunks simulated in parallel and emitters compacted in
+    parallel. Retired emitters without particles left are removed and given back to the pool.
+*/
+void UpdateParticles(platform_api* Platform, particle_system* System, float dt) {
+    TIMED_BLOCK;
+    System->dt = dt;
+    System->nChunks = 0;
+    for (uint32 i = 0; i < System->nEmitters; i++) {
+        particle_emitter* Emitter = System->Emitters[i];
+        uint32 FirstSpawn = ReserveParticles(Emitter, GetParticlesToEmit(Emitter, dt));
+        for (uint32 Start = 0; Start < Emitter->Count; Start += PARTICLE_CHUNK_SIZE) {
+            Assert(System->nChunks < System->MaxChunks, "Too many particle chunks.");
+            particle_chunk* Chunk = &System->Chunks[System->nChunks++];
+            Chunk->Emitter = Emitter;
+            Chunk->Start = Start;
+            Chunk->End = min(Start + PARTICLE_CHUNK_SIZE, Emitter->Count);
+            Chunk->FirstSpawn = FirstSpawn;
+            Chunk->Index = Start / PARTICLE_CHUNK_SIZE;
+        }
+    }
+    ParallelFor(Platform, System->nChunks, 1, UpdateParticleChunks, System);
+    ParallelFor(Platform, System->nEmitters, 1, CompactParticleEmitters, System);
+
+    uint32 i = 0;
+    while (i < System->nEmitters) {
+        particle_emitter* Emitter = System->Emitters[i];
+        if (Emitter->Retired && Emitter->Count == 0) {
+            ReleaseParticleEmitter(System, Emitter);
+            System->Emitters[i] = System->Emitters[--System->nEmitters];
+        }
+        else i++;
+    }
+}
+
+/*
+    One draw per emitter with every live particle in it, sorted by the distance from the camera to the emitter. Inside
+    the draw particles go back to front, sorted again every SortInterval frames of the emitter and kept in the last
+    order in between. With Billboards particles are expanded to camera facing quads on the CPU, otherwise they are
+    points sized by the vertex shader. Particles that do not fit in what is left of the vertex buffer are not drawn,
+    being the last in order they are the nearest ones.
+*/
+void PushParticles(render_group* Group, particle_system* System, bool Billboards = false) {
+    TIMED_BLOCK;
+    game_shader_pipeline* Shader = GetShaderPipeline(Group->Assets, Shader_Pipeline_Particle_ID);
+    vertex_layout_id LayoutID = vertex_layout_vec3_vec4_float_id;
+    memory_arena* Vertices = &Group->VertexBuffer.Vertices[LayoutID];
+    uint32 VerticesPerParticle = Billboards ? PARTICLE_QUAD_VERTICES : 1;
+    uint32 ParticleStride = VerticesPerParticle * Group->VertexBuffer.Layouts[LayoutID].Stride;
+    v3 Eye = GetCameraEye(Group->Camera);
+    v3 Forward = -Group->Camera->Basis.Z;
+    for (uint32 e = 0; e < System->nEmitters; e++) {
+        particle_emitter* Emitter = System->Emitters[e];
+        uint32 N = min(Emitter->Count, (uint32)((Vertices->Size - Vertices->Used) / ParticleStride));
+        if (N == 0) continue;
+
+        uint32* Order = NULL;
+        if (Emitter->SortInterval > 0) {
+            if (Emitter->SortCountdown == 0) {
+                SortParticles(Emitter, Eye, Forward);
+                Emitter->SortCountdown = Emitter->SortInterval;
+            }
+            else RefreshParticleOrder(Emitter);
+            Emitter->SortCountdown--;
+            Order = Emitter->Order;
+        }
+
+        float* Out = PushPrimitiveCommand(
+            Group,
+            Billboards ? render_primitive_triangle : render_primitive_point,
+            White,
+            Shader,
+            LayoutID,
+            N * VerticesPerParticle,
+            0,
+            SORT_ORDER_DEBUG_OVERLAY - distance(GetParticleEmitterCenter(Emitter), Group->Camera->Position)
+        )->Vertices;
+        WriteParticleVertices(Emitter, N, Out, Billboards ? &Group->Camera->Basis : NULL, Order);
     }
 }
 
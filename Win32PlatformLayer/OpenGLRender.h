@@ -556,18 +556,9 @@ void ClearModelUniforms(openGL* OpenGL) {
 	SetUBO(Matrices, 3);
 }
 
-void SetBoneUniforms(openGL* OpenGL, armature* Armature) {
-	bone_uniforms BoneUniforms = {};
-	BoneUniforms.n_bones = Armature->nBones;
-	int Offset1 = offsetof(bone_uniforms, bone_transforms);
-	int Offset2 = offsetof(bone_uniforms, bone_normal_transforms);
-	int Offset3 = offsetof(bone_uniforms, n_bones);
-	for (int i = 0; i < Armature->nBones; i++) {
-		matrix4 BoneMatrix = Matrix(Armature->Bones[i].Transform);
-		BoneUniforms.bone_transforms[i] = BoneMatrix;
-		BoneUniforms.bone_normal_transforms[i] = Matrix4(inverse(Matrix3(BoneMatrix)));
-	}
-	SetUBO(BoneUniforms, 4);
+// The palette already has the uniform block layout, evaluated by the animation system
+void SetBoneUniforms(openGL* OpenGL, bone_palette* Palette) {
+	glNamedBufferSubData(OpenGL->UBOs[4], 0, sizeof(bone_palette), Palette);
 }
 
 void ClearBoneUniforms(openGL* OpenGL) {
@@ -868,7 +859,7 @@ void InitializeRenderer(
 			uint32 VBO = OpenGL->VBOs[i];
 			
 			vertex_layout Layout = Assets->VertexLayouts[i];
-			memory_index Size = VERTEX_BUFFER_SIZE;
+			memory_index Size = GetVertexBufferSize((vertex_layout_id)i);
 			
 			glNamedBufferStorage(VBO, Size, 0, GL_DYNAMIC_STORAGE_BIT);
 
@@ -1044,7 +1035,7 @@ void Render(HWND Window, render_group* Group, openGL* OpenGL, double Time) {
 					matrix4 Model = Matrix(Options.Transform);
 					SetModelUniforms(OpenGL, Model);
 
-					if (Options.Armature != NULL) SetBoneUniforms(OpenGL, Options.Armature);
+					if (Options.Palette != NULL) SetBoneUniforms(OpenGL, Options.Palette);
 				}
 
 				if (Options.Font != NULL) {
@@ -0,0 +1,308 @@
+#include "pch.h"
+#include "GameLibrary.h"
+#include "Win32PlatformLayer.h"
+
+/*
+    Headless entity and gameplay benchmark. Builds a game_memory without window, renderer or sound, spawns entities
+    through the usual AddX functions and runs the same per frame path as the game (simulation ticks, camera and
+    PushEntities) for a fixed number of frames.
+
+    Usage:
+        Win32Benchmark.exe [Frames] [Characters Enemies Props Weapons]
+
+    Without counts it sweeps from a few entities up to FULL_SCENE. Results are printed and appended to
+    benchmark.csv as one row per system and run, so two runs can be diffed to spot regressions.
+
+    Particles are measured apart, on large emitters with one to every thread, and appended to
+    benchmark_particles.csv.
+*/
+
+game_memory Memory;
+
+// Every timed block is in the headers above
+time_record TimeRecordArray[__COUNTER__];
+
+struct benchmark_config {
+    uint32 nCharacters;
+    uint32 nEnemies;
+    uint32 nProps;
+    uint32 nWeapons;
+    uint32 nFrames;
+};
+
+struct benchmark_result {
+    uint32 nEntities;
+    double SecondsPerFrame;
+    uint64 CyclesPerFrame;
+    memory_index GameStateSize;
+    memory_index ArenaUsed;
+    uint64 WorkingSet;
+};
+
+// Largest scene of the sweep, kept as it was when each type had a fixed maximum so rows stay comparable
+const benchmark_config FULL_SCENE = { 8, 4096, 32, 32, 0 };
+
+const char* BENCHMARK_CSV_PATH = "benchmark.csv";
+const char* BENCHMARK_CSV_HEADER = "characters,enemies,props,weapons,entities,frames,threads,system,hits_per_frame,mcycles_per_frame,cycles_per_entity,ms_per_frame,game_state_kb,arena_kb,working_set_kb\n";
+
+uint64 GetWorkingSet() {
+    PROCESS_MEMORY_COUNTERS_EX PMC = {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&PMC, sizeof(PMC))) {
+        return PMC.WorkingSetSize;
+    }
+    return 0;
+}
+
+// Entities are spread over an area that grows with their number, so density and collision pairs stay comparable
+void SpawnEntities(game_assets* Assets, game_entity_state* State, benchmark_config Config) {
+    float WorldSize = 10.0f * sqrtf((float)(Config.nCharacters + Config.nEnemies + Config.nProps + Config.nWeapons));
+    srand(2024);
+
+    camera* Camera = AddCamera(State, V3(0, 3.2f, 0), -45.0f, 22.5f);
+    Camera->OnAir = true;
+
+    ReserveEntities(State, Entity_Type_Character, Config.nCharacters);
+    ReserveEntities(State, Entity_Type_Enemy, Config.nEnemies);
+    ReserveEntities(State, Entity_Type_Prop, Config.nProps);
+    ReserveEntities(State, Entity_Type_Weapon, Config.nWeapons);
+
+    for (int i = 0; i < Config.nCharacters; i++) {
+        v3 Position = V3(RandFloat(-WorldSize, WorldSize), 0, RandFloat(-WorldSize, WorldSize));
+        AddCharacter(Assets, State, Position, 100);
+    }
+    for (int i = 0; i < Config.nEnemies; i++) {
+        AddEnemy(State, V3(RandFloat(-WorldSize, WorldSize), 0, RandFloat(-WorldSize, WorldSize)));
+    }
+    for (int i = 0; i < Config.nProps; i++) {
+        v3 Position = V3(RandFloat(-WorldSize, WorldSize), 0, RandFloat(-WorldSize, WorldSize));
+        AddProp(State, Mesh_Sphere_ID, Shader_Pipeline_Sphere_ID, White, Position);
+    }
+
+    // One sword and one shield per character go to its hands, the rest lie around
+    for (int i = 0; i < Config.nWeapons; i++) {
+        weapon_type Type = i % 2 == 0 ? Weapon_Sword : Weapon_Shield;
+        v3 Position = V3(RandFloat(-WorldSize, WorldSize), 0, RandFloat(-WorldSize, WorldSize));
+        weapon* Weapon = AddWeapon(State, Type, White, Position);
+        if (i / 2 < Config.nCharacters) {
+            Equip(State, Weapon, &State->Characters[i / 2]);
+        }
+    }
+}
+
+benchmark_result RunBenchmark(benchmark_config Config, memory_index ArenaMark) {
+    Assert(Config.nCharacters > 0, "The simulation needs a controlled character.");
+    // The camera and every configured entity, the entity state is sized for exactly these
+    int MaxEntities = 1 + Config.nCharacters + Config.nEnemies + Config.nProps + Config.nWeapons;
+    Assert(Config.nCharacters <= MAX_ANIMATORS, "Not enough animator palettes.");
+
+    // Start from the same zeroed memory every run
+    ZeroSize(Memory.Permanent.Used - ArenaMark, Memory.Permanent.Base + ArenaMark);
+    Memory.Permanent.Used = ArenaMark;
+    memset(TimeRecordArray, 0, sizeof(TimeRecordArray));
+
+    game_state* State = PushStruct(&Memory.Permanent, game_state);
+    Memory.GameState = State;
+    InitializeEntityState(&State->Entities, &Memory.Permanent, MaxEntities);
+    State->Broadphase = AllocateBroadphase(&Memory.Permanent, MaxEntities, 16 * MaxEntities);
+    AllocateCommandBuffers(&Memory.Permanent, State);
+    State->Grid = AllocateSpatialHash(&Memory.Permanent, MaxEntities, 4.0f, 2 * MaxEntities);
+    State->Animation = AllocateAnimationSystem(&Memory.Permanent, MAX_ANIMATORS);
+    SetTickRate(&State->Step, DEFAULT_TICK_RATE);
+
+    SpawnEntities(&Memory.Assets, &State->Entities, Config);
+
+    render_group* Group = &Memory.RenderGroup;
+    Group->Width = 1280;
+    Group->Height = 720;
+    game_input Input = {};
+    Input.Mode = Keyboard;
+
+    // Exactly one tick per frame
+    LARGE_INTEGER Frequency, Start, End;
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    uint64 StartCycles = __rdtsc();
+    for (int Frame = 0; Frame < Config.nFrames; Frame++) {
+        ClearEntries(Group);
+        ClearVertexBuffer(&Group->VertexBuffer);
+        State->FrameDt = State->Step.TickDt;
+        SimulateFrame(&Memory.Platform, &Memory.Assets, State, &Input);
+        UpdateCamera(State, &Input, &Group->Camera, Group->Width, Group->Height);
+        PushEntities(Group, &State->Entities, &Input, State->Time, State->Step.Alpha);
+    }
+    uint64 Cycles = __rdtsc() - StartCycles;
+    QueryPerformanceCounter(&End);
+
+    benchmark_result Result = {};
+    Result.nEntities = State->Entities.Entities.Count;
+    Result.SecondsPerFrame = (double)(End.QuadPart - Start.QuadPart) / (Frequency.QuadPart * (double)Config.nFrames);
+    Result.CyclesPerFrame = Cycles / Config.nFrames;
+    Result.GameStateSize = sizeof(game_state);
+    Result.ArenaUsed = Memory.Permanent.Used - ArenaMark;
+    Result.WorkingSet = GetWorkingSet();
+    return Result;
+}
+
+void WriteRow(FILE* File, benchmark_config Config, benchmark_result Result, const char* System, double Hits, uint64 Cycles) {
+    double CyclesPerFrame = (double)Cycles / Config.nFrames;
+    fprintf(
+        File,
+        "%u,%u,%u,%u,%u,%u,%u,%s,%.2f,%.4f,%.1f,%.4f,%llu,%llu,%llu\n",
+        Config.nCharacters, Config.nEnemies, Config.nProps, Config.nWeapons, Result.nEntities, Config.nFrames,
+        Memory.Platform.nThreads, System, Hits, CyclesPerFrame / 1000000.0, CyclesPerFrame / Result.nEntities,
+        1000.0 * Result.SecondsPerFrame, Result.GameStateSize / 1024, Result.ArenaUsed / 1024, Result.WorkingSet / 1024
+    );
+}
+
+// Frame total first, then every timed block that ran, as recorded in TimeRecordArray
+void ReportBenchmark(FILE* File, benchmark_config Config, benchmark_result Result) {
+    WriteRow(File, Config, Result, "Frame", 1.0, Result.CyclesPerFrame * Config.nFrames);
+    for (int i = 0; i < ArrayCount(TimeRecordArray); i++) {
+        time_record* Record = TimeRecordArray + i;
+        if (Record->HitCount > 0) {
+            WriteRow(File, Config, Result, Record->FunctionName, (double)Record->HitCount / Config.nFrames, Record->CycleCount);
+        }
+    }
+}
+
+const char* PARTICLE_CSV_PATH = "benchmark_particles.csv";
+const char* PARTICLE_CSV_HEADER = "threads,emitters,particles,frames,ms_per_frame,particles_per_ms\n";
+
+/*
+    Particles per millisecond with 1, 2, 4... threads up to all of them. Emitters are full and their particles never
+    die, so every update simulates the same amount. Each thread count gets its own work queue (threads can't be
+    stopped, the ones of the other queues wait idle on their semaphores).
+*/
+void WriteParticleRow(FILE* File, uint32 nThreads, uint32 nEmitters, uint64 nParticles, uint32 nFrames, double Milliseconds) {
+    fprintf(
+        File, "%u,%u,%llu,%u,%.4f,%.0f\n",
+        nThreads, nEmitters, nParticles, nFrames, Milliseconds / nFrames, nParticles * nFrames / Milliseconds
+    );
+}
+
+void RunParticleBenchmark(FILE* File, uint32 nFrames, memory_index ArenaMark) {
+    const uint32 nEmitters = 4;
+    const uint32 EmitterSize = 1 << 20;
+    static platform_work_queue Queues[MAX_THREADS];
+    static win32_thread_info ThreadInfos[MAX_THREADS][MAX_THREADS];
+
+    uint32 ThreadCounts[MAX_THREADS];
+    uint32 nRuns = 0;
+    for (uint32 nThreads = 1; nThreads < Memory.Platform.nThreads; nThreads *= 2) ThreadCounts[nRuns++] = nThreads;
+    ThreadCounts[nRuns++] = Memory.Platform.nThreads;
+
+    for (uint32 Run = 0; Run < nRuns; Run++) {
+        uint32 nThreads = ThreadCounts[Run];
+        ZeroSize(Memory.Permanent.Used - ArenaMark, Memory.Permanent.Base + ArenaMark);
+        Memory.Permanent.Used = ArenaMark;
+
+        particle_system* System = AllocateParticleSystem(&Memory.Permanent, nEmitters, nEmitters * GetParticleChunkCount(EmitterSize));
+        for (uint32 e = 0; e < nEmitters; e++) {
+            particle_emitter* Emitter = AllocateParticleEmitter(&Memory.Permanent, EmitterSize);
+            SetParticleEmitterCircle(Emitter, V3(10.0f * e, 0, 0), 5.0f, V3(0, 1, 0));
+            Emitter->ParticleLifetime = 1e6f;
+            AddParticleEmitter(System, Emitter, e);
+            random_series Series = RandomSeries(e);
+            SpawnParticles(Emitter, ReserveParticles(Emitter, EmitterSize), EmitterSize, &Series);
+        }
+
+        platform_api Platform = Memory.Platform;
+        Platform.WorkQueue = NULL;
+        Platform.nThreads = 1;
+        if (nThreads > 1) {
+            Platform.nThreads = InitWorkQueue(&Queues[nThreads - 1], ThreadInfos[nThreads - 1], nThreads);
+            Platform.WorkQueue = &Queues[nThreads - 1];
+        }
+
+        LARGE_INTEGER Frequency, Start, End;
+        QueryPerformanceFrequency(&Frequency);
+        QueryPerformanceCounter(&Start);
+        for (uint32 Frame = 0; Frame < nFrames; Frame++) {
+            UpdateParticles(&Platform, System, 1.0f / 60.0f);
+        }
+        QueryPerformanceCounter(&End);
+
+        double Milliseconds = 1000.0 * (End.QuadPart - Start.QuadPart) / (double)Frequency.QuadPart;
+        uint64 nParticles = (uint64)nEmitters * EmitterSize;
+        WriteParticleRow(stdout, Platform.nThreads, nEmitters, nParticles, nFrames, Milliseconds);
+        WriteParticleRow(File, Platform.nThreads, nEmitters, nParticles, nFrames, Milliseconds);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32 nFrames = argc > 1 ? atoi(argv[1]) : 300;
+
+    benchmark_config Configs[8] = {};
+    int nConfigs = 0;
+    if (argc > 5) {
+        Configs[nConfigs++] = { (uint32)atoi(argv[2]), (uint32)atoi(argv[3]), (uint32)atoi(argv[4]), (uint32)atoi(argv[5]), nFrames };
+    }
+    else {
+        for (int Shift = 6; Shift >= 0; Shift -= 2) {
+            benchmark_config Config = {};
+            Config.nCharacters = max(FULL_SCENE.nCharacters >> Shift, 1);
+            Config.nEnemies = FULL_SCENE.nEnemies >> Shift;
+            Config.nProps = max(FULL_SCENE.nProps >> Shift, 1);
+            Config.nWeapons = max(FULL_SCENE.nWeapons >> Shift, 2);
+            Config.nFrames = nFrames;
+            Configs[nConfigs++] = Config;
+        }
+    }
+
+    // Memory
+    memory_index PermanentStorageSize = Megabytes(512);
+    void* GameMemoryBlock = VirtualAlloc(0, PermanentStorageSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    Memory.Permanent = MemoryArena(PermanentStorageSize, (uint8*)GameMemoryBlock);
+    Memory.Transient = SuballocateMemoryArena(&Memory.Permanent, Megabytes(1));
+    memory_arena FontsArena = SuballocateMemoryArena(&Memory.Permanent, Megabytes(1));
+
+    Memory.Platform.FreeFileMemory = PlatformFreeFileMemory;
+    Memory.Platform.ReadEntireFile = PlatformReadEntireFile;
+    Memory.Platform.GetFileTimestamp = PlatformGetFileTimestamp;
+    Memory.Platform.WriteEntireFile = PlatformWriteEntireFile;
+    Memory.Platform.AppendToFile = PlatformAppendToFile;
+    Memory.Platform.RemoveFile = PlatformRemoveFile;
+
+    static platform_work_queue WorkQueue;
+    static win32_thread_info ThreadInfos[MAX_THREADS];
+    Memory.Platform.nThreads = InitWorkQueue(&WorkQueue, ThreadInfos);
+    Memory.Platform.WorkQueue = &WorkQueue;
+    Memory.Platform.AddWorkEntry = PlatformAddWorkEntry;
+    Memory.Platform.CompleteAllWork = PlatformCompleteAllWork;
+
+    // Assets are expected to be packed already, by running the game once
+    LoadAssetsFromFile(&FontsArena, Memory.Platform.ReadEntireFile, &Memory.Assets, "..\\GameAssets\\game_assets");
+    InitializeRenderGroup(&Memory.Permanent, &Memory.RenderGroup, &Memory.Assets);
+    memory_index ArenaMark = Memory.Permanent.Used;
+
+    FILE* File = NULL;
+    bool WriteHeader = fopen_s(&File, BENCHMARK_CSV_PATH, "r") != 0;
+    if (File) fclose(File);
+    if (fopen_s(&File, BENCHMARK_CSV_PATH, "a") != 0) {
+        printf("Could not open %s.\n", BENCHMARK_CSV_PATH);
+        return 1;
+    }
+    if (WriteHeader) fputs(BENCHMARK_CSV_HEADER, File);
+    fputs(BENCHMARK_CSV_HEADER, stdout);
+
+    for (int i = 0; i < nConfigs; i++) {
+        benchmark_result Result = RunBenchmark(Configs[i], ArenaMark);
+        ReportBenchmark(stdout, Configs[i], Result);
+        ReportBenchmark(File, Configs[i], Result);
+    }
+
+    fclose(File);
+
+    WriteHeader = fopen_s(&File, PARTICLE_CSV_PATH, "r") != 0;
+    if (File) fclose(File);
+    if (fopen_s(&File, PARTICLE_CSV_PATH, "a") != 0) {
+        printf("Could not open %s.\n", PARTICLE_CSV_PATH);
+        return 1;
+    }
+    if (WriteHeader) fputs(PARTICLE_CSV_HEADER, File);
+    fputs(PARTICLE_CSV_HEADER, stdout);
+    RunParticleBenchmark(File, nFrames, ArenaMark);
+
+    fclose(File);
+    return 0;
+}
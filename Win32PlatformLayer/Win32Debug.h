@@ -105,6 +105,11 @@ void Raise(const char* ErrorMessage) {
 #define TIMED_BLOCK_(Line) TIMED_BLOCK__(Line);
 #define TIMED_BLOCK TIMED_BLOCK_(__LINE__)
 
+// Same, for a block inside a function that should show up under its own name
+#define TIMED_NAMED_BLOCK__(Name, Line) timed_block TimedBlock_##Line(__COUNTER__, __FILE__, Line, Name)
+#define TIMED_NAMED_BLOCK_(Name, Line) TIMED_NAMED_BLOCK__(Name, Line);
+#define TIMED_NAMED_BLOCK(Name) TIMED_NAMED_BLOCK_(Name, __LINE__)
+
 struct time_record {
     uint64 CycleCount;
     
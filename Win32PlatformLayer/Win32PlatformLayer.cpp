@@ -398,8 +398,11 @@ void BeginRecordingInput(record_and_playback* RecordPlayback, int RecordIndex) {
     LPCSTR Filename = "foo.jgzr";
     RecordPlayback->RecordFile = CreateFileA(Filename, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
 
+    // Entity snapshot instead of the whole game memory, prefixed by its size
+    uint32 Size = WriteSnapshot(RecordPlayback->GameState, RecordPlayback->Snapshot, RecordPlayback->MaxSnapshotSize);
     DWORD BytesWritten;
-    WriteFile(RecordPlayback->RecordFile, RecordPlayback->GameMemoryBlock, RecordPlayback->TotalSize, &BytesWritten, 0);
+    WriteFile(RecordPlayback->RecordFile, &Size, sizeof(Size), &BytesWritten, 0);
+    WriteFile(RecordPlayback->RecordFile, RecordPlayback->Snapshot, Size, &BytesWritten, 0);
 }
 
 void EndRecordingInput(record_and_playback* RecordPlayback) {
@@ -417,10 +420,13 @@ void BeginInputPlayback(record_and_playback* RecordPlayback, int PlaybackIndex)
     LPCSTR Filename = "foo.jgzr";
     RecordPlayback->PlaybackFile = CreateFileA(Filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
 
-    DWORD BytesToRead = RecordPlayback->TotalSize;
+    uint32 Size = 0;
     DWORD BytesRead;
-    if (ReadFile(RecordPlayback->PlaybackFile, RecordPlayback->GameMemoryBlock, BytesToRead, &BytesRead, 0)) {
-
+    if (
+        ReadFile(RecordPlayback->PlaybackFile, &Size, sizeof(Size), &BytesRead, 0) && Size <= RecordPlayback->MaxSnapshotSize &&
+        ReadFile(RecordPlayback->PlaybackFile, RecordPlayback->Snapshot, Size, &BytesRead, 0) && BytesRead == Size
+    ) {
+        ReadSnapshot(RecordPlayback->GameState, RecordPlayback->Assets, RecordPlayback->Snapshot, Size);
     }
     else {
         Log(Error, "Reading game state failed.");
@@ -738,8 +744,18 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
     Memory.Platform.FreeFileMemory = PlatformFreeFileMemory;
     Memory.Platform.ReadEntireFile = PlatformReadEntireFile;
+    Memory.Platform.GetFileTimestamp = PlatformGetFileTimestamp;
     Memory.Platform.WriteEntireFile = PlatformWriteEntireFile;
     Memory.Platform.AppendToFile = PlatformAppendToFile;
+    Memory.Platform.RemoveFile = PlatformRemoveFile;
+
+    // Worker threads
+    static platform_work_queue WorkQueue;
+    static win32_thread_info ThreadInfos[MAX_THREADS];
+    Memory.Platform.nThreads = InitWorkQueue(&WorkQueue, ThreadInfos);
+    Memory.Platform.WorkQueue = &WorkQueue;
+    Memory.Platform.AddWorkEntry = PlatformAddWorkEntry;
+    Memory.Platform.CompleteAllWork = PlatformCompleteAllWork;
 
     game_state* pGameState = PushStruct(&Memory.Permanent, game_state);
     Memory.GameState = pGameState;
@@ -757,8 +773,10 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     record_and_playback RecordPlayback;
     RecordPlayback.PlaybackIndex = 0;
     RecordPlayback.RecordIndex = 0;
-    RecordPlayback.GameMemoryBlock = GameMemoryBlock;
-    RecordPlayback.TotalSize = PermanentStorageSize;
+    RecordPlayback.GameState = pGameState;
+    RecordPlayback.Assets = &Memory.Assets;
+    RecordPlayback.MaxSnapshotSize = MAX_SNAPSHOT_SIZE;
+    RecordPlayback.Snapshot = PushArray(&Memory.Permanent, MAX_SNAPSHOT_SIZE, uint8);
     
     render_group* Group = &Memory.RenderGroup;
     InitializeRenderGroup(
@@ -1039,8 +1057,8 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
         DEBUG_VALUE(UsedTime_ms, float);
         DEBUG_VALUE(UsedMCyclesPerFrame, float);
 
-        pGameState->dt = ActualSecsElapsed;
-        pGameState->Time += ActualSecsElapsed;
+        // The game advances Time itself in fixed ticks
+        pGameState->FrameDt = ActualSecsElapsed;
 
         float Time = pGameState->Time;
         DEBUG_VALUE(Time, float);
@@ -47,6 +47,15 @@ PLATFORM_READ_ENTIRE_FILE(PlatformReadEntireFile) {
     return Result;
 };
 
+PLATFORM_GET_FILE_TIMESTAMP(PlatformGetFileTimestamp) {
+    int64 Result = 0;
+    WIN32_FILE_ATTRIBUTE_DATA Data;
+    if (GetFileAttributesExA(Path, GetFileExInfoStandard, &Data)) {
+        *(FILETIME*)&Result = Data.ftLastWriteTime;
+    }
+    return Result;
+}
+
 PLATFORM_WRITE_ENTIRE_FILE(PlatformWriteEntireFile) {
     bool Result = false;
     HANDLE FileHandle = CreateFileA(Path, GENERIC_WRITE, NULL, NULL, CREATE_ALWAYS, NULL, NULL);
@@ -91,14 +100,107 @@ PLATFORM_APPEND_TO_FILE(PlatformAppendToFile) {
     return Result;
 }
 
+PLATFORM_REMOVE_FILE(PlatformRemoveFile) {
+    return DeleteFileA(Path) != 0;
+}
+
+// Work queue
+struct platform_work_queue_entry {
+    platform_work_queue_callback* Callback;
+    void* Data;
+};
+
+// Single producer (main thread), any thread consumes
+struct platform_work_queue {
+    uint32 volatile CompletionGoal;
+    uint32 volatile CompletionCount;
+    uint32 volatile NextEntryToWrite;
+    uint32 volatile NextEntryToRead;
+    HANDLE Semaphore;
+    platform_work_queue_entry Entries[1024];
+};
+
+struct win32_thread_info {
+    uint32 ThreadIndex;
+    platform_work_queue* Queue;
+};
+
+PLATFORM_ADD_WORK_ENTRY(PlatformAddWorkEntry) {
+    uint32 NewNextEntryToWrite = (Queue->NextEntryToWrite + 1) % ArrayCount(Queue->Entries);
+    Assert(NewNextEntryToWrite != Queue->NextEntryToRead, "Work queue is full.");
+    platform_work_queue_entry* Entry = &Queue->Entries[Queue->NextEntryToWrite];
+    Entry->Callback = Callback;
+    Entry->Data = Data;
+    Queue->CompletionGoal++;
+    _WriteBarrier();
+    Queue->NextEntryToWrite = NewNextEntryToWrite;
+    ReleaseSemaphore(Queue->Semaphore, 1, 0);
+}
+
+// Returns true when there was nothing to do
+bool DoNextWorkQueueEntry(platform_work_queue* Queue, uint32 ThreadIndex) {
+    uint32 OriginalNextEntryToRead = Queue->NextEntryToRead;
+    if (OriginalNextEntryToRead == Queue->NextEntryToWrite) return true;
+
+    uint32 NewNextEntryToRead = (OriginalNextEntryToRead + 1) % ArrayCount(Queue->Entries);
+    uint32 Index = InterlockedCompareExchange((LONG volatile*)&Queue->NextEntryToRead, NewNextEntryToRead, OriginalNextEntryToRead);
+    if (Index == OriginalNextEntryToRead) {
+        platform_work_queue_entry Entry = Queue->Entries[Index];
+        Entry.Callback(Queue, ThreadIndex, Entry.Data);
+        InterlockedIncrement((LONG volatile*)&Queue->CompletionCount);
+    }
+    return false;
+}
+
+PLATFORM_COMPLETE_ALL_WORK(PlatformCompleteAllWork) {
+    while (Queue->CompletionGoal != Queue->CompletionCount) {
+        DoNextWorkQueueEntry(Queue, 0);
+    }
+    Queue->CompletionGoal = 0;
+    Queue->CompletionCount = 0;
+}
+
+DWORD WINAPI WorkerThreadProc(LPVOID lpParameter) {
+    win32_thread_info* ThreadInfo = (win32_thread_info*)lpParameter;
+    while (true) {
+        if (DoNextWorkQueueEntry(ThreadInfo->Queue, ThreadInfo->ThreadIndex)) {
+            WaitForSingleObjectEx(ThreadInfo->Queue->Semaphore, INFINITE, FALSE);
+        }
+    }
+    return 0;
+}
+
+// One worker per logical core besides the main thread, up to MAX_THREADS in total
+uint32 InitWorkQueue(platform_work_queue* Queue, win32_thread_info* ThreadInfos, uint32 MaxThreads = MAX_THREADS) {
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+    uint32 nThreads = SystemInfo.dwNumberOfProcessors;
+    if (nThreads > MaxThreads) nThreads = MaxThreads;
+    if (nThreads > MAX_THREADS) nThreads = MAX_THREADS;
+    if (nThreads < 1) nThreads = 1;
+
+    *Queue = {};
+    Queue->Semaphore = CreateSemaphoreEx(0, 0, nThreads, 0, 0, SEMAPHORE_ALL_ACCESS);
+    for (uint32 i = 1; i < nThreads; i++) {
+        win32_thread_info* ThreadInfo = &ThreadInfos[i];
+        ThreadInfo->ThreadIndex = i;
+        ThreadInfo->Queue = Queue;
+        HANDLE ThreadHandle = CreateThread(0, 0, WorkerThreadProc, ThreadInfo, 0, 0);
+        CloseHandle(ThreadHandle);
+    }
+    return nThreads;
+}
+
 // Record and playback
 struct record_and_playback {
     HANDLE RecordFile;
     int RecordIndex;
     HANDLE PlaybackFile;
     int PlaybackIndex;
-    void* GameMemoryBlock;
-    uint64 TotalSize;
+    game_state* GameState;
+    game_assets* Assets;
+    uint8* Snapshot;
+    uint32 MaxSnapshotSize;
 };
 
 // Monitors
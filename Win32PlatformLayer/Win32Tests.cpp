@@ -0,0 +1,49 @@
+#include "pch.h"
+#include "GameLibrary.h"
+#include "Win32PlatformLayer.h"
+
+/*
+    Test runner. Runs every test in GameTest.h through RunTests with the work queue and file functions of the
+    platform layer, each one on a cleared arena. A failed Assert stops the run on the test that was printed last.
+
+    Usage:
+        Win32Tests.exe [Filter]
+
+    With a filter only the tests whose call contains it run, e.g. Win32Tests.exe Particle.
+*/
+
+game_memory Memory;
+
+// Every timed block is in the headers above
+time_record TimeRecordArray[__COUNTER__];
+
+int main(int argc, char** argv) {
+    // Memory
+    memory_index TestStorageSize = Megabytes(512);
+    void* TestMemoryBlock = VirtualAlloc(0, TestStorageSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+    Memory.Platform.FreeFileMemory = PlatformFreeFileMemory;
+    Memory.Platform.ReadEntireFile = PlatformReadEntireFile;
+    Memory.Platform.GetFileTimestamp = PlatformGetFileTimestamp;
+    Memory.Platform.WriteEntireFile = PlatformWriteEntireFile;
+    Memory.Platform.AppendToFile = PlatformAppendToFile;
+    Memory.Platform.RemoveFile = PlatformRemoveFile;
+
+    static platform_work_queue WorkQueue;
+    static win32_thread_info ThreadInfos[MAX_THREADS];
+    Memory.Platform.nThreads = InitWorkQueue(&WorkQueue, ThreadInfos);
+    Memory.Platform.WorkQueue = &WorkQueue;
+    Memory.Platform.AddWorkEntry = PlatformAddWorkEntry;
+    Memory.Platform.CompleteAllWork = PlatformCompleteAllWork;
+
+    test_context Test = {};
+    Test.Platform = &Memory.Platform;
+    Test.Arena = MemoryArena(TestStorageSize, (uint8*)TestMemoryBlock);
+    Test.Output = stdout;
+    Test.Filter = argc > 1 ? argv[1] : NULL;
+
+    RunTests(&Test);
+
+    printf("%u tests passed.\n", Test.nTests);
+    return 0;
+}
@@ -0,0 +1,29 @@
+@ECHO OFF
+
+@REM Environment variables
+call bat\env.bat
+
+@REM Compile headless benchmark (needs bin\pch.obj from pch.bat and the packed assets the game writes on startup)
+%COMPILE%^
+ /std:c++20^
+ Win32PlatformLayer\Win32Benchmark.cpp^
+ bin\pch.obj^
+ %DEBUG_FLAG%^
+ /Fe".\bin\Win32Benchmark.exe"^
+ /Fo".\bin\Win32Benchmark.obj"^
+ /Fd".\bin\vc140.pdb"^
+ /Yu"pch.h" /Fp"bin\pch.pch"^
+ /link^
+ kernel32.lib^
+ user32.lib^
+ avcodec.lib^
+ avformat.lib^
+ avutil.lib^
+ swscale.lib^
+ psapi.lib^
+ /MACHINE:X64
+
+@REM Run it from bin so asset paths resolve like the game's
+cd bin
+Win32Benchmark.exe %*
+cd ..
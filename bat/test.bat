@@ -0,0 +1,29 @@
+@ECHO OFF
+
+@REM Environment variables
+call bat\env.bat
+
+@REM Compile test runner (needs bin\pch.obj from pch.bat)
+%COMPILE%^
+ /std:c++20^
+ Win32PlatformLayer\Win32Tests.cpp^
+ bin\pch.obj^
+ %DEBUG_FLAG%^
+ /Fe".\bin\Win32Tests.exe"^
+ /Fo".\bin\Win32Tests.obj"^
+ /Fd".\bin\vc140.pdb"^
+ /Yu"pch.h" /Fp"bin\pch.pch"^
+ /link^
+ kernel32.lib^
+ user32.lib^
+ avcodec.lib^
+ avformat.lib^
+ avutil.lib^
+ swscale.lib^
+ psapi.lib^
+ /MACHINE:X64
+
+@REM Run it from bin so asset paths resolve like the game's
+cd bin
+Win32Tests.exe %*
+cd ..
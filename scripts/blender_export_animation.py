@@ -8,18 +8,27 @@ from mathutils import Vector # type: ignore
 class Bone:
     id: int
     name: str
+    parent: str
     head: Vector
     tail: Vector
 
 
+# Same ids as collect_bones in blender_export_vertices.py: depth first, children of excluded bones hang from the
+# closest exported ancestor.
 def collect_bones(armature) -> dict[str, Bone]:
     result = {}
     exclude = ['Knee', 'Wrist', 'Elbow', 'Heel']
-    id = 0
-    for bone_name, bone in armature.data.bones.items():
-        if bone_name.split("_")[0] not in exclude:
-            result[bone_name] = Bone(id, bone_name, bone.head_local, bone.tail_local)
-            id += 1
+
+    def visit(bone, parent):
+        if bone.name.split("_")[0] not in exclude:
+            result[bone.name] = Bone(len(result), bone.name, parent, bone.head_local, bone.tail_local)
+            parent = bone.name
+        for child in bone.children:
+            visit(child, parent)
+
+    for bone in armature.data.bones:
+        if bone.parent is None:
+            visit(bone, None)
     return result
 
 def export_animation(filepath):
@@ -36,21 +45,22 @@ def export_animation(filepath):
     
     lines = []
 
-    lines.append(f"nF {end_frame + 1} nB {len(bones)}")
+    lines.append(f"nF {end_frame + 1} nB {len(bones)} fps {scene.render.fps / scene.render.fps_base} local 1")
     
     for frame in range(start_frame, end_frame + 1):
         scene.frame_set(frame)
         
-        for pose_bone in armature.pose.bones:
-            if pose_bone.bone.name in bones:
-                id = bones[pose_bone.bone.name].id
-
-                bone_matrix = pose_bone.matrix.copy() @ pose_bone.bone.matrix_local.inverted()
-                translation = bone_matrix.translation
-                rotation = bone_matrix.to_quaternion()
-                scale = bone_matrix.to_scale()
-                
-                lines.append(f"{frame} {id} {translation.x} {translation.z} {translation.y} {rotation.w} {rotation.x} {rotation.z} {rotation.y} {scale.x} {scale.z} {scale.y}")        
+        # Pose relative to the exported parent, the game composes the hierarchy and applies the bind pose
+        for bone in bones.values():
+            pose_bone = armature.pose.bones[bone.name]
+            bone_matrix = pose_bone.matrix.copy()
+            if bone.parent is not None:
+                bone_matrix = armature.pose.bones[bone.parent].matrix.inverted() @ bone_matrix
+            translation = bone_matrix.translation
+            rotation = bone_matrix.to_quaternion()
+            scale = bone_matrix.to_scale()
+            
+            lines.append(f"{frame} {bone.id} {translation.x} {translation.z} {translation.y} {rotation.w} {rotation.x} {rotation.z} {rotation.y} {scale.x} {scale.z} {scale.y}")        
     
     with open(filepath, 'w') as f:
         f.write("\n".join(lines))
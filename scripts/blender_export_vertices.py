@@ -1,6 +1,6 @@
 from dataclasses import dataclass, field
 import bpy # type: ignore
-from mathutils import Vector # type: ignore
+from mathutils import Quaternion, Vector # type: ignore
 import os
 
 
@@ -8,8 +8,10 @@ import os
 class Bone:
     id: int
     name: str
+    parent: int
     head: Vector
     tail: Vector
+    rotation: Quaternion
 
 @dataclass
 class Vertex:
@@ -28,14 +30,23 @@ class Loop:
     uv: Vector
     order: int = -1
 
+# Depth first from the roots, so parents get lower ids than their children. Excluded bones are skipped and their
+# children hang from the closest exported ancestor. Must match collect_bones in blender_export_animation.py.
 def collect_bones(mesh) -> dict[str, Bone]:
     result = {}
     exclude = ['Knee', 'Wrist', 'Elbow', 'Heel']
-    id = 0
-    for bone_name, bone in mesh.parent.data.bones.items():
-        if bone_name.split("_")[0] not in exclude:
-            result[bone_name] = Bone(id, bone_name, bone.head_local, bone.tail_local)
-            id += 1
+
+    def visit(bone, parent):
+        if bone.name.split("_")[0] not in exclude:
+            rotation = bone.matrix_local.to_quaternion()
+            result[bone.name] = Bone(len(result), bone.name, parent, bone.head_local, bone.tail_local, rotation)
+            parent = result[bone.name].id
+        for child in bone.children:
+            visit(child, parent)
+
+    for bone in mesh.parent.data.bones:
+        if bone.parent is None:
+            visit(bone, -1)
     return result
 
 def consolidate_loops(loops: list[Loop]) -> list[Loop]:
@@ -144,13 +155,14 @@ def export_vertices(output_path):
     # Bones loop
     if nBones > 0:
         for bone in bones.values():
-            lines.append(f"{bone.id} {bone.name} {bone.head.x:.6f} {bone.head.z:.6f} {bone.head.y:.6f} {bone.tail.x:.6f} {bone.tail.z:.6f} {bone.tail.y:.6f}")
+            q = bone.rotation
+            lines.append(f"{bone.id} {bone.name} {bone.parent} {bone.head.x:.6f} {bone.head.z:.6f} {bone.head.y:.6f} {bone.tail.x:.6f} {bone.tail.z:.6f} {bone.tail.y:.6f} {q.w:.6f} {q.x:.6f} {q.z:.6f} {q.y:.6f}")
     
     # Exporting file
     with open(output_path, "w") as out_file:
         header = f"nV {nVertices} nF {nFaces}"
         if nBones > 0:
-            header += f" nB {nBones}"
+            header += f" nB {nBones} bind 1"
         header += "\n"
         out_file.write(header + "\n".join(lines))
         print(f"File {output_path} has been exported succesfully!")